@@ -27,6 +27,8 @@
 #include <component/intc.h>
 #include <arch/cpu-types.h>
 #include <irq/types.h>
+#include <arch/psci.h>
+#include <generated/autoconf.h>
 
 static irqret_t pmu_irq_handler(irq_t irq, void *data) {
     verbose_async("PMU overflow interrupt");
@@ -163,3 +165,18 @@ uint64_t arch_cpu_get_cycle_count(void) {
     asm("mrc p15, 0, %0, c9, c13, 0" : "=r" (v));
     return (((uint64_t) _laritos.arch_data.high_cycle_counter ) << 32) | v;
 }
+
+#ifdef CONFIG_SMP
+int arch_cpu_start_secondary(uint8_t id) {
+    // Entry point for the secondary cpus (see start.S)
+    extern void _secondary_start(void);
+
+    // cpu ids are the affinity level 0 of the MPIDR (single cluster)
+    int32_t ret = arch_psci_cpu_on(id, _secondary_start, 0);
+    if (ret != PSCI_RET_SUCCESS) {
+        error("PSCI CPU_ON failed for cpu %u, ret=%ld", id, ret);
+        return -1;
+    }
+    return 0;
+}
+#endif
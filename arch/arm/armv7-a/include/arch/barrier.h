@@ -1,5 +1,9 @@
 #pragma once
 
 static inline void arch_barrier_dmb(void) {
-    asm("dmb");
+    asm volatile("dmb" : : : "memory");
+}
+
+static inline void arch_barrier_dsb(void) {
+    asm("dsb" : : : "memory");
 }
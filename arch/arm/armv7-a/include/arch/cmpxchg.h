@@ -9,7 +9,8 @@ static inline bool arch_atomic_cmpxchg(volatile int *buf, int old, int new) {
 
     // volatile to prevent any gcc optimization on the assembly code
     asm volatile (
-        "1: ldrex %[lockv], [%[buf]]                \n"
+        "1: mov %[strex_failed], #1                 \n"
+        "   ldrex %[lockv], [%[buf]]                \n"
         "   cmp %[lockv], %[old]                    \n"
         "   bne 2f                                  \n"
         "   strex %[strex_failed], %[new], [%[buf]] \n"
@@ -19,4 +19,14 @@ typedef struct {
      * Trigger mode for the PMU irq
      */
     irq_trigger_mode_t pmu_irq_trigger;
+
+    /**
+     * Private peripheral interrupt of the generic virtual timer, used as the local tick
+     * of the cpu (the physical timer is left for the hrtimer component)
+     */
+    irq_t local_tick_irq;
+    irq_trigger_mode_t local_tick_irq_trigger;
+    uint32_t local_tick_period;
+    cpu_tick_cb_t local_tick_cb;
+    void *local_tick_data;
 } arm_cpu_t;
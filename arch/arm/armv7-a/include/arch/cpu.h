@@ -326,6 +326,23 @@ static inline uint8_t arch_cpu_get_id(void) {
     return v & 0b11;
 }
 
+/**
+ * The pointer of the thread running on the cpu is kept in TPIDRPRW (PL1 only software thread
+ * id register), so it isn't visible to user mode. TPIDRURO holds the exception temp stack
+ * instead (see start.S).
+ * Reading it takes a single instruction, so it is always consistent with the cpu the caller
+ * runs on, even if it is preempted and migrated right after.
+ */
+static inline void *arch_cpu_get_thread_ptr(void) {
+    void *ptr;
+    asm volatile("mrc p15, 0, %0, c13, c0, 4" : "=r" (ptr));
+    return ptr;
+}
+
+static inline void arch_cpu_set_thread_ptr(void *ptr) {
+    asm volatile("mcr p15, 0, %0, c13, c0, 4" : : "r" (ptr) : "memory");
+}
+
 static inline void arch_cpu_wfi(void) {
     insane_async("Putting CPU #%u to sleep", arch_cpu_get_id());
     asm("wfi");
@@ -347,3 +364,8 @@ static inline bool arch_cpu_is_user_mode(regpsr_t psr) {
 int arch_cpu_set_cycle_count_enable(bool enable);
 int arch_cpu_reset_cycle_count(void);
 uint64_t arch_cpu_get_cycle_count(void);
+
+/**
+ * Powers on the secondary cpu <id>, which starts executing the kernel at _secondary_start
+ */
+int arch_cpu_start_secondary(uint8_t id);
@@ -38,10 +38,32 @@ typedef struct {
     };
 } regcntpctl_t;
 
+/**
+ * The control register for the virtual timer has the same layout
+ */
+typedef regcntpctl_t regcntvctl_t;
+
 static inline void arch_set_cntfrq(uint32_t freq) {
     asm("mcr p15, 0, %0, c14, c0, 0" : : "r" (freq));
 }
 
+static inline uint32_t arch_get_cntfrq(void) {
+    uint32_t freq;
+    asm("mrc p15, 0, %0, c14, c0, 0" : "=r" (freq));
+    return freq;
+}
+
+static inline void arch_set_cntv_ctl(regcntvctl_t reg) {
+    asm("mcr p15, 0, %0, c14, c3, 1" : : "r" (reg));
+}
+
+/**
+ * Sets the virtual timer to expire <val> counter ticks from now
+ */
+static inline void arch_set_cntv_tval(uint32_t val) {
+    asm("mcr p15, 0, %0, c14, c3, 0" : : "r" (val));
+}
+
 static inline void arch_set_cntp_ctl(regcntpctl_t reg) {
     asm("mcr p15, 0, %0, c14, c2, 1" : : "r" (reg));
 }
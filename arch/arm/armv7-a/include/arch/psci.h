@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Power State Coordination Interface (ARM DEN 0022), SMC32 calling convention
+ */
+#define PSCI_FN_VERSION 0x84000000
+#define PSCI_FN_CPU_OFF 0x84000002
+#define PSCI_FN_CPU_ON 0x84000003
+
+#define PSCI_RET_SUCCESS 0
+#define PSCI_RET_NOT_SUPPORTED -1
+#define PSCI_RET_INVALID_PARAMETERS -2
+#define PSCI_RET_DENIED -3
+#define PSCI_RET_ALREADY_ON -4
+#define PSCI_RET_ON_PENDING -5
+#define PSCI_RET_INTERNAL_FAILURE -6
+
+/**
+ * Calls the PSCI firmware function <fn> (via HVC, or SMC if CONFIG_ARM_PSCI_CONDUIT_SMC)
+ *
+ * @return Value returned by the firmware in r0
+ */
+int32_t arch_psci_call(uint32_t fn, uint32_t arg0, uint32_t arg1, uint32_t arg2);
+
+/**
+ * Powers on the cpu with affinity <mpidr>, which will start executing at <entry> (physical
+ * address) in supervisor mode, with the MMU and caches off and <ctx> in r0
+ *
+ * @return PSCI_RET_SUCCESS on success, <0 otherwise
+ */
+static inline int32_t arch_psci_cpu_on(uint32_t mpidr, void *entry, uint32_t ctx) {
+    return arch_psci_call(PSCI_FN_CPU_ON, mpidr, (uint32_t) entry, ctx);
+}
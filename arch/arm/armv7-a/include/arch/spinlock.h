@@ -49,3 +49,20 @@ static inline int arch_spinlock_release(arch_spinlock_t *lock) {
 static inline bool arch_spinlock_is_locked(arch_spinlock_t *lock) {
     return *lock == 1;
 }
+
+/**
+ * Puts the cpu in low-power state until an event is signaled (see arch_spinlock_send_event())
+ * or an irq is raised. If an event was signaled since the last wait, it returns right away.
+ */
+static inline void arch_spinlock_wait_event(void) {
+    asm volatile("wfe" : : : "memory");
+}
+
+/**
+ * Wakes up the cpus waiting in arch_spinlock_wait_event()
+ */
+static inline void arch_spinlock_send_event(void) {
+    // Make sure the lock release is visible before waking up the waiters
+    dsb();
+    asm volatile("sev" : : : "memory");
+}
@@ -0,0 +1,40 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <arch/psci.h>
+#include <generated/autoconf.h>
+
+int32_t arch_psci_call(uint32_t fn, uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+    register uint32_t r0 asm("r0") = fn;
+    register uint32_t r1 asm("r1") = arg0;
+    register uint32_t r2 asm("r2") = arg1;
+    register uint32_t r3 asm("r3") = arg2;
+#ifdef CONFIG_ARM_PSCI_CONDUIT_SMC
+    asm volatile(".arch_extension sec\n"
+                 "smc #0" : "+r" (r0) : "r" (r1), "r" (r2), "r" (r3) : "memory");
+#else
+    asm volatile(".arch_extension virt\n"
+                 "hvc #0" : "+r" (r0) : "r" (r1), "r" (r2), "r" (r3) : "memory");
+#endif
+    return (int32_t) r0;
+}
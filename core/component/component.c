@@ -39,6 +39,7 @@ int component_init_global_context() {
     for (i = 0; i < ARRAYSIZE(_laritos.comps); i++) {
         INIT_LIST_HEAD(&_laritos.comps[i]);
     }
+    rwlock_init(&_laritos.comps_lock);
     return 0;
 }
 
@@ -127,17 +128,24 @@ static int remove_component_sysfs(component_t *c) {
 int component_register(component_t *comp) {
     debug("Registering component '%s' of type %d", comp->id, comp->type);
 
+    irqctx_t ctx;
+    rwlock_write_acquire(&_laritos.comps_lock, &ctx);
     // If it is the default component, then add it as the first element in the list
     if (comp->dflt) {
         list_add(&comp->list, &_laritos.comps[comp->type]);
     } else {
         list_add_tail(&comp->list, &_laritos.comps[comp->type]);
     }
+    rwlock_write_release(&_laritos.comps_lock, &ctx);
 
+    // The component may look up other components during its initialization, don't hold
+    // the lock here
     verbose("Initializing component '%s'", comp->id);
     if (comp->ops.init(comp) < 0) {
         error("Couldn't initialize component '%s'", comp->id);
+        rwlock_write_acquire(&_laritos.comps_lock, &ctx);
         list_del(&comp->list);
+        rwlock_write_release(&_laritos.comps_lock, &ctx);
         return -1;
     }
 
@@ -153,7 +161,10 @@ int component_unregister(component_t *comp) {
 
     remove_component_sysfs(comp);
 
+    irqctx_t ctx;
+    rwlock_write_acquire(&_laritos.comps_lock, &ctx);
     list_del(&comp->list);
+    rwlock_write_release(&_laritos.comps_lock, &ctx);
     if (comp->ops.deinit(comp) < 0) {
         error("Couldn't de-initialize component '%s'", comp->id);
     }
@@ -175,17 +186,29 @@ int component_set_info(component_t *comp, char *product, char *vendor, char *des
 }
 
 component_t *component_get_by_id(char *id) {
+    irqctx_t ctx;
+    rwlock_read_acquire(&_laritos.comps_lock, &ctx);
     component_t *c;
     for_each_component(c) {
         if (strncmp(c->id, id, COMPONENT_MAX_ID_LEN) == 0) {
+            rwlock_read_release(&_laritos.comps_lock, &ctx);
             return c;
         }
     }
+    rwlock_read_release(&_laritos.comps_lock, &ctx);
     return NULL;
 }
 
+component_t *component_get_first(component_type_t t) {
+    irqctx_t ctx;
+    rwlock_read_acquire(&_laritos.comps_lock, &ctx);
+    component_t *c = list_first_entry_or_null(&_laritos.comps[t], component_t, list);
+    rwlock_read_release(&_laritos.comps_lock, &ctx);
+    return c;
+}
+
 bool component_any_of(component_type_t t) {
-    return !list_empty(&_laritos.comps[t]);
+    return component_get_first(t) != NULL;
 }
 
 bool component_are_mandatory_comps_present(void) {
@@ -30,13 +30,18 @@
 #include <utils/utils.h>
 #include <utils/function.h>
 #include <mm/heap.h>
+#include <mm/kmem-cache.h>
 #include <sync/atomic.h>
+#include <sync/rcu.h>
+#include <sync/spinlock.h>
 #include <generated/autoconf.h>
 #include <irq/types.h>
 #include <fs/vfs/core.h>
 #include <fs/vfs/types.h>
 #include <fs/pseudofs.h>
 
+DEF_KMEM_CACHE(irq_handler_cache, "irq_handler", irq_handler_info_t, NULL, NULL);
+
 int intc_enable_irq_with_handler(intc_t *intc, irq_t irq, irq_trigger_mode_t tmode, irq_handler_t h, void *data) {
     if (intc->ops.set_irq_trigger_mode(intc, irq, tmode) < 0) {
         error("Failed to set trigger mode for irq %u", irq);
@@ -73,8 +78,9 @@ static irqret_t handle_irq(intc_t *intc, irq_t irq) {
 
     irqret_t ret = IRQ_RET_NOT_HANDLED;
 
+    // Irqs are disabled, this is already a read-side critical section
     irq_handler_info_t *hi;
-    list_for_each_entry(hi, &intc->handlers[irq], list) {
+    list_for_each_entry_rcu(hi, &intc->handlers[irq], list) {
         if (hi->h != NULL) {
             ret = hi->h(irq, hi->data);
             insane_async("irq %u processed with handler 0x%p(data=0x%p) = %s", irq, hi->h, hi->data, irq_get_irqret_str(ret));
@@ -92,6 +98,10 @@ static irqret_t handle_irq(intc_t *intc, irq_t irq) {
     return ret;
 }
 
+static void free_irq_handler(rcu_head_t *head) {
+    kmem_cache_free(&irq_handler_cache, container_of(head, irq_handler_info_t, rcu));
+}
+
 /**
  * Add an irq handler to process <irq>
  *
@@ -110,16 +120,7 @@ static int add_irq_handler(intc_t *intc, irq_t irq, irq_handler_t h, void *data)
         return -1;
     }
 
-    // Make sure the handler is not already there
-    irq_handler_info_t *hi;
-    list_for_each_entry(hi, &intc->handlers[irq], list) {
-        if (hi->h == h) {
-            verbose("Handler 0x%p(data=0x%p) for irq %u already setup, ignoring...", h, data, irq);
-            return 0;
-        }
-    }
-
-    hi = calloc(1, sizeof(irq_handler_info_t));
+    irq_handler_info_t *hi = kmem_cache_alloc(&irq_handler_cache);
     if (hi == NULL) {
         error("Couldn't allocate memory for irq_handler_info_t");
         return -1;
@@ -127,7 +128,21 @@ static int add_irq_handler(intc_t *intc, irq_t irq, irq_handler_t h, void *data)
     hi->h = h;
     hi->data = data;
     INIT_LIST_HEAD(&hi->list);
-    list_add_tail(&hi->list, &intc->handlers[irq]);
+
+    irqctx_t ctx;
+    spinlock_acquire(&intc->handlers_lock, &ctx);
+    // Make sure the handler is not already there
+    irq_handler_info_t *pos;
+    list_for_each_entry(pos, &intc->handlers[irq], list) {
+        if (pos->h == h) {
+            spinlock_release(&intc->handlers_lock, &ctx);
+            verbose("Handler 0x%p(data=0x%p) for irq %u already setup, ignoring...", h, data, irq);
+            kmem_cache_free(&irq_handler_cache, hi);
+            return 0;
+        }
+    }
+    list_add_tail_rcu(&hi->list, &intc->handlers[irq]);
+    spinlock_release(&intc->handlers_lock, &ctx);
     return 0;
 }
 
@@ -137,15 +152,19 @@ static int remove_irq_handler(intc_t *intc, irq_t irq, irq_handler_t h) {
         error("Invalid irq %u, max_supported: %u", irq, CONFIG_INT_MAX_IRQS);
         return -1;
     }
+    irqctx_t ctx;
+    spinlock_acquire(&intc->handlers_lock, &ctx);
     irq_handler_info_t *hi;
-    irq_handler_info_t *hitemp;
-    list_for_each_entry_safe(hi, hitemp, &intc->handlers[irq], list) {
+    list_for_each_entry(hi, &intc->handlers[irq], list) {
         if (hi->h == h) {
-            list_del(&hi->list);
-            free(hi);
+            list_del_rcu(&hi->list);
+            spinlock_release(&intc->handlers_lock, &ctx);
+            // Another cpu may be running the handler right now
+            call_rcu(&hi->rcu, free_irq_handler);
             return 0;
         }
     }
+    spinlock_release(&intc->handlers_lock, &ctx);
     return 0;
 }
 
@@ -154,6 +173,7 @@ DEF_NOT_IMPL_FUNC(ni_set_irq_trigger_mode, intc_t *intc, irq_t irq, irq_trigger_
 DEF_NOT_IMPL_FUNC(ni_set_irq_target_cpus, intc_t *intc, irq_t irq, cpubits_t bits);
 DEF_NOT_IMPL_FUNC(ni_set_irqs_enable_for_this_cpu, intc_t *intc, bool enabled);
 DEF_NOT_IMPL_FUNC(ni_set_priority_filter, intc_t *intc, uint8_t lowest_prio);
+DEF_NOT_IMPL_FUNC(ni_send_sgi, intc_t *intc, irq_t irq, cpubits_t targets);
 
 
 
@@ -204,6 +224,7 @@ int intc_component_init(intc_t *intc, char *id, board_comp_t *bcomp,
     intc->ops.set_irq_target_cpus = ni_set_irq_target_cpus;
     intc->ops.set_irqs_enable_for_this_cpu = ni_set_irqs_enable_for_this_cpu;
     intc->ops.set_priority_filter = ni_set_priority_filter;
+    intc->ops.send_sgi = ni_send_sgi;
     intc->ops.add_irq_handler = add_irq_handler;
     intc->ops.remove_irq_handler = remove_irq_handler;
 
@@ -211,6 +232,7 @@ int intc_component_init(intc_t *intc, char *id, board_comp_t *bcomp,
     for (i = 0; i < ARRAYSIZE(intc->handlers); i++) {
         INIT_LIST_HEAD(&intc->handlers[i]);
     }
+    spinlock_init(&intc->handlers_lock);
 
     for (i = 0; i < ARRAYSIZE(intc->irq_count); i++) {
         atomic32_init(&intc->irq_count[i], 0);
@@ -34,38 +34,63 @@
 #include <math.h>
 #include <dstruct/list.h>
 #include <mm/heap.h>
+#include <mm/kmem-cache.h>
+#include <sync/rcu.h>
+#include <sync/spinlock.h>
 
 
-static int ticker_cb(vrtimer_comp_t *t, void *data) {
-    // Increment global tick
-    tick_inc_os_ticks();
+DEF_KMEM_CACHE(ticker_cb_cache, "ticker_cb", ticker_cb_info_t, NULL, NULL);
 
-    ticker_comp_t *ticker = (ticker_comp_t *) data;
+void ticker_run_callbacks(ticker_comp_t *t) {
+    // Always runs in irq context, i.e. already a read-side critical section. A callback may
+    // remove itself (or any other one) while the list is being walked
     ticker_cb_info_t *ti;
-    list_for_each_entry(ti, &ticker->cbs, list) {
+    list_for_each_entry_rcu(ti, &t->cbs, list) {
         insane_async("Executing ticker callback 0x%p(data=0x%p)", ti->cb, ti->data);
-        if (ti->cb(ticker, ti->data) < 0) {
+        if (ti->cb(t, ti->data) < 0) {
             error_async("Failed to execute callback 0x%p(data=0x%p)", ti->cb, ti->data);
         }
     }
+}
+
+static int ticker_cb(vrtimer_comp_t *t, void *data) {
+    // Increment global tick
+    tick_inc_os_ticks();
+
+    ticker_comp_t *ticker = (ticker_comp_t *) data;
+#ifdef CONFIG_TICKER_NOHZ_IDLE
+    t->hrtimer->ops.get_value(t->hrtimer, &ticker->last_tick_hrticks);
+#endif
 
+    ticker_run_callbacks(ticker);
     return 0;
 }
 
+/**
+ * @return Number of hrtimer ticks per OS tick
+ */
+static inline tick_t get_period(ticker_comp_t *t) {
+    tick_t timer_ticks = t->vrtimer->hrtimer->curfreq / t->ticks_per_sec;
+    // If the timer resolution cannot handle the required ticks_per_sec, then
+    // expire at the next tick
+    return timer_ticks > 0 ? timer_ticks : 1;
+}
+
 static int ticker_pause(ticker_comp_t *t) {
     verbose_async("Pausing ticker '%s'", ((component_t *) t)->id);
+#ifdef CONFIG_TICKER_NOHZ_IDLE
+    t->running = false;
+#endif
     return t->vrtimer->ops.remove_vrtimer(t->vrtimer, ticker_cb, t, true);
 }
 
 static int ticker_resume(ticker_comp_t *t) {
     verbose_async("Resuming ticker '%s'", ((component_t *) t)->id);
-    tick_t timer_ticks = t->vrtimer->hrtimer->curfreq / t->ticks_per_sec;
-    if (timer_ticks == 0) {
-        // If the timer resolution cannot handle the required ticks_per_sec, then
-        // expire at the next tick
-        timer_ticks = 1;
-    }
-    return t->vrtimer->ops.add_vrtimer(t->vrtimer, timer_ticks, ticker_cb, t, true);
+#ifdef CONFIG_TICKER_NOHZ_IDLE
+    t->running = true;
+    t->vrtimer->hrtimer->ops.get_value(t->vrtimer->hrtimer, &t->last_tick_hrticks);
+#endif
+    return t->vrtimer->ops.add_vrtimer(t->vrtimer, get_period(t), ticker_cb, t, true);
 }
 
 int ticker_init(ticker_comp_t *t) {
@@ -74,6 +99,7 @@ int ticker_init(ticker_comp_t *t) {
     tick_reset_os_ticks();
 
     INIT_LIST_HEAD(&t->cbs);
+    spinlock_init(&t->cbs_lock);
 
     return 0;
 }
@@ -85,7 +111,7 @@ int ticker_deinit(ticker_comp_t *t) {
 static int add_callback(ticker_comp_t *t, ticker_cb_t cb, void *data) {
     verbose_async("Adding ticker callback 0x%p(data=0x%p)", cb, data);
 
-    ticker_cb_info_t *ti = calloc(1, sizeof(ticker_cb_info_t));
+    ticker_cb_info_t *ti = kmem_cache_alloc(&ticker_cb_cache);
     if (ti == NULL) {
         error("Couldn't allocate memory for ticker_cb_info_t");
         return -1;
@@ -95,21 +121,32 @@ static int add_callback(ticker_comp_t *t, ticker_cb_t cb, void *data) {
     ti->data = data;
     INIT_LIST_HEAD(&ti->list);
 
-    list_add_tail(&ti->list, &t->cbs);
+    irqctx_t ctx;
+    spinlock_acquire(&t->cbs_lock, &ctx);
+    list_add_tail_rcu(&ti->list, &t->cbs);
+    spinlock_release(&t->cbs_lock, &ctx);
     return 0;
 }
 
+static void free_callback(rcu_head_t *head) {
+    kmem_cache_free(&ticker_cb_cache, container_of(head, ticker_cb_info_t, rcu));
+}
+
 static int remove_callback(ticker_comp_t *t, ticker_cb_t cb, void *data) {
+    irqctx_t ctx;
+    spinlock_acquire(&t->cbs_lock, &ctx);
     ticker_cb_info_t *pos;
-    ticker_cb_info_t *tmp;
-    list_for_each_entry_safe(pos, tmp, &t->cbs, list) {
+    list_for_each_entry(pos, &t->cbs, list) {
         if (pos->cb == cb && pos->data == data) {
             verbose_async("Removing ticker callback 0x%p(data=0x%p)", cb, data);
-            list_del(&pos->list);
-            free(pos);
-            break;
+            list_del_rcu(&pos->list);
+            spinlock_release(&t->cbs_lock, &ctx);
+            // The ticker may be running it right now (e.g. a callback removing itself)
+            call_rcu(&pos->rcu, free_callback);
+            return 0;
         }
     }
+    spinlock_release(&t->cbs_lock, &ctx);
     return 0;
 }
 
@@ -157,6 +194,57 @@ int ticker_start_all(void) {
 }
 
 
+#ifdef CONFIG_TICKER_NOHZ_IDLE
+int ticker_nohz_enter_all(void) {
+    component_t *comp;
+    for_each_component_type(comp, COMP_TYPE_TICKER) {
+        ticker_comp_t *ticker = (ticker_comp_t *) comp;
+        if (!ticker->running) {
+            continue;
+        }
+        insane_async("Stopping ticker '%s' while idle", comp->id);
+        if (ticker_pause(ticker) < 0) {
+            error_async("Could not stop ticker %s", comp->id);
+            return -1;
+        }
+        ticker->nohz_stopped = true;
+    }
+    return 0;
+}
+
+int ticker_nohz_exit_all(void) {
+    component_t *comp;
+    for_each_component_type(comp, COMP_TYPE_TICKER) {
+        ticker_comp_t *ticker = (ticker_comp_t *) comp;
+        if (!ticker->nohz_stopped) {
+            continue;
+        }
+        ticker->nohz_stopped = false;
+
+        abstick_t now;
+        if (ticker->vrtimer->hrtimer->ops.get_value(ticker->vrtimer->hrtimer, &now) < 0) {
+            error_async("Failed to read hrtimer value");
+            return -1;
+        }
+
+        // Account the ticks we missed, keep the remainder for the next time so that the
+        // OS ticks don't drift behind after many idle periods
+        tick_t period = get_period(ticker);
+        abstick_t elapsed = now - ticker->last_tick_hrticks + ticker->nohz_residue;
+        abstick_t skipped = elapsed / period;
+        ticker->nohz_residue = elapsed - skipped * period;
+        tick_add_os_ticks(skipped);
+        insane_async("Restarting ticker '%s', %lu ticks skipped", comp->id, (uint32_t) skipped);
+
+        if (ticker_resume(ticker) < 0) {
+            error_async("Could not restart ticker %s", comp->id);
+            return -1;
+        }
+    }
+    return 0;
+}
+#endif
+
 
 #ifdef CONFIG_TEST_CORE_COMPONENT_TICKER
 #include __FILE__
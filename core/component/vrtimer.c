@@ -31,11 +31,24 @@
 #include <utils/function.h>
 #include <dstruct/list.h>
 #include <mm/heap.h>
+#include <mm/kmem-cache.h>
 #include <sync/spinlock.h>
+#include <cpu/core.h>
+#include <cpu/smp.h>
+
+DEF_KMEM_CACHE(vrtimer_cache, "vrtimer", vrtimer_t, NULL, NULL);
 
 static int vrtimer_cb(timer_comp_t *t, void *data);
 
 static void update_expiration_locked(vrtimer_comp_t *t) {
+#ifdef CONFIG_SMP
+    if (cpu_get_id() != t->cpu) {
+        // Let the cpu that owns the hrtimer program it (see vrtimer_update_expiration())
+        smp_send_vrtimer_update(t->cpu);
+        return;
+    }
+#endif
+
     if (list_empty(&t->timers)) {
         t->hrtimer->ops.clear_expiration(t->hrtimer);
         t->low_power_timer->ops.clear_expiration(t->low_power_timer);
@@ -116,7 +129,7 @@ static int vrtimer_cb(timer_comp_t *tcomp, void *data) {
                 pos->abs_ticks = curticks + pos->ticks;
                 add_vrtimer_sorted_locked(vrt, pos);
             } else {
-                free(pos);
+                kmem_cache_free(&vrtimer_cache, pos);
             }
         } else {
             break;
@@ -131,7 +144,7 @@ static int vrtimer_cb(timer_comp_t *tcomp, void *data) {
 }
 
 static int add_vrtimer(vrtimer_comp_t *t, tick_t ticks, vrtimer_cb_t cb, void *data, bool periodic) {
-    vrtimer_t *vrt = calloc(1, sizeof(vrtimer_t));
+    vrtimer_t *vrt = kmem_cache_alloc(&vrtimer_cache);
     if (vrt == NULL) {
         error_async("Couldn't allocate memory for vrtimer_t");
         return -1;
@@ -171,7 +184,9 @@ static int remove_vrtimer(vrtimer_comp_t *t, vrtimer_cb_t cb, void *data, bool p
         if (pos->cb == cb && pos->data == data && pos->periodic == periodic) {
             verbose_async("Removing vrtimer with cb=0x%p, data=0x%p, periodic=%u", cb, data, periodic);
             list_del(&pos->list);
-            free(pos);
+            kmem_cache_free(&vrtimer_cache, pos);
+            // Don't wake up for a timer that is no longer there
+            update_expiration_locked(t);
             break;
         }
     }
@@ -180,9 +195,17 @@ static int remove_vrtimer(vrtimer_comp_t *t, vrtimer_cb_t cb, void *data, bool p
     return 0;
 }
 
+void vrtimer_update_expiration(vrtimer_comp_t *t) {
+    irqctx_t ctx;
+    spinlock_acquire(&t->lock, &ctx);
+    update_expiration_locked(t);
+    spinlock_release(&t->lock, &ctx);
+}
+
 int vrtimer_init(vrtimer_comp_t *t) {
     INIT_LIST_HEAD(&t->timers);
     spinlock_init(&t->lock);
+    t->cpu = cpu_get_id();
     info("High-res timer frequency: %lu HZ", t->hrtimer->curfreq);
     info("Low power timer frequency: %lu HZ", t->low_power_timer->curfreq);
     return 0;
@@ -0,0 +1,273 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <core.h>
+#include <assert.h>
+#include <cpu/core.h>
+#include <cpu/smp.h>
+#include <process/core.h>
+#include <sched/core.h>
+#include <sched/workqueue.h>
+#include <component/component.h>
+#include <component/cpu.h>
+#include <component/intc.h>
+#include <irq/types.h>
+#include <component/timer.h>
+#include <component/ticker.h>
+#include <component/vrtimer.h>
+#include <sync/spinlock.h>
+#include <sync/atomic.h>
+#include <generated/autoconf.h>
+
+/**
+ * Note: The queue of <cpuid> doesn't need to be locked, the result is then just an estimate
+ *
+ * @return Number of processes (other than idle) running or waiting to run on <cpuid>
+ */
+static inline uint32_t get_load(uint8_t cpuid) {
+    pcb_t *running = *CPU_LOCAL_GET_PTR_FOR_CPU(_laritos.sched.running, cpuid);
+    // The idle process is either the one running or waiting in the queue
+    uint32_t load = sched_get_rq_of_cpu_locked(cpuid)->nready + (running != NULL ? 1 : 0);
+    return load > 0 ? load - 1 : 0;
+}
+
+/**
+ * Pulls one READY process from the busiest online cpu, as long as it has at least two
+ * processes more than <cpuid>. Every cpu runs this periodically, so the load spreads one
+ * process at a time.
+ *
+ * The busiest cpu is found without any lock, only the two queues involved are locked to
+ * double-check the imbalance and move the process
+ *
+ * @return true if a process was moved to the ready queue of <cpuid>
+ */
+static bool pull_from_busiest(uint8_t cpuid) {
+    uint8_t busiest = cpuid;
+    uint32_t maxload = 0;
+    uint8_t i;
+    for (i = 0; i < CONFIG_CPU_MAX_CPUS; i++) {
+        if (i == cpuid || !(_laritos.sched.online & BIT_FOR_CPU(i))) {
+            continue;
+        }
+        uint32_t load = get_load(i);
+        if (load > maxload) {
+            maxload = load;
+            busiest = i;
+        }
+    }
+
+    if (busiest == cpuid || maxload < get_load(cpuid) + 2) {
+        return false;
+    }
+
+    irqctx_t ctx;
+    irqctx_t busiestctx;
+    sched_rq_double_lock(cpuid, busiest, &ctx, &busiestctx);
+    pcb_t *pcb = NULL;
+    if (get_load(busiest) >= get_load(cpuid) + 2) {
+        pcb = sched_rq_first_migratable_locked(sched_get_rq_of_cpu_locked(busiest), cpuid);
+        if (pcb != NULL) {
+            sched_migrate_locked(pcb, cpuid);
+            atomic32_inc(&_laritos.stats.migrations);
+        }
+    }
+    sched_rq_double_unlock(cpuid, busiest, &ctx, &busiestctx);
+    return pcb != NULL;
+}
+
+static int balance_ticker_cb(ticker_comp_t *t, void *data) {
+    tick_t *countdown = CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.balance_countdown);
+    if (*countdown > 1) {
+        (*countdown)--;
+        return 0;
+    }
+    *countdown = CONFIG_SMP_BALANCE_PERIOD;
+
+    uint8_t cpuid = cpu_get_id();
+    if ((_laritos.sched.online & BIT_FOR_CPU(cpuid)) && pull_from_busiest(cpuid)) {
+        // Let the scheduler decide whether the newcomer should run right away
+        *CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.need_sched) = true;
+    }
+    return 0;
+}
+
+static irqret_t resched_ipi_handler(irq_t irq, void *data) {
+    // The re-schedule itself takes place on the way out of the irq
+    *CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.need_sched) = true;
+    return IRQ_RET_HANDLED;
+}
+
+static irqret_t vrtimer_ipi_handler(irq_t irq, void *data) {
+    uint8_t cpuid = cpu_get_id();
+    // The vrtimers are board components, registered before any secondary cpu is online
+    component_t *comp;
+    for_each_component_type(comp, COMP_TYPE_VRTIMER) {
+        vrtimer_comp_t *t = (vrtimer_comp_t *) comp;
+        if (t->cpu == cpuid) {
+            vrtimer_update_expiration(t);
+        }
+    }
+    return IRQ_RET_HANDLED;
+}
+
+void smp_send_resched(uint8_t cpuid) {
+    cpu_t *c = *CPU_LOCAL_GET_PTR_FOR_CPU(_laritos.cpu, cpuid);
+    if (c == NULL || c->intc->ops.send_sgi(c->intc, SMP_IPI_RESCHED, BIT_FOR_CPU(cpuid)) < 0) {
+        error_async("Couldn't send re-schedule ipi to cpu #%u", cpuid);
+    }
+}
+
+void smp_send_vrtimer_update(uint8_t cpuid) {
+    cpu_t *c = *CPU_LOCAL_GET_PTR_FOR_CPU(_laritos.cpu, cpuid);
+    if (c == NULL || c->intc->ops.send_sgi(c->intc, SMP_IPI_VRTIMER, BIT_FOR_CPU(cpuid)) < 0) {
+        error_async("Couldn't send vrtimer ipi to cpu #%u", cpuid);
+    }
+}
+
+/**
+ * SGIs are banked, every cpu enables its own
+ */
+static int enable_ipis(cpu_t *c) {
+    if (c->intc->ops.add_irq_handler(c->intc, SMP_IPI_RESCHED, resched_ipi_handler, NULL) < 0 ||
+            c->intc->ops.set_irq_enable(c->intc, SMP_IPI_RESCHED, true) < 0) {
+        return -1;
+    }
+    if (c->intc->ops.add_irq_handler(c->intc, SMP_IPI_VRTIMER, vrtimer_ipi_handler, NULL) < 0) {
+        return -1;
+    }
+    return c->intc->ops.set_irq_enable(c->intc, SMP_IPI_VRTIMER, true);
+}
+
+/**
+ * The secondary cpus don't drive the OS tickers (which keep the global time), instead
+ * they replay the callbacks of the default ticker (scheduler ticks, load balancing, etc)
+ * from their own private tick
+ */
+static int local_tick_cb(cpu_t *c, void *data) {
+    ticker_run_callbacks((ticker_comp_t *) data);
+    return 0;
+}
+
+void smp_secondary_entry(void) {
+    uint8_t id = cpu_get_id();
+    cpu_t *c = cpu();
+
+    // The idle process of this cpu was spawned before powering it on. It is the current
+    // process from now on, locks and logs rely on having one in process mode
+    pcb_t *idle = *CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.idle);
+    process_set_current(idle);
+
+    // The distributor is already configured by the boot cpu, but the cpu interface
+    // registers are banked
+    if (c->intc->ops.set_priority_filter(c->intc, 0xff) < 0) {
+        error_async("Failed to set the irq priority filter for cpu #%u", id);
+    }
+    assert(cpu_initialize() >= 0, "Failed to initialize cpu #%u", id);
+    assert(enable_ipis(c) >= 0, "Failed to enable ipis on cpu #%u", id);
+
+    component_t *comp;
+    for_each_component_type(comp, COMP_TYPE_HRTIMER) {
+        timer_comp_t *t = (timer_comp_t *) comp;
+        if (t->ops.init_cpu != NULL && t->ops.init_cpu(t) < 0) {
+            error_async("Failed to initialize timer '%s' for cpu #%u", comp->id, id);
+        }
+    }
+
+    assert(sched_attach_cpu(c) >= 0, "Failed to attach scheduler to cpu #%u", id);
+
+    ticker_comp_t *ticker = component_get_default(COMP_TYPE_TICKER, ticker_comp_t);
+    assert(c->ops.set_local_tick != NULL, "cpu #%u doesn't support a local tick", id);
+    assert(c->ops.set_local_tick(c, ticker->ticks_per_sec, local_tick_cb, ticker) >= 0,
+            "Failed to start the local tick of cpu #%u", id);
+
+    irqctx_t ctx;
+    spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
+    _laritos.sched.online |= BIT_FOR_CPU(id);
+    spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
+
+    info_async("cpu #%u online", id);
+
+    // Irqs will be enabled by the context of the idle process
+    sched_execute_first_system_proc(idle);
+    // Execution will never reach this point
+}
+
+int smp_boot_secondary_cpus(void) {
+    uint8_t boot = cpu_get_id();
+
+    irqctx_t ctx;
+    spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
+    _laritos.sched.online = BIT_FOR_CPU(boot);
+    spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
+
+    if (enable_ipis(cpu()) < 0) {
+        error("Couldn't enable ipis on cpu #%u", boot);
+        return -1;
+    }
+
+    ticker_comp_t *ticker = component_get_default(COMP_TYPE_TICKER, ticker_comp_t);
+    if (ticker->ops.add_callback(ticker, balance_ticker_cb, NULL) < 0) {
+        error("Couldn't setup the load balancer");
+        return -1;
+    }
+
+    // Spawn the idle processes before any secondary cpu comes online, so that they are
+    // already pinned by the time the load balancer starts moving processes around
+    component_t *comp;
+    for_each_component_type(comp, COMP_TYPE_CPU) {
+        cpu_t *c = (cpu_t *) comp;
+        if (c->id == boot || c->id >= CONFIG_CPU_MAX_CPUS) {
+            continue;
+        }
+        if (idle_launch_on_cpu(c->id) == NULL) {
+            error("Couldn't launch idle process for cpu #%u", c->id);
+            return -1;
+        }
+        if (workqueue_launch_on_cpu(c->id) < 0) {
+            error("Couldn't launch workqueue workers for cpu #%u", c->id);
+            return -1;
+        }
+    }
+
+    int ret = 0;
+    for_each_component_type(comp, COMP_TYPE_CPU) {
+        cpu_t *c = (cpu_t *) comp;
+        if (c->id == boot || c->id >= CONFIG_CPU_MAX_CPUS) {
+            continue;
+        }
+        info("Starting cpu #%u", c->id);
+        if (cpu_start_secondary(c->id) < 0) {
+            error("Couldn't start cpu #%u", c->id);
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+
+#ifdef CONFIG_TEST_CORE_CPU_SMP
+#include __FILE__
+#endif
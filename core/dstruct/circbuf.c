@@ -106,9 +106,9 @@ static int do_circbuf_read(circbuf_t *cb, void *buf, size_t n, bool blocking, bo
     } else {
         cb->head = (cb->head + n) % cb->size;
         cb->datalen -= n;
-        spinlock_release(&cb->lock, &ctx);
         // Notify writers there is some space available for storing data
         condition_notify_all_locked(&cb->space_avail_cond);
+        spinlock_release(&cb->lock, &ctx);
     }
 
     return n;
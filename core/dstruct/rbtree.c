@@ -0,0 +1,276 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <dstruct/rbtree.h>
+
+static inline bool is_red(const rbnode_t *n) {
+    return n != NULL && n->red;
+}
+
+/**
+ * Makes <new> take the place of <old> in <old>'s parent (or as the root)
+ */
+static inline void replace_child(rbtree_t *t, rbnode_t *old, rbnode_t *new) {
+    rbnode_t *p = old->parent;
+    if (p == NULL) {
+        t->root = new;
+    } else if (p->left == old) {
+        p->left = new;
+    } else {
+        p->right = new;
+    }
+}
+
+static void rotate_left(rbtree_t *t, rbnode_t *x) {
+    rbnode_t *y = x->right;
+    x->right = y->left;
+    if (y->left != NULL) {
+        y->left->parent = x;
+    }
+    replace_child(t, x, y);
+    y->parent = x->parent;
+    y->left = x;
+    x->parent = y;
+}
+
+static void rotate_right(rbtree_t *t, rbnode_t *x) {
+    rbnode_t *y = x->left;
+    x->left = y->right;
+    if (y->right != NULL) {
+        y->right->parent = x;
+    }
+    replace_child(t, x, y);
+    y->parent = x->parent;
+    y->right = x;
+    x->parent = y;
+}
+
+static void insert_fixup(rbtree_t *t, rbnode_t *n) {
+    while (is_red(n->parent)) {
+        rbnode_t *p = n->parent;
+        // A red node is never the root, so the grandparent always exists
+        rbnode_t *g = p->parent;
+        if (p == g->left) {
+            rbnode_t *u = g->right;
+            if (is_red(u)) {
+                p->red = false;
+                u->red = false;
+                g->red = true;
+                n = g;
+                continue;
+            }
+            if (n == p->right) {
+                rotate_left(t, p);
+                n = p;
+                p = n->parent;
+            }
+            p->red = false;
+            g->red = true;
+            rotate_right(t, g);
+        } else {
+            rbnode_t *u = g->left;
+            if (is_red(u)) {
+                p->red = false;
+                u->red = false;
+                g->red = true;
+                n = g;
+                continue;
+            }
+            if (n == p->left) {
+                rotate_right(t, p);
+                n = p;
+                p = n->parent;
+            }
+            p->red = false;
+            g->red = true;
+            rotate_left(t, g);
+        }
+    }
+    t->root->red = false;
+}
+
+void rbtree_insert(rbtree_t *t, rbnode_t *n, rbtree_less_t less) {
+    rbnode_t *parent = NULL;
+    rbnode_t **link = &t->root;
+    bool leftmost = true;
+
+    while (*link != NULL) {
+        parent = *link;
+        if (less(n, parent)) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = false;
+        }
+    }
+
+    n->parent = parent;
+    n->left = NULL;
+    n->right = NULL;
+    n->red = true;
+    *link = n;
+
+    if (leftmost) {
+        t->leftmost = n;
+    }
+
+    insert_fixup(t, n);
+}
+
+/**
+ * Restores the red-black properties after removing a black node.
+ *
+ * <x> is the node that took the place of the removed one (may be NULL) and <parent> its parent
+ */
+static void remove_fixup(rbtree_t *t, rbnode_t *x, rbnode_t *parent) {
+    while (x != t->root && !is_red(x)) {
+        // x is "doubly black", hence its sibling w always exists
+        if (x == parent->left) {
+            rbnode_t *w = parent->right;
+            if (is_red(w)) {
+                w->red = false;
+                parent->red = true;
+                rotate_left(t, parent);
+                w = parent->right;
+            }
+            if (!is_red(w->left) && !is_red(w->right)) {
+                w->red = true;
+                x = parent;
+                parent = x->parent;
+            } else {
+                if (!is_red(w->right)) {
+                    w->left->red = false;
+                    w->red = true;
+                    rotate_right(t, w);
+                    w = parent->right;
+                }
+                w->red = parent->red;
+                parent->red = false;
+                w->right->red = false;
+                rotate_left(t, parent);
+                x = t->root;
+            }
+        } else {
+            rbnode_t *w = parent->left;
+            if (is_red(w)) {
+                w->red = false;
+                parent->red = true;
+                rotate_right(t, parent);
+                w = parent->left;
+            }
+            if (!is_red(w->left) && !is_red(w->right)) {
+                w->red = true;
+                x = parent;
+                parent = x->parent;
+            } else {
+                if (!is_red(w->left)) {
+                    w->right->red = false;
+                    w->red = true;
+                    rotate_left(t, w);
+                    w = parent->left;
+                }
+                w->red = parent->red;
+                parent->red = false;
+                w->left->red = false;
+                rotate_right(t, parent);
+                x = t->root;
+            }
+        }
+    }
+    if (x != NULL) {
+        x->red = false;
+    }
+}
+
+void rbtree_remove(rbtree_t *t, rbnode_t *n) {
+    if (t->leftmost == n) {
+        t->leftmost = rbtree_next(n);
+    }
+
+    rbnode_t *child;
+    rbnode_t *parent;
+    bool removed_red;
+
+    if (n->left == NULL || n->right == NULL) {
+        child = n->left != NULL ? n->left : n->right;
+        parent = n->parent;
+        removed_red = n->red;
+        if (child != NULL) {
+            child->parent = parent;
+        }
+        replace_child(t, n, child);
+    } else {
+        // Two children, replace n with its successor (left-most node of the right subtree)
+        rbnode_t *succ = n->right;
+        while (succ->left != NULL) {
+            succ = succ->left;
+        }
+        removed_red = succ->red;
+        child = succ->right;
+
+        if (succ->parent == n) {
+            parent = succ;
+        } else {
+            parent = succ->parent;
+            parent->left = child;
+            if (child != NULL) {
+                child->parent = parent;
+            }
+            succ->right = n->right;
+            n->right->parent = succ;
+        }
+
+        succ->left = n->left;
+        n->left->parent = succ;
+        replace_child(t, n, succ);
+        succ->parent = n->parent;
+        succ->red = n->red;
+    }
+
+    if (!removed_red) {
+        remove_fixup(t, child, parent);
+    }
+
+    rbnode_init(n);
+}
+
+rbnode_t *rbtree_next(const rbnode_t *n) {
+    if (n->right != NULL) {
+        n = n->right;
+        while (n->left != NULL) {
+            n = n->left;
+        }
+        return (rbnode_t *) n;
+    }
+
+    while (n->parent != NULL && n == n->parent->right) {
+        n = n->parent;
+    }
+    return n->parent;
+}
+
+
+#ifdef CONFIG_TEST_CORE_DSTRUCT_RBTREE
+#include __FILE__
+#endif
@@ -32,6 +32,8 @@
 #include <fs/vfs/core.h>
 #include <sched/core.h>
 #include <sync/atomic.h>
+#include <sync/rcu.h>
+#include <sync/futex.h>
 #include <property/core.h>
 #include <utils/utils.h>
 
@@ -46,6 +48,14 @@ static int initialize_global_context(void) {
         while(1);
     }
 
+    if (rcu_init_global_context() < 0) {
+        while(1);
+    }
+
+    if (futex_init_global_context() < 0) {
+        while(1);
+    }
+
     if (loader_init_global_context() < 0) {
         while(1);
     }
@@ -67,6 +77,9 @@ static int initialize_global_context(void) {
     }
 
     atomic32_init(&_laritos.stats.ctx_switches, 0);
+    atomic32_init(&_laritos.stats.avoided_switches, 0);
+    atomic32_init(&_laritos.stats.migrations, 0);
+    atomic32_init(&_laritos.stats.steals, 0);
 
     return 0;
 }
@@ -76,6 +89,12 @@ void kernel_entry(void)  {
         while(1);
     }
 
+#ifdef CONFIG_MM_PAGE_ALLOC
+    if (page_alloc_initialize(__pages_start, CONFIG_MEM_PAGE_AREA_SIZE) < 0) {
+        while(1);
+    }
+#endif
+
     if (initialize_global_context() < 0) {
         while(1);
     }
@@ -41,6 +41,7 @@
 int vfs_init_global_context() {
     INIT_LIST_HEAD(&_laritos.fs.fstypes);
     INIT_LIST_HEAD(&_laritos.fs.mounts);
+    rwlock_init(&_laritos.fs.mounts_lock);
     INIT_LIST_HEAD(&_laritos.fs.sysfs_mods);
     return 0;
 }
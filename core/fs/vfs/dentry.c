@@ -30,12 +30,15 @@
 #include <fs/vfs/types.h>
 #include <fs/vfs/core.h>
 #include <mm/heap.h>
+#include <mm/kmem-cache.h>
 #include <fs/file.h>
 #include <math.h>
 #include <process/core.h>
 #include <generated/autoconf.h>
 
 
+DEF_KMEM_CACHE(dentry_cache, "dentry", fs_dentry_t, NULL, NULL);
+
 void vfs_dentry_add_child(fs_dentry_t *parent, fs_dentry_t *child) {
     list_add_tail(&child->siblings, &parent->children);
     child->parent = parent;
@@ -60,7 +63,7 @@ void vfs_dentry_init(fs_dentry_t *d, char *name, fs_inode_t *inode, fs_dentry_t
 }
 
 fs_dentry_t *vfs_dentry_alloc(char *name, fs_inode_t *inode, fs_dentry_t *parent) {
-    fs_dentry_t *d = calloc(1, sizeof(fs_dentry_t));
+    fs_dentry_t *d = kmem_cache_alloc(&dentry_cache);
     if (d == NULL) {
         return NULL;
     }
@@ -75,7 +78,7 @@ void vfs_dentry_free(fs_dentry_t *d) {
         d->inode->sb->ops.free_inode(d->inode);
         d->inode = NULL;
     }
-    free(d);
+    kmem_cache_free(&dentry_cache, d);
 }
 
 static inline fs_dentry_t *lookup_inode_and_create_dentry(fs_dentry_t *parent, char *name) {
@@ -169,7 +172,7 @@ fs_dentry_t *vfs_dentry_lookup(char *path) {
         return vfs_dentry_lookup_from(_laritos.fs.root, path);
     }
 
-    return vfs_dentry_lookup_from(process_get_current()->cwd, path);
+    return vfs_dentry_lookup_from(process_get_leader(process_get_current())->cwd, path);
 }
 
 fs_dentry_t *vfs_dentry_lookup_parent(char *path) {
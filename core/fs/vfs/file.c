@@ -101,30 +101,39 @@ fs_file_t *vfs_file_open(char *path, fs_access_mode_t mode) {
     return vfs_file_dentry_open(d, mode);
 }
 
-int vfs_file_close(fs_file_t *f) {
-    verbose("Closing '%s'", f->dentry->name);
-
+/**
+ * Runs the close() operation of the file, its fd is not released
+ */
+static int file_release(fs_file_t *f) {
     if (f->dentry != NULL && f->dentry->inode != NULL && f->dentry->inode->fops.close != NULL &&
             f->dentry->inode->fops.close(f->dentry->inode, f) < 0) {
         error_async("Error closing '%s'", f->dentry->name);
         return -1;
     }
     f->opened = false;
+    return 0;
+}
+
+int vfs_file_close(fs_file_t *f) {
+    verbose("Closing '%s'", f->dentry->name);
+
+    if (file_release(f) < 0) {
+        return -1;
+    }
 
     vfs_file_free(f);
     return 0;
 }
 
-int vfs_file_close_all_for_cur_process(void) {
-    pcb_t *pcb = process_get_current();
-    slab_t *slab = pcb->fs.fds_slab;
+int vfs_file_close_all(slab_t *fds_slab) {
     int i;
-    for (i = 0; i < slab_get_total_elems(slab); i++) {
-        if (slab_is_taken(slab, i)) {
-            fs_file_t *f = slab_get_ptr_from_position(slab, i);
+    for (i = 0; i < slab_get_total_elems(fds_slab); i++) {
+        if (slab_is_taken(fds_slab, i)) {
+            fs_file_t *f = slab_get_ptr_from_position(fds_slab, i);
             if (f->opened) {
-                warn_async("pid=%u is about to die with fd=%d open", pcb->pid, i);
-                vfs_file_close(f);
+                // The fds go away with the slab, no need to free them one by one
+                warn_async("fd=%d still open when releasing its fd table", i);
+                file_release(f);
             }
         }
     }
@@ -57,12 +57,16 @@ static inline fs_mount_t *get_fsmount(char *mount_point) {
         return NULL;
     }
 
+    irqctx_t ctx;
+    rwlock_read_acquire(&_laritos.fs.mounts_lock, &ctx);
     fs_mount_t *fsm;
     list_for_each_entry(fsm, &_laritos.fs.mounts, list) {
         if (mount_de == fsm->root) {
+            rwlock_read_release(&_laritos.fs.mounts_lock, &ctx);
             return fsm;
         }
     }
+    rwlock_read_release(&_laritos.fs.mounts_lock, &ctx);
     return NULL;
 }
 
@@ -126,7 +130,10 @@ fs_mount_t *vfs_mount_fs(char *fstype, char *mount_point, fs_mount_flags_t flags
         fsm->root->inode->mode |= FS_ACCESS_MODE_WRITE;
     }
 
+    irqctx_t ctx;
+    rwlock_write_acquire(&_laritos.fs.mounts_lock, &ctx);
     list_add_tail(&fsm->list, &_laritos.fs.mounts);
+    rwlock_write_release(&_laritos.fs.mounts_lock, &ctx);
 
     if (parent != NULL) {
         vfs_dentry_add_child(parent, fsm->root);
@@ -156,7 +163,10 @@ int vfs_unmount_fs(char *mount_point) {
 
     info("Unmounting filesystem %s", mount_point);
 
+    irqctx_t ctx;
+    rwlock_write_acquire(&_laritos.fs.mounts_lock, &ctx);
     list_del_init(&fsm->list);
+    rwlock_write_release(&_laritos.fs.mounts_lock, &ctx);
     vfs_dentry_free_tree(fsm->root);
     if (fsm->ops.unmount != NULL && fsm->ops.unmount(fsm) < 0) {
         error("Error while unmounting filesystem at %s", mount_point);
@@ -36,6 +36,8 @@ static int mount_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
     char data[512];
     uint32_t totalb = 0;
     fs_mount_t *mnt = NULL;
+    irqctx_t ctx;
+    rwlock_read_acquire(&_laritos.fs.mounts_lock, &ctx);
     list_for_each_entry(mnt, &_laritos.fs.mounts, list) {
         if (sizeof(data) - totalb < 32) {
             break;
@@ -54,10 +56,12 @@ static int mount_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
                 mnt->sb->fstype->id, mnt->flags & FS_MOUNT_READ ? "r" : "",
                 mnt->flags & FS_MOUNT_WRITE ? "w" : "");
         if (strlen < 0) {
+            rwlock_read_release(&_laritos.fs.mounts_lock, &ctx);
             return -1;
         }
         totalb += strlen;
     }
+    rwlock_read_release(&_laritos.fs.mounts_lock, &ctx);
 
     return pseudofs_write_to_buf(buf, blen, data, totalb, offset);
 }
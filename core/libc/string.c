@@ -35,6 +35,15 @@ void *memcpy(void *dest, const void *src, size_t n) {
 
 void *memset(void *buf, int c, size_t count) {
     char *b = buf;
+    // Byte stores until we are word-aligned, then a word at a time
+    while (count > 0 && ((uintptr_t) b & (sizeof(uint32_t) - 1)) != 0) {
+        *b++ = c;
+        count--;
+    }
+    uint32_t w = (uint8_t) c * 0x01010101UL;
+    for (; count >= sizeof(uint32_t); count -= sizeof(uint32_t), b += sizeof(uint32_t)) {
+        *(uint32_t *) b = w;
+    }
     while (count-- > 0) {
         *b++ = c;
     }
@@ -33,14 +33,42 @@
 #include <fs/pseudofs.h>
 
 
+#define BITSET_FULL ((bitset_t) -1)
+
+/**
+ * A slab is made of one or more chunks of <chunk_elems> elements each. Chunks
+ * are allocated on demand (up to <nchunks>) and given back to the heap once
+ * they become empty. Element positions (used e.g. as pid or fd numbers) are
+ * <chunk index> * <chunk_elems> + <index inside the chunk>, so they never
+ * change while the element is in use.
+ */
+typedef struct {
+    uint32_t avail_elems;
+    char *data;
+    /**
+     * Second level bitset, bit i is set when bitset[i] is full. Used to find
+     * a free element without scanning the whole bitset array.
+     */
+    bitset_t *summary;
+    bitset_t bitset[];
+} bs_chunk_t;
+
 typedef struct {
     spinlock_t lock;
     size_t elem_size;
+    uint32_t chunk_elems;
+    // Number of bitset and summary elements per chunk
     uint32_t bs_elems;
+    uint32_t summary_elems;
+    // Max number of elements, i.e. nchunks * chunk_elems
     uint32_t total_elems;
     uint32_t avail_elems;
-    char *data;
-    bitset_t bitset[];
+    // Free elements in the chunks currently allocated
+    uint32_t chunk_avail_elems;
+    bool has_sysfs;
+    uint32_t nchunks;
+    // Chunk 0 is allocated along with the slab and never released
+    bs_chunk_t *chunks[];
 } bs_slab_t;
 
 
@@ -68,6 +96,25 @@ static int avail_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
     return pseudofs_write_to_buf(buf, blen, data, strlen, offset);
 }
 
+static int chunks_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    bs_slab_t *s = f->data0;
+
+    irqctx_t ctx;
+    spinlock_acquire(&s->lock, &ctx);
+    uint32_t nchunks = 0;
+    uint32_t i;
+    for (i = 0; i < s->nchunks; i++) {
+        if (s->chunks[i] != NULL) {
+            nchunks++;
+        }
+    }
+    char data[32];
+    int strlen = snprintf(data, sizeof(data), "%lu/%lu", nchunks, s->nchunks);
+    spinlock_release(&s->lock, &ctx);
+
+    return pseudofs_write_to_buf(buf, blen, data, strlen, offset);
+}
+
 static inline int sysfs_create(bs_slab_t *slab) {
     char buf[CONFIG_FS_MAX_FILENAME_LEN];
     snprintf(buf, sizeof(buf), "%p", slab);
@@ -88,6 +135,11 @@ static inline int sysfs_create(bs_slab_t *slab) {
         return -1;
     }
 
+    if (pseudofs_create_custom_ro_file_with_dataptr(dir, "chunks", chunks_read, slab) == NULL) {
+        error("Failed to create 'chunks' sysfs file");
+        return -1;
+    }
+
     return 0;
 }
 
@@ -97,41 +149,146 @@ static inline int sysfs_remove(bs_slab_t *slab) {
     return vfs_dir_remove(_laritos.fs.slab_root, buf);
 }
 
-slab_t *slab_create(uint32_t numelems, size_t elemsize) {
-    if (numelems == 0 || numelems == BITSET_ARRAY_IDX_NOT_FOUND || elemsize == 0) {
+/**
+ * @return Size of a chunk, including its bitsets and data
+ */
+static inline size_t calc_chunk_size(uint32_t bselems, uint32_t sumelems, uint32_t chunkelems, size_t elemsize) {
+    return sizeof(bs_chunk_t) + (bselems + sumelems) * sizeof(bitset_t) + chunkelems * elemsize;
+}
+
+static inline size_t chunk_size(bs_slab_t *s) {
+    return calc_chunk_size(s->bs_elems, s->summary_elems, s->chunk_elems, s->elem_size);
+}
+
+/**
+ * Lays out and initializes a zeroed chunk:
+ *      bs_chunk_t | bitset array | summary bitset array | data
+ */
+static void init_chunk(bs_slab_t *s, bs_chunk_t *c) {
+    c->summary = c->bitset + s->bs_elems;
+    c->data = (char *) (c->summary + s->summary_elems);
+    c->avail_elems = s->chunk_elems;
+
+    // Padding bits of the last bitset element and summary bits with no bitset element
+    // behind them are marked as taken, so that they are never picked
+    uint32_t i;
+    for (i = s->chunk_elems; i < s->bs_elems * BITSET_NBITS; i++) {
+        bitset_array_lm_set(c->bitset, s->bs_elems, i);
+    }
+    for (i = s->bs_elems; i < s->summary_elems * BITSET_NBITS; i++) {
+        bitset_array_lm_set(c->summary, s->summary_elems, i);
+    }
+}
+
+static bs_slab_t *create_slab(uint32_t chunkelems, uint32_t maxelems, size_t elemsize) {
+    // The slab grows by whole chunks, a partial last chunk would exceed <maxelems>
+    if (chunkelems == 0 || chunkelems == BITSET_ARRAY_IDX_NOT_FOUND || elemsize == 0 ||
+            maxelems < chunkelems || maxelems % chunkelems != 0) {
         return NULL;
     }
 
-    // Space for the struct
-    size_t size = sizeof(bs_slab_t);
+    uint32_t nchunks = maxelems / chunkelems;
 
-    // Space for the bitset array
-    uint32_t bselems = numelems / BITSET_NBITS;
-    bselems += (numelems % BITSET_NBITS > 0) ? 1 : 0;
-    size += bselems * sizeof(bitset_t);
+    uint32_t bselems = chunkelems / BITSET_NBITS;
+    bselems += (chunkelems % BITSET_NBITS > 0) ? 1 : 0;
+    uint32_t sumelems = bselems / BITSET_NBITS;
+    sumelems += (bselems % BITSET_NBITS > 0) ? 1 : 0;
 
-    // Offset to the data chunk
-    size_t dataoffset = size;
-    // Space for the actual slabs
-    size += numelems * elemsize;
+    // Space for the struct and the chunk pointers (keep chunk 0 aligned to 8 bytes)
+    size_t size = sizeof(bs_slab_t) + nchunks * sizeof(bs_chunk_t *);
+    size = (size + 7) & ~7;
+    size_t chunkoffset = size;
+    // Space for the first chunk
+    size += calc_chunk_size(bselems, sumelems, chunkelems, elemsize);
 
     bs_slab_t *slab = calloc(1, size);
     if (slab == NULL) {
         return NULL;
     }
-    slab->bs_elems = bselems;
-    slab->total_elems = numelems;
-    slab->avail_elems = numelems;
     slab->elem_size = elemsize;
-    slab->data = (char *) slab + dataoffset;
-
-    sysfs_create(slab);
+    slab->chunk_elems = chunkelems;
+    slab->bs_elems = bselems;
+    slab->summary_elems = sumelems;
+    slab->nchunks = nchunks;
+    slab->total_elems = nchunks * chunkelems;
+    slab->avail_elems = slab->total_elems;
+    slab->chunk_avail_elems = chunkelems;
+    slab->chunks[0] = (bs_chunk_t *) ((char *) slab + chunkoffset);
+    init_chunk(slab, slab->chunks[0]);
 
     verbose_async("slab=0x%p new", slab);
 
+    return slab;
+}
+
+slab_t *slab_create(uint32_t numelems, size_t elemsize) {
+    return slab_create_growable(numelems, numelems, elemsize);
+}
+
+slab_t *slab_create_growable(uint32_t chunkelems, uint32_t maxelems, size_t elemsize) {
+    bs_slab_t *slab = create_slab(chunkelems, maxelems, elemsize);
+    if (slab != NULL) {
+        slab->has_sysfs = true;
+        sysfs_create(slab);
+    }
     return (slab_t *) slab;
 }
 
+slab_t *slab_create_nosysfs(uint32_t numelems, size_t elemsize) {
+    return (slab_t *) create_slab(numelems, numelems, elemsize);
+}
+
+/**
+ * @return Index of the chunk to allocate from, allocating a new one if needed,
+ *         or -1 if the slab cannot grow anymore
+ */
+static int32_t get_chunk_for_alloc_locked(bs_slab_t *s) {
+    int32_t missing = -1;
+    uint32_t i;
+    // Use the lowest chunk with free elements, only grow if all the allocated ones are full
+    for (i = 0; i < s->nchunks; i++) {
+        if (s->chunks[i] == NULL) {
+            if (missing < 0) {
+                missing = i;
+            }
+        } else if (s->chunks[i]->avail_elems > 0) {
+            return i;
+        }
+    }
+    if (missing < 0) {
+        return -1;
+    }
+
+    bs_chunk_t *c = calloc(1, chunk_size(s));
+    if (c == NULL) {
+        return -1;
+    }
+    init_chunk(s, c);
+    s->chunks[missing] = c;
+    s->chunk_avail_elems += s->chunk_elems;
+
+    verbose_async("slab=0x%p new chunk #%ld", s, missing);
+    return missing;
+}
+
+/**
+ * Gives an empty chunk back to the heap, unless it is the first one or it would leave
+ * less than a chunk worth of free elements around (to avoid thrashing when allocating and
+ * freeing around a chunk boundary)
+ */
+static void release_chunk_if_unused_locked(bs_slab_t *s, uint32_t chunkidx) {
+    bs_chunk_t *c = s->chunks[chunkidx];
+    if (chunkidx == 0 || c->avail_elems < s->chunk_elems ||
+            s->chunk_avail_elems - c->avail_elems < s->chunk_elems) {
+        return;
+    }
+    s->chunks[chunkidx] = NULL;
+    s->chunk_avail_elems -= s->chunk_elems;
+    free(c);
+
+    verbose_async("slab=0x%p released chunk #%lu", s, chunkidx);
+}
+
 void *slab_alloc(slab_t *slab) {
     if (slab == NULL) {
         return NULL;
@@ -147,20 +304,59 @@ void *slab_alloc(slab_t *slab) {
         return NULL;
     }
 
-    uint32_t idx = bitset_array_ffz(s->bitset, s->bs_elems);
-    if (idx == BITSET_ARRAY_IDX_NOT_FOUND) {
+    int32_t chunkidx = get_chunk_for_alloc_locked(s);
+    if (chunkidx < 0) {
         spinlock_release(&s->lock, &ctx);
         return NULL;
     }
+    bs_chunk_t *c = s->chunks[chunkidx];
 
-    verbose_async("slab=0x%p alloc #%lu", slab, idx);
+    // Look for a non-full bitset element first, then for the free bit inside it
+    uint32_t bsidx = bitset_array_ffz(c->summary, s->summary_elems);
+    if (bsidx == BITSET_ARRAY_IDX_NOT_FOUND || bsidx >= s->bs_elems) {
+        spinlock_release(&s->lock, &ctx);
+        return NULL;
+    }
+    uint32_t idx = bsidx * BITSET_NBITS + bitset_ffz(c->bitset[bsidx]);
 
-    bitset_array_lm_set(s->bitset, s->bs_elems, idx);
+    bitset_array_lm_set(c->bitset, s->bs_elems, idx);
+    if (c->bitset[bsidx] == BITSET_FULL) {
+        bitset_array_lm_set(c->summary, s->summary_elems, bsidx);
+    }
+    c->avail_elems--;
+    s->chunk_avail_elems--;
     s->avail_elems--;
 
     spinlock_release(&s->lock, &ctx);
 
-    return slab_get_ptr_from_position(slab, idx);
+    verbose_async("slab=0x%p alloc #%lu", slab, chunkidx * s->chunk_elems + idx);
+
+    return c->data + idx * s->elem_size;
+}
+
+static inline bool is_taken_locked(bs_slab_t *s, uint32_t idx) {
+    if (idx >= s->total_elems) {
+        return false;
+    }
+    bs_chunk_t *c = s->chunks[idx / s->chunk_elems];
+    return c != NULL && bitset_array_lm_bit(c->bitset, s->bs_elems, idx % s->chunk_elems) != 0;
+}
+
+/**
+ * @return Position of <ptr> in the slab, -1 if it doesn't belong to any allocated chunk
+ */
+static int32_t get_position_locked(bs_slab_t *s, void *ptr) {
+    uint32_t i;
+    for (i = 0; i < s->nchunks; i++) {
+        bs_chunk_t *c = s->chunks[i];
+        if (c != NULL && (char *) ptr >= c->data) {
+            uint32_t idx = ((char *) ptr - c->data) / s->elem_size;
+            if (idx < s->chunk_elems) {
+                return i * s->chunk_elems + idx;
+            }
+        }
+    }
+    return -1;
 }
 
 void slab_free(slab_t *slab, void *ptr) {
@@ -169,27 +365,41 @@ void slab_free(slab_t *slab, void *ptr) {
     }
 
     bs_slab_t *s = (bs_slab_t *) slab;
-    uint32_t bsidx = ((char *) ptr - s->data) / s->elem_size;
 
     irqctx_t ctx;
     spinlock_acquire(&s->lock, &ctx);
 
     // Check if it belongs to a real block and if it is actually being used
-    if (bsidx < s->total_elems && slab_is_taken(s, bsidx)) {
-        bitset_array_lm_clear(s->bitset, s->bs_elems, bsidx);
+    int32_t pos = get_position_locked(s, ptr);
+    if (pos >= 0 && is_taken_locked(s, pos)) {
+        uint32_t chunkidx = pos / s->chunk_elems;
+        uint32_t idx = pos % s->chunk_elems;
+        bs_chunk_t *c = s->chunks[chunkidx];
+        bitset_array_lm_clear(c->bitset, s->bs_elems, idx);
+        bitset_array_lm_clear(c->summary, s->summary_elems, idx / BITSET_NBITS);
+        c->avail_elems++;
+        s->chunk_avail_elems++;
         s->avail_elems++;
+        release_chunk_if_unused_locked(s, chunkidx);
     }
 
     spinlock_release(&s->lock, &ctx);
 
-    verbose_async("slab=0x%p free #%lu", slab, bsidx);
+    verbose_async("slab=0x%p free #%ld", slab, pos);
 }
 
 void slab_destroy(slab_t *slab) {
     if (slab == NULL) {
         return;
     }
-    sysfs_remove(slab);
+    bs_slab_t *s = (bs_slab_t *) slab;
+    if (s->has_sysfs) {
+        sysfs_remove(s);
+    }
+    uint32_t i;
+    for (i = 1; i < s->nchunks; i++) {
+        free(s->chunks[i]);
+    }
     free(slab);
     verbose_async("slab=0x%p destroy", slab);
 }
@@ -204,8 +414,11 @@ uint32_t slab_get_total_elems(slab_t *slab) {
 
 int32_t slab_get_slab_position(slab_t *slab, void *ptr) {
     bs_slab_t *s = (bs_slab_t *) slab;
-    uint32_t pos = ((char *) ptr - s->data) / s->elem_size;
-    return pos >= s->total_elems ? -1 : pos;
+    irqctx_t ctx;
+    spinlock_acquire(&s->lock, &ctx);
+    int32_t pos = get_position_locked(s, ptr);
+    spinlock_release(&s->lock, &ctx);
+    return pos;
 }
 
 void *slab_get_ptr_from_position(slab_t *slab, uint32_t pos) {
@@ -213,12 +426,21 @@ void *slab_get_ptr_from_position(slab_t *slab, uint32_t pos) {
     if (pos >= s->total_elems) {
         return NULL;
     }
-    return (void *) (s->data + pos * s->elem_size);
+    irqctx_t ctx;
+    spinlock_acquire(&s->lock, &ctx);
+    bs_chunk_t *c = s->chunks[pos / s->chunk_elems];
+    void *ptr = c != NULL ? c->data + (pos % s->chunk_elems) * s->elem_size : NULL;
+    spinlock_release(&s->lock, &ctx);
+    return ptr;
 }
 
 bool slab_is_taken(slab_t *slab, uint32_t idx) {
     bs_slab_t *s = (bs_slab_t *) slab;
-    return bitset_array_lm_bit(s->bitset, s->bs_elems, idx) != 0;
+    irqctx_t ctx;
+    spinlock_acquire(&s->lock, &ctx);
+    bool taken = is_taken_locked(s, idx);
+    spinlock_release(&s->lock, &ctx);
+    return taken;
 }
 
 static int slab_create_sysfs(fs_sysfs_mod_t *sysfs) {
@@ -24,6 +24,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <dstruct/list.h>
 #include <mm/heap.h>
 #include <utils/utils.h>
@@ -74,16 +75,10 @@ int heap_initialize(void *start, uint32_t size) {
     return 0;
 }
 
-void *_malloc(size_t size) {
-    if (size <= 0) {
-        return NULL;
-    }
-
-    insane_async("malloc(%d)", size);
-
-    irqctx_t ctx;
-    spinlock_acquire(&lock, &ctx);
-
+/**
+ * Note: Must be called with the freelist lock held
+ */
+static void *malloc_locked(size_t size) {
     fl_node_t *best = NULL;
     fl_node_t *pos = NULL;
     list_for_each_entry(pos, &freelist, list) {
@@ -98,7 +93,8 @@ void *_malloc(size_t size) {
                 fl_node_t *split = (fl_node_t *) ((char *) pos + size_and_meta);
                 split->size = pos->size - size_and_meta;
                 INIT_LIST_HEAD(&split->list);
-                list_add(&split->list, &freelist);
+                // Take the place of the selected chunk to keep the list sorted
+                list_add(&split->list, &pos->list);
 
                 // We only update the size of the selected chunk if it was split.
                 // If we don't have any available space for splitting the chunk, we just keep
@@ -117,9 +113,43 @@ void *_malloc(size_t size) {
     dump_freelist();
 #endif
 
+    return best != NULL ? best->data : NULL;
+}
+
+void *_malloc(size_t size) {
+    if (size <= 0) {
+        return NULL;
+    }
+
+    insane_async("malloc(%d)", size);
+
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+    void *ptr = malloc_locked(size);
     spinlock_release(&lock, &ctx);
 
-    return best != NULL ? best->data : NULL;
+    return ptr;
+}
+
+uint32_t _malloc_batch(size_t size, void **ptrs, uint32_t n) {
+    if (size <= 0) {
+        return 0;
+    }
+
+    insane_async("malloc_batch(%d, %lu)", size, n);
+
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+
+    uint32_t i;
+    for (i = 0; i < n; i++) {
+        if ((ptrs[i] = malloc_locked(size)) == NULL) {
+            break;
+        }
+    }
+
+    spinlock_release(&lock, &ctx);
+    return i;
 }
 
 static void merge(void) {
@@ -146,14 +176,12 @@ static void merge(void) {
 #endif
 }
 
-void _free(void *ptr) {
-    if (ptr == NULL) {
-        return;
-    }
-
-    irqctx_t ctx;
-    spinlock_acquire(&lock, &ctx);
-
+/**
+ * Inserts the chunk back into the (sorted) free list without merging it
+ *
+ * Note: Must be called with the freelist lock held
+ */
+static void free_locked(void *ptr) {
     fl_node_t *node = container_of(ptr, fl_node_t, data);
     insane_async("Freeing ptr=0x%p, block [0x%p, size=%lu]", ptr, node, node->size);
 
@@ -161,13 +189,76 @@ void _free(void *ptr) {
     list_for_each(pos, &freelist) {
         if (pos > &node->list) {
             __list_add(&node->list, pos->prev, pos);
-            goto end;
+            return;
         }
     }
 
     list_add_tail(&node->list, &freelist);
+}
+
+/**
+ * Trims the (used) block <node> down to <size> bytes if the remainder is big enough to
+ * hold another block, which is then given back to the free list.
+ *
+ * Note: Must be called with the freelist lock held
+ */
+static void trim_locked(fl_node_t *node, size_t size) {
+    if (node->size <= size + sizeof(fl_node_t)) {
+        return;
+    }
+    fl_node_t *split = (fl_node_t *) ((char *) node->data + size);
+    split->size = node->size - size - sizeof(fl_node_t);
+    node->size = size;
+    insane_async("Trimming: [0x%p, size=%lu] + [0x%p, size=%lu]", node, node->size, split, split->size);
+    free_locked(split->data);
+}
+
+void *_memalign(size_t alignment, size_t size) {
+    if (size <= 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        return NULL;
+    }
+
+    insane_async("memalign(%lu, %d)", alignment, size);
+
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+
+    // Worst case, we need to skip up to <alignment> bytes plus a block header to be able to
+    // give the unaligned head of the block back to the free list
+    char *ptr = malloc_locked(size + alignment + sizeof(fl_node_t));
+    if (ptr == NULL) {
+        spinlock_release(&lock, &ctx);
+        return NULL;
+    }
+
+    fl_node_t *node = container_of((void *) ptr, fl_node_t, data);
+    char *aligned = (char *) (((uintptr_t) ptr + alignment - 1) & ~(alignment - 1));
+    if (aligned != ptr) {
+        while (aligned - ptr < sizeof(fl_node_t)) {
+            aligned += alignment;
+        }
+        fl_node_t *anode = container_of((void *) aligned, fl_node_t, data);
+        anode->size = node->data + node->size - aligned;
+        node->size = (char *) anode - node->data;
+        free_locked(node->data);
+        node = anode;
+    }
+    trim_locked(node, size);
 
-end:
+    merge();
+    spinlock_release(&lock, &ctx);
+    return node->data;
+}
+
+void _free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+
+    free_locked(ptr);
 #ifdef DEBUG
     dump_freelist();
 #endif
@@ -176,6 +267,63 @@ end:
     spinlock_release(&lock, &ctx);
 }
 
+bool _resize(void *ptr, size_t size) {
+    if (ptr == NULL || size <= 0) {
+        return false;
+    }
+
+    fl_node_t *node = container_of(ptr, fl_node_t, data);
+
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+
+    if (node->size < size) {
+        // Try to take over the free block right after this one
+        fl_node_t *next = (fl_node_t *) (node->data + node->size);
+        fl_node_t *pos;
+        bool found = false;
+        list_for_each_entry(pos, &freelist, list) {
+            if (pos >= next) {
+                found = pos == next;
+                break;
+            }
+        }
+        if (!found || node->size + sizeof(fl_node_t) + next->size < size) {
+            spinlock_release(&lock, &ctx);
+            return false;
+        }
+        insane_async("Growing: [0x%p, size=%lu] U [0x%p, size=%lu]", node, node->size, next, next->size);
+        list_del(&next->list);
+        node->size += sizeof(fl_node_t) + next->size;
+    }
+
+    trim_locked(node, size);
+    merge();
+
+    spinlock_release(&lock, &ctx);
+    return true;
+}
+
+void _free_batch(void **ptrs, uint32_t n) {
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+
+    uint32_t i;
+    for (i = 0; i < n; i++) {
+        if (ptrs[i] != NULL) {
+            free_locked(ptrs[i]);
+        }
+    }
+    // Just one merge pass for the whole batch
+    merge();
+
+    spinlock_release(&lock, &ctx);
+}
+
+size_t heap_get_chunk_size(void *ptr) {
+    return container_of(ptr, fl_node_t, data)->size;
+}
+
 uint32_t heap_get_available(void) {
     irqctx_t ctx;
     spinlock_acquire(&lock, &ctx);
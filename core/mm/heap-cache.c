@@ -0,0 +1,234 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <core.h>
+#include <cpu/cpu-local.h>
+#include <irq/core.h>
+#include <mm/heap.h>
+#include <utils/utils.h>
+#include <fs/vfs/core.h>
+#include <fs/vfs/types.h>
+#include <fs/pseudofs.h>
+#include <generated/autoconf.h>
+
+/**
+ * Per-cpu cache of small heap chunks (aka magazines).
+ *
+ * Each cpu keeps a stack of free chunks per power-of-two size class. malloc() and free()
+ * only disable local irqs to access the current cpu magazines, the shared heap (and its
+ * lock) is only used to refill an empty magazine or drain a full one, in batches of
+ * HC_BATCH chunks.
+ */
+
+#define HC_MIN_SIZE 16
+#define HC_NUM_CLASSES 5
+#define HC_MAX_SIZE (HC_MIN_SIZE << (HC_NUM_CLASSES - 1))
+#define HC_MAG_SIZE CONFIG_MM_HEAP_PERCPU_CACHE_MAG_SIZE
+#define HC_BATCH (HC_MAG_SIZE / 2)
+
+typedef struct {
+    uint32_t count;
+    void *chunks[HC_MAG_SIZE];
+} hc_magazine_t;
+
+typedef struct {
+    hc_magazine_t mags[HC_NUM_CLASSES];
+    uint32_t hits;
+    uint32_t misses;
+} hc_cpu_cache_t;
+
+static DEF_CPU_LOCAL(hc_cpu_cache_t, cpucache);
+
+
+static inline size_t class_size(uint8_t cls) {
+    return HC_MIN_SIZE << cls;
+}
+
+/**
+ * @return Smallest class able to hold <size> bytes
+ */
+static inline uint8_t class_for_alloc(size_t size) {
+    uint8_t cls = 0;
+    while (class_size(cls) < size) {
+        cls++;
+    }
+    return cls;
+}
+
+/**
+ * @return Biggest class whose chunks can be served by a chunk of <size> bytes
+ */
+static inline uint8_t class_for_free(size_t size) {
+    uint8_t cls = HC_NUM_CLASSES - 1;
+    while (class_size(cls) > size) {
+        cls--;
+    }
+    return cls;
+}
+
+void *heap_cache_malloc(size_t size) {
+    if (size == 0 || size > HC_MAX_SIZE) {
+        return _malloc(size);
+    }
+
+    uint8_t cls = class_for_alloc(size);
+
+    // Irqs disabled to prevent any other execution flow on this cpu from touching the magazines
+    irqctx_t ctx;
+    irq_disable_local_and_save_ctx(&ctx);
+
+    hc_cpu_cache_t *cc = CPU_LOCAL_GET_PTR_LOCKED(cpucache);
+    hc_magazine_t *mag = &cc->mags[cls];
+    if (mag->count > 0) {
+        cc->hits++;
+    } else {
+        cc->misses++;
+        mag->count = _malloc_batch(class_size(cls), mag->chunks, HC_BATCH);
+        if (mag->count == 0) {
+            irq_local_restore_ctx(&ctx);
+            return NULL;
+        }
+    }
+    void *ptr = mag->chunks[--mag->count];
+
+    irq_local_restore_ctx(&ctx);
+    return ptr;
+}
+
+void heap_cache_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    // Chunks from the heap manager may be a bit bigger than requested, but a chunk twice as
+    // big as the largest class is not worth caching
+    size_t size = heap_get_chunk_size(ptr);
+    if (size < HC_MIN_SIZE || size >= 2 * HC_MAX_SIZE) {
+        _free(ptr);
+        return;
+    }
+
+    uint8_t cls = class_for_free(size);
+
+    irqctx_t ctx;
+    irq_disable_local_and_save_ctx(&ctx);
+
+    hc_magazine_t *mag = &CPU_LOCAL_GET_PTR_LOCKED(cpucache)->mags[cls];
+    if (mag->count == HC_MAG_SIZE) {
+        // Magazine is full, give the oldest half back to the heap
+        _free_batch(mag->chunks, HC_BATCH);
+        memcpy(mag->chunks, &mag->chunks[HC_BATCH], (HC_MAG_SIZE - HC_BATCH) * sizeof(void *));
+        mag->count -= HC_BATCH;
+    }
+    mag->chunks[mag->count++] = ptr;
+
+    irq_local_restore_ctx(&ctx);
+}
+
+static int hits_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    uint32_t hits = 0;
+    hc_cpu_cache_t *cc;
+    CPU_LOCAL_FOR_EACH_CPU_VAR(cpucache, cc) {
+        hits += cc->hits;
+    }
+    char data[16];
+    int strlen = snprintf(data, sizeof(data), "%lu", hits);
+    return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);
+}
+
+static int misses_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    uint32_t misses = 0;
+    hc_cpu_cache_t *cc;
+    CPU_LOCAL_FOR_EACH_CPU_VAR(cpucache, cc) {
+        misses += cc->misses;
+    }
+    char data[16];
+    int strlen = snprintf(data, sizeof(data), "%lu", misses);
+    return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);
+}
+
+static int cached_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    char data[256];
+    uint32_t totalb = 0;
+    uint8_t cpuid = 0;
+    hc_cpu_cache_t *cc;
+    CPU_LOCAL_FOR_EACH_CPU_VAR(cpucache, cc) {
+        int strlen = snprintf(data + totalb, sizeof(data) - totalb, "cpu%u", cpuid++);
+        if (strlen < 0) {
+            return -1;
+        }
+        totalb += strlen;
+        int i;
+        for (i = 0; i < HC_NUM_CLASSES; i++) {
+            strlen = snprintf(data + totalb, sizeof(data) - totalb, " %lu", cc->mags[i].count);
+            if (strlen < 0) {
+                return -1;
+            }
+            totalb += strlen;
+        }
+        totalb += snprintf(data + totalb, sizeof(data) - totalb, "\n");
+    }
+    return pseudofs_write_to_buf(buf, blen, data, totalb, offset);
+}
+
+static int heap_cache_create_sysfs(fs_sysfs_mod_t *sysfs) {
+    fs_dentry_t *dir = vfs_dir_create(_laritos.fs.mem_root, "heapcache",
+            FS_ACCESS_MODE_READ | FS_ACCESS_MODE_WRITE | FS_ACCESS_MODE_EXEC);
+    if (dir == NULL) {
+        error("Error creating heapcache sysfs directory");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file(dir, "hits", hits_read) == NULL) {
+        error("Failed to create 'hits' sysfs file");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file(dir, "misses", misses_read) == NULL) {
+        error("Failed to create 'misses' sysfs file");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file(dir, "cached", cached_read) == NULL) {
+        error("Failed to create 'cached' sysfs file");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int heap_cache_remove_sysfs(fs_sysfs_mod_t *sysfs) {
+    return vfs_dir_remove(_laritos.fs.mem_root, "heapcache");
+}
+
+
+SYSFS_MODULE(heapcache, heap_cache_create_sysfs, heap_cache_remove_sysfs)
+
+
+#ifdef CONFIG_TEST_CORE_MM_HEAP_CACHE
+#include __FILE__
+#endif
@@ -0,0 +1,198 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <printf.h>
+#include <core.h>
+#include <cpu/core.h>
+#include <mm/heap.h>
+#include <mm/heap-prof.h>
+#include <sync/spinlock.h>
+#include <symbol.h>
+#include <fs/vfs/core.h>
+#include <fs/vfs/types.h>
+#include <fs/pseudofs.h>
+#include <generated/autoconf.h>
+
+#define HPROF_NENTRIES CONFIG_MEM_HEAP_PROFILER_ENTRIES
+
+typedef struct {
+    regpc_t pc;
+    uint32_t live_bytes;
+    uint32_t live_allocs;
+    uint32_t total_allocs;
+    uint32_t peak_bytes;
+} hprof_entry_t;
+
+static struct {
+    spinlock_t lock;
+    hprof_entry_t entries[HPROF_NENTRIES];
+    // Allocations not recorded because the table was full
+    uint32_t dropped;
+} hprof;
+
+
+static inline uint32_t hash_pc(regpc_t pc) {
+    // Instructions are 4-byte aligned, drop the lower bits before hashing (Knuth's multiplicative hash)
+    return (((uint32_t) pc >> 2) * 2654435761UL) % HPROF_NENTRIES;
+}
+
+/**
+ * Looks up the entry for <pc> using linear probing
+ *
+ * @param create: Whether to take an empty entry if <pc> is not in the table yet
+ * @return Entry for <pc>, NULL if not found (or the table is full)
+ */
+static hprof_entry_t *get_entry_locked(regpc_t pc, bool create) {
+    uint32_t idx = hash_pc(pc);
+    uint32_t i;
+    for (i = 0; i < HPROF_NENTRIES; i++) {
+        hprof_entry_t *e = &hprof.entries[(idx + i) % HPROF_NENTRIES];
+        if (e->pc == pc) {
+            return e;
+        }
+        if (e->pc == NULL) {
+            if (!create) {
+                return NULL;
+            }
+            e->pc = pc;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+void heap_prof_record_alloc(regpc_t pc, size_t size) {
+    irqctx_t ctx;
+    spinlock_acquire(&hprof.lock, &ctx);
+    hprof_entry_t *e = get_entry_locked(pc, true);
+    if (e == NULL) {
+        hprof.dropped++;
+    } else {
+        e->live_bytes += size;
+        e->live_allocs++;
+        e->total_allocs++;
+        if (e->live_bytes > e->peak_bytes) {
+            e->peak_bytes = e->live_bytes;
+        }
+    }
+    spinlock_release(&hprof.lock, &ctx);
+}
+
+void heap_prof_record_free(regpc_t pc, size_t size) {
+    irqctx_t ctx;
+    spinlock_acquire(&hprof.lock, &ctx);
+    hprof_entry_t *e = get_entry_locked(pc, false);
+    if (e != NULL && e->live_allocs > 0) {
+        e->live_bytes -= size;
+        e->live_allocs--;
+    }
+    spinlock_release(&hprof.lock, &ctx);
+}
+
+static int profile_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    // Work on a copy, resolving symbols is too slow to do it with the lock held
+    hprof_entry_t *entries = malloc(sizeof(hprof.entries));
+    if (entries == NULL) {
+        return -1;
+    }
+    irqctx_t ctx;
+    spinlock_acquire(&hprof.lock, &ctx);
+    memcpy(entries, hprof.entries, sizeof(hprof.entries));
+    uint32_t dropped = hprof.dropped;
+    spinlock_release(&hprof.lock, &ctx);
+
+    // Compact the used entries and sort them by live bytes (insertion sort, the table is small)
+    int n = 0;
+    int i;
+    for (i = 0; i < HPROF_NENTRIES; i++) {
+        if (entries[i].pc == NULL) {
+            continue;
+        }
+        hprof_entry_t e = entries[i];
+        int j = n;
+        while (j > 0 && entries[j - 1].live_bytes < e.live_bytes) {
+            entries[j] = entries[j - 1];
+            j--;
+        }
+        entries[j] = e;
+        n++;
+    }
+
+    size_t datalen = 64 + n * (64 + CONFIG_FS_MAX_FILENAME_LEN);
+    char *data = malloc(datalen);
+    if (data == NULL) {
+        free(entries);
+        return -1;
+    }
+    int totalb = snprintf(data, datalen, "live_bytes live_allocs total_allocs peak_bytes pc symbol\n");
+    for (i = 0; i < n; i++) {
+        char symbol[CONFIG_FS_MAX_FILENAME_LEN] = { 0 };
+        if (symbol_get_name_at(entries[i].pc, symbol, sizeof(symbol)) < 0) {
+            strncpy(symbol, "?", sizeof(symbol));
+        }
+        totalb += snprintf(data + totalb, datalen - totalb, "%lu %lu %lu %lu 0x%p %s\n",
+                entries[i].live_bytes, entries[i].live_allocs, entries[i].total_allocs,
+                entries[i].peak_bytes, entries[i].pc, symbol);
+    }
+    if (dropped > 0) {
+        totalb += snprintf(data + totalb, datalen - totalb, "dropped %lu\n", dropped);
+    }
+    free(entries);
+
+    int ret = pseudofs_write_to_buf(buf, blen, data, totalb, offset);
+    free(data);
+    return ret;
+}
+
+static int heap_prof_create_sysfs(fs_sysfs_mod_t *sysfs) {
+    fs_dentry_t *dir = vfs_dir_create(_laritos.fs.mem_root, "heap",
+            FS_ACCESS_MODE_READ | FS_ACCESS_MODE_WRITE | FS_ACCESS_MODE_EXEC);
+    if (dir == NULL) {
+        error("Error creating heap sysfs directory");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file(dir, "profile", profile_read) == NULL) {
+        error("Failed to create 'profile' sysfs file");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int heap_prof_remove_sysfs(fs_sysfs_mod_t *sysfs) {
+    return vfs_dir_remove(_laritos.fs.mem_root, "heap");
+}
+
+
+SYSFS_MODULE(heap_prof, heap_prof_create_sysfs, heap_prof_remove_sysfs)
+
+
+
+#ifdef CONFIG_TEST_CORE_MM_HEAP_PROF
+#include __FILE__
+#endif
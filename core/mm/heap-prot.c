@@ -0,0 +1,247 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <printf.h>
+#include <core.h>
+#include <cpu/core.h>
+#include <mm/heap.h>
+#include <sync/spinlock.h>
+#include <sync/atomic.h>
+#include <dstruct/bitset.h>
+#include <utils/debug.h>
+#include <symbol.h>
+#include <fs/vfs/core.h>
+#include <fs/vfs/types.h>
+#include <fs/pseudofs.h>
+#include <generated/autoconf.h>
+
+void heap_prot_report_overflow(bufprot_head_t *h, bufprot_tail_t *t, regpc_t pc) {
+    debug_message_delimiter();
+    error("Buffer overflow on block with size %zu bytes:", h->size);
+    error("  Expected canaries head=0x%lX tail=0x%lX, got head=0x%lX tail=0x%lX", CANARY, CANARY, h->canary, t->canary);
+    char symbol[32] = { 0 };
+    symbol_get_name_at(h->pc, symbol, sizeof(symbol));
+    error("  Allocation at %s (pc=0x%p)", symbol, h->pc);
+    error("  Run gdb-multiarch -batch -n -ex 'file bin/laritos.elf' -ex 'disassemble /m 0x%p'", h->pc);
+    symbol_get_name_at(pc, symbol, sizeof(symbol));
+    error("  Deallocation at %s (pc=0x%p)", symbol, pc);
+    error("  Run gdb-multiarch -batch -n -ex 'file bin/laritos.elf' -ex 'disassemble /m 0x%p'", pc);
+    debug_message_delimiter();
+}
+
+
+#ifdef CONFIG_MEM_HEAP_BUFFER_PROTECTION_SAMPLED
+
+#define SLOT_SIZE CONFIG_MEM_HEAP_PROT_SAMPLED_SLOT_SIZE
+#define NSLOTS CONFIG_MEM_HEAP_PROT_SAMPLED_SLOTS
+#define NSLOTS_BS ((NSLOTS + BITSET_NBITS - 1) / BITSET_NBITS)
+#define SLOT_MAX_ALLOC (SLOT_SIZE - sizeof(bufprot_head_t) - sizeof(bufprot_tail_t))
+
+/**
+ * Freed slots are filled with this pattern, a slot whose pattern was modified by the time
+ * it is reused means someone wrote to it after it was freed
+ */
+#define FREED_PATTERN 0xde
+
+char _heap_prot_pool[HEAP_PROT_POOL_SIZE] __attribute__ ((aligned (8)));
+atomic32_t _heap_prot_countdown = ATOMIC32_INIT(CONFIG_MEM_HEAP_PROT_SAMPLE_RATE);
+
+static struct {
+    spinlock_t lock;
+    uint32_t sample_rate;
+    bitset_t used[NSLOTS_BS];
+    // Pc of the free() that released each slot, used to report use-after-free errors
+    regpc_t free_pc[NSLOTS];
+    uint32_t sampled;
+    uint32_t uaf;
+} hp = {
+    .sample_rate = CONFIG_MEM_HEAP_PROT_SAMPLE_RATE,
+};
+
+static inline char *slot_addr(uint32_t slot) {
+    return _heap_prot_pool + slot * SLOT_SIZE;
+}
+
+static void check_use_after_free_locked(uint32_t slot) {
+    char *s = slot_addr(slot);
+    // Slots never used are zeroed (.bss)
+    if (hp.free_pc[slot] == 0) {
+        return;
+    }
+    uint32_t i;
+    for (i = 0; i < SLOT_SIZE; i++) {
+        if ((uint8_t) s[i] != FREED_PATTERN) {
+            hp.uaf++;
+            char symbol[32] = { 0 };
+            symbol_get_name_at(hp.free_pc[slot], symbol, sizeof(symbol));
+            error_async("Use after free detected at offset %lu of a chunk freed at %s (pc=0x%p)",
+                    i, symbol, hp.free_pc[slot]);
+            return;
+        }
+    }
+}
+
+void *heap_prot_sampled_malloc(size_t size, regpc_t pc) {
+    irqctx_t ctx;
+    spinlock_acquire(&hp.lock, &ctx);
+
+    if (size > SLOT_MAX_ALLOC) {
+        // Too big for a slot, try again with the next allocation
+        atomic32_set(&_heap_prot_countdown, 1);
+        spinlock_release(&hp.lock, &ctx);
+        return NULL;
+    }
+    atomic32_set(&_heap_prot_countdown, hp.sample_rate);
+
+    uint32_t slot = bitset_array_ffz(hp.used, NSLOTS_BS);
+    if (slot == BITSET_ARRAY_IDX_NOT_FOUND || slot >= NSLOTS) {
+        spinlock_release(&hp.lock, &ctx);
+        return NULL;
+    }
+    bitset_array_lm_set(hp.used, NSLOTS_BS, slot);
+    check_use_after_free_locked(slot);
+    hp.sampled++;
+
+    spinlock_release(&hp.lock, &ctx);
+
+    // Place the chunk at the end of the slot (keeping 8-byte alignment), so that the tail canary
+    // sits right before the slot boundary
+    bufprot_head_t *h = (bufprot_head_t *) (slot_addr(slot) + SLOT_SIZE -
+            ((sizeof(bufprot_head_t) + size + sizeof(bufprot_tail_t) + 7) & ~7));
+    return heap_prot_guard(h, size, pc);
+}
+
+void heap_prot_sampled_free(void *ptr, regpc_t pc) {
+    uint32_t slot = ((char *) ptr - _heap_prot_pool) / SLOT_SIZE;
+
+    irqctx_t ctx;
+    spinlock_acquire(&hp.lock, &ctx);
+    if (!bitset_array_lm_bit(hp.used, NSLOTS_BS, slot)) {
+        spinlock_release(&hp.lock, &ctx);
+        error_async("Double free of sampled chunk 0x%p, last freed at pc=0x%p", ptr, hp.free_pc[slot]);
+        return;
+    }
+    spinlock_release(&hp.lock, &ctx);
+
+    bufprot_head_t *h;
+    bufprot_tail_t *t;
+    bool corrupted = heap_prot_is_corrupted(ptr, &h, &t);
+    if (corrupted) {
+        heap_prot_report_overflow(h, t, pc);
+    } else {
+        heap_prot_unguard(h);
+    }
+
+    memset(slot_addr(slot), FREED_PATTERN, SLOT_SIZE);
+
+    spinlock_acquire(&hp.lock, &ctx);
+    hp.free_pc[slot] = pc;
+    bitset_array_lm_clear(hp.used, NSLOTS_BS, slot);
+    spinlock_release(&hp.lock, &ctx);
+
+    if (corrupted) {
+        heap_prot_handle_overflow();
+    }
+}
+
+void heap_prot_set_sample_rate(uint32_t rate) {
+    if (rate == 0) {
+        rate = 1;
+    }
+    irqctx_t ctx;
+    spinlock_acquire(&hp.lock, &ctx);
+    // Called periodically by the health check, only restart the countdown if the rate
+    // changed. Otherwise, the next sample would be delayed again and again
+    if (rate != hp.sample_rate) {
+        hp.sample_rate = rate;
+        atomic32_set(&_heap_prot_countdown, rate);
+    }
+    spinlock_release(&hp.lock, &ctx);
+}
+
+uint32_t heap_prot_get_sample_rate(void) {
+    return hp.sample_rate;
+}
+
+static int sampled_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    char data[16];
+    int strlen = snprintf(data, sizeof(data), "%lu", hp.sampled);
+    return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);
+}
+
+static int uaf_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    char data[16];
+    int strlen = snprintf(data, sizeof(data), "%lu", hp.uaf);
+    return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);
+}
+
+static int rate_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    char data[16];
+    int strlen = snprintf(data, sizeof(data), "%lu", hp.sample_rate);
+    return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);
+}
+
+static int heap_prot_create_sysfs(fs_sysfs_mod_t *sysfs) {
+    fs_dentry_t *dir = vfs_dir_create(_laritos.fs.mem_root, "heapprot",
+            FS_ACCESS_MODE_READ | FS_ACCESS_MODE_WRITE | FS_ACCESS_MODE_EXEC);
+    if (dir == NULL) {
+        error("Error creating heapprot sysfs directory");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file(dir, "sampled", sampled_read) == NULL) {
+        error("Failed to create 'sampled' sysfs file");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file(dir, "uaf", uaf_read) == NULL) {
+        error("Failed to create 'uaf' sysfs file");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file(dir, "sample_rate", rate_read) == NULL) {
+        error("Failed to create 'sample_rate' sysfs file");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int heap_prot_remove_sysfs(fs_sysfs_mod_t *sysfs) {
+    return vfs_dir_remove(_laritos.fs.mem_root, "heapprot");
+}
+
+
+SYSFS_MODULE(heapprot, heap_prot_create_sysfs, heap_prot_remove_sysfs)
+
+#endif
+
+
+
+#ifdef CONFIG_TEST_CORE_MM_HEAP_PROT
+#include __FILE__
+#endif
@@ -0,0 +1,333 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <core.h>
+#include <dstruct/list.h>
+#include <mm/heap.h>
+#include <mm/slab.h>
+#include <mm/kmem-cache.h>
+#include <sync/spinlock.h>
+#include <fs/vfs/core.h>
+#include <fs/vfs/types.h>
+#include <fs/pseudofs.h>
+#include <generated/autoconf.h>
+
+
+#define KC_OBJS_PER_SLAB CONFIG_MM_KMEM_CACHE_OBJS_PER_SLAB
+
+typedef struct {
+    list_head_t list;
+    slab_t *slab;
+} kc_slab_t;
+
+static LIST_HEAD(caches);
+static spinlock_t caches_lock;
+
+
+static int stat_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset, uint32_t *stat) {
+    kmem_cache_t *c = f->data0;
+
+    irqctx_t ctx;
+    spinlock_acquire(&c->lock, &ctx);
+    char data[16];
+    int strlen = snprintf(data, sizeof(data), "%lu", *stat);
+    spinlock_release(&c->lock, &ctx);
+
+    return pseudofs_write_to_buf(buf, blen, data, strlen, offset);
+}
+
+static int active_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    return stat_read(f, buf, blen, offset, &((kmem_cache_t *) f->data0)->active);
+}
+
+static int total_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    return stat_read(f, buf, blen, offset, &((kmem_cache_t *) f->data0)->total);
+}
+
+static int highwater_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    return stat_read(f, buf, blen, offset, &((kmem_cache_t *) f->data0)->highwater);
+}
+
+static int objsize_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    kmem_cache_t *c = f->data0;
+    char data[16];
+    int strlen = snprintf(data, sizeof(data), "%lu", (uint32_t) c->objsize);
+    return pseudofs_write_to_buf(buf, blen, data, strlen, offset);
+}
+
+static int sysfs_create(kmem_cache_t *c) {
+    if (c->sysfs_dir != NULL) {
+        return 0;
+    }
+
+    c->sysfs_dir = vfs_dir_create(_laritos.fs.slab_root, (char *) c->name,
+            FS_ACCESS_MODE_READ | FS_ACCESS_MODE_WRITE | FS_ACCESS_MODE_EXEC);
+    if (c->sysfs_dir == NULL) {
+        error("Error creating '%s' kmem cache sysfs directory", c->name);
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file_with_dataptr(c->sysfs_dir, "objsize", objsize_read, c) == NULL) {
+        error("Failed to create 'objsize' sysfs file");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file_with_dataptr(c->sysfs_dir, "active", active_read, c) == NULL) {
+        error("Failed to create 'active' sysfs file");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file_with_dataptr(c->sysfs_dir, "total", total_read, c) == NULL) {
+        error("Failed to create 'total' sysfs file");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file_with_dataptr(c->sysfs_dir, "highwater", highwater_read, c) == NULL) {
+        error("Failed to create 'highwater' sysfs file");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int sysfs_remove(kmem_cache_t *c) {
+    if (c->sysfs_dir == NULL) {
+        return 0;
+    }
+    c->sysfs_dir = NULL;
+    return vfs_dir_remove(_laritos.fs.slab_root, (char *) c->name);
+}
+
+static void register_cache(kmem_cache_t *c) {
+    irqctx_t ctx;
+    spinlock_acquire(&caches_lock, &ctx);
+    if (c->registered) {
+        spinlock_release(&caches_lock, &ctx);
+        return;
+    }
+    // Mark it as registered before creating the sysfs nodes, creating them may
+    // allocate objects from this very same cache (e.g. dentries)
+    c->registered = true;
+    list_add_tail(&c->list, &caches);
+    spinlock_release(&caches_lock, &ctx);
+
+    // Caches used before the sysfs tree exists get their nodes once the
+    // kmem_cache sysfs module is loaded
+    if (_laritos.fs.slab_root != NULL) {
+        sysfs_create(c);
+    }
+}
+
+static kc_slab_t *grow_locked(kmem_cache_t *c) {
+    kc_slab_t *s = calloc(1, sizeof(kc_slab_t));
+    if (s == NULL) {
+        return NULL;
+    }
+    s->slab = slab_create_nosysfs(KC_OBJS_PER_SLAB, c->objsize);
+    if (s->slab == NULL) {
+        free(s);
+        return NULL;
+    }
+    INIT_LIST_HEAD(&s->list);
+    // Newest slab first, it is the one with free objects
+    list_add(&s->list, &c->slabs);
+    c->total += KC_OBJS_PER_SLAB;
+
+    verbose_async("kmem_cache '%s' grown to %lu objects", c->name, c->total);
+    return s;
+}
+
+static void shrink_locked(kmem_cache_t *c, kc_slab_t *s) {
+    list_del(&s->list);
+    slab_destroy(s->slab);
+    free(s);
+    c->total -= KC_OBJS_PER_SLAB;
+
+    verbose_async("kmem_cache '%s' shrunk to %lu objects", c->name, c->total);
+}
+
+kmem_cache_t *kmem_cache_create(const char *name, size_t objsize, void (*ctor)(void *obj), void (*dtor)(void *obj)) {
+    if (name == NULL || name[0] == '\0' || objsize == 0) {
+        return NULL;
+    }
+
+    size_t namelen = strlen(name) + 1;
+    kmem_cache_t *c = calloc(1, sizeof(kmem_cache_t) + namelen);
+    if (c == NULL) {
+        error("Couldn't allocate memory for kmem cache '%s'", name);
+        return NULL;
+    }
+    char *cname = (char *) (c + 1);
+    strncpy(cname, name, namelen);
+    c->name = cname;
+    c->objsize = objsize;
+    c->ctor = ctor;
+    c->dtor = dtor;
+    spinlock_init(&c->lock);
+    INIT_LIST_HEAD(&c->slabs);
+    INIT_LIST_HEAD(&c->list);
+
+    register_cache(c);
+    return c;
+}
+
+int kmem_cache_destroy(kmem_cache_t *cache) {
+    if (cache == NULL) {
+        return -1;
+    }
+
+    irqctx_t ctx;
+    spinlock_acquire(&cache->lock, &ctx);
+    if (cache->active > 0) {
+        spinlock_release(&cache->lock, &ctx);
+        error("Cannot destroy kmem cache '%s', %lu objects still in use", cache->name, cache->active);
+        return -1;
+    }
+    kc_slab_t *s;
+    kc_slab_t *tmp;
+    list_for_each_entry_safe(s, tmp, &cache->slabs, list) {
+        shrink_locked(cache, s);
+    }
+    spinlock_release(&cache->lock, &ctx);
+
+    if (cache->registered) {
+        spinlock_acquire(&caches_lock, &ctx);
+        list_del_init(&cache->list);
+        cache->registered = false;
+        spinlock_release(&caches_lock, &ctx);
+    }
+    sysfs_remove(cache);
+
+    free(cache);
+    return 0;
+}
+
+void *kmem_cache_alloc(kmem_cache_t *cache) {
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    if (!cache->registered) {
+        register_cache(cache);
+    }
+
+    irqctx_t ctx;
+    spinlock_acquire(&cache->lock, &ctx);
+
+    void *obj = NULL;
+    kc_slab_t *s;
+    list_for_each_entry(s, &cache->slabs, list) {
+        if (slab_get_avail_elems(s->slab) > 0) {
+            obj = slab_alloc(s->slab);
+            break;
+        }
+    }
+
+    if (obj == NULL) {
+        s = grow_locked(cache);
+        if (s == NULL) {
+            spinlock_release(&cache->lock, &ctx);
+            error_async("Couldn't grow kmem cache '%s'", cache->name);
+            return NULL;
+        }
+        obj = slab_alloc(s->slab);
+    }
+
+    cache->active++;
+    if (cache->active > cache->highwater) {
+        cache->highwater = cache->active;
+    }
+
+    spinlock_release(&cache->lock, &ctx);
+
+    if (cache->ctor != NULL) {
+        cache->ctor(obj);
+    } else {
+        memset(obj, 0, cache->objsize);
+    }
+
+    return obj;
+}
+
+void kmem_cache_free(kmem_cache_t *cache, void *obj) {
+    if (cache == NULL || obj == NULL) {
+        return;
+    }
+
+    if (cache->dtor != NULL) {
+        cache->dtor(obj);
+    }
+
+    irqctx_t ctx;
+    spinlock_acquire(&cache->lock, &ctx);
+
+    kc_slab_t *s;
+    list_for_each_entry(s, &cache->slabs, list) {
+        if (slab_get_slab_position(s->slab, obj) >= 0) {
+            slab_free(s->slab, obj);
+            cache->active--;
+            // Give empty slabs back to the heap, but keep at least one around to
+            // avoid thrashing when a single object is allocated and freed repeatedly
+            if (slab_get_avail_elems(s->slab) == KC_OBJS_PER_SLAB && cache->total > KC_OBJS_PER_SLAB) {
+                shrink_locked(cache, s);
+            }
+            spinlock_release(&cache->lock, &ctx);
+            return;
+        }
+    }
+
+    spinlock_release(&cache->lock, &ctx);
+    error_async("0x%p doesn't belong to kmem cache '%s'", obj, cache->name);
+}
+
+static int kmem_cache_create_sysfs(fs_sysfs_mod_t *sysfs) {
+    // No locking needed, sysfs modules are loaded during boot by a single execution flow
+    kmem_cache_t *c;
+    list_for_each_entry(c, &caches, list) {
+        if (sysfs_create(c) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int kmem_cache_remove_sysfs(fs_sysfs_mod_t *sysfs) {
+    kmem_cache_t *c;
+    list_for_each_entry(c, &caches, list) {
+        sysfs_remove(c);
+    }
+    return 0;
+}
+
+
+SYSFS_MODULE(kmem_cache, kmem_cache_create_sysfs, kmem_cache_remove_sysfs)
+
+
+
+#ifdef CONFIG_TEST_CORE_MM_KMEM_CACHE
+#include __FILE__
+#endif
@@ -0,0 +1,182 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <mm/heap.h>
+#include <mm/lfslab.h>
+#include <sync/atomic.h>
+#include <sync/barrier.h>
+#include <sync/cmpxchg.h>
+
+
+/**
+ * The head of the free stack is a single 32-bit word so that it can be
+ * updated with one LDREX/STREX pair:
+ *
+ *     [31:16] tag, incremented on every push/pop (ABA protection)
+ *     [15:0]  index of the first free element, LFS_IDX_NONE if empty
+ */
+#define LFS_IDX_BITS 16
+#define LFS_IDX_MASK ((1 << LFS_IDX_BITS) - 1)
+#define LFS_IDX_NONE LFS_IDX_MASK
+#define LFS_MAX_ELEMS LFS_IDX_NONE
+
+#define LFS_HEAD_IDX(_head) ((uint32_t) (_head) & LFS_IDX_MASK)
+#define LFS_HEAD_TAG(_head) ((uint32_t) (_head) >> LFS_IDX_BITS)
+#define LFS_HEAD(_tag, _idx) ((int) (((uint32_t) (_tag) << LFS_IDX_BITS) | ((_idx) & LFS_IDX_MASK)))
+
+typedef struct {
+    volatile int head;
+    atomic32_t avail_elems;
+    uint32_t total_elems;
+    size_t elem_size;
+    char *data;
+    /**
+     * Link to the next free element, indexed by element position. Links live
+     * outside of the elements themselves, so a stale read of a link that
+     * belongs to an element which was just popped by someone else never
+     * touches user data (and the cmpxchg on the tagged head fails anyway)
+     */
+    volatile uint16_t next[];
+} lf_slab_t;
+
+
+lfslab_t *lfslab_create(uint32_t numelems, size_t elemsize) {
+    if (numelems == 0 || numelems > LFS_MAX_ELEMS || elemsize == 0) {
+        return NULL;
+    }
+
+    // Space for the struct and the links
+    size_t size = sizeof(lf_slab_t) + numelems * sizeof(uint16_t);
+    // Keep the data chunk word-aligned
+    size = (size + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+    size_t dataoffset = size;
+    // Space for the actual slabs
+    size += numelems * elemsize;
+
+    lf_slab_t *slab = calloc(1, size);
+    if (slab == NULL) {
+        return NULL;
+    }
+    slab->total_elems = numelems;
+    slab->elem_size = elemsize;
+    slab->data = (char *) slab + dataoffset;
+    atomic32_init(&slab->avail_elems, numelems);
+
+    // Initially all elements are free, lowest index on top of the stack
+    uint32_t i;
+    for (i = 0; i < numelems - 1; i++) {
+        slab->next[i] = i + 1;
+    }
+    slab->next[numelems - 1] = LFS_IDX_NONE;
+    slab->head = LFS_HEAD(0, 0);
+    dmb();
+
+    verbose_async("lfslab=0x%p new", slab);
+
+    return (lfslab_t *) slab;
+}
+
+void *lfslab_alloc(lfslab_t *slab) {
+    if (slab == NULL) {
+        return NULL;
+    }
+
+    lf_slab_t *s = (lf_slab_t *) slab;
+    int old;
+    uint32_t idx;
+    do {
+        old = s->head;
+        idx = LFS_HEAD_IDX(old);
+        if (idx == LFS_IDX_NONE) {
+            return NULL;
+        }
+        // Make sure the link is read after the head
+        dmb();
+    } while (!atomic_cmpxchg(&s->head, old, LFS_HEAD(LFS_HEAD_TAG(old) + 1, s->next[idx])));
+    dmb();
+
+    atomic32_dec(&s->avail_elems);
+
+    insane_async("lfslab=0x%p alloc #%lu", slab, idx);
+
+    return (void *) (s->data + idx * s->elem_size);
+}
+
+void lfslab_free(lfslab_t *slab, void *ptr) {
+    if (slab == NULL || ptr == NULL) {
+        return;
+    }
+
+    lf_slab_t *s = (lf_slab_t *) slab;
+    int32_t pos = lfslab_get_slab_position(slab, ptr);
+    if (pos < 0 || s->data + pos * s->elem_size != (char *) ptr) {
+        error_async("lfslab=0x%p invalid free of 0x%p", slab, ptr);
+        return;
+    }
+
+    int old;
+    do {
+        old = s->head;
+        s->next[pos] = LFS_HEAD_IDX(old);
+        // Publish the link before the element becomes visible through the head
+        dmb();
+    } while (!atomic_cmpxchg(&s->head, old, LFS_HEAD(LFS_HEAD_TAG(old) + 1, pos)));
+
+    atomic32_inc(&s->avail_elems);
+
+    insane_async("lfslab=0x%p free #%ld", slab, pos);
+}
+
+void lfslab_destroy(lfslab_t *slab) {
+    if (slab == NULL) {
+        return;
+    }
+    free(slab);
+    verbose_async("lfslab=0x%p destroy", slab);
+}
+
+uint32_t lfslab_get_avail_elems(lfslab_t *slab) {
+    return atomic32_get(&((lf_slab_t *) slab)->avail_elems);
+}
+
+uint32_t lfslab_get_total_elems(lfslab_t *slab) {
+    return ((lf_slab_t *) slab)->total_elems;
+}
+
+int32_t lfslab_get_slab_position(lfslab_t *slab, void *ptr) {
+    lf_slab_t *s = (lf_slab_t *) slab;
+    if ((char *) ptr < s->data) {
+        return -1;
+    }
+    uint32_t pos = ((char *) ptr - s->data) / s->elem_size;
+    return pos >= s->total_elems ? -1 : pos;
+}
+
+
+
+#ifdef CONFIG_TEST_CORE_MM_LOCKFREE_SLAB
+#include __FILE__
+#endif
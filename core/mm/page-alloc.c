@@ -0,0 +1,300 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <printf.h>
+#include <core.h>
+#include <dstruct/list.h>
+#include <mm/page.h>
+#include <sync/spinlock.h>
+#include <fs/vfs/core.h>
+#include <fs/vfs/types.h>
+#include <fs/pseudofs.h>
+#include <generated/autoconf.h>
+
+/**
+ * Binary buddy allocator.
+ *
+ * The managed area is split into blocks of 2^order pages, each block aligned (relative to
+ * the start of the area) to its own size. Free blocks are kept in one list per order, the
+ * list node lives in the first page of the free block itself. When a block is freed, it is
+ * merged with its buddy (the block whose index only differs in bit <order>) for as long as
+ * the buddy is also free.
+ *
+ * Free blocks that have never been handed out since boot are known to be zeroed (the area
+ * is cleared once during initialization), which lets page_alloc_zeroed() skip the memset.
+ * A block stops being zeroed as soon as it is allocated with page_alloc(), and merging it
+ * with a non-zeroed buddy makes the whole block non-zeroed.
+ */
+
+#define PAGE_NPAGES (CONFIG_MEM_PAGE_AREA_SIZE / PAGE_SIZE)
+
+// Per-page info, only meaningful for the first page of a block
+#define PI_FREE 0x80
+#define PI_USED 0x40
+#define PI_ZEROED 0x20
+#define PI_ORDER_MASK 0x1f
+
+typedef struct {
+    spinlock_t lock;
+    char *start;
+    uint32_t npages;
+    uint32_t avail_pages;
+    list_head_t freelists[PAGE_MAX_ORDER + 1];
+    uint32_t nfree[PAGE_MAX_ORDER + 1];
+} page_alloc_t;
+
+static page_alloc_t pa;
+static uint8_t pageinfo[PAGE_NPAGES];
+
+
+static inline void *page_addr(uint32_t idx) {
+    return pa.start + idx * PAGE_SIZE;
+}
+
+static inline void add_free_block_locked(uint32_t idx, uint8_t order, bool zeroed) {
+    list_head_t *node = (list_head_t *) page_addr(idx);
+    INIT_LIST_HEAD(node);
+    list_add(node, &pa.freelists[order]);
+    pa.nfree[order]++;
+    pageinfo[idx] = PI_FREE | (zeroed ? PI_ZEROED : 0) | order;
+}
+
+/**
+ * @return true if the block was zeroed (except for its list node)
+ */
+static inline bool remove_free_block_locked(uint32_t idx, uint8_t order) {
+    bool zeroed = (pageinfo[idx] & PI_ZEROED) != 0;
+    list_del((list_head_t *) page_addr(idx));
+    pa.nfree[order]--;
+    pageinfo[idx] = 0;
+    return zeroed;
+}
+
+int page_alloc_initialize(void *start, uint32_t size) {
+    spinlock_init(&pa.lock);
+    int i;
+    for (i = 0; i <= PAGE_MAX_ORDER; i++) {
+        INIT_LIST_HEAD(&pa.freelists[i]);
+        pa.nfree[i] = 0;
+    }
+
+    if (((uint32_t) start & (PAGE_SIZE - 1)) != 0) {
+        error_async("Page allocator area 0x%p is not page-aligned", start);
+        return -1;
+    }
+
+    pa.start = start;
+    pa.npages = size / PAGE_SIZE;
+    if (pa.npages > PAGE_NPAGES) {
+        pa.npages = PAGE_NPAGES;
+    }
+    pa.avail_pages = pa.npages;
+    memset(pa.start, 0, pa.npages * PAGE_SIZE);
+
+    // Carve the area into the biggest naturally-aligned blocks possible
+    uint32_t idx = 0;
+    while (idx < pa.npages) {
+        uint8_t order = PAGE_MAX_ORDER;
+        while ((idx & ((1 << order) - 1)) != 0 || idx + (1 << order) > pa.npages) {
+            order--;
+        }
+        add_free_block_locked(idx, order, true);
+        idx += 1 << order;
+    }
+
+    return 0;
+}
+
+/**
+ * @param zeroed: Set to true if the contents of the returned block are all zeros
+ */
+static void *alloc_block(uint8_t order, bool *zeroed) {
+    if (order > PAGE_MAX_ORDER) {
+        return NULL;
+    }
+
+    irqctx_t ctx;
+    spinlock_acquire(&pa.lock, &ctx);
+
+    uint8_t o = order;
+    while (o <= PAGE_MAX_ORDER && list_empty(&pa.freelists[o])) {
+        o++;
+    }
+    if (o > PAGE_MAX_ORDER) {
+        spinlock_release(&pa.lock, &ctx);
+        return NULL;
+    }
+
+    list_head_t *node = pa.freelists[o].next;
+    uint32_t idx = ((char *) node - pa.start) / PAGE_SIZE;
+    *zeroed = remove_free_block_locked(idx, o);
+
+    // Split the block, the upper halves go back to the free lists
+    while (o > order) {
+        o--;
+        add_free_block_locked(idx + (1 << o), o, *zeroed);
+    }
+
+    pageinfo[idx] = PI_USED | order;
+    pa.avail_pages -= 1 << order;
+
+    spinlock_release(&pa.lock, &ctx);
+
+    if (*zeroed) {
+        // The list node was the only thing ever written into the block
+        memset(node, 0, sizeof(list_head_t));
+    }
+
+    insane_async("page_alloc(%u)=0x%p", order, page_addr(idx));
+    return page_addr(idx);
+}
+
+void *page_alloc(uint8_t order) {
+    bool zeroed;
+    return alloc_block(order, &zeroed);
+}
+
+void *page_alloc_zeroed(uint8_t order) {
+    bool zeroed;
+    void *ptr = alloc_block(order, &zeroed);
+    if (ptr != NULL && !zeroed) {
+        memset(ptr, 0, PAGE_SIZE << order);
+    }
+    return ptr;
+}
+
+void page_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    if ((char *) ptr < pa.start || (char *) ptr >= (char *) page_addr(pa.npages) ||
+            (((char *) ptr - pa.start) & (PAGE_SIZE - 1)) != 0) {
+        error_async("0x%p was not allocated with page_alloc()", ptr);
+        return;
+    }
+
+    uint32_t idx = ((char *) ptr - pa.start) / PAGE_SIZE;
+
+    irqctx_t ctx;
+    spinlock_acquire(&pa.lock, &ctx);
+
+    if (!(pageinfo[idx] & PI_USED)) {
+        spinlock_release(&pa.lock, &ctx);
+        error_async("Invalid page_free(0x%p), block not in use", ptr);
+        return;
+    }
+
+    uint8_t order = pageinfo[idx] & PI_ORDER_MASK;
+    pageinfo[idx] = 0;
+    pa.avail_pages += 1 << order;
+
+    // Coalesce with the buddy for as long as it is free and of the same order
+    while (order < PAGE_MAX_ORDER) {
+        uint32_t buddy = idx ^ (1 << order);
+        if (buddy + (1 << order) > pa.npages || (pageinfo[buddy] & ~PI_ZEROED) != (PI_FREE | order)) {
+            break;
+        }
+        remove_free_block_locked(buddy, order);
+        if (buddy < idx) {
+            idx = buddy;
+        }
+        order++;
+    }
+    add_free_block_locked(idx, order, false);
+
+    spinlock_release(&pa.lock, &ctx);
+
+    insane_async("page_free(0x%p)", ptr);
+}
+
+size_t page_get_size(void *ptr) {
+    uint32_t idx = ((char *) ptr - pa.start) / PAGE_SIZE;
+    if (idx >= pa.npages || !(pageinfo[idx] & PI_USED)) {
+        return 0;
+    }
+    return PAGE_SIZE << (pageinfo[idx] & PI_ORDER_MASK);
+}
+
+uint32_t page_get_available(void) {
+    return pa.avail_pages * PAGE_SIZE;
+}
+
+static int avail_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    char data[16];
+    int strlen = snprintf(data, sizeof(data), "%lu", page_get_available());
+    return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);
+}
+
+static int freeblocks_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    char data[24 * (PAGE_MAX_ORDER + 1)];
+    int strlen = 0;
+
+    irqctx_t ctx;
+    spinlock_acquire(&pa.lock, &ctx);
+    int i;
+    for (i = 0; i <= PAGE_MAX_ORDER; i++) {
+        strlen += snprintf(data + strlen, sizeof(data) - strlen, "%u: %lu\n", i, pa.nfree[i]);
+    }
+    spinlock_release(&pa.lock, &ctx);
+
+    return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);
+}
+
+static int page_alloc_create_sysfs(fs_sysfs_mod_t *sysfs) {
+    fs_dentry_t *dir = vfs_dir_create(_laritos.fs.mem_root, "pages",
+            FS_ACCESS_MODE_READ | FS_ACCESS_MODE_WRITE | FS_ACCESS_MODE_EXEC);
+    if (dir == NULL) {
+        error("Error creating pages sysfs directory");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file(dir, "avail", avail_read) == NULL) {
+        error("Failed to create 'avail' sysfs file");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file(dir, "freeblocks", freeblocks_read) == NULL) {
+        error("Failed to create 'freeblocks' sysfs file");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int page_alloc_remove_sysfs(fs_sysfs_mod_t *sysfs) {
+    return vfs_dir_remove(_laritos.fs.mem_root, "pages");
+}
+
+
+SYSFS_MODULE(page_alloc, page_alloc_create_sysfs, page_alloc_remove_sysfs)
+
+
+
+#ifdef CONFIG_TEST_CORE_MM_PAGE_ALLOC
+#include __FILE__
+#endif
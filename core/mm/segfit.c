@@ -0,0 +1,559 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <dstruct/list.h>
+#include <dstruct/bitset.h>
+#include <mm/heap.h>
+#include <utils/utils.h>
+#include <math.h>
+#include <sync/spinlock.h>
+#include <fs/vfs/core.h>
+#include <fs/vfs/types.h>
+#include <fs/pseudofs.h>
+
+/**
+ * Segregated-fit heap manager.
+ *
+ * Free blocks are kept in one list per power-of-two size class (class i holds the blocks
+ * whose payload size is within [2^i, 2^(i+1))). A bitmap tells which classes have free blocks,
+ * so finding a class that satisfies a request takes a couple of clz instructions.
+ * Every block is preceded by a boundary tag with the size of the previous block (only valid
+ * if that block is free), which allows us to coalesce both neighbours in constant time.
+ */
+
+#define SF_ALIGN 8
+#define SF_NUM_CLASSES 32
+#define SF_FLAG_FREE 0x1
+#define SF_FLAG_PREV_FREE 0x2
+#define SF_FLAGS_MASK (SF_ALIGN - 1)
+
+typedef struct {
+    /**
+     * Boundary tag, size of the previous block payload.
+     * Only valid when the SF_FLAG_PREV_FREE flag is set
+     */
+    uint32_t prev_size;
+    /**
+     * Payload size | SF_FLAG_*
+     */
+    uint32_t size;
+    /**
+     * Node used to link the block to its size class list.
+     * Only valid while the block is free, otherwise it is part of the payload.
+     */
+    list_head_t list;
+} sf_block_t;
+
+#define SF_HDR_SIZE (offsetof(sf_block_t, list))
+#define SF_MIN_PAYLOAD (sizeof(list_head_t))
+#define SF_MAX_PAYLOAD (1UL << (SF_NUM_CLASSES - 1))
+
+/**
+ * Free lists, one per size class
+ */
+static list_head_t classes[SF_NUM_CLASSES];
+
+/**
+ * Bit n (left-most numbering) is set if classes[n] is not empty
+ */
+static bitset_t classmap[SF_NUM_CLASSES / BITSET_NBITS];
+
+/**
+ * Sum of the payload sizes of all the free blocks
+ */
+static uint32_t avail;
+
+/**
+ * Heap lock
+ */
+static spinlock_t lock;
+
+
+static inline uint32_t block_size(sf_block_t *b) {
+    return b->size & ~SF_FLAGS_MASK;
+}
+
+static inline void block_set_size(sf_block_t *b, uint32_t size) {
+    b->size = size | (b->size & SF_FLAGS_MASK);
+}
+
+static inline bool block_is_free(sf_block_t *b) {
+    return (b->size & SF_FLAG_FREE) != 0;
+}
+
+static inline sf_block_t *block_next(sf_block_t *b) {
+    return (sf_block_t *) ((char *) b + SF_HDR_SIZE + block_size(b));
+}
+
+static inline sf_block_t *block_prev(sf_block_t *b) {
+    return (sf_block_t *) ((char *) b - b->prev_size - SF_HDR_SIZE);
+}
+
+static inline void *block_to_ptr(sf_block_t *b) {
+    return (char *) b + SF_HDR_SIZE;
+}
+
+static inline sf_block_t *ptr_to_block(void *ptr) {
+    return (sf_block_t *) ((char *) ptr - SF_HDR_SIZE);
+}
+
+/**
+ * @return floor(log2(size)), i.e. the size class a block of <size> bytes belongs to
+ */
+static inline uint32_t size_class(uint32_t size) {
+    int i;
+    for (i = 0; i < 32; i += BITSET_NBITS) {
+        // The first 1 in <size> is the first 0 in its negation
+        bitset_t chunk = (bitset_t) ~(size >> (32 - BITSET_NBITS - i));
+        uint8_t relidx = bitset_ffz(chunk);
+        if (relidx != BITSET_IDX_NOT_FOUND) {
+            return 31 - (i + relidx);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Note: Must be called with the heap lock held
+ *
+ * @return First non-empty class greater than or equal to <from>, BITSET_ARRAY_IDX_NOT_FOUND
+ * if there is none
+ */
+static inline uint32_t find_class_locked(uint32_t from) {
+    uint32_t i = from / BITSET_NBITS;
+    // Ignore the classes smaller than <from>
+    bitset_t bs = classmap[i] & (bitset_t) (((bitset_t) -1) >> (from % BITSET_NBITS));
+    while (1) {
+        uint8_t relidx = bitset_ffz((bitset_t) ~bs);
+        if (relidx != BITSET_IDX_NOT_FOUND) {
+            return i * BITSET_NBITS + relidx;
+        }
+        if (++i >= ARRAYSIZE(classmap)) {
+            return BITSET_ARRAY_IDX_NOT_FOUND;
+        }
+        bs = classmap[i];
+    }
+}
+
+/**
+ * Marks the block as free and adds it to its size class list
+ *
+ * Note: Must be called with the heap lock held
+ */
+static inline void insert_free_block_locked(sf_block_t *b) {
+    uint32_t size = block_size(b);
+    uint32_t cls = size_class(size);
+
+    b->size |= SF_FLAG_FREE;
+    sf_block_t *next = block_next(b);
+    next->prev_size = size;
+    next->size |= SF_FLAG_PREV_FREE;
+
+    list_add(&b->list, &classes[cls]);
+    bitset_array_lm_set(classmap, ARRAYSIZE(classmap), cls);
+    avail += size;
+}
+
+/**
+ * Removes the block from its size class list and marks it as used
+ *
+ * Note: Must be called with the heap lock held
+ */
+static inline void remove_free_block_locked(sf_block_t *b) {
+    uint32_t size = block_size(b);
+    uint32_t cls = size_class(size);
+
+    list_del(&b->list);
+    if (list_empty(&classes[cls])) {
+        bitset_array_lm_clear(classmap, ARRAYSIZE(classmap), cls);
+    }
+    avail -= size;
+
+    b->size &= ~SF_FLAG_FREE;
+    block_next(b)->size &= ~SF_FLAG_PREV_FREE;
+}
+
+/**
+ * Splits the (used) block <b> so that its payload is exactly <size> bytes, the remaining
+ * space is returned to the free lists.
+ *
+ * Note: Must be called with the heap lock held
+ */
+static inline void split_block_locked(sf_block_t *b, uint32_t size) {
+    uint32_t bsize = block_size(b);
+    // If there is no room for another block, we just keep the original size even if we
+    // waste some memory
+    if (bsize < size + SF_HDR_SIZE + SF_MIN_PAYLOAD) {
+        return;
+    }
+
+    block_set_size(b, size);
+    sf_block_t *rem = block_next(b);
+    rem->size = bsize - size - SF_HDR_SIZE;
+    insane_async("Splitting: [0x%p, size=%lu] + [0x%p, size=%lu]", b, size, rem, block_size(rem));
+    insert_free_block_locked(rem);
+}
+
+/**
+ * Same as split_block_locked(), but the remainder is first merged with the next block if
+ * that one is free (i.e. when <b> didn't just come from the free lists)
+ *
+ * Note: Must be called with the heap lock held
+ */
+static inline void trim_block_locked(sf_block_t *b, uint32_t size) {
+    sf_block_t *next = block_next(b);
+    if (block_is_free(next) && block_size(b) > size) {
+        remove_free_block_locked(next);
+        block_set_size(b, block_size(b) + SF_HDR_SIZE + block_size(next));
+    }
+    split_block_locked(b, size);
+}
+
+int heap_initialize(void *start, uint32_t size) {
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+
+    int i;
+    for (i = 0; i < ARRAYSIZE(classes); i++) {
+        INIT_LIST_HEAD(&classes[i]);
+    }
+
+    char *s = (char *) (((uint32_t) start + SF_ALIGN - 1) & ~(SF_ALIGN - 1));
+    size = (size - (s - (char *) start)) & ~(SF_ALIGN - 1);
+
+    // Zero-sized block always in use at the end of the heap, stops the coalescing process
+    sf_block_t *sentinel = (sf_block_t *) (s + size - SF_HDR_SIZE);
+    sentinel->prev_size = 0;
+    sentinel->size = 0;
+
+    sf_block_t *whole = (sf_block_t *) s;
+    whole->prev_size = 0;
+    whole->size = size - 2 * SF_HDR_SIZE;
+    insert_free_block_locked(whole);
+
+    spinlock_release(&lock, &ctx);
+    return 0;
+}
+
+/**
+ * Note: Must be called with the heap lock held
+ */
+static void *malloc_locked(size_t size) {
+    uint32_t cls = size_class(size);
+    // Any block from a class above the requested one will satisfy the request. If size is
+    // a power of two, then every block in its own class will do as well
+    uint32_t from = (size & (size - 1)) == 0 ? cls : cls + 1;
+
+    sf_block_t *b = NULL;
+    uint32_t found = from < SF_NUM_CLASSES ? find_class_locked(from) : BITSET_ARRAY_IDX_NOT_FOUND;
+    if (found != BITSET_ARRAY_IDX_NOT_FOUND) {
+        b = list_first_entry(&classes[found], sf_block_t, list);
+    } else if (!list_empty(&classes[cls])) {
+        // Last resort, check the first block of the requested class (without walking the
+        // whole list, to keep malloc() bounded)
+        sf_block_t *first = list_first_entry(&classes[cls], sf_block_t, list);
+        if (block_size(first) >= size) {
+            b = first;
+        }
+    }
+
+    if (b == NULL) {
+        return NULL;
+    }
+
+    insane_async("Block found [0x%p, size=%lu]", b, block_size(b));
+    remove_free_block_locked(b);
+    split_block_locked(b, size);
+    return block_to_ptr(b);
+}
+
+/**
+ * Note: Must be called with the heap lock held
+ */
+static void free_locked(void *ptr) {
+    sf_block_t *b = ptr_to_block(ptr);
+    insane_async("Freeing ptr=0x%p, block [0x%p, size=%lu]", ptr, b, block_size(b));
+
+    if (block_is_free(b)) {
+        error_async("Double free of ptr=0x%p", ptr);
+        return;
+    }
+
+    // Merge with the next block
+    sf_block_t *next = block_next(b);
+    if (block_is_free(next)) {
+        insane_async("Merging: [0x%p, size=%lu] U [0x%p, size=%lu]", b, block_size(b), next, block_size(next));
+        remove_free_block_locked(next);
+        block_set_size(b, block_size(b) + SF_HDR_SIZE + block_size(next));
+    }
+
+    // Merge with the previous block
+    if (b->size & SF_FLAG_PREV_FREE) {
+        sf_block_t *prev = block_prev(b);
+        insane_async("Merging: [0x%p, size=%lu] U [0x%p, size=%lu]", prev, block_size(prev), b, block_size(b));
+        remove_free_block_locked(prev);
+        block_set_size(prev, block_size(prev) + SF_HDR_SIZE + block_size(b));
+        b = prev;
+    }
+
+    insert_free_block_locked(b);
+}
+
+static inline size_t normalize_size(size_t size) {
+    return max((size + SF_ALIGN - 1) & ~(SF_ALIGN - 1), SF_MIN_PAYLOAD);
+}
+
+void *_malloc(size_t size) {
+    if (size <= 0 || size > SF_MAX_PAYLOAD) {
+        return NULL;
+    }
+
+    insane_async("malloc(%d)", size);
+
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+    void *ptr = malloc_locked(normalize_size(size));
+    spinlock_release(&lock, &ctx);
+
+    return ptr;
+}
+
+void *_memalign(size_t alignment, size_t size) {
+    if (size <= 0 || size > SF_MAX_PAYLOAD || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        return NULL;
+    }
+    if (alignment <= SF_ALIGN) {
+        return _malloc(size);
+    }
+
+    insane_async("memalign(%lu, %d)", alignment, size);
+
+    size = normalize_size(size);
+
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+
+    // Worst case, we need to skip up to <alignment> bytes plus a minimum block to be able
+    // to give the unaligned head of the block back to the free lists
+    char *ptr = malloc_locked(normalize_size(size + alignment + SF_HDR_SIZE + SF_MIN_PAYLOAD));
+    if (ptr == NULL) {
+        spinlock_release(&lock, &ctx);
+        return NULL;
+    }
+
+    sf_block_t *b = ptr_to_block(ptr);
+    char *aligned = (char *) (((uintptr_t) ptr + alignment - 1) & ~(alignment - 1));
+    if (aligned != ptr) {
+        while (aligned - ptr < SF_HDR_SIZE + SF_MIN_PAYLOAD) {
+            aligned += alignment;
+        }
+        sf_block_t *ab = ptr_to_block(aligned);
+        ab->size = (char *) block_next(b) - aligned;
+        block_set_size(b, (char *) ab - ptr);
+        // Neighbours of a used block are never free, so the head doesn't need to be merged
+        insert_free_block_locked(b);
+        b = ab;
+    }
+    trim_block_locked(b, size);
+
+    spinlock_release(&lock, &ctx);
+    return block_to_ptr(b);
+}
+
+uint32_t _malloc_batch(size_t size, void **ptrs, uint32_t n) {
+    if (size <= 0 || size > SF_MAX_PAYLOAD) {
+        return 0;
+    }
+
+    insane_async("malloc_batch(%d, %lu)", size, n);
+
+    size = normalize_size(size);
+
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+
+    uint32_t i;
+    for (i = 0; i < n; i++) {
+        if ((ptrs[i] = malloc_locked(size)) == NULL) {
+            break;
+        }
+    }
+
+    spinlock_release(&lock, &ctx);
+    return i;
+}
+
+void _free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+    free_locked(ptr);
+    spinlock_release(&lock, &ctx);
+}
+
+bool _resize(void *ptr, size_t size) {
+    if (ptr == NULL || size <= 0 || size > SF_MAX_PAYLOAD) {
+        return false;
+    }
+
+    size = normalize_size(size);
+    sf_block_t *b = ptr_to_block(ptr);
+
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+
+    if (block_size(b) < size) {
+        sf_block_t *next = block_next(b);
+        if (!block_is_free(next) || block_size(b) + SF_HDR_SIZE + block_size(next) < size) {
+            spinlock_release(&lock, &ctx);
+            return false;
+        }
+        // Take over the next block, whatever is not needed will be split again below
+        insane_async("Growing: [0x%p, size=%lu] U [0x%p, size=%lu]", b, block_size(b), next, block_size(next));
+        remove_free_block_locked(next);
+        block_set_size(b, block_size(b) + SF_HDR_SIZE + block_size(next));
+    }
+    trim_block_locked(b, size);
+
+    spinlock_release(&lock, &ctx);
+    return true;
+}
+
+void _free_batch(void **ptrs, uint32_t n) {
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+
+    uint32_t i;
+    for (i = 0; i < n; i++) {
+        if (ptrs[i] != NULL) {
+            free_locked(ptrs[i]);
+        }
+    }
+
+    spinlock_release(&lock, &ctx);
+}
+
+size_t heap_get_chunk_size(void *ptr) {
+    return block_size(ptr_to_block(ptr));
+}
+
+uint32_t heap_get_available(void) {
+    return avail;
+}
+
+static int status_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+
+    uint32_t blocks = 0;
+    uint32_t maxs = 0;
+    uint32_t mins = 0xffffffff;
+    int i;
+    for (i = 0; i < ARRAYSIZE(classes); i++) {
+        sf_block_t *block;
+        list_for_each_entry(block, &classes[i], list) {
+            blocks++;
+            maxs = max(maxs, block_size(block));
+            mins = min(mins, block_size(block));
+        }
+    }
+
+    spinlock_release(&lock, &ctx);
+
+    char data[512];
+    int strlen = snprintf(data, sizeof(data),
+            "Free blocks: %lu\n"
+            "Max size: %lu\n"
+            "Min size: %lu",
+            blocks, maxs, blocks > 0 ? mins : 0);
+    return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);
+}
+
+static int classes_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    irqctx_t ctx;
+    spinlock_acquire(&lock, &ctx);
+
+    char data[512];
+    uint32_t totalb = 0;
+    int i;
+    for (i = 0; i < ARRAYSIZE(classes); i++) {
+        if (list_empty(&classes[i])) {
+            continue;
+        }
+        uint32_t blocks = 0;
+        list_head_t *pos;
+        list_for_each(pos, &classes[i]) {
+            blocks++;
+        }
+        int strlen = snprintf(data + totalb, sizeof(data) - totalb, "%lu %lu\n", 1UL << i, blocks);
+        if (strlen < 0) {
+            spinlock_release(&lock, &ctx);
+            return -1;
+        }
+        totalb += strlen;
+    }
+
+    spinlock_release(&lock, &ctx);
+
+    return pseudofs_write_to_buf(buf, blen, data, totalb, offset);
+}
+
+static int segfit_create_sysfs(fs_sysfs_mod_t *sysfs) {
+    fs_dentry_t *dir = vfs_dir_create(_laritos.fs.mem_root, "segfit",
+            FS_ACCESS_MODE_READ | FS_ACCESS_MODE_WRITE | FS_ACCESS_MODE_EXEC);
+    if (dir == NULL) {
+        error("Error creating segfit sysfs directory");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file(dir, "status", status_read) == NULL) {
+        error("Failed to create 'status' sysfs file");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file(dir, "classes", classes_read) == NULL) {
+        error("Failed to create 'classes' sysfs file");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int segfit_remove_sysfs(fs_sysfs_mod_t *sysfs) {
+    return vfs_dir_remove(_laritos.fs.mem_root, "segfit");
+}
+
+
+SYSFS_MODULE(segfit, segfit_create_sysfs, segfit_remove_sysfs)
+
+
+#ifdef CONFIG_TEST_CORE_MM_SEGFIT
+#include __FILE__
+#endif
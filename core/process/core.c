@@ -36,6 +36,7 @@
 #include <sched/context.h>
 #include <sync/spinlock.h>
 #include <sync/condition.h>
+#include <sync/rmutex.h>
 #include <sync/atomic.h>
 #include <fs/vfs/types.h>
 #include <fs/vfs/core.h>
@@ -46,15 +47,17 @@
 
 int process_init_global_context(void) {
     INIT_LIST_HEAD(&_laritos.proc.pcbs);
-    spinlock_init(&_laritos.proc.pcbs_lock);
-    spinlock_init(&_laritos.proc.pcbs_data_lock);
+    rwlock_init_class(&_laritos.proc.pcbs_lock, LOCK_CLASS_PCBS);
+    spinlock_init_class(&_laritos.proc.pcbs_data_lock, LOCK_CLASS_PCBS_DATA);
+    spinlock_init_class(&_laritos.proc.pi_lock, LOCK_CLASS_PI);
 
-    list_head_t *l;
-    CPU_LOCAL_FOR_EACH_CPU_VAR(_laritos.sched.ready_pcbs, l) {
-        INIT_LIST_HEAD(l);
+    sched_runqueue_t *rq;
+    CPU_LOCAL_FOR_EACH_CPU_VAR(_laritos.sched.rq, rq) {
+        sched_rq_init(rq);
     }
 
-    _laritos.proc.pcb_slab = slab_create(CONFIG_PROCESS_MAX_CONCURRENT_PROCS, sizeof(pcb_t));
+    _laritos.proc.pcb_slab = slab_create_growable(CONFIG_PROCESS_PCB_SLAB_CHUNK_ELEMS,
+                                CONFIG_PROCESS_MAX_CONCURRENT_PROCS, sizeof(pcb_t));
     return _laritos.proc.pcb_slab != NULL ? 0 : -1;
 }
 
@@ -67,6 +70,13 @@ int process_free(pcb_t *pcb) {
         error_async("You can only free a process in NOT_INIT or ZOMBIE state");
         return -1;
     }
+    // The fd table of a thread belongs to its leader, which is only freed once all of its
+    // threads are gone (see free_process_slab_locked())
+    if (pcb->leader == NULL && pcb->fs.fds_slab != NULL) {
+        vfs_file_close_all(pcb->fs.fds_slab);
+        slab_destroy(pcb->fs.fds_slab);
+        pcb->fs.fds_slab = NULL;
+    }
     // Wipe memory region for security reasons
     memset(pcb, 0, sizeof(pcb));
     slab_free(_laritos.proc.pcb_slab, pcb);
@@ -79,10 +89,19 @@ int process_free(pcb_t *pcb) {
  */
 static void free_process_slab_locked(refcount_t *ref) {
     pcb_t *pcb = container_of(ref, pcb_t, refcnt);
+    pcb_t *leader = pcb->leader;
     process_free(pcb);
+    // A thread keeps its leader (and therefore its fd table) alive
+    if (leader != NULL) {
+        ref_dec(&leader->refcnt);
+    }
 }
 
-pcb_t *process_alloc(void) {
+/**
+ * Allocates a pcb. If <leader> is not NULL, the new pcb is a thread sharing the fd
+ * table and cwd of <leader> instead of getting its own
+ */
+static pcb_t *do_process_alloc(pcb_t *leader) {
     pcb_t *pcb = slab_alloc(_laritos.proc.pcb_slab);
     if (pcb == NULL) {
         error_async("Couldn't allocate memory for process");
@@ -90,8 +109,14 @@ pcb_t *process_alloc(void) {
     }
 
     memset(pcb, 0, sizeof(pcb_t));
+    spinlock_init_class(&pcb->lock, LOCK_CLASS_PCB);
     INIT_LIST_HEAD(&pcb->sched.pcb_node);
     INIT_LIST_HEAD(&pcb->sched.sched_node);
+    INIT_LIST_HEAD(&pcb->sched.pi_node);
+    INIT_LIST_HEAD(&pcb->sched.pi_mutexes);
+#ifdef CONFIG_SCHED_CFS
+    rbnode_init(&pcb->sched.fair_node);
+#endif
     INIT_LIST_HEAD(&pcb->children);
     INIT_LIST_HEAD(&pcb->siblings);
     condition_init(&pcb->parent_waiting_cond);
@@ -101,11 +126,19 @@ pcb_t *process_alloc(void) {
         atomic32_init(&pcb->stats.syscalls[i], 0);
     }
     pcb->sched.status = PROC_STATUS_NOT_INIT;
+    pcb->sched.affinity = CPU_ALL_MASK;
     process_set_name(pcb, "?");
     process_assign_pid(pcb);
     pcb->cwd = _laritos.fs.root;
 
-    pcb->fs.fds_slab = slab_create(CONFIG_PROCESS_MAX_OPEN_FILES, sizeof(fs_file_t));
+    if (leader != NULL) {
+        pcb->leader = leader;
+        pcb->fs.fds_slab = leader->fs.fds_slab;
+        return pcb;
+    }
+
+    pcb->fs.fds_slab = slab_create_growable(CONFIG_PROCESS_FDS_SLAB_CHUNK_ELEMS,
+                                CONFIG_PROCESS_MAX_OPEN_FILES, sizeof(fs_file_t));
     if (pcb->fs.fds_slab == NULL) {
         error_async("Couldn't allocate memory for process fd slab");
         goto error_fds;
@@ -118,14 +151,23 @@ error_fds:
     return NULL;
 }
 
+pcb_t *process_alloc(void) {
+    return do_process_alloc(NULL);
+}
+
 int process_register(pcb_t *pcb) {
     irqctx_t ctx;
-    spinlock_acquire(&_laritos.proc.pcbs_lock, &ctx);
+    rwlock_write_acquire(&_laritos.proc.pcbs_lock, &ctx);
     irqctx_t datactx;
     spinlock_acquire(&_laritos.proc.pcbs_data_lock, &datactx);
 
     debug_async("Registering process with pid=%u, priority=%u", pcb->pid, pcb->sched.priority);
 
+    if (pcb->leader != NULL) {
+        // The thread references its leader until it is freed
+        ref_inc(&pcb->leader->refcnt);
+    }
+
     if (_laritos.process_mode) {
         pcb_t *parent = process_get_current();
         pcb->parent = parent;
@@ -141,14 +183,15 @@ int process_register(pcb_t *pcb) {
 
     list_add_tail(&pcb->sched.pcb_node, &_laritos.proc.pcbs);
 
-    sched_move_to_ready_locked(pcb);
+    sched_wake_up(pcb);
 
-    if (process_sysfs_create(pcb) < 0) {
+    // Threads are not exposed in sysfs, they are short-lived helpers of their leader
+    if (pcb->leader == NULL && process_sysfs_create(pcb) < 0) {
         error("Error creating sysfs entries for pid=%u", pcb->pid);
     }
 
     spinlock_release(&_laritos.proc.pcbs_data_lock, &datactx);
-    spinlock_release(&_laritos.proc.pcbs_lock, &ctx);
+    rwlock_write_release(&_laritos.proc.pcbs_lock, &ctx);
 
     return 0;
 }
@@ -161,22 +204,51 @@ int process_release_zombie_resources_locked(pcb_t *pcb) {
 
     debug_async("Releasing zombie resources for pid=%u, exit status=%d", pcb->pid, pcb->exit_status);
 
-    if (process_sysfs_remove(pcb) < 0) {
+    if (pcb->leader == NULL && process_sysfs_remove(pcb) < 0) {
         error("Error removing sysfs entries for pid=%u", pcb->pid);
     }
 
-    list_del(&pcb->sched.pcb_node);
     list_del(&pcb->sched.sched_node);
 
-    free(pcb->mm.imgaddr);
-    pcb->mm.imgaddr = NULL;
+    // A cpu may still be running on its stack (e.g. an exiting process on its way to
+    // schedule()), or saving its context into it. That cpu releases it once it switches
+    // away (see process_release_switched_out_zombie()), the pcb must outlive that
+    if (pcb->sched.on_cpu) {
+        ref_inc(&pcb->refcnt);
+    } else {
+        free(pcb->mm.imgaddr);
+        pcb->mm.imgaddr = NULL;
+    }
 
-    slab_destroy(pcb->fs.fds_slab);
-    pcb->fs.fds_slab = NULL;
+    // The fd table is closed and destroyed with the pcb (see process_free()), once no thread
+    // uses it
 
     return 0;
 }
 
+void process_release_switched_out_zombie(pcb_t *pcb) {
+    irqctx_t ctx;
+    spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
+    debug_async("Releasing the stack of pid=%u, its cpu switched away from it", pcb->pid);
+    free(pcb->mm.imgaddr);
+    pcb->mm.imgaddr = NULL;
+    pcb->sched.on_cpu = false;
+    // The parent may be waiting for it (see process_wait_for())
+    condition_notify_locked(&pcb->parent_waiting_cond);
+    // Taken in process_release_zombie_resources_locked(), may free the pcb
+    ref_dec(&pcb->refcnt);
+    spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
+}
+
+/**
+ * Note: Must be called with _laritos.proc.pcbs_data_lock held
+ *
+ * @return true if <pcb> is a ZOMBIE no cpu is using anymore
+ */
+static inline bool is_dead_locked(pcb_t *pcb) {
+    return pcb->sched.status == PROC_STATUS_ZOMBIE && !pcb->sched.on_cpu;
+}
+
 /**
  * Note: Must be called with _laritos.proc.pcbs_data_lock held
  */
@@ -217,13 +289,19 @@ pcb_t *asm_process_get_current(void) {
 void process_kill_locked(pcb_t *pcb) {
     verbose_async("Killing process pid=%u", pcb->pid);
     sched_move_to_zombie_locked(pcb);
+    rmutex_pi_process_exit(pcb);
 }
 
 void process_kill(pcb_t *pcb) {
     irqctx_t ctx;
-    spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
+    rwlock_write_acquire(&_laritos.proc.pcbs_lock, &ctx);
+    irqctx_t datactx;
+    spinlock_acquire(&_laritos.proc.pcbs_data_lock, &datactx);
     process_kill_locked(pcb);
-    spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
+    // Readers of the pcbs list may be walking it, unlink it with the write side held
+    list_del(&pcb->sched.pcb_node);
+    spinlock_release(&_laritos.proc.pcbs_data_lock, &datactx);
+    rwlock_write_release(&_laritos.proc.pcbs_lock, &ctx);
 }
 
 void process_kill_and_schedule(pcb_t *pcb) {
@@ -232,29 +310,68 @@ void process_kill_and_schedule(pcb_t *pcb) {
 }
 
 int process_set_priority(pcb_t *pcb, uint8_t priority) {
-    irqctx_t ctx;
-    spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
-
     if (!pcb->kernel && priority < CONFIG_SCHED_PRIORITY_MAX_USER) {
         error_async("Invalid priority for a user process, max priority = %u", CONFIG_SCHED_PRIORITY_MAX_USER);
-        spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
         return -1;
     }
 
+    irqctx_t ctx;
+    spinlock_acquire(&_laritos.proc.pi_lock, &ctx);
     debug_async("Setting priority for process at 0x%p to %u", pcb, priority);
+    pcb->sched.base_priority = priority;
+    // The process may still inherit a higher priority from the waiters of its rmutexes
+    rmutex_pi_update_priority_locked(pcb);
+    spinlock_release(&_laritos.proc.pi_lock, &ctx);
+
+    return 0;
+}
+
+void process_apply_priority_locked(pcb_t *pcb, uint8_t priority) {
+    irqctx_t pcbctx;
+    irqctx_t rqctx;
+    sched_runqueue_t *rq = sched_pcb_rq_lock(pcb, &pcbctx, &rqctx);
+
     uint8_t prev_prio = pcb->sched.priority;
+    // If the process is in the ready queue, then move it to the queue of its new priority
+    if (pcb->sched.status == PROC_STATUS_READY) {
+        sched_rq_dequeue_locked(rq, pcb);
+    }
     pcb->sched.priority = priority;
 
-    // If the process is in the ready queue, then reorder it based on the new priority
     if (pcb->sched.status == PROC_STATUS_READY) {
-        sched_move_to_ready_locked(pcb);
+        sched_move_to_ready_on_cpu_locked(pcb, pcb->sched.cpu);
     } else if (pcb->sched.status == PROC_STATUS_RUNNING && priority > prev_prio) {
         // If the process is running and it now has a lower priority (i.e. higher number), then re-schedule.
         // There may be now a higher priority ready process
-        _laritos.sched.need_sched = true;
+        sched_request_resched_locked(pcb->sched.cpu);
     }
 
-    spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
+    sched_pcb_rq_unlock(pcb, rq, &pcbctx, &rqctx);
+}
+
+/**
+ * @return Mask of the valid cpus in <affinity>, 0 if there isn't any
+ */
+static inline cpubits_t valid_affinity(cpubits_t affinity) {
+    affinity &= BIT_FOR_CPU(CONFIG_CPU_MAX_CPUS) - 1;
+    if (affinity == 0) {
+        error_async("Invalid affinity, a process must be allowed to run on at least one cpu");
+    }
+    return affinity;
+}
+
+int process_set_affinity(pcb_t *pcb, cpubits_t affinity) {
+    affinity = valid_affinity(affinity);
+    if (affinity == 0) {
+        return -1;
+    }
+
+    irqctx_t ctx;
+    spinlock_acquire(&pcb->lock, &ctx);
+    debug_async("Setting affinity for process at 0x%p to 0x%lx", pcb, affinity);
+    pcb->sched.affinity = affinity;
+    sched_apply_affinity(pcb);
+    spinlock_release(&pcb->lock, &ctx);
 
     return 0;
 }
@@ -268,7 +385,8 @@ void process_exit(int exit_status) {
 
     debug_async("Exiting process pid=%u, exitcode=%d", pcb->pid, pcb->exit_status);
 
-    vfs_file_close_all_for_cur_process();
+    // Open files are closed once the last process sharing the fd table is freed, threads
+    // may still be using them
     process_kill_and_schedule(pcb);
 }
 
@@ -279,11 +397,15 @@ static void kernel_main_wrapper(kproc_main_t main, void *data) {
     // Execution will never reach this point
 }
 
-pcb_t *process_spawn_kernel_process(char *name, kproc_main_t main, void *data, uint32_t stacksize, uint8_t priority) {
-    debug_async("Spawning kernel process (name=%-7.7s, main=0x%p, data=0x%p, prio=%u)", name, main, data, priority);
+static pcb_t *spawn_kernel(char *name, kproc_main_t main, void *data, uint32_t stacksize, uint8_t priority,
+        cpubits_t affinity, pcb_t *leader) {
+    affinity = valid_affinity(affinity);
+    if (affinity == 0) {
+        goto error_pcb;
+    }
 
     // Allocate PCB structure for this new process
-    pcb_t *pcb = process_alloc();
+    pcb_t *pcb = do_process_alloc(leader);
     if (pcb == NULL) {
         error_async("Could not allocate space for PCB");
         goto error_pcb;
@@ -291,7 +413,7 @@ pcb_t *process_spawn_kernel_process(char *name, kproc_main_t main, void *data, u
 
     process_set_name(pcb, name);
     pcb->kernel = true;
-    strncpy(pcb->cmd, "<kernel>", sizeof(pcb->cmd));
+    strncpy(pcb->cmd, leader != NULL ? "<thread>" : "<kernel>", sizeof(pcb->cmd));
 
     verbose_async("Allocating %lu bytes for kernel process stack", stacksize);
     // Since we only allocate space for the stack (for kernel processes), imgaddr is
@@ -330,6 +452,8 @@ pcb_t *process_spawn_kernel_process(char *name, kproc_main_t main, void *data, u
     arch_context_set_second_arg(pcb->mm.sp_ctx, data);
 
     process_set_priority(pcb, priority);
+    // Set before registering it, so that it's never queued on a cpu it isn't allowed to run on
+    pcb->sched.affinity = affinity;
 
     if (process_register(pcb) < 0) {
         error_async("Could not register process loaded at 0x%p", pcb);
@@ -347,6 +471,29 @@ error_pcb:
     return NULL;
 }
 
+pcb_t *process_spawn_kernel_process(char *name, kproc_main_t main, void *data, uint32_t stacksize, uint8_t priority) {
+    debug_async("Spawning kernel process (name=%-7.7s, main=0x%p, data=0x%p, prio=%u)", name, main, data, priority);
+    return spawn_kernel(name, main, data, stacksize, priority, CPU_ALL_MASK, NULL);
+}
+
+pcb_t *process_spawn_kernel_process_on(char *name, kproc_main_t main, void *data, uint32_t stacksize,
+        uint8_t priority, cpubits_t affinity) {
+    debug_async("Spawning kernel process (name=%-7.7s, main=0x%p, data=0x%p, prio=%u, affinity=0x%lx)",
+            name, main, data, priority, affinity);
+    return spawn_kernel(name, main, data, stacksize, priority, affinity, NULL);
+}
+
+pcb_t *process_spawn_kernel_thread(char *name, kproc_main_t main, void *data, uint32_t stacksize, uint8_t priority) {
+    if (!_laritos.process_mode) {
+        error_async("Kernel threads can only be spawned in process mode");
+        return NULL;
+    }
+    pcb_t *leader = process_get_leader(process_get_current());
+    debug_async("Spawning kernel thread (name=%-7.7s, main=0x%p, data=0x%p, prio=%u, leader=%u)",
+            name, main, data, priority, leader->pid);
+    return spawn_kernel(name, main, data, stacksize, priority, CPU_ALL_MASK, leader);
+}
+
 int process_wait_for(pcb_t *pcb, int *status) {
     verbose_async("Waiting for pid=%u", pcb->pid);
 
@@ -358,13 +505,14 @@ int process_wait_for(pcb_t *pcb, int *status) {
         return -1;
     }
 
-    if (pcb->sched.status == PROC_STATUS_ZOMBIE) {
+    if (is_dead_locked(pcb)) {
         handle_dead_child_locked(pcb, status);
         spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
         return 0;
     }
 
-    BLOCK_UNTIL(pcb->sched.status == PROC_STATUS_ZOMBIE, &pcb->parent_waiting_cond,
+    // Once it's a ZOMBIE, its cpu may still have to switch away from it
+    BLOCK_UNTIL(is_dead_locked(pcb), &pcb->parent_waiting_cond,
                 &_laritos.proc.pcbs_data_lock, &ctx);
     handle_dead_child_locked(pcb, status);
 
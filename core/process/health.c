@@ -30,6 +30,7 @@
 #include <mm/spprot.h>
 #include <sync/spinlock.h>
 #include <property/core.h>
+#include <utils/utils.h>
 #include <generated/autoconf.h>
 
 /**
@@ -44,10 +45,22 @@
  * % of available process stack at which to trigger a warning
  */
 #define AVAIL_PROC_STACK_THRESH_PROP "health.thresh.availstack"
+#ifdef CONFIG_MEM_HEAP_BUFFER_PROTECTION_SAMPLED
+/**
+ * 1 out of every N allocations is protected against buffer overflows
+ */
+#define HEAP_PROT_SAMPLE_RATE_PROP "mm.heapprot.sample_rate"
+#endif
 
 
 static void check_heap(void) {
     verbose("Checking heap healthy status");
+#ifdef CONFIG_MEM_HEAP_BUFFER_PROTECTION_SAMPLED
+    // Properties cannot be read from malloc() (it may be called with the property lock
+    // held), apply any change to the sample rate here instead
+    heap_prot_set_sample_rate(property_get_or_def_int32(HEAP_PROT_SAMPLE_RATE_PROP,
+            CONFIG_MEM_HEAP_PROT_SAMPLE_RATE));
+#endif
     uint32_t avail = heap_get_available() * 100 / CONFIG_MEM_HEAP_SIZE;
     if (avail < (uint32_t) property_get_or_def_int32(AVAIL_HEAP_THRESH_PROP, 30)) {
         warn("Running low on heap memory, %lu%% available", avail);
@@ -58,7 +71,7 @@ static void check_processes(void) {
     verbose("Checking processes healthy statuses");
 
     irqctx_t ctx;
-    spinlock_acquire(&_laritos.proc.pcbs_lock, &ctx);
+    rwlock_read_acquire(&_laritos.proc.pcbs_lock, &ctx);
 
     pcb_t *proc;
     for_each_process_locked(proc) {
@@ -76,7 +89,7 @@ static void check_processes(void) {
         }
     }
 
-    spinlock_release(&_laritos.proc.pcbs_lock, &ctx);
+    rwlock_read_release(&_laritos.proc.pcbs_lock, &ctx);
 }
 
 static int health_main(void *data) {
@@ -86,6 +99,10 @@ static int health_main(void *data) {
             PROPERTY_MODE_READ_BY_ALL | PROPERTY_MODE_WRITE_BY_ALL);
     property_create(AVAIL_PROC_STACK_THRESH_PROP, "30",
             PROPERTY_MODE_READ_BY_ALL | PROPERTY_MODE_WRITE_BY_ALL);
+#ifdef CONFIG_MEM_HEAP_BUFFER_PROTECTION_SAMPLED
+    property_create(HEAP_PROT_SAMPLE_RATE_PROP, TOSTRING(CONFIG_MEM_HEAP_PROT_SAMPLE_RATE),
+            PROPERTY_MODE_READ_BY_ALL | PROPERTY_MODE_WRITE_BY_ALL);
+#endif
 
     while (1) {
         check_heap();
@@ -25,17 +25,71 @@
 #include <process/types.h>
 #include <process/core.h>
 #include <arch/cpu.h>
+#include <cpu/core.h>
+#include <irq/core.h>
+#include <sched/core.h>
+#include <sync/spinlock.h>
+#include <component/ticker.h>
 #include <generated/autoconf.h>
 
+#ifdef CONFIG_TICKER_NOHZ_IDLE
+static inline bool is_anyone_else_ready(void) {
+    irqctx_t ctx;
+    sched_runqueue_t *rq = sched_rq_lock(cpu_get_id(), &ctx);
+    bool ready = rq->nready > 0;
+    sched_rq_unlock(rq, &ctx);
+    return ready || *CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.need_sched);
+}
+
+/**
+ * The OS tickers keep the global time and are driven by the boot cpu, they can only be
+ * stopped when there is no other cpu relying on them
+ */
+static inline bool can_stop_ticker(void) {
+#ifdef CONFIG_SMP
+    return _laritos.sched.online == BIT_FOR_CPU(cpu_get_id());
+#else
+    return true;
+#endif
+}
+#endif
+
 static int idle_main(void *data) {
     while (1) {
         insane("IDLE");
+#ifdef CONFIG_TICKER_NOHZ_IDLE
+        // With irqs disabled, any irq raised from now on will still wake the cpu up from wfi,
+        // but won't be handled until the ticker is running again
+        irqctx_t ctx;
+        irq_disable_local_and_save_ctx(&ctx);
+        if (!is_anyone_else_ready()) {
+            if (can_stop_ticker()) {
+                ticker_nohz_enter_all();
+                arch_cpu_wfi();
+                ticker_nohz_exit_all();
+            } else {
+                arch_cpu_wfi();
+            }
+        }
+        irq_local_restore_ctx(&ctx);
+#else
         arch_cpu_wfi();
+#endif
     }
     return 0;
 }
 
+pcb_t *idle_launch_on_cpu(uint8_t cpuid) {
+    // Pinned from the start, no other cpu may ever pick it
+    pcb_t *pcb = process_spawn_kernel_process_on("idle", idle_main, NULL,
+            CONFIG_PROCESS_IDLE_STACK_SIZE, CONFIG_SCHED_PRIORITY_LOWEST, BIT_FOR_CPU(cpuid));
+    if (pcb == NULL) {
+        return NULL;
+    }
+    *CPU_LOCAL_GET_PTR_FOR_CPU(_laritos.sched.idle, cpuid) = pcb;
+    return pcb;
+}
+
 pcb_t *idle_launcher(void) {
-    return process_spawn_kernel_process("idle", idle_main, NULL,
-            CONFIG_PROCESS_IDLE_STACK_SIZE, CONFIG_SCHED_PRIORITY_LOWEST);
+    return idle_launch_on_cpu(cpu_get_id());
 }
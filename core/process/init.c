@@ -28,6 +28,7 @@
 #include <process/core.h>
 #include <process/sysfs.h>
 #include <cpu/core.h>
+#include <cpu/smp.h>
 #include <assert.h>
 #include <sync/spinlock.h>
 #include <component/component.h>
@@ -40,6 +41,7 @@
 #include <symbol.h>
 #include <utils/conf.h>
 #include <sched/core.h>
+#include <sched/workqueue.h>
 #include <fs/vfs/core.h>
 #include <module/core.h>
 #include <generated/autoconf.h>
@@ -117,8 +119,19 @@ static void init_loop(void) {
         irqctx_t ctx;
         spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
 
-        // Block and wait for events (e.g. new zombie process)
-        sched_move_to_blocked_locked(init, NULL);
+        // Block and wait for events (e.g. new zombie process). Zombies are created with
+        // pcbs_data_lock held, so none can slip in between the check and the block
+        pcb_t *child;
+        bool zombies = false;
+        for_each_child_process_locked(init, child) {
+            if (child->sched.status == PROC_STATUS_ZOMBIE) {
+                zombies = true;
+                break;
+            }
+        }
+        if (!zombies) {
+            sched_block_current();
+        }
 
         spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
 
@@ -139,6 +152,9 @@ int init_main(void *data) {
     log_always("-- laritOS " UTS_RELEASE " --");
     info("Initializing kernel");
     info("Heap of %u bytes initialized at 0x%p", CONFIG_MEM_HEAP_SIZE, __heap_start);
+#ifdef CONFIG_MM_PAGE_ALLOC
+    info("Page allocator managing %u bytes at 0x%p", CONFIG_MEM_PAGE_AREA_SIZE, __pages_start);
+#endif
 
     assert(module_load_static_modules() >= 0, "Failed to load static modules");
 
@@ -150,6 +166,9 @@ int init_main(void *data) {
     pcb_t *idle_launcher(void);
     assert(idle_launcher() != NULL, "Couldn't launch idle process");
 
+    info("Launching workqueue workers");
+    assert(workqueue_launch_on_cpu(cpu_get_id()) >= 0, "Couldn't launch workqueue workers");
+
     assert(board_parse_and_initialize(&_laritos.bi) >= 0, "Couldn't initialize board");
 
 #ifdef CONFIG_LOG_LEVEL_DEBUG
@@ -162,8 +181,9 @@ int init_main(void *data) {
     debug_dump_registered_comps();
 #endif
 
-    // TODO Once we implement SMP, we should do this for each cpu
+    // Secondary cpus go through the same steps in smp_secondary_entry()
     assert(cpu_initialize() >= 0, "Failed to initialize cpu #%u", cpu_get_id());
+    assert(sched_attach_cpu(cpu()) >= 0, "Failed to attach scheduler to cpu #%u", cpu_get_id());
 
     // Save the RTC boot time. Useful for calculating the current time with nanoseconds
     // resolution (rtc just provides second resolution)
@@ -181,6 +201,10 @@ int init_main(void *data) {
         warn("Error mounting file systems from config file, some FSs may not be mounted");
     }
 
+#ifdef CONFIG_SMP
+    assert(smp_boot_secondary_cpus() >= 0, "Failed to start secondary cpus");
+#endif
+
     assert(launch_on_boot_processes() >= 0, "Failed to create system processes");
 
     assert(ticker_start_all() >= 0, "Failed to start OS tickers");
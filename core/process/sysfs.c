@@ -31,6 +31,7 @@
 #include <fs/vfs/types.h>
 #include <fs/pseudofs.h>
 #include <sched/context.h>
+#include <sched/core.h>
 #include <time/core.h>
 #include <sync/spinlock.h>
 #include <arch/debug.h>
@@ -49,12 +50,27 @@ static int _name##_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
     return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);\
 }
 
-SYSFS_DEF_READ(prio, 16, "%u", pcb->sched.priority)
+/**
+ * Same as SYSFS_DEF_READ() for the scheduling data, protected by the pcb and ready queue locks
+ */
+#define SYSFS_DEF_SCHED_READ(_name, _datalen, _fmt, _expr) \
+static int _name##_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) { \
+    pcb_t *pcb = f->data0; \
+    irqctx_t pcbctx; \
+    irqctx_t rqctx; \
+    sched_runqueue_t *rq = sched_pcb_rq_lock(pcb, &pcbctx, &rqctx); \
+    char data[_datalen]; \
+    int strlen = snprintf(data, sizeof(data), _fmt, _expr); \
+    sched_pcb_rq_unlock(pcb, rq, &pcbctx, &rqctx); \
+    return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);\
+}
+
+SYSFS_DEF_SCHED_READ(prio, 16, "%u", pcb->sched.priority)
 SYSFS_DEF_READ(ppid, 16, "%u", pcb->parent->pid)
-SYSFS_DEF_READ(running, 16, "%lu", (uint32_t) pcb->stats.ticks_spent[PROC_STATUS_RUNNING])
-SYSFS_DEF_READ(ready, 16, "%lu", (uint32_t) pcb->stats.ticks_spent[PROC_STATUS_READY])
-SYSFS_DEF_READ(blocked, 16, "%lu", (uint32_t) pcb->stats.ticks_spent[PROC_STATUS_BLOCKED])
-SYSFS_DEF_READ(status, 16, "%s", pcb_get_status_str(pcb->sched.status))
+SYSFS_DEF_SCHED_READ(running, 16, "%lu", (uint32_t) pcb->stats.ticks_spent[PROC_STATUS_RUNNING])
+SYSFS_DEF_SCHED_READ(ready, 16, "%lu", (uint32_t) pcb->stats.ticks_spent[PROC_STATUS_READY])
+SYSFS_DEF_SCHED_READ(blocked, 16, "%lu", (uint32_t) pcb->stats.ticks_spent[PROC_STATUS_BLOCKED])
+SYSFS_DEF_SCHED_READ(status, 16, "%s", pcb_get_status_str(pcb->sched.status))
 
 static int name_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
     pcb_t *pcb = f->data0;
@@ -67,8 +83,9 @@ static int name_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
 
 static int pc_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
     pcb_t *pcb = f->data0;
-    irqctx_t ctx;
-    spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
+    irqctx_t pcbctx;
+    irqctx_t rqctx;
+    sched_runqueue_t *rq = sched_pcb_rq_lock(pcb, &pcbctx, &rqctx);
 
     char data[64];
     regpc_t pc = pcb->sched.status == PROC_STATUS_RUNNING ? arch_cpu_get_pc() : arch_context_get_retaddr(pcb->mm.sp_ctx);
@@ -77,7 +94,7 @@ static int pc_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
 
     int strlen = snprintf(data, sizeof(data), "0x%p %s", pc, symbol);
 
-    spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
+    sched_pcb_rq_unlock(pcb, rq, &pcbctx, &rqctx);
     return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);
 }
 
@@ -94,15 +111,16 @@ static int availstack_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset
 
 static int mode_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
     pcb_t *pcb = f->data0;
-    irqctx_t ctx;
-    spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
+    irqctx_t pcbctx;
+    irqctx_t rqctx;
+    sched_runqueue_t *rq = sched_pcb_rq_lock(pcb, &pcbctx, &rqctx);
     char data[64];
     char mode[64] = { 0 };
     int strlen = snprintf(data, sizeof(data), "%s",
                     pcb->sched.status == PROC_STATUS_RUNNING ?
                         arch_debug_get_psr_str(arch_cpu_get_cpsr(), mode, sizeof(mode)) :
                         arch_debug_get_psr_str_from_ctx(pcb->mm.sp_ctx, mode, sizeof(mode)));
-    spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
+    sched_pcb_rq_unlock(pcb, rq, &pcbctx, &rqctx);
     return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);
 }
 
@@ -27,15 +27,18 @@
 #include <strtoxl.h>
 #include <property/core.h>
 #include <mm/heap.h>
-#include <sync/spinlock.h>
+#include <mm/kmem-cache.h>
+#include <sync/rwlock.h>
 #include <fs/vfs/core.h>
 #include <fs/vfs/types.h>
 #include <fs/pseudofs.h>
 #include <math.h>
 
+DEF_KMEM_CACHE(property_cache, "property", property_t, NULL, NULL);
+
 int property_init_global_context(void) {
     INIT_LIST_HEAD(&_laritos.properties);
-    spinlock_init(&_laritos.prop_lock);
+    rwlock_init(&_laritos.prop_lock);
     return 0;
 }
 
@@ -93,18 +96,18 @@ int property_create(char *id, char *value, prop_mode_t mode) {
     debug("Creating property %s with value='%s', mode=0x%x", id, value, mode);
 
     irqctx_t ctx;
-    spinlock_acquire(&_laritos.prop_lock, &ctx);
+    rwlock_write_acquire(&_laritos.prop_lock, &ctx);
 
     if (get_property_locked(id) != NULL) {
         error("Property %s already used", id);
-        spinlock_release(&_laritos.prop_lock, &ctx);
+        rwlock_write_release(&_laritos.prop_lock, &ctx);
         return -1;
     }
 
-    property_t *p = calloc(1, sizeof(property_t));
+    property_t *p = kmem_cache_alloc(&property_cache);
     if (p == NULL) {
         error("Couldn't create property %s", id);
-        spinlock_release(&_laritos.prop_lock, &ctx);
+        rwlock_write_release(&_laritos.prop_lock, &ctx);
         return -1;
     }
 
@@ -129,7 +132,7 @@ int property_create(char *id, char *value, prop_mode_t mode) {
 
     sysfs_create(p);
 
-    spinlock_release(&_laritos.prop_lock, &ctx);
+    rwlock_write_release(&_laritos.prop_lock, &ctx);
 
     return 0;
 }
@@ -138,18 +141,18 @@ int property_remove(char *id) {
     debug("Removing property %s", id);
 
     irqctx_t ctx;
-    spinlock_acquire(&_laritos.prop_lock, &ctx);
+    rwlock_write_acquire(&_laritos.prop_lock, &ctx);
 
     property_t *p = get_property_locked(id);
     if (p == NULL) {
         error("Property %s doesn't exist", id);
-        spinlock_release(&_laritos.prop_lock, &ctx);
+        rwlock_write_release(&_laritos.prop_lock, &ctx);
         return -1;
     }
 
     if ((p->mode & PROPERTY_MODE_WRITE_BY_OWNER) && p->owner != process_get_current()) {
         error("Cannot remove %s, not the property owner", id);
-        spinlock_release(&_laritos.prop_lock, &ctx);
+        rwlock_write_release(&_laritos.prop_lock, &ctx);
         return -1;
     }
 
@@ -167,61 +170,61 @@ int property_remove(char *id) {
         spinlock_release(&_laritos.proc.pcbs_data_lock, &pcbdata_ctx);
     }
 
-    spinlock_release(&_laritos.prop_lock, &ctx);
+    rwlock_write_release(&_laritos.prop_lock, &ctx);
 
-    free(p);
+    kmem_cache_free(&property_cache, p);
     return 0;
 }
 
 int property_set(char *id, char *value) {
     irqctx_t ctx;
-    spinlock_acquire(&_laritos.prop_lock, &ctx);
+    rwlock_write_acquire(&_laritos.prop_lock, &ctx);
 
     property_t *p = get_property_locked(id);
     if (p == NULL) {
         error("Property %s doesn't exist", id);
-        spinlock_release(&_laritos.prop_lock, &ctx);
+        rwlock_write_release(&_laritos.prop_lock, &ctx);
         return -1;
     }
 
     if ((p->mode & PROPERTY_MODE_WRITE_BY_OWNER) && p->owner != process_get_current()) {
         error("Cannot write %s, not the property owner", id);
-        spinlock_release(&_laritos.prop_lock, &ctx);
+        rwlock_write_release(&_laritos.prop_lock, &ctx);
         return -1;
     }
     if (!(p->mode & (PROPERTY_MODE_WRITE_BY_ALL | PROPERTY_MODE_WRITE_BY_OWNER))) {
         error("Cannot write %s, read-only property", id);
-        spinlock_release(&_laritos.prop_lock, &ctx);
+        rwlock_write_release(&_laritos.prop_lock, &ctx);
         return -1;
     }
 
     strncpy(p->value, value, sizeof(p->value) - 1);
 
-    spinlock_release(&_laritos.prop_lock, &ctx);
+    rwlock_write_release(&_laritos.prop_lock, &ctx);
 
     return 0;
 }
 
 int property_get(char *id, char *buf) {
     irqctx_t ctx;
-    spinlock_acquire(&_laritos.prop_lock, &ctx);
+    rwlock_read_acquire(&_laritos.prop_lock, &ctx);
 
     property_t *p = get_property_locked(id);
     if (p == NULL) {
         verbose("Property %s doesn't exist", id);
-        spinlock_release(&_laritos.prop_lock, &ctx);
+        rwlock_read_release(&_laritos.prop_lock, &ctx);
         return -1;
     }
 
     if ((p->mode & PROPERTY_MODE_READ_BY_OWNER) && p->owner != process_get_current()) {
         error("Cannot read %s, not the property owner", id);
-        spinlock_release(&_laritos.prop_lock, &ctx);
+        rwlock_read_release(&_laritos.prop_lock, &ctx);
         return -1;
     }
 
     strncpy(buf, p->value, sizeof(p->value) - 1);
 
-    spinlock_release(&_laritos.prop_lock, &ctx);
+    rwlock_read_release(&_laritos.prop_lock, &ctx);
 
     return 0;
 }
@@ -0,0 +1,220 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <core.h>
+#include <board/core.h>
+#include <process/types.h>
+#include <process/status.h>
+#include <sched/core.h>
+#include <sched/cfs.h>
+#include <component/ticker.h>
+#include <component/sched.h>
+#include <dstruct/list.h>
+#include <dstruct/rbtree.h>
+#include <time/system-tick.h>
+#include <mm/heap.h>
+#include <generated/autoconf.h>
+
+#define CFS_WEIGHT_DEFAULT 1024
+#define CFS_VRUNTIME_PER_TICK ((uint64_t) CFS_WEIGHT_DEFAULT)
+#define CFS_GRANULARITY (CONFIG_SCHED_CFS_GRANULARITY * CFS_VRUNTIME_PER_TICK)
+
+/**
+ * 1024 * 2^(-i/16), used to interpolate the weight between two halvings
+ */
+static const uint16_t weight_frac[16] = {
+    1024, 981, 939, 899, 861, 824, 789, 756, 724, 693, 664, 636, 609, 583, 558, 535,
+};
+
+uint32_t sched_cfs_get_weight(uint8_t priority) {
+    int d = (int) priority - CONFIG_SCHED_PRIORITY_USER_DEFAULT;
+    int h = CONFIG_SCHED_CFS_PRIORITY_HALVING;
+    if (d >= 0) {
+        int q = d / h;
+        uint32_t w = weight_frac[(d % h) * 16 / h];
+        return q < 10 ? w >> q : 1;
+    }
+    int q = (-d + h - 1) / h;
+    uint32_t w = weight_frac[(q * h + d) * 16 / h];
+    return w << min(q, 16);
+}
+
+static inline uint64_t ticks_to_vruntime(tick_t ticks, uint8_t priority) {
+    return (uint64_t) ticks * CFS_WEIGHT_DEFAULT * CFS_VRUNTIME_PER_TICK / sched_cfs_get_weight(priority);
+}
+
+/**
+ * Processes with the lowest priority (i.e. idle) only run when nobody else is ready,
+ * instead of getting a (tiny) share of the cpu
+ */
+static inline bool is_idle_class(pcb_t *pcb) {
+    return pcb->sched.priority == CONFIG_SCHED_PRIORITY_LOWEST;
+}
+
+/**
+ * Adds the running time accumulated since the last charge to the virtual runtime of <pcb>
+ */
+static inline void charge_locked(pcb_t *pcb) {
+    tick_t running = pcb->stats.ticks_spent[PROC_STATUS_RUNNING];
+    pcb->sched.vruntime += ticks_to_vruntime(running - pcb->sched.vruntime_ticks, pcb->sched.priority);
+    pcb->sched.vruntime_ticks = running;
+}
+
+static bool vruntime_less(const rbnode_t *a, const rbnode_t *b) {
+    pcb_t *pa = rbtree_entry(a, pcb_t, sched.fair_node);
+    pcb_t *pb = rbtree_entry(b, pcb_t, sched.fair_node);
+    if (is_idle_class(pa) != is_idle_class(pb)) {
+        return is_idle_class(pb);
+    }
+    return pa->sched.vruntime < pb->sched.vruntime;
+}
+
+static inline void update_min_vruntime_locked(sched_runqueue_t *rq) {
+    pcb_t *first = sched_cfs_first_locked(rq);
+    if (first != NULL && !is_idle_class(first) && first->sched.vruntime > rq->min_vruntime) {
+        rq->min_vruntime = first->sched.vruntime;
+    }
+}
+
+void sched_cfs_enqueue_locked(sched_runqueue_t *rq, pcb_t *pcb) {
+    charge_locked(pcb);
+
+    // New processes and processes waking up after a long sleep are placed right behind
+    // the others, otherwise they would monopolize the cpu until catching up
+    if (rq->min_vruntime > CFS_GRANULARITY && pcb->sched.vruntime < rq->min_vruntime - CFS_GRANULARITY) {
+        pcb->sched.vruntime = rq->min_vruntime - CFS_GRANULARITY;
+    }
+
+    rbtree_insert(&rq->vtree, &pcb->sched.fair_node, vruntime_less);
+    rq->nready++;
+    update_min_vruntime_locked(rq);
+}
+
+void sched_cfs_dequeue_locked(sched_runqueue_t *rq, pcb_t *pcb) {
+    if (!rbnode_is_linked(&pcb->sched.fair_node)) {
+        return;
+    }
+    rbtree_remove(&rq->vtree, &pcb->sched.fair_node);
+    rq->nready--;
+    update_min_vruntime_locked(rq);
+}
+
+bool sched_cfs_should_preempt_locked(sched_runqueue_t *rq, pcb_t *curpcb, pcb_t *pcb) {
+    if (is_idle_class(curpcb) != is_idle_class(pcb)) {
+        return is_idle_class(curpcb);
+    }
+
+    // Include the ticks the current process has been running for since it was scheduled
+    tick_t running = curpcb->stats.ticks_spent[PROC_STATUS_RUNNING] +
+            (tick_t) (tick_get_os_ticks() - curpcb->stats.last_status_change) - curpcb->sched.vruntime_ticks;
+    uint64_t curvr = curpcb->sched.vruntime + ticks_to_vruntime(running, curpcb->sched.priority);
+    return curvr > pcb->sched.vruntime + CFS_GRANULARITY;
+}
+
+static inline pcb_t *pick_ready_locked(sched_comp_t *sched, struct cpu *cpu, pcb_t *curpcb) {
+    return sched_rq_first_locked(sched_get_rq_locked());
+}
+
+static int attach_cpu_locked(sched_comp_t *sched, cpu_t *cpu) {
+    sched_runqueue_t *rq = &_laritos.sched.rq[cpu->id];
+    if (rq->fair) {
+        return 0;
+    }
+
+    // Processes that became READY before the scheduler was attached (e.g. idle) are in
+    // the priority queues, move them to the fair queue
+    LIST_HEAD(pending);
+    pcb_t *pcb;
+    pcb_t *temp;
+    while ((pcb = sched_rq_first_locked(rq)) != NULL) {
+        sched_rq_dequeue_locked(rq, pcb);
+        list_add_tail(&pcb->sched.sched_node, &pending);
+    }
+
+    rq->fair = true;
+    list_for_each_entry_safe(pcb, temp, &pending, sched.sched_node) {
+        list_del_init(&pcb->sched.sched_node);
+        sched_rq_enqueue_locked(rq, pcb);
+    }
+    return 0;
+}
+
+static int cfs_ticker_cb(ticker_comp_t *t, void *data) {
+    *CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.need_sched) = true;
+    return 0;
+}
+
+static int init(component_t *c) {
+    sched_comp_t *sched = (sched_comp_t *) c;
+    return sched->ticker->ops.add_callback(sched->ticker, cfs_ticker_cb, sched);
+}
+
+static int deinit(component_t *c) {
+    sched_comp_t *sched = (sched_comp_t *) c;
+    return sched->ticker->ops.remove_callback(sched->ticker, cfs_ticker_cb, sched);
+}
+
+static int process(board_comp_t *comp) {
+    sched_comp_t *s = component_alloc(sizeof(sched_comp_t));
+    if (s == NULL) {
+        error("Failed to allocate memory for '%s'", comp->id);
+        return -1;
+    }
+
+    s->ops.pick_ready_locked = pick_ready_locked;
+    s->ops.attach_cpu_locked = attach_cpu_locked;
+
+    if (component_init((component_t *) s, comp->id, comp, COMP_TYPE_SCHED, init, deinit) < 0) {
+        error("Failed to initialize '%s' scheduler component", comp->id);
+        goto fail;
+    }
+
+    if (board_get_component_attr(comp, "ticker", (component_t **) &s->ticker) < 0) {
+        error("Invalid or no ticker specified in the board info");
+        goto fail;
+    }
+
+    component_set_info((component_t *) s, "CFS Scheduler", "lzungri", "Completely fair scheduler");
+
+    if (component_register((component_t *) s) < 0) {
+        error("Couldn't register scheduler '%s'", comp->id);
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+    free(s);
+    return -1;
+}
+
+DRIVER_MODULE(cfs, process);
+
+
+#ifdef CONFIG_TEST_CORE_SCHED_CFS
+#include __FILE__
+#endif
@@ -31,7 +31,7 @@
 #include <cpu/cpu-local.h>
 
 static inline pcb_t *pick_ready_locked(sched_comp_t *sched, struct cpu *cpu, pcb_t *curpcb) {
-    return list_first_entry_or_null(CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.ready_pcbs), pcb_t, sched.sched_node);
+    return sched_rq_first_locked(sched_get_rq_locked());
 }
 
 static int process(board_comp_t *comp) {
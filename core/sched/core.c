@@ -38,20 +38,59 @@
 #include <mm/exc-handlers.h>
 #include <sync/spinlock.h>
 #include <sync/atomic.h>
+#include <sync/rcu.h>
+
+void sched_finish_switch(void) {
+    pcb_t **prevp = CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.prev);
+    if (*prevp == NULL) {
+        return;
+    }
+
+    // Until now, <prev> could only be queued on this cpu (see sched_wake_up()). The slot
+    // is checked again with the lock held, it is cleared if <prev> gets killed meanwhile
+    irqctx_t rqctx;
+    sched_runqueue_t *rq = sched_rq_lock(cpu_get_id(), &rqctx);
+    pcb_t *prev = *prevp;
+    *prevp = NULL;
+    bool misplaced = false;
+    bool zombie = false;
+    if (prev != NULL) {
+        // The on_cpu flag of a zombie is cleared once its stack is released
+        zombie = prev->sched.status == PROC_STATUS_ZOMBIE;
+        if (!zombie) {
+            prev->sched.on_cpu = false;
+            misplaced = prev->sched.status == PROC_STATUS_READY && !sched_can_run_on(prev, prev->sched.cpu);
+        }
+    }
+    sched_rq_unlock(rq, &rqctx);
+
+    if (zombie) {
+        // Killed while its context was still live on this cpu, nothing uses its stack anymore
+        process_release_switched_out_zombie(prev);
+    } else if (misplaced) {
+        // Its affinity changed while it was running
+        sched_apply_affinity(prev);
+    }
+}
 
 /**
- * NOTE: Must be called with irqs disabled and pcbs_data_lock held
+ * NOTE: Must be called with irqs disabled and the lock of the local ready queue <rq> held
  */
-static inline void sched_switch_to_locked(pcb_t *from, pcb_t *to, irqctx_t *pcbdatalock_ctx) {
+static inline void sched_switch_to_locked(pcb_t *from, pcb_t *to, sched_runqueue_t *rq, irqctx_t *rqctx) {
     sched_move_to_running_locked(to);
+    // <from> cannot be picked by other cpus until its context is saved. If it's a zombie,
+    // its stack is released once this cpu stops using it
+    *CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.prev) = from;
 
-    spinlock_release(&_laritos.proc.pcbs_data_lock, pcbdatalock_ctx);
+    sched_rq_unlock(rq, rqctx);
 
     context_save_and_restore(from, to);
 
     // Once the *from* context is restored, it will continue execution from
     // here (actually from within the context_save_and_restore() function)
 
+    sched_finish_switch();
+
     insane_async("Resuming execution of pid=%u", process_get_current()->pid);
     // Check if the stack has been corrupted
     if (spprot_is_stack_corrupted(process_get_current())) {
@@ -66,50 +105,217 @@ static inline void sched_switch_to_locked(pcb_t *from, pcb_t *to, irqctx_t *pcbd
 }
 
 /**
- * NOTE: Must be called with irqs disabled and pcbs_data_lock held
+ * NOTE: Must be called with irqs disabled and the lock of the local ready queue <rq> held
  */
-static inline void context_switch_locked(pcb_t *cur, pcb_t *to, irqctx_t *pcbdatalock_ctx) {
+static inline void context_switch_locked(pcb_t *cur, pcb_t *to, sched_runqueue_t *rq, irqctx_t *rqctx) {
     insane_async("Context switch pid=%u -> pid=%u", cur->pid, to->pid);
 
     // Update context switch stats
     atomic32_inc(&_laritos.stats.ctx_switches);
 
-    // Check whether the process is actually running (i.e. not a zombie)
+    // Check whether the process is actually running (i.e. not a zombie or blocked). It goes
+    // back to the local queue, sched_finish_switch() moves it elsewhere if its affinity
+    // doesn't allow this cpu anymore
     if (cur->sched.status == PROC_STATUS_RUNNING) {
-        sched_move_to_ready_locked(cur);
+        sched_move_to_ready_on_cpu_locked(cur, cpu_get_id());
+    }
+
+    sched_switch_to_locked(cur, to, rq, rqctx);
+}
+
+#ifdef CONFIG_SMP
+/**
+ * Takes the first READY process allowed to run on <cpuid> from the peer with the longest
+ * ready queue. The peer queue is only try-locked, an idle cpu must not wait on a busy one
+ * (nor deadlock with a cpu stealing in the opposite direction)
+ *
+ * NOTE: Must be called with the lock of the ready queue of <cpuid> held
+ *
+ * @return true if a process was moved to the ready queue of <cpuid>
+ */
+static bool steal_work_locked(uint8_t cpuid) {
+    uint8_t busiest = cpuid;
+    uint32_t maxready = 0;
+    uint8_t i;
+    for (i = 0; i < CONFIG_CPU_MAX_CPUS; i++) {
+        if (i == cpuid || !(_laritos.sched.online & BIT_FOR_CPU(i))) {
+            continue;
+        }
+        // Racy read, only used as a hint
+        uint32_t nready = sched_get_rq_of_cpu_locked(i)->nready;
+        if (nready > maxready) {
+            maxready = nready;
+            busiest = i;
+        }
+    }
+
+    if (busiest == cpuid) {
+        return false;
+    }
+
+    irqctx_t ctx;
+    sched_runqueue_t *rq = sched_get_rq_of_cpu_locked(busiest);
+    if (!spinlock_trylock(&rq->lock, &ctx)) {
+        return false;
+    }
+    pcb_t *victim = sched_rq_first_migratable_locked(rq, cpuid);
+    if (victim != NULL) {
+        sched_migrate_locked(victim, cpuid);
+        atomic32_inc(&_laritos.stats.steals);
+    }
+    sched_rq_unlock(rq, &ctx);
+    return victim != NULL;
+}
+#endif
+
+void sched_apply_affinity(pcb_t *pcb) {
+    uint8_t cpuid = cpu_get_id();
+    while (1) {
+        uint8_t from = pcb->sched.cpu;
+        if (sched_can_run_on(pcb, from)) {
+            return;
+        }
+        uint8_t to = sched_can_run_on(pcb, cpuid) ? cpuid : (uint8_t) __builtin_ctz(pcb->sched.affinity);
+
+        irqctx_t fromctx;
+        irqctx_t toctx;
+        sched_rq_double_lock(from, to, &fromctx, &toctx);
+        if (pcb->sched.cpu != from) {
+            // Moved by somebody else in the meantime, check again
+            sched_rq_double_unlock(from, to, &fromctx, &toctx);
+            continue;
+        }
+        if (pcb->sched.status == PROC_STATUS_READY && !pcb->sched.on_cpu) {
+            sched_migrate_locked(pcb, to);
+            sched_request_resched_locked(to);
+        } else if (pcb->sched.status == PROC_STATUS_RUNNING) {
+            // The scheduler will move it to an allowed cpu as soon as it gets switched out
+            sched_request_resched_locked(from);
+        }
+        sched_rq_double_unlock(from, to, &fromctx, &toctx);
+        return;
+    }
+}
+
+void sched_move_to_zombie_locked(pcb_t *pcb) {
+    irqctx_t spinctx;
+    irqctx_t pcbctx;
+    irqctx_t rqctx;
+    spinlock_t *spin;
+    sched_runqueue_t *rq;
+    while (1) {
+        // A process BLOCKED on a condition is linked to its list, protected by the spinlock
+        // of the condition (already held if it's a parent_waiting_cond)
+        spin = pcb->sched.blocked_spin;
+        if (spin != NULL && spin != &_laritos.proc.pcbs_data_lock) {
+            spinlock_acquire(spin, &spinctx);
+        }
+        rq = sched_pcb_rq_lock(pcb, &pcbctx, &rqctx);
+        if (pcb->sched.blocked_spin == spin) {
+            break;
+        }
+        // Woken up in the meantime
+        sched_pcb_rq_unlock(pcb, rq, &pcbctx, &rqctx);
+        if (spin != NULL && spin != &_laritos.proc.pcbs_data_lock) {
+            spinlock_release(spin, &spinctx);
+        }
+    }
+
+    insane_async("PID %u: %s -> ZOMBIE ", pcb->pid, pcb_get_status_str(pcb->sched.status));
+
+    bool running = pcb->sched.status == PROC_STATUS_RUNNING;
+    uint8_t cpuid = pcb->sched.cpu;
+
+    sched_update_stats_locked(pcb);
+    _sched_unlink_locked(pcb);
+    pcb->sched.blocked_spin = NULL;
+    pcb->sched.status = PROC_STATUS_ZOMBIE;
+    // If its context is still live on a cpu (i.e. on_cpu), that cpu releases its stack once
+    // it switches away from it (see sched_finish_switch())
+
+    sched_pcb_rq_unlock(pcb, rq, &pcbctx, &rqctx);
+    if (spin != NULL && spin != &_laritos.proc.pcbs_data_lock) {
+        spinlock_release(spin, &spinctx);
+    }
+
+    if (running && cpuid != cpu_get_id()) {
+        // Stop it right away
+        sched_request_resched_locked(cpuid);
+    }
+
+    pcb_t *child;
+    pcb_t *temp;
+    pcb_t *gparent = pcb->parent;
+
+    // Grandparent will become the new parent
+    for_each_child_process_safe_locked(pcb, child, temp) {
+        insane_async("pid=%u new parent pid=%u", child->pid, gparent->pid);
+        child->parent = gparent;
+        list_move_tail(&child->siblings, &gparent->children);
     }
 
-    sched_switch_to_locked(cur, to, pcbdatalock_ctx);
+    process_release_zombie_resources_locked(pcb);
+
+    // Notify blocked parent (if any) about its dead
+    condition_notify_locked(&pcb->parent_waiting_cond);
+
+    if (gparent == _laritos.proc.init) {
+        // New zombie process child of init, wake up init so that it releases its resources
+        sched_wake_up(_laritos.proc.init);
+    }
 }
 
 void schedule(void) {
     irqctx_t ctx;
     irq_disable_local_and_save_ctx(&ctx);
 
+    // In case the current process started executing from scratch (i.e. it didn't resume
+    // from sched_switch_to_locked())
+    sched_finish_switch();
+
+    // Any read-side critical section of this cpu is over
+    rcu_note_quiescent_state_locked();
+
     cpu_t *c = cpu();
     pcb_t *curpcb = process_get_current();
 
     // This lock is going to be released right before performing the actual context switch in
     // sched_switch_to_locked()
-    irqctx_t pcbdatalock_ctx;
-    spinlock_acquire(&_laritos.proc.pcbs_data_lock, &pcbdatalock_ctx);
+    irqctx_t rqctx;
+    sched_runqueue_t *rq = sched_rq_lock(c->id, &rqctx);
 
-    pcb_t *pcb = c->sched->ops.pick_ready_locked(c->sched, c, curpcb);;
+    pcb_t *pcb = c->sched->ops.pick_ready_locked(c->sched, c, curpcb);
+#ifdef CONFIG_SMP
+    // Rather than idling, take some work from a busier cpu
+    pcb_t *idle = *CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.idle);
+    if ((pcb == NULL || pcb == idle) && (curpcb == idle || curpcb->sched.status != PROC_STATUS_RUNNING) &&
+            steal_work_locked(c->id)) {
+        pcb = c->sched->ops.pick_ready_locked(c->sched, c, curpcb);
+    }
+#endif
     while (pcb != NULL && pcb != curpcb && !process_is_valid_context_locked(pcb, pcb->mm.sp_ctx)) {
-        exc_dump_process_info_locked(pcb);
+        // Killing a process takes locks that must be acquired before the ready queue lock
+        sched_rq_unlock(rq, &rqctx);
+        exc_dump_process_info(pcb);
         error_async("Cannot switch to pid=%u, invalid context. Killing process...", pcb->pid);
-        process_kill_locked(pcb);
-        pcb = c->sched->ops.pick_ready_locked(c->sched, c, curpcb);;
+        process_kill(pcb);
+        rq = sched_rq_lock(c->id, &rqctx);
+        pcb = c->sched->ops.pick_ready_locked(c->sched, c, curpcb);
     }
 
-    // If the current process is running and:
+    // If the current process is running, its affinity still allows this cpu and:
     //      - there is no other pcb ready,
     //      - or there is another pcb ready but with lower priority (i.e. higher number),
+    //        or, for a fair queue, the current process hasn't used up its share yet,
     // then continue execution of the current process
 
-    if (curpcb->sched.status == PROC_STATUS_RUNNING) {
-        if (pcb == NULL || (curpcb->sched.priority < pcb->sched.priority)) {
-            spinlock_release(&_laritos.proc.pcbs_data_lock, &pcbdatalock_ctx);
+    if (curpcb->sched.status == PROC_STATUS_RUNNING && sched_can_run_on(curpcb, c->id)) {
+        if (pcb == NULL || !sched_rq_should_preempt_locked(rq, curpcb, pcb)) {
+            if (curpcb->sched.quantum_left == 0) {
+                // Time slice expired but nobody else can run, start a new one
+                curpcb->sched.quantum_left = sched_get_quantum(curpcb->sched.priority);
+            }
+            sched_rq_unlock(rq, &rqctx);
             irq_local_restore_ctx(&ctx);
             return;
         }
@@ -117,9 +323,13 @@ void schedule(void) {
 
     assert(pcb != NULL, "No process ready for execution, where is the idle process?");
     if (curpcb != pcb) {
-        context_switch_locked(curpcb, pcb, &pcbdatalock_ctx);
+        context_switch_locked(curpcb, pcb, rq, &rqctx);
     } else {
-        spinlock_release(&_laritos.proc.pcbs_data_lock, &pcbdatalock_ctx);
+        if (pcb->sched.status == PROC_STATUS_READY) {
+            // Woken up before it got to switch out, just keep running
+            sched_move_to_running_locked(pcb);
+        }
+        sched_rq_unlock(rq, &rqctx);
     }
 
     irq_local_restore_ctx(&ctx);
@@ -127,11 +337,28 @@ void schedule(void) {
 
 void sched_execute_first_system_proc(pcb_t *pcb) {
     irqctx_t ctx;
-    spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
+    sched_runqueue_t *rq = sched_rq_lock(cpu_get_id(), &ctx);
     // Execute the first process
     sched_move_to_running_locked(pcb);
-    spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
+    sched_rq_unlock(rq, &ctx);
 
     context_restore(pcb);
     // Execution will never reach this point
 }
+
+int sched_attach_cpu(cpu_t *c) {
+    if (c->sched->ops.attach_cpu_locked == NULL) {
+        return 0;
+    }
+
+    irqctx_t ctx;
+    sched_runqueue_t *rq = sched_rq_lock(c->id, &ctx);
+    int ret = c->sched->ops.attach_cpu_locked(c->sched, c);
+    sched_rq_unlock(rq, &ctx);
+    return ret;
+}
+
+
+#ifdef CONFIG_TEST_CORE_SCHED_CORE
+#include __FILE__
+#endif
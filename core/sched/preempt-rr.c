@@ -33,11 +33,23 @@
 #include <cpu/cpu-local.h>
 
 static inline pcb_t *pick_ready_locked(sched_comp_t *sched, struct cpu *cpu, pcb_t *curpcb) {
-    return list_first_entry_or_null(CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.ready_pcbs), pcb_t, sched.sched_node);
+    return sched_rq_first_locked(sched_get_rq_locked());
 }
 
 static int rr_ticker_cb(ticker_comp_t *t, void *data) {
-    _laritos.sched.need_sched = true;
+    // Only re-schedule once the running process has used up its time slice. Higher priority
+    // processes becoming ready request a re-schedule on their own
+    pcb_t *pcb = *CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.running);
+    if (pcb != NULL && pcb->sched.quantum_left > 1) {
+        pcb->sched.quantum_left--;
+        atomic32_inc(&_laritos.stats.avoided_switches);
+        return 0;
+    }
+
+    if (pcb != NULL) {
+        pcb->sched.quantum_left = 0;
+    }
+    *CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.need_sched) = true;
     return 0;
 }
 
@@ -35,6 +35,24 @@ static int ctxswitches_read(fs_file_t *f, void *buf, size_t blen, uint32_t offse
     return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);
 }
 
+static int avoidedswitches_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    char data[16];
+    int strlen = snprintf(data, sizeof(data), "%lu", atomic32_get(&_laritos.stats.avoided_switches));
+    return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);
+}
+
+static int migrations_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    char data[16];
+    int strlen = snprintf(data, sizeof(data), "%lu", atomic32_get(&_laritos.stats.migrations));
+    return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);
+}
+
+static int steals_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
+    char data[16];
+    int strlen = snprintf(data, sizeof(data), "%lu", atomic32_get(&_laritos.stats.steals));
+    return pseudofs_write_to_buf(buf, blen, data, strlen + 1, offset);
+}
+
 static int osticks_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset) {
     char data[16];
     int strlen = snprintf(data, sizeof(data), "%lu", (uint32_t) atomic64_get(&_laritos.timeinfo.osticks));
@@ -54,6 +72,21 @@ static int create_root_sysfs(fs_sysfs_mod_t *sysfs) {
         return -1;
     }
 
+    if (pseudofs_create_custom_ro_file(_laritos.fs.sched_root, "avoidedswitches", avoidedswitches_read) == NULL) {
+        error("Failed to create 'avoidedswitches' sysfs file");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file(_laritos.fs.sched_root, "migrations", migrations_read) == NULL) {
+        error("Failed to create 'migrations' sysfs file");
+        return -1;
+    }
+
+    if (pseudofs_create_custom_ro_file(_laritos.fs.sched_root, "steals", steals_read) == NULL) {
+        error("Failed to create 'steals' sysfs file");
+        return -1;
+    }
+
     if (pseudofs_create_custom_ro_file(_laritos.fs.sched_root, "osticks", osticks_read) == NULL) {
         error("Failed to create 'osticks' sysfs file");
         return -1;
@@ -0,0 +1,132 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <core.h>
+#include <cpu/core.h>
+#include <cpu/cpu-local.h>
+#include <irq/core.h>
+#include <process/core.h>
+#include <sched/core.h>
+#include <sched/workqueue.h>
+#include <sync/atomic.h>
+#include <generated/autoconf.h>
+
+/**
+ * Note: Must be called with irqs disabled
+ *
+ * @return Oldest work queued on the current cpu, NULL if there isn't any
+ */
+static inline work_t *dequeue_work_locked(sched_workqueue_t *wq) {
+    work_t *work = wq->head;
+    if (work == NULL) {
+        return NULL;
+    }
+    wq->head = work->next;
+    if (wq->head == NULL) {
+        wq->tail = NULL;
+    }
+    work->next = NULL;
+    return work;
+}
+
+static int worker_main(void *data) {
+    uint32_t idx = (uint32_t) data;
+    while (1) {
+        irqctx_t ctx;
+        irq_disable_local_and_save_ctx(&ctx);
+        // The worker is pinned, the queue of the current cpu is always its own
+        sched_workqueue_t *wq = CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.wq);
+        work_t *work = dequeue_work_locked(wq);
+        if (work == NULL) {
+            // Irqs are disabled, no work can be queued on this cpu before the worker is BLOCKED.
+            // Work queued right after irqs are restored wakes it up before it is switched out
+            wq->waiting[idx] = true;
+            sched_block_current();
+            irq_local_restore_ctx(&ctx);
+            schedule();
+            continue;
+        }
+        // From now on, the work can be queued again (e.g. by an irq raised while it runs)
+        atomic32_dec(&work->pending);
+        irq_local_restore_ctx(&ctx);
+
+        insane_async("Running work 0x%p, func=0x%p", work, work->func);
+        work->func(work);
+    }
+    return 0;
+}
+
+bool workqueue_queue(work_t *work) {
+    if (atomic32_inc(&work->pending) != 1) {
+        // Already pending, it will run only once
+        atomic32_dec(&work->pending);
+        return false;
+    }
+
+    irqctx_t ctx;
+    irq_disable_local_and_save_ctx(&ctx);
+    sched_workqueue_t *wq = CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.wq);
+    work->next = NULL;
+    if (wq->tail != NULL) {
+        wq->tail->next = work;
+    } else {
+        wq->head = work;
+    }
+    wq->tail = work;
+
+    int i;
+    for (i = 0; i < ARRAYSIZE(wq->workers); i++) {
+        if (wq->waiting[i]) {
+            wq->waiting[i] = false;
+            sched_wake_up(wq->workers[i]);
+            break;
+        }
+    }
+    irq_local_restore_ctx(&ctx);
+    return true;
+}
+
+int workqueue_launch_on_cpu(uint8_t cpuid) {
+    sched_workqueue_t *wq = CPU_LOCAL_GET_PTR_FOR_CPU(_laritos.sched.wq, cpuid);
+    int i;
+    for (i = 0; i < ARRAYSIZE(wq->workers); i++) {
+        // Pinned from the start, it never runs on (nor touches the queue of) another cpu
+        pcb_t *pcb = process_spawn_kernel_process_on("kworker", worker_main, (void *) i,
+                CONFIG_SCHED_WORKQUEUE_STACK_SIZE, CONFIG_SCHED_WORKQUEUE_PRIORITY, BIT_FOR_CPU(cpuid));
+        if (pcb == NULL) {
+            error("Couldn't spawn worker #%d for cpu #%u", i, cpuid);
+            return -1;
+        }
+        wq->workers[i] = pcb;
+    }
+    return 0;
+}
+
+
+
+#ifdef CONFIG_TEST_CORE_SCHED_WORKQUEUE
+#include __FILE__
+#endif
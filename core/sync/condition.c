@@ -35,33 +35,15 @@ int condition_init(condition_t *cond) {
     return 0;
 }
 
-/**
- * HACK ALERT: A condition can be used in different scenarios, some of them may or may not
- * have the _laritos.proc.pcbs_data_lock lock held. In order to prevent deadlocks by
- * re-acquiring the same lock, we use the following hack to only grab the spinlock if it
- * wasn't already owned by the process.
- */
-static inline bool grab_pcbsdatalock_if_not_held(irqctx_t *pcbdata_ctx) {
-    if (spinlock_trylock(&_laritos.proc.pcbs_data_lock, pcbdata_ctx)) {
-        return true;
-    } else if (!spinlock_owned_by_me(&_laritos.proc.pcbs_data_lock)) {
-        spinlock_acquire(&_laritos.proc.pcbs_data_lock, pcbdata_ctx);
-        return true;
-    }
-    return false;
-}
-
 void condition_wait_locked(condition_t *cond, spinlock_t *spin, irqctx_t *ctx) {
     pcb_t *pcb = process_get_current();
 
-    irqctx_t pcbdata_ctx;
-    bool pcbs_lock_acquired = grab_pcbsdatalock_if_not_held(&pcbdata_ctx);
+    irqctx_t pcbctx;
+    irqctx_t rqctx;
+    sched_runqueue_t *rq = sched_pcb_rq_lock(pcb, &pcbctx, &rqctx);
+    sched_move_to_blocked_locked(pcb, &cond->blocked, spin);
+    sched_pcb_rq_unlock(pcb, rq, &pcbctx, &rqctx);
 
-    sched_move_to_blocked_locked(pcb, &cond->blocked);
-
-    if (pcbs_lock_acquired) {
-        spinlock_release(&_laritos.proc.pcbs_data_lock, &pcbdata_ctx);
-    }
     spinlock_release(spin, ctx);
 
     verbose_async("pid=%u waiting for condition=0x%p", pcb->pid, cond);
@@ -77,26 +59,20 @@ static inline void wakeup_pcb_locked(pcb_t *pcb, condition_t *cond) {
     }
     verbose_async("Waking up pid=%u waiting for condition=0x%p", pcb->pid, cond);
     list_del_init(&pcb->sched.sched_node);
-    sched_move_to_ready_locked(pcb);
+    sched_wake_up(pcb);
 }
 
 pcb_t *condition_notify_locked(condition_t *cond) {
-    irqctx_t pcbdata_ctx;
-    bool pcbs_lock_acquired = grab_pcbsdatalock_if_not_held(&pcbdata_ctx);
-
     pcb_t *pcb = list_first_entry_or_null(&cond->blocked, pcb_t, sched.sched_node);
     wakeup_pcb_locked(pcb, cond);
-
-    if (pcbs_lock_acquired) {
-        spinlock_release(&_laritos.proc.pcbs_data_lock, &pcbdata_ctx);
-    }
     return pcb;
 }
 
-bool condition_notify_all_locked(condition_t *cond) {
-    irqctx_t pcbdata_ctx;
-    bool pcbs_lock_acquired = grab_pcbsdatalock_if_not_held(&pcbdata_ctx);
+void condition_notify_pcb_locked(condition_t *cond, pcb_t *pcb) {
+    wakeup_pcb_locked(pcb, cond);
+}
 
+bool condition_notify_all_locked(condition_t *cond) {
     pcb_t *pcb;
     pcb_t *tmp;
     bool proc_awakened = false;
@@ -104,10 +80,5 @@ bool condition_notify_all_locked(condition_t *cond) {
         wakeup_pcb_locked(pcb, cond);
         proc_awakened = true;
     }
-
-    if (pcbs_lock_acquired) {
-        spinlock_release(&_laritos.proc.pcbs_data_lock, &pcbdata_ctx);
-    }
-
     return proc_awakened;
 }
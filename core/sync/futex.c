@@ -0,0 +1,118 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <core.h>
+#include <process/core.h>
+#include <sync/condition.h>
+#include <sync/futex.h>
+#include <sync/spinlock.h>
+#include <utils/utils.h>
+#include <generated/autoconf.h>
+
+typedef struct {
+    spinlock_t lock;
+    condition_t cond;
+} futex_bucket_t;
+
+static futex_bucket_t buckets[CONFIG_SYNC_FUTEX_BUCKETS];
+
+static inline futex_bucket_t *get_bucket(volatile int32_t *addr) {
+    // Multiplicative hash, the lower two bits of an aligned address are always 0
+    uint32_t hash = ((uint32_t) addr >> 2) * 2654435761u;
+    return &buckets[(hash >> 16) % ARRAYSIZE(buckets)];
+}
+
+static inline bool is_valid_addr(volatile int32_t *addr) {
+    return addr != NULL && ((uint32_t) addr & (sizeof(*addr) - 1)) == 0;
+}
+
+int futex_init_global_context(void) {
+    int i;
+    for (i = 0; i < ARRAYSIZE(buckets); i++) {
+        spinlock_init(&buckets[i].lock);
+        condition_init(&buckets[i].cond);
+    }
+    return 0;
+}
+
+int futex_wait(volatile int32_t *addr, int32_t val) {
+    if (!is_valid_addr(addr)) {
+        error_async("Invalid futex address 0x%p", addr);
+        return -1;
+    }
+
+    futex_bucket_t *b = get_bucket(addr);
+    pcb_t *pcb = process_get_current();
+
+    irqctx_t ctx;
+    spinlock_acquire(&b->lock, &ctx);
+    // Any waker changes the value before taking the bucket lock, a wake up cannot be
+    // missed once the value is checked with the lock held
+    if (*addr != val) {
+        spinlock_release(&b->lock, &ctx);
+        return -1;
+    }
+    pcb->sched.futex_addr = addr;
+    // The bucket is shared by other addresses, only a wake on <addr> clears futex_addr
+    BLOCK_UNTIL(pcb->sched.futex_addr == NULL, &b->cond, &b->lock, &ctx);
+    spinlock_release(&b->lock, &ctx);
+    return 0;
+}
+
+int futex_wake(volatile int32_t *addr, int32_t nwake) {
+    if (!is_valid_addr(addr)) {
+        error_async("Invalid futex address 0x%p", addr);
+        return -1;
+    }
+
+    futex_bucket_t *b = get_bucket(addr);
+    int woken = 0;
+
+    irqctx_t ctx;
+    spinlock_acquire(&b->lock, &ctx);
+    pcb_t *pcb;
+    pcb_t *tmp;
+    // Waiters are queued in fifo order
+    list_for_each_entry_safe(pcb, tmp, &b->cond.blocked, sched.sched_node) {
+        if (woken >= nwake) {
+            break;
+        }
+        if (pcb->sched.futex_addr != addr) {
+            continue;
+        }
+        pcb->sched.futex_addr = NULL;
+        condition_notify_pcb_locked(&b->cond, pcb);
+        woken++;
+    }
+    spinlock_release(&b->lock, &ctx);
+    return woken;
+}
+
+
+
+#ifdef CONFIG_TEST_CORE_SYNC_FUTEX
+#include __FILE__
+#endif
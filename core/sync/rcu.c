@@ -0,0 +1,136 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <core.h>
+#include <cpu/core.h>
+#include <cpu/cpu-local.h>
+#include <irq/core.h>
+#include <sched/core.h>
+#include <sched/workqueue.h>
+#include <sync/rcu.h>
+#include <sync/atomic.h>
+#include <sync/barrier.h>
+#include <sync/spinlock.h>
+#include <time/core.h>
+#include <generated/autoconf.h>
+
+static void run_callbacks(work_t *work) {
+    irqctx_t ctx;
+    spinlock_acquire(&_laritos.rcu.lock, &ctx);
+    rcu_head_t *head = _laritos.rcu.cbs;
+    _laritos.rcu.cbs = NULL;
+    _laritos.rcu.cbs_tail = &_laritos.rcu.cbs;
+    spinlock_release(&_laritos.rcu.lock, &ctx);
+
+    // Callbacks queued from now on are handled by the next run of the work
+    synchronize_rcu();
+
+    while (head != NULL) {
+        rcu_head_t *next = head->next;
+        insane_async("Running rcu callback 0x%p", head->func);
+        head->func(head);
+        head = next;
+    }
+}
+
+int rcu_init_global_context(void) {
+    _laritos.rcu.cbs = NULL;
+    _laritos.rcu.cbs_tail = &_laritos.rcu.cbs;
+    spinlock_init(&_laritos.rcu.lock);
+    work_init(&_laritos.rcu.work, run_callbacks, NULL);
+#ifdef CONFIG_SMP
+    atomic32_t *qs;
+    CPU_LOCAL_FOR_EACH_CPU_VAR(_laritos.rcu.qs, qs) {
+        atomic32_init(qs, 0);
+    }
+#endif
+    return 0;
+}
+
+void synchronize_rcu(void) {
+#ifdef CONFIG_SMP
+    if (!_laritos.process_mode) {
+        // Only the boot cpu is running
+        return;
+    }
+
+    // Make the unlinking of the old data visible before looking at the other cpus
+    dmb();
+
+    int32_t snapshot[CONFIG_CPU_MAX_CPUS];
+    uint32_t pending = 0;
+    irqctx_t ctx;
+    irq_disable_local_and_save_ctx(&ctx);
+    // The caller isn't inside any read-side critical section, no need to wait for this cpu
+    uint8_t me = cpu_get_id();
+    int i;
+    for (i = 0; i < CONFIG_CPU_MAX_CPUS; i++) {
+        if (i == me || !(_laritos.sched.online & BIT_FOR_CPU(i))) {
+            continue;
+        }
+        snapshot[i] = atomic32_get(CPU_LOCAL_GET_PTR_FOR_CPU(_laritos.rcu.qs, i));
+        pending |= BIT_FOR_CPU(i);
+        // Don't wait for the next time slice to expire, ask the cpu to schedule right away
+        sched_request_resched_locked(i);
+    }
+    irq_local_restore_ctx(&ctx);
+
+    while (pending) {
+        for (i = 0; i < CONFIG_CPU_MAX_CPUS; i++) {
+            if ((pending & BIT_FOR_CPU(i)) &&
+                    atomic32_get(CPU_LOCAL_GET_PTR_FOR_CPU(_laritos.rcu.qs, i)) != snapshot[i]) {
+                pending &= ~BIT_FOR_CPU(i);
+            }
+        }
+        if (pending) {
+            msleep(1);
+        }
+    }
+    dmb();
+#endif
+    // Without CONFIG_SMP, read-side critical sections cannot be preempted, the only cpu is
+    // running the caller and hence there is no reader left
+}
+
+void call_rcu(rcu_head_t *head, void (*func)(rcu_head_t *head)) {
+    head->func = func;
+    head->next = NULL;
+
+    irqctx_t ctx;
+    spinlock_acquire(&_laritos.rcu.lock, &ctx);
+    *_laritos.rcu.cbs_tail = head;
+    _laritos.rcu.cbs_tail = &head->next;
+    spinlock_release(&_laritos.rcu.lock, &ctx);
+
+    // Nothing to do if already pending, it hasn't detached the callbacks yet
+    workqueue_queue(&_laritos.rcu.work);
+}
+
+
+
+#ifdef CONFIG_TEST_CORE_SYNC_RCU
+#include __FILE__
+#endif
@@ -30,24 +30,151 @@
 #include <process/core.h>
 #include <sched/core.h>
 #include <assert.h>
+#include <math.h>
+#include <dstruct/list.h>
+
+/**
+ * Upper bound of the rmutex owners walked when propagating a priority change, so that
+ * a deadlock cycle between rmutexes doesn't keep the cpu spinning with _laritos.proc.pi_lock held
+ */
+#define RMUTEX_PI_MAX_CHAIN 16
 
 int rmutex_init(rmutex_t *mutex) {
     mutex->lock_count = 0;
     mutex->owner = NULL;
     spinlock_init(&mutex->lock);
     condition_init(&mutex->cond);
+    INIT_LIST_HEAD(&mutex->pi_waiters);
+    INIT_LIST_HEAD(&mutex->pi_node);
     return 0;
 }
 
+uint8_t rmutex_pi_get_priority_locked(pcb_t *pcb) {
+    uint8_t prio = pcb->sched.base_priority;
+    rmutex_t *mutex;
+    list_for_each_entry(mutex, &pcb->sched.pi_mutexes, pi_node) {
+        pcb_t *waiter;
+        list_for_each_entry(waiter, &mutex->pi_waiters, sched.pi_node) {
+            prio = min(prio, waiter->sched.priority);
+        }
+    }
+    return prio;
+}
+
+void rmutex_pi_update_priority_locked(pcb_t *pcb) {
+    int i;
+    for (i = 0; pcb != NULL && i < RMUTEX_PI_MAX_CHAIN; i++) {
+        uint8_t prio = rmutex_pi_get_priority_locked(pcb);
+        if (prio == pcb->sched.priority) {
+            break;
+        }
+        verbose_async("rmutex pi: pid=%u priority %u -> %u", pcb->pid, pcb->sched.priority, prio);
+        process_apply_priority_locked(pcb, prio);
+
+        // The owner of the rmutex <pcb> is waiting for inherits the new priority as well
+        rmutex_t *next = pcb->sched.pi_blocked_on;
+        pcb = next != NULL ? next->owner : NULL;
+    }
+}
+
+/**
+ * Registers <cur> as a waiter of <mutex> and boosts the chain of owners
+ *
+ * Note: Must be called with mutex->lock held
+ */
+static void pi_block_on_locked(rmutex_t *mutex, pcb_t *cur) {
+    irqctx_t ctx;
+    spinlock_acquire(&_laritos.proc.pi_lock, &ctx);
+    if (cur->sched.pi_blocked_on != mutex) {
+        cur->sched.pi_blocked_on = mutex;
+        list_add_tail(&cur->sched.pi_node, &mutex->pi_waiters);
+    }
+    // A dying owner has already dropped its priority inheritance state, don't link it again
+    pcb_t *owner = mutex->owner;
+    if (owner->sched.status != PROC_STATUS_ZOMBIE) {
+        if (list_empty(&mutex->pi_node)) {
+            list_add_tail(&mutex->pi_node, &owner->sched.pi_mutexes);
+        }
+        rmutex_pi_update_priority_locked(owner);
+    }
+    spinlock_release(&_laritos.proc.pi_lock, &ctx);
+}
+
+/**
+ * Stops waiting for <mutex> (if <cur> was) and inherits the priority of its remaining waiters
+ *
+ * Note: Must be called with mutex->lock held, right after <cur> became the owner
+ */
+static void pi_acquired_locked(rmutex_t *mutex, pcb_t *cur) {
+    irqctx_t ctx;
+    spinlock_acquire(&_laritos.proc.pi_lock, &ctx);
+    if (cur->sched.pi_blocked_on == mutex) {
+        list_del_init(&cur->sched.pi_node);
+        cur->sched.pi_blocked_on = NULL;
+    }
+    if (!list_empty(&mutex->pi_waiters) && list_empty(&mutex->pi_node)) {
+        list_add_tail(&mutex->pi_node, &cur->sched.pi_mutexes);
+    }
+    rmutex_pi_update_priority_locked(cur);
+    spinlock_release(&_laritos.proc.pi_lock, &ctx);
+}
+
+/**
+ * Drops the priority <cur> inherited from the waiters of <mutex>
+ *
+ * Note: Must be called with mutex->lock held, right after <cur> released it
+ *
+ * @return true if the priority of <cur> got lower
+ */
+static bool pi_released_locked(rmutex_t *mutex, pcb_t *cur) {
+    irqctx_t ctx;
+    spinlock_acquire(&_laritos.proc.pi_lock, &ctx);
+    uint8_t prev_prio = cur->sched.priority;
+    list_del_init(&mutex->pi_node);
+    rmutex_pi_update_priority_locked(cur);
+    bool lowered = cur->sched.priority > prev_prio;
+    spinlock_release(&_laritos.proc.pi_lock, &ctx);
+    return lowered;
+}
+
+void rmutex_pi_process_exit(pcb_t *pcb) {
+    irqctx_t ctx;
+    spinlock_acquire(&_laritos.proc.pi_lock, &ctx);
+    rmutex_t *mutex = pcb->sched.pi_blocked_on;
+    if (mutex != NULL) {
+        list_del_init(&pcb->sched.pi_node);
+        pcb->sched.pi_blocked_on = NULL;
+        // The owner may not need the priority of the dying process anymore
+        pcb_t *owner = mutex->owner;
+        if (owner != NULL && owner != pcb) {
+            rmutex_pi_update_priority_locked(owner);
+        }
+    }
+    rmutex_t *temp;
+    list_for_each_entry_safe(mutex, temp, &pcb->sched.pi_mutexes, pi_node) {
+        list_del_init(&mutex->pi_node);
+    }
+    spinlock_release(&_laritos.proc.pi_lock, &ctx);
+}
+
 int rmutex_acquire(rmutex_t *mutex) {
     pcb_t *cur = process_get_current();
     irqctx_t ctx;
     spinlock_acquire(&mutex->lock, &ctx);
 
-    BLOCK_UNTIL(mutex->owner == cur || mutex->lock_count == 0, &mutex->cond, &mutex->lock, &ctx);
+    while (mutex->owner != cur && mutex->lock_count != 0) {
+        pi_block_on_locked(mutex, cur);
+        condition_wait_locked(&mutex->cond, &mutex->lock, &ctx);
+    }
     mutex->lock_count++;
     mutex->owner = cur;
 
+    // Waiters are only registered under mutex->lock, skip the priority inheritance
+    // bookkeeping if the mutex was not contended
+    if (cur->sched.pi_blocked_on == mutex || !list_empty(&mutex->pi_waiters)) {
+        pi_acquired_locked(mutex, cur);
+    }
+
     verbose_async("rmutex_acquire(m=0x%p, count=%u, pid=%u)%s",
             mutex, mutex->lock_count, cur->pid, mutex->lock_count == 1 ? " -> ACQUIRED" : "");
     spinlock_release(&mutex->lock, &ctx);
@@ -65,14 +192,19 @@ int rmutex_release(rmutex_t *mutex) {
         return -1;
     }
 
-    bool proc_awakened = false;
+    bool need_sched = false;
 
     mutex->lock_count--;
     if (mutex->lock_count == 0) {
         mutex->owner = NULL;
 
+        // Drop back to the base priority (or the one inherited from other rmutexes)
+        if (!list_empty(&mutex->pi_node) && pi_released_locked(mutex, cur)) {
+            need_sched = true;
+        }
+
         if (condition_notify_all_locked(&mutex->cond)) {
-            proc_awakened = true;
+            need_sched = true;
         }
         verbose_async("rmutex_release(m=0x%p, count=%u, pid=%u) -> RELEASED", mutex, mutex->lock_count, cur->pid);
     } else {
@@ -82,7 +214,7 @@ int rmutex_release(rmutex_t *mutex) {
     spinlock_release(&mutex->lock, &ctx);
 
     // Switch to higher priority processes (if any)
-    if (proc_awakened) {
+    if (need_sched) {
         schedule();
     }
 
@@ -90,7 +222,6 @@ int rmutex_release(rmutex_t *mutex) {
 }
 
 
-
 #ifdef CONFIG_TEST_CORE_SYNC_RMUTEX
 #include __FILE__
 #endif
@@ -0,0 +1,123 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <irq/core.h>
+#include <sync/rwlock.h>
+#include <sync/atomic.h>
+#include <sync/barrier.h>
+#include <sync/cmpxchg.h>
+#include <generated/autoconf.h>
+
+#ifdef CONFIG_SYNC_LOCKDEP
+#define lockdep_acquire(_lock) lockdep_acquire_class((_lock), (_lock)->lclass, true)
+#define lockdep_release(_lock) lockdep_release_class((_lock)->lclass)
+#else
+#define lockdep_acquire(_lock)
+#define lockdep_release(_lock)
+#endif
+
+/**
+ * Without CONFIG_SMP, disabling local irqs is enough to keep the lock uncontended, so
+ * there is never anybody to wait for nor to wake up
+ */
+static inline void wait_for_release(void) {
+#ifdef CONFIG_SMP
+    arch_spinlock_wait_event();
+#endif
+}
+
+static inline void signal_release(void) {
+#ifdef CONFIG_SMP
+    arch_spinlock_send_event();
+#endif
+}
+
+int rwlock_init(rwlock_t *lock) {
+    return rwlock_init_class(lock, LOCK_CLASS_NONE);
+}
+
+int rwlock_init_class(rwlock_t *lock, lock_class_t lclass) {
+    atomic32_init(&lock->state, 0);
+    atomic32_init(&lock->writers_waiting, 0);
+#ifdef CONFIG_SYNC_LOCKDEP
+    lock->lclass = lclass;
+#endif
+    return 0;
+}
+
+int rwlock_read_acquire(rwlock_t *lock, irqctx_t *ctx) {
+    if (irq_disable_local_and_save_ctx(ctx) < 0) {
+        return -1;
+    }
+    lockdep_acquire(lock);
+    while (true) {
+        int32_t state = atomic32_get(&lock->state);
+        // Let any waiting writer go first, otherwise a steady flow of readers would starve it
+        if (state != RWLOCK_WRITER && atomic32_get(&lock->writers_waiting) == 0 &&
+                atomic_cmpxchg((volatile int *) &lock->state, state, state + 1)) {
+            break;
+        }
+        wait_for_release();
+    }
+    dmb();
+    return 0;
+}
+
+int rwlock_read_release(rwlock_t *lock, irqctx_t *ctx) {
+    dmb();
+    // Only the last reader leaving can unblock a writer
+    if (atomic32_dec(&lock->state) == 0) {
+        signal_release();
+    }
+    lockdep_release(lock);
+    return irq_local_restore_ctx(ctx);
+}
+
+int rwlock_write_acquire(rwlock_t *lock, irqctx_t *ctx) {
+    if (irq_disable_local_and_save_ctx(ctx) < 0) {
+        return -1;
+    }
+    lockdep_acquire(lock);
+    atomic32_inc(&lock->writers_waiting);
+    while (!atomic_cmpxchg((volatile int *) &lock->state, 0, RWLOCK_WRITER)) {
+        wait_for_release();
+    }
+    atomic32_dec(&lock->writers_waiting);
+    dmb();
+    return 0;
+}
+
+int rwlock_write_release(rwlock_t *lock, irqctx_t *ctx) {
+    dmb();
+    atomic32_set(&lock->state, 0);
+    // Readers and writers may be waiting for the lock
+    signal_release();
+    lockdep_release(lock);
+    return irq_local_restore_ctx(ctx);
+}
+
+
+
+#ifdef CONFIG_TEST_CORE_SYNC_RWLOCK
+#include __FILE__
+#endif
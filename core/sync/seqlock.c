@@ -0,0 +1,69 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <irq/core.h>
+#include <sync/seqlock.h>
+#include <sync/atomic.h>
+#include <sync/barrier.h>
+#include <sync/spinlock.h>
+
+int seqlock_init(seqlock_t *lock) {
+    atomic32_init(&lock->seq, 0);
+    return spinlock_init(&lock->lock);
+}
+
+uint32_t seqlock_read_begin(seqlock_t *lock) {
+    uint32_t seq;
+    // Writers hold a spinlock, i.e. they run with irqs disabled and are never preempted.
+    // A write in progress can only happen on another cpu and will be over soon
+    while ((seq = (uint32_t) atomic32_get(&lock->seq)) & 1);
+    dmb();
+    return seq;
+}
+
+bool seqlock_read_retry(seqlock_t *lock, uint32_t start) {
+    dmb();
+    return (uint32_t) atomic32_get(&lock->seq) != start;
+}
+
+int seqlock_write_acquire(seqlock_t *lock, irqctx_t *ctx) {
+    if (spinlock_acquire(&lock->lock, ctx) < 0) {
+        return -1;
+    }
+    atomic32_inc(&lock->seq);
+    dmb();
+    return 0;
+}
+
+int seqlock_write_release(seqlock_t *lock, irqctx_t *ctx) {
+    dmb();
+    atomic32_inc(&lock->seq);
+    return spinlock_release(&lock->lock, ctx);
+}
+
+
+
+#ifdef CONFIG_TEST_CORE_SYNC_SEQLOCK
+#include __FILE__
+#endif
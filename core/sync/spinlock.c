@@ -24,21 +24,208 @@
 
 #include <stdbool.h>
 #include <sync/spinlock.h>
+#include <sync/atomic.h>
+#include <sync/barrier.h>
+#include <sync/cmpxchg.h>
 #include <core.h>
 #include <process/core.h>
 #include <assert.h>
 #include <generated/autoconf.h>
 
 
+#ifdef CONFIG_SYNC_LOCKDEP
+lock_class_t lockdep_acquire_class(void *lock, lock_class_t lclass, bool check) {
+    if (lclass == LOCK_CLASS_NONE) {
+        return LOCK_CLASS_NONE;
+    }
+    uint32_t *held = CPU_LOCAL_GET_PTR_LOCKED(_laritos.lockdep_held);
+    if (!check && (*held & (1 << lclass)) && lclass + 1 < LOCK_CLASS_LEN) {
+        // A trylock of a lock whose class is already held, record it as nested
+        lclass++;
+    }
+    assert(!check || (*held >> lclass) == 0, "Lock order violation acquiring 0x%p (class %u) while holding classes 0x%lx",
+            lock, lclass, *held);
+    *held |= 1 << lclass;
+    return lclass;
+}
+
+void lockdep_release_class(lock_class_t lclass) {
+    if (lclass == LOCK_CLASS_NONE) {
+        return;
+    }
+    uint32_t *held = CPU_LOCAL_GET_PTR_LOCKED(_laritos.lockdep_held);
+    *held &= ~(1 << lclass);
+}
+
+static inline void lockdep_acquire(spinlock_t *lock, lock_class_t lclass, bool check) {
+    lock->held_class = lockdep_acquire_class(lock, lclass, check);
+}
+
+static inline void lockdep_release(spinlock_t *lock) {
+    lockdep_release_class(lock->held_class);
+    lock->held_class = LOCK_CLASS_NONE;
+}
+#else
+#define lockdep_acquire(_lock, _lclass, _check)
+#define lockdep_release(_lock)
+#endif
+
+#ifdef CONFIG_SMP
+#if defined(CONFIG_SYNC_SPINLOCK_TICKET)
+static inline void raw_init(spinlock_raw_t *raw) {
+    atomic32_init(&raw->next, 0);
+    atomic32_init(&raw->serving, 0);
+}
+
+static inline void raw_acquire(spinlock_raw_t *raw) {
+    int32_t ticket = atomic32_inc(&raw->next) - 1;
+    // The owner signals an event on release, no need to keep polling the lock
+    while (atomic32_get(&raw->serving) != ticket) {
+        arch_spinlock_wait_event();
+    }
+    dmb();
+}
+
+static inline bool raw_trylock(spinlock_raw_t *raw) {
+    int32_t serving = atomic32_get(&raw->serving);
+    // Only take a ticket if it is the one being served
+    bool locked = atomic_cmpxchg((volatile int *) &raw->next, serving, (int32_t) ((uint32_t) serving + 1));
+    dmb();
+    return locked;
+}
+
+static inline void raw_release(spinlock_raw_t *raw) {
+    dmb();
+    // Only the owner writes <serving>
+    atomic32_set(&raw->serving, (int32_t) ((uint32_t) atomic32_get(&raw->serving) + 1));
+    arch_spinlock_send_event();
+}
+
+static inline bool raw_is_locked(spinlock_raw_t *raw) {
+    return atomic32_get(&raw->next) != atomic32_get(&raw->serving);
+}
+#elif defined(CONFIG_SYNC_SPINLOCK_MCS)
+/**
+ * Max number of MCS locks a cpu can hold (or wait for) at once
+ */
+#define SPINLOCK_MCS_NODES 8
+
+/**
+ * Queue nodes of each cpu. Spinlocks are held with irqs disabled, so only the local cpu
+ * allocates and releases its nodes
+ */
+static spinlock_mcs_node_t mcs_nodes[CONFIG_CPU_MAX_CPUS][SPINLOCK_MCS_NODES];
+
+static inline spinlock_mcs_node_t *mcs_alloc_node(void) {
+    spinlock_mcs_node_t *nodes = mcs_nodes[arch_cpu_get_id()];
+    int i;
+    for (i = 0; i < SPINLOCK_MCS_NODES; i++) {
+        if (!nodes[i].busy) {
+            nodes[i].busy = true;
+            nodes[i].next = NULL;
+            nodes[i].locked = false;
+            return &nodes[i];
+        }
+    }
+    assert(false, "Too many nested spinlocks on cpu #%u", arch_cpu_get_id());
+    return NULL;
+}
+
+static inline void raw_init(spinlock_raw_t *raw) {
+    raw->tail = NULL;
+    raw->node = NULL;
+}
+
+static inline void raw_acquire(spinlock_raw_t *raw) {
+    spinlock_mcs_node_t *node = mcs_alloc_node();
+    spinlock_mcs_node_t *prev;
+    do {
+        prev = raw->tail;
+    } while (!atomic_cmpxchg((volatile int *) &raw->tail, (int) prev, (int) node));
+    dmb();
+
+    if (prev != NULL) {
+        // Queue behind the previous cpu and wait until it hands the lock over
+        prev->next = node;
+        while (!node->locked) {
+            arch_spinlock_wait_event();
+        }
+    }
+    dmb();
+    raw->node = node;
+}
+
+static inline bool raw_trylock(spinlock_raw_t *raw) {
+    spinlock_mcs_node_t *node = mcs_alloc_node();
+    if (!atomic_cmpxchg((volatile int *) &raw->tail, (int) NULL, (int) node)) {
+        node->busy = false;
+        return false;
+    }
+    dmb();
+    raw->node = node;
+    return true;
+}
+
+static inline void raw_release(spinlock_raw_t *raw) {
+    spinlock_mcs_node_t *node = raw->node;
+    dmb();
+    if (node->next == NULL) {
+        // No one waiting, unlock
+        if (atomic_cmpxchg((volatile int *) &raw->tail, (int) node, (int) NULL)) {
+            node->busy = false;
+            return;
+        }
+        // A cpu is queueing up, wait until it links its node
+        while (node->next == NULL);
+    }
+    node->next->locked = true;
+    arch_spinlock_send_event();
+    node->busy = false;
+}
+
+static inline bool raw_is_locked(spinlock_raw_t *raw) {
+    return raw->tail != NULL;
+}
+#else
+static inline void raw_init(spinlock_raw_t *raw) {
+    arch_spinlock_set(raw, 0);
+}
+
+static inline void raw_acquire(spinlock_raw_t *raw) {
+    arch_spinlock_acquire(raw);
+}
+
+static inline bool raw_trylock(spinlock_raw_t *raw) {
+    return arch_spinlock_trylock(raw);
+}
+
+static inline void raw_release(spinlock_raw_t *raw) {
+    arch_spinlock_release(raw);
+}
+
+static inline bool raw_is_locked(spinlock_raw_t *raw) {
+    return arch_spinlock_is_locked(raw);
+}
+#endif
+#endif
+
 int spinlock_init(spinlock_t *lock) {
+    return spinlock_init_class(lock, LOCK_CLASS_NONE);
+}
+
+int spinlock_init_class(spinlock_t *lock, lock_class_t lclass) {
 #ifdef CONFIG_SMP
-    arch_spinlock_set(&lock->lock, 0);
+    raw_init(&lock->lock);
 #endif
     lock->owner = NULL;
+#ifdef CONFIG_SYNC_LOCKDEP
+    lock->lclass = lclass;
+    lock->held_class = LOCK_CLASS_NONE;
+#endif
     return 0;
 }
 
-int spinlock_acquire(spinlock_t *lock, irqctx_t *ctx) {
+static inline int acquire_as(spinlock_t *lock, lock_class_t lclass, irqctx_t *ctx) {
     // Only disable irqs locally, no need to disable on other cpus:
     //   - If the irqs are not disabled locally, that may lead to a situation in which the irq
     //     handler tries to acquire the same spinlock already locked by the current cpu, causing
@@ -49,37 +236,53 @@ int spinlock_acquire(spinlock_t *lock, irqctx_t *ctx) {
     if (irq_disable_local_and_save_ctx(ctx) < 0) {
         return -1;
     }
+    // Check the order before spinning, a violation may deadlock right away
+    lockdep_acquire(lock, lclass, true);
 #ifdef CONFIG_SMP
-    if (arch_spinlock_acquire(&lock->lock) < 0) {
-        irq_local_restore_ctx(ctx);
-        return -1;
-    }
+    raw_acquire(&lock->lock);
 #endif
-    // TODO Optimize this
     lock->owner = _laritos.process_mode ? process_get_current() : SPINLOCK_KERNEL_OWNER;
     return 0;
 }
 
+int spinlock_acquire(spinlock_t *lock, irqctx_t *ctx) {
+#ifdef CONFIG_SYNC_LOCKDEP
+    return acquire_as(lock, lock->lclass, ctx);
+#else
+    return acquire_as(lock, LOCK_CLASS_NONE, ctx);
+#endif
+}
+
+int spinlock_acquire_nested(spinlock_t *lock, irqctx_t *ctx) {
+#ifdef CONFIG_SYNC_LOCKDEP
+    assert(lock->lclass + 1 < LOCK_CLASS_LEN, "Lock class %u cannot be nested", lock->lclass);
+    return acquire_as(lock, lock->lclass == LOCK_CLASS_NONE ? LOCK_CLASS_NONE : lock->lclass + 1, ctx);
+#else
+    return acquire_as(lock, LOCK_CLASS_NONE, ctx);
+#endif
+}
+
 bool spinlock_trylock(spinlock_t *lock, irqctx_t *ctx) {
-#ifdef CONFIG_SMP
     if (irq_disable_local_and_save_ctx(ctx) < 0) {
-        return -1;
+        return false;
     }
-    if (arch_spinlock_trylock(&lock->lock)) {
-        // TODO Optimize this
-        lock->owner = _laritos.process_mode ? process_get_current() : SPINLOCK_KERNEL_OWNER;
-        return true;
+#ifdef CONFIG_SMP
+    if (!raw_trylock(&lock->lock)) {
+        irq_local_restore_ctx(ctx);
+        return false;
     }
-    irq_local_restore_ctx(ctx);
-    return false;
 #endif
-    return spinlock_acquire(lock, ctx) >= 0;
+    // A trylock cannot deadlock, only record the lock as held
+    lockdep_acquire(lock, lock->lclass, false);
+    lock->owner = _laritos.process_mode ? process_get_current() : SPINLOCK_KERNEL_OWNER;
+    return true;
 }
 
 int spinlock_release(spinlock_t *lock, irqctx_t *ctx) {
     lock->owner = NULL;
+    lockdep_release(lock);
 #ifdef CONFIG_SMP
-    arch_spinlock_release(&lock->lock);
+    raw_release(&lock->lock);
 #endif
     return irq_local_restore_ctx(ctx);
 }
@@ -87,13 +290,12 @@ int spinlock_release(spinlock_t *lock, irqctx_t *ctx) {
 bool spinlock_is_locked(spinlock_t *lock) {
 #ifdef CONFIG_SMP
     // This is faster than checking for the owner
-    return arch_spinlock_is_locked(&lock->lock);
+    return raw_is_locked(&lock->lock);
 #endif
     return spinlock_owned_by_me(lock);
 }
 
 bool spinlock_owned_by_me(spinlock_t *lock) {
-    // TODO Optimize this
     if (_laritos.process_mode) {
         return lock->owner == process_get_current();
     }
@@ -35,7 +35,7 @@ int syscall_getcwd(char *buf, int buflen) {
     pcb_t *pcb = process_get_current();
     irqctx_t ctx;
     spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
-    vfs_dentry_get_fullpath(pcb->cwd, buf, buflen);
+    vfs_dentry_get_fullpath(process_get_leader(pcb)->cwd, buf, buflen);
     spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
     return 0;
 }
@@ -49,7 +49,7 @@ int syscall_chdir(char *path) {
     pcb_t *pcb = process_get_current();
     irqctx_t ctx;
     spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
-    pcb->cwd = vfs_dentry_lookup(path);
+    process_get_leader(pcb)->cwd = vfs_dentry_lookup(path);
     spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
     return 0;
 }
@@ -60,7 +60,7 @@ int syscall_listdir(char *path, uint32_t offset, fs_listdir_t *dirs, int dirlen)
         pcb_t *pcb = process_get_current();
         irqctx_t ctx;
         spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
-        f = vfs_file_dentry_open(pcb->cwd, FS_ACCESS_MODE_READ);
+        f = vfs_file_dentry_open(process_get_leader(pcb)->cwd, FS_ACCESS_MODE_READ);
         spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
     } else {
         f = vfs_file_open(path, FS_ACCESS_MODE_READ);
@@ -71,6 +71,7 @@ static syscall_entry_t systable[] = {
     DEF_SCE(SYSCALL_SPAWN_PROCESS, syscall_spawn_process),
     DEF_SCE(SYSCALL_WAITPID, syscall_waitpid),
     DEF_SCE(SYSCALL_MKDIR, syscall_mkdir),
+    DEF_SCE(SYSCALL_FUTEX, syscall_futex),
 };
 
 
@@ -100,13 +100,12 @@ void time_to_hms(time_t *t, uint16_t *h, uint16_t *m, uint16_t *s) {
 static int process_sleep_cb(vrtimer_comp_t *t, void *data) {
     pcb_t *pcb = (pcb_t *) data;
 
-    irqctx_t ctx;
-    spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
+    sched_wake_up(pcb);
 
-    sched_move_to_ready_locked(pcb);
     // pcb_t no longer needed by sleep()
+    irqctx_t ctx;
+    spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
     ref_dec(&pcb->refcnt);
-
     spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
 
     return 0;
@@ -130,27 +129,31 @@ static inline void _sleep(tick_t ticks) {
     if (_laritos.process_mode) {
         pcb_t *pcb = process_get_current();
 
+        // We are gonna need the pcb_t to unblock it once the timer expires.
+        // Make sure it is not released by keeping a reference to it
+        irqctx_t datactx;
+        spinlock_acquire(&_laritos.proc.pcbs_data_lock, &datactx);
+        ref_inc(&pcb->refcnt);
+        spinlock_release(&_laritos.proc.pcbs_data_lock, &datactx);
+
+        // Running in process mode, then block the process and schedule().
+        // The process is blocked before installing the timer, so that an early expiration
+        // (e.g. on another cpu) finds it BLOCKED. Irqs are kept disabled until the timer
+        // is installed, otherwise the process could be switched out and never woken up.
+        // Note that the timer lock is not held while blocking, the callback takes the pcb
+        // lock while holding it
         irqctx_t ctx;
-        spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
-
-        // Running in process mode, then block the process and schedule()
+        irq_disable_local_and_save_ctx(&ctx);
+        sched_block_current();
         if (t->ops.add_vrtimer(t, ticks, process_sleep_cb, pcb, false) < 0) {
             error_async("Failed to create virtual timer ticks=%lu", ticks);
-            spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
-            return;
+            // Back to READY, the schedule() below resumes it like any other ready process
+            sched_wake_up(pcb);
+            spinlock_acquire(&_laritos.proc.pcbs_data_lock, &datactx);
+            ref_dec(&pcb->refcnt);
+            spinlock_release(&_laritos.proc.pcbs_data_lock, &datactx);
         }
-        // Make sure we install the timer before blocking the process, otherwise
-        // the process may block forever if there is a context switch.
-        // The spinlock, by disabling local irqs, will ensure no other
-        // process preempts the current one until the timer is installed and
-        // the process moved to the blocked list
-        sched_move_to_blocked_locked(pcb, NULL);
-
-        // We are gonna need the pcb_t to unblock it once the timer expires.
-        // Make sure it is not released by keeping a reference to it
-        ref_inc(&pcb->refcnt);
-
-        spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
+        irq_local_restore_ctx(&ctx);
 
         schedule();
     } else {
@@ -30,6 +30,8 @@
 #include <component/intc.h>
 #include <component/cpu.h>
 #include <arch/cpu-types.h>
+#include <arch/generic-timer.h>
+#include <math.h>
 
 static int set_irqs_enable(cpu_t *c, bool enabled) {
     if (cpu_get_id() != c->id) {
@@ -44,6 +46,47 @@ static int custom_initialization(cpu_t *c) {
     return cpu_set_cycle_count_enable(true);
 }
 
+static irqret_t local_tick_irq_handler(irq_t irq, void *data) {
+    arm_cpu_t *c = (arm_cpu_t *) cpu();
+    // Re-arm the timer first, TVAL counts down from the current counter value
+    arch_set_cntv_tval(c->local_tick_period);
+    if (c->local_tick_cb(&c->parent, c->local_tick_data) < 0) {
+        return IRQ_RET_ERROR;
+    }
+    return IRQ_RET_HANDLED;
+}
+
+static int set_local_tick(cpu_t *c, uint32_t ticks_per_sec, cpu_tick_cb_t cb, void *data) {
+    arm_cpu_t *ac = (arm_cpu_t *) c;
+    if (cpu_get_id() != c->id) {
+        error_async("Cannot set the local tick on behalf of other processor");
+        return -1;
+    }
+
+    regcntvctl_t ctl = { 0 };
+    if (ticks_per_sec == 0) {
+        arch_set_cntv_ctl(ctl);
+        return 0;
+    }
+
+    ac->local_tick_period = max(arch_get_cntfrq() / ticks_per_sec, 1);
+    ac->local_tick_cb = cb;
+    ac->local_tick_data = data;
+
+    // The irq enable bits of private interrupts are banked, this only affects the calling cpu.
+    // The handler is shared by all the cpus and finds out its own state via cpu()
+    if (intc_enable_irq_with_handler(c->intc, ac->local_tick_irq, ac->local_tick_irq_trigger,
+            local_tick_irq_handler, NULL) < 0) {
+        error_async("Failed to enable local tick irq %u for cpu %u", ac->local_tick_irq, c->id);
+        return -1;
+    }
+
+    arch_set_cntv_tval(ac->local_tick_period);
+    ctl.b.enable = true;
+    arch_set_cntv_ctl(ctl);
+    return 0;
+}
+
 static int process(board_comp_t *comp) {
     arm_cpu_t *cpu = component_alloc(sizeof(arm_cpu_t));
     if (cpu == NULL) {
@@ -66,6 +109,14 @@ static int process(board_comp_t *comp) {
     cpu->pmu_irq = irq;
     board_get_irq_trigger_attr_def(comp, "pmu_trigger", &cpu->pmu_irq_trigger, IRQ_TRIGGER_LEVEL_HIGH);
 
+    // The local tick is optional, only secondary cpus need it
+    board_get_int_attr_def(comp, "local_tick_irq", &irq, -1);
+    if (irq >= 0) {
+        cpu->local_tick_irq = irq;
+        board_get_irq_trigger_attr_def(comp, "local_tick_trigger", &cpu->local_tick_irq_trigger, IRQ_TRIGGER_LEVEL_HIGH);
+        cpu->parent.ops.set_local_tick = set_local_tick;
+    }
+
     component_set_info((component_t *) cpu, "Cortex-A15", "ARM", "Cortex-A15 armv7-a processor");
 
     if (cpu_component_register((cpu_t *) cpu) < 0) {
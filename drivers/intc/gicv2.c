@@ -32,6 +32,7 @@
 #include <driver/gicv2.h>
 #include <math.h>
 #include <mm/heap.h>
+#include <sync/barrier.h>
 #include <generated/autoconf.h>
 
 
@@ -93,6 +94,26 @@ static int set_priority_filter(intc_t *intc, uint8_t lowest_prio) {
     return 0;
 }
 
+static int send_sgi(intc_t *intc, irq_t irq, cpubits_t targets) {
+    verbose_async("Sending sgi %u to cpus 0x%lx", irq, targets);
+    gic_t *gic = (gic_t *) intc;
+    if (irq > GICV2_MAX_SGI_ID) {
+        error_async("Invalid sgi %u, max: %u", irq, GICV2_MAX_SGI_ID);
+        return -1;
+    }
+
+    // Build the whole value first, the register is write-only
+    gic_dist_sgi_t sgi = { .v = 0 };
+    sgi.b.intid = irq;
+    sgi.b.cpu_target_list = (uint8_t) targets;
+    sgi.b.target_list_filter = GIC_SGI_FILTER_TARGET_LIST;
+    // Make sure any data the target cpus need (e.g. ready queues) is visible before they
+    // get the interrupt
+    dsb();
+    gic->dist->sgi.v = sgi.v;
+    return 0;
+}
+
 static irqret_t dispatch_irq(intc_t *intc) {
     gic_t *gic = (gic_t *) intc;
 
@@ -182,6 +203,7 @@ static int process(board_comp_t *comp) {
     intc->ops.set_irq_target_cpus = set_irq_target_cpus;
     intc->ops.set_irqs_enable_for_this_cpu = set_irqs_enable_for_this_cpu;
     intc->ops.set_priority_filter = set_priority_filter;
+    intc->ops.send_sgi = send_sgi;
 
     component_set_info((component_t *) intc, "GICv2", "ARM", "Generic Interrupt Controller v2");
 
@@ -36,6 +36,7 @@
 #include <mm/heap.h>
 #include <component/timer.h>
 #include <component/component.h>
+#include <cpu/core.h>
 
 
 static int get_value(timer_comp_t *t, uint64_t *v) {
@@ -120,14 +121,7 @@ static irqret_t armv7_timer_irq_handler(irq_t irq, void *data) {
     return timer_handle_expiration(t);
 }
 
-static int init(component_t *c) {
-    timer_comp_t *t = (timer_comp_t *) c;
-
-    if (timer_init(t) < 0) {
-        error("Failed to initialize timer for component '%s'", c->id);
-        return -1;
-    }
-
+static int init_cpu(timer_comp_t *t) {
     /**
      * According to ARM ARM:
      *   The CNTFRQ register is UNKNOWN at reset, and therefore the counter
@@ -138,9 +132,28 @@ static int init(component_t *c) {
     set_enable(t, false);
     // Reset compare value
     arch_set_cntp_cval(0);
+
+    // Each cpu has its own physical timer, signaled through the same private irq. The cpu
+    // arming the timer gets the expiration irq itself (the vrtimer is only armed by the cpu
+    // that owns it, see vrtimer_comp_t.cpu)
+    if (t->intio && t->intc->ops.set_irq_enable(t->intc, t->irq, true) < 0) {
+        error_async("Couldn't enable irq %u for cpu %u", t->irq, cpu_get_id());
+        return -1;
+    }
     return 0;
 }
 
+static int init(component_t *c) {
+    timer_comp_t *t = (timer_comp_t *) c;
+
+    if (timer_init(t) < 0) {
+        error("Failed to initialize timer for component '%s'", c->id);
+        return -1;
+    }
+
+    return init_cpu(t);
+}
+
 static int deinit(component_t *c) {
     timer_comp_t *t = (timer_comp_t *) c;
     return timer_deinit(t);
@@ -164,6 +177,7 @@ static int process(board_comp_t *comp) {
     t->ops.set_enable = set_enable;
     t->ops.set_expiration_ticks = set_expiration_ticks;
     t->ops.clear_expiration = clear_expiration;
+    t->ops.init_cpu = init_cpu;
 
     component_set_info((component_t *) timer, "ARM v7 timer", "ARM", "ARM v7 Generic Timer");
 
@@ -29,6 +29,7 @@
 #include <driver/pl011.h>
 #include <utils/utils.h>
 #include <mm/heap.h>
+#include <sched/workqueue.h>
 
 
 static int transmit_data(bytestream_t *bs) {
@@ -72,6 +73,11 @@ static inline int put_into_bytestream(uart_t *uart) {
     return 0;
 }
 
+static void transmit_work(work_t *work) {
+    uart_t *uart = (uart_t *) work->data;
+    transmit_data(&uart->bs);
+}
+
 static irqret_t pl011_irq_handler(irq_t irq, void *data) {
     uart_t *uart = (uart_t *) data;
     pl011_mm_t *pl011 = (pl011_mm_t *) uart->baseaddr;
@@ -98,8 +104,9 @@ static irqret_t pl011_irq_handler(irq_t irq, void *data) {
         // Clear tx interrupt
         pl011->icr.b.txim = 1;
 
-        // Retry sending the data
-        transmit_data(&uart->bs);
+        // Retry sending the data in process mode, refilling the FIFO one byte at a
+        // time is too slow to be done with irqs disabled
+        workqueue_queue(&uart->tx_work);
     }
     return IRQ_RET_HANDLED;
 }
@@ -143,6 +150,7 @@ static int process(board_comp_t *comp) {
         return -1;
     }
     uart->irq_handler = pl011_irq_handler;
+    work_init(&uart->tx_work, transmit_work, uart);
     if (uart_component_init_and_register(uart, comp, init, deinit, transmit_data) < 0){
         error("Failed to register '%s'", comp->id);
         goto fail;
@@ -75,11 +75,16 @@ typedef struct component {
 } component_t;
 
 #define component_first_of_type(_t, _type) \
-    ((_type *) list_first_entry_or_null(&_laritos.comps[_t], component_t, list))
+    ((_type *) component_get_first(_t))
 
 #define component_get_default(_ct, _type) \
     component_first_of_type(_ct, _type)
 
+/**
+ * NOTE: The iterators below don't lock the list, they must either be called with
+ * _laritos.comps_lock held or when no component can be (un)registered concurrently
+ * (e.g. while loading the components at boot time)
+ */
 #define for_each_component_type(_c, _t) \
     list_for_each_entry(_c, &_laritos.comps[_t], list)
 
@@ -94,6 +99,7 @@ int component_init(component_t *comp, char *id, board_comp_t *bcomp, component_t
 int component_register(component_t *comp);
 int component_unregister(component_t *comp);
 component_t *component_get_by_id(char *id);
+component_t *component_get_first(component_type_t t);
 void component_dump_registered_comps(void);
 int component_set_info(component_t *c, char *product, char *vendor, char *description);
 bool component_any_of(component_type_t t);
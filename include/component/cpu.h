@@ -6,12 +6,22 @@
 #include <generated/autoconf.h>
 
 struct cpu;
+
+typedef int (*cpu_tick_cb_t)(struct cpu *c, void *data);
+
 typedef struct {
     int (*set_irqs_enable)(struct cpu *c, bool enabled);
     /**
      * Can be NULL
      */
     int (*custom_initialization)(struct cpu *c);
+    /**
+     * Starts a periodic interrupt private to this cpu, executing <cb> (in irq context)
+     * <ticks_per_sec> times per second. A <ticks_per_sec> of 0 stops it.
+     *
+     * Must be called from the cpu itself. Can be NULL
+     */
+    int (*set_local_tick)(struct cpu *c, uint32_t ticks_per_sec, cpu_tick_cb_t cb, void *data);
 } cpu_ops_t;
 
 struct sched_comp;
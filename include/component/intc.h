@@ -5,6 +5,7 @@
 #include <cpu/core.h>
 #include <irq/types.h>
 #include <dstruct/list.h>
+#include <sync/spinlock.h>
 #include <component/component.h>
 #include <generated/autoconf.h>
 
@@ -26,6 +27,10 @@ typedef struct {
      * Note: Higher priority corresponds to a lower Priority field value
      */
     int (*set_priority_filter)(struct intc *intc, uint8_t lowest_prio);
+    /**
+     * Raises the software generated interrupt <irq> on every cpu in <targets>
+     */
+    int (*send_sgi)(struct intc *intc, irq_t irq, cpubits_t targets);
 } intc_ops_t;
 
 typedef struct {
@@ -33,6 +38,7 @@ typedef struct {
     void *data;
 
     list_head_t list;
+    rcu_head_t rcu;
 } irq_handler_info_t;
 
 typedef struct intc{
@@ -41,7 +47,12 @@ typedef struct intc{
 
     atomic32_t irq_count[CONFIG_INT_MAX_IRQS];
 
+    /**
+     * Handlers of each irq. The irq dispatch walks them under rcu (see include/sync/rcu.h),
+     * changes are serialized with <handlers_lock>
+     */
     list_head_t handlers[CONFIG_INT_MAX_IRQS];
+    spinlock_t handlers_lock;
 } intc_t;
 
 
@@ -9,9 +9,16 @@
 struct sched_comp;
 typedef struct {
     /**
-     * NOTE: Must be called with pcbs_data_lock held
+     * NOTE: Must be called with the ready queue lock of <cpu> held
      */
     pcb_t *(*pick_ready_locked)(struct sched_comp *sched, cpu_t *cpu, pcb_t *curpcb);
+
+    /**
+     * Optional, called once <cpu> is about to start using this scheduler
+     *
+     * NOTE: Must be called with the ready queue lock of <cpu> held
+     */
+    int (*attach_cpu_locked)(struct sched_comp *sched, cpu_t *cpu);
 } sched_comp_ops_t;
 
 struct ticker_comp;
@@ -5,6 +5,7 @@
 #include <dstruct/list.h>
 #include <component/component.h>
 #include <component/vrtimer.h>
+#include <sync/spinlock.h>
 #include <dstruct/list.h>
 
 struct ticker_comp;
@@ -15,6 +16,7 @@ typedef struct {
     ticker_cb_t cb;
     void *data;
     list_head_t list;
+    rcu_head_t rcu;
 } ticker_cb_info_t;
 
 typedef struct {
@@ -29,9 +31,30 @@ typedef struct ticker_comp {
 
     uint32_t ticks_per_sec;
     vrtimer_comp_t *vrtimer;
+    /**
+     * Walked under rcu on every tick (see include/sync/rcu.h), changes are serialized
+     * with <cbs_lock>
+     */
     list_head_t cbs;
+    spinlock_t cbs_lock;
 
     ticker_comp_ops_t ops;
+
+#ifdef CONFIG_TICKER_NOHZ_IDLE
+    bool running;
+    /**
+     * Whether the ticker was stopped by ticker_nohz_enter_all()
+     */
+    bool nohz_stopped;
+    /**
+     * hrtimer value at the last tick
+     */
+    abstick_t last_tick_hrticks;
+    /**
+     * hrtimer ticks elapsed while stopped that didn't add up to a whole OS tick
+     */
+    abstick_t nohz_residue;
+#endif
 } ticker_comp_t;
 
 int ticker_init(ticker_comp_t *t);
@@ -39,3 +62,27 @@ int ticker_deinit(ticker_comp_t *t);
 int ticker_component_init(ticker_comp_t *t, board_comp_t *bcomp,
         int (*init)(component_t *c), int (*deinit)(component_t *c));
 int ticker_start_all(void);
+
+/**
+ * Executes the callbacks of <t> on the current cpu, without advancing the OS ticks. Used to
+ * drive the secondary cpus with their own private tick (see core/cpu/smp.c)
+ */
+void ticker_run_callbacks(ticker_comp_t *t);
+
+#ifdef CONFIG_TICKER_NOHZ_IDLE
+/**
+ * Stops the periodic OS tick of every running ticker, so that the cpu is only woken up by
+ * the next vrtimer deadline (or any other irq)
+ *
+ * Note: Must be called with irqs disabled, and followed by ticker_nohz_exit_all()
+ */
+int ticker_nohz_enter_all(void);
+
+/**
+ * Restarts the tickers stopped by ticker_nohz_enter_all(), accounting the OS ticks
+ * skipped in the meantime
+ *
+ * Note: Must be called with irqs disabled
+ */
+int ticker_nohz_exit_all(void);
+#endif
@@ -38,6 +38,13 @@ typedef struct {
     int (*set_expiration_ticks)(struct timer_comp *t, int64_t timer_ticks, timer_exp_type_t type,
             timer_cb_t cb, void *data, bool periodic);
     int (*clear_expiration)(struct timer_comp *t);
+
+    /**
+     * Initializes the state of the timer private to the calling cpu (e.g. banked registers
+     * and private peripheral interrupts). Only needed by per-cpu timers, called by every
+     * secondary cpu as it comes online. Can be NULL
+     */
+    int (*init_cpu)(struct timer_comp *t);
 } timer_comp_ops_t;
 
 typedef struct timer_comp {
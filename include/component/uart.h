@@ -8,6 +8,7 @@
 #include <component/intc.h>
 #include <component/bytestream.h>
 #include <dstruct/circbuf.h>
+#include <sched/types.h>
 #include <generated/autoconf.h>
 
 typedef struct uart {
@@ -24,6 +25,12 @@ typedef struct uart {
     uint8_t txbuf[CONFIG_UART_TXBUF_SIZE];
 
     bytestream_t bs;
+
+    /**
+     * Deferred refill of the transmit FIFO, queued by the irq handler once the FIFO has
+     * space again
+     */
+    work_t tx_work;
 } uart_t;
 
 int uart_init(uart_t *uart);
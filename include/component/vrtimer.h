@@ -42,11 +42,21 @@ typedef struct vrtimer_comp {
     timer_comp_t *hrtimer;
     timer_comp_t *low_power_timer;
     spinlock_t lock;
+    /**
+     * Cpu that programs the hrtimer. Its registers may be banked (e.g. ARM generic timer),
+     * so the expiration is always armed on the cpu that initialized the component
+     */
+    uint8_t cpu;
 
     vrtimer_comp_ops_t ops;
 } vrtimer_comp_t;
 
 int vrtimer_init(vrtimer_comp_t *t);
+/**
+ * Re-arms the hrtimer/low power timer for the soonest vrtimer to expire. Must be called
+ * on the cpu that owns <t>
+ */
+void vrtimer_update_expiration(vrtimer_comp_t *t);
 int vrtimer_deinit(vrtimer_comp_t *t);
 int vrtimer_component_init(vrtimer_comp_t *t, board_comp_t *bcomp,
         int (*init)(component_t *c), int (*deinit)(component_t *c));
@@ -11,11 +11,13 @@
 #include <mm/slab.h>
 #include <time/tick.h>
 #include <sync/spinlock.h>
+#include <sync/rwlock.h>
 #include <sync/atomic.h>
 #include <arch/core.h>
 #include <generated/autoconf.h>
 #include <irq/types.h>
 #include <fs/vfs/types.h>
+#include <sched/types.h>
 
 struct pcb;
 typedef struct {
@@ -30,27 +32,42 @@ typedef struct {
     list_head_t pcbs;
 
     /**
-     * Spinlock used to synchronize the _laritos.proc.pcbs list
-     *
-     * Lock ordering (if both locks are needed):
-     *      pcbs_lock
-     *          pcbs_data_lock
+     * Readers-writer lock used to synchronize the _laritos.proc.pcbs list. Walking the list
+     * only needs the read side, so that it doesn't serialize the cpus
      */
-    spinlock_t pcbs_lock;
+    rwlock_t pcbs_lock;
 
     /**
-     * Spinlock used to protect any pcb_t data structure that may be changed by
-     * two or more processors at the same time.
+     * Spinlock used to protect the process tree and the pcb_t data that isn't related to
+     * scheduling: name, cwd, parent, children/siblings, exit status, reference counters,
+     * zombie resources, etc. It is also the lock of the pcb_t.parent_waiting_cond conditions.
      *
-     * Ideally, for performance reasons, there should be one lock per pcb_t, but this greatly
-     * simplifies the code and reduces synchronization complexity.
+     * Scheduling data is protected by finer grained locks instead, so that the cpus don't
+     * serialize on every context switch and wake up:
+     *      - pcb_t.lock: Status transitions from/to BLOCKED, priority and affinity of the process
+     *      - sched_runqueue_t.lock: Contents of the ready queue of a cpu, the READY <-> RUNNING
+     *        transitions of its processes, their scheduling stats, time slice, virtual runtime,
+     *        and the pcb_t.sched.on_cpu flag. Changing pcb_t.sched.cpu requires either the pcb
+     *        lock and the new queue lock (wake up) or the locks of both queues (migration)
      *
-     * Lock ordering (if both locks are needed):
-     *      pcbs_lock
+     * Lock ordering (see lock_class_t, CONFIG_SYNC_LOCKDEP checks it at runtime):
+     *      pcbs_lock (either side of the readers-writer lock)
      *          pcbs_data_lock
+     *              pi_lock
+     *                  pcb_t.lock
+     *                      sched_runqueue_t.lock (two queues are taken in ascending cpu id order)
+     *
+     * Any other lock (e.g. the spinlock of a condition, virtual timers) must be acquired
+     * before the pcb_t and ready queue locks
      */
     spinlock_t pcbs_data_lock;
 
+    /**
+     * Protects the priority inheritance relationships between processes and rmutexes
+     * (see include/sync/rmutex.h). Taken with the spinlock of an rmutex held, if any
+     */
+    spinlock_t pi_lock;
+
     /**
      * Pointer to the init process pcb_t
      */
@@ -68,28 +85,82 @@ typedef struct {
     DEF_CPU_LOCAL(struct pcb *, running);
 
     /**
-     * List of READY processes per cpu
+     * Queue of READY processes per cpu
      */
-    DEF_CPU_LOCAL(list_head_t, ready_pcbs);
+    DEF_CPU_LOCAL(sched_runqueue_t, rq);
 
     /**
-     * Indicates whether or not the OS should schedule the next 'ready' process
+     * Indicates whether or not each cpu should schedule the next 'ready' process
      * right before returning from the current non-user mode and when all the work required is done.
      *
      * Calling schedule() while handling an irq (e.g. without having acknowledged the int
      * controller yet), may prevent future irqs to be dispatched, will block the current irq
      * processing, among other unintentional fatal consequences.
      */
-    bool need_sched;
+    DEF_CPU_LOCAL(bool, need_sched);
+
+    /**
+     * preempt_disable() nesting level of each cpu, schedule_if_needed() doesn't switch away
+     * from the running process while it is not 0
+     */
+    DEF_CPU_LOCAL(uint32_t, preempt_count);
+
+    /**
+     * Idle process of each cpu
+     */
+    DEF_CPU_LOCAL(struct pcb *, idle);
+
+    /**
+     * Process each cpu is switching away from. Its context is saved by the time the next
+     * process starts executing, which then clears its pcb_t.sched.on_cpu flag
+     */
+    DEF_CPU_LOCAL(struct pcb *, prev);
+
+    /**
+     * Deferred work queued by each cpu (see include/sched/workqueue.h)
+     */
+    DEF_CPU_LOCAL(sched_workqueue_t, wq);
+
+#ifdef CONFIG_SMP
+    /**
+     * Bitmask of the cpus that completed their bring-up and are running processes
+     *
+     * Written with _laritos.proc.pcbs_data_lock held, a cpu only sets its own bit once.
+     * Readers may check it without any lock
+     */
+    uint32_t online;
+
+    /**
+     * OS ticks left for the next load balancing pass of each cpu
+     */
+    DEF_CPU_LOCAL(tick_t, balance_countdown);
+#endif
 } laritos_sched_t;
 
 typedef struct {
     atomic32_t ctx_switches;
+    /**
+     * Number of re-schedule requests avoided thanks to the time slices (i.e. ticks and
+     * wake ups that didn't need to preempt the running process)
+     */
+    atomic32_t avoided_switches;
+    /**
+     * Number of READY processes moved to the queue of a different cpu by the load balancer
+     */
+    atomic32_t migrations;
+    /**
+     * Number of READY processes taken from the queue of a different cpu by an idle cpu
+     */
+    atomic32_t steals;
 } laritos_stats_t;
 
 typedef struct {
     list_head_t fstypes;
     list_head_t mounts;
+    /**
+     * Protects the _laritos.fs.mounts list
+     */
+    rwlock_t mounts_lock;
     list_head_t sysfs_mods;
     fs_dentry_t *root;
     fs_dentry_t *proc_root;
@@ -103,6 +174,26 @@ typedef struct {
     fs_dentry_t *property_root;
 } laritos_fs_t;
 
+typedef struct {
+    /**
+     * Callbacks waiting for a grace period (see call_rcu()), in queuing order
+     */
+    rcu_head_t *cbs;
+    rcu_head_t **cbs_tail;
+    spinlock_t lock;
+    /**
+     * Runs the queued callbacks once their grace period is over
+     */
+    work_t work;
+#ifdef CONFIG_SMP
+    /**
+     * Number of quiescent states (i.e. calls to schedule() outside of any read-side critical
+     * section) of each cpu
+     */
+    DEF_CPU_LOCAL(atomic32_t, qs);
+#endif
+} laritos_rcu_t;
+
 /**
  * laritOS Global context
  */
@@ -126,6 +217,10 @@ typedef struct {
      * List of components grouped by type (for performance reasons)
      */
     list_head_t comps[COMP_TYPE_LEN];
+    /**
+     * Protects the _laritos.comps lists
+     */
+    rwlock_t comps_lock;
 
     /**
      * List of loaded modules
@@ -148,19 +243,27 @@ typedef struct {
      */
     list_head_t properties;
     /**
-     * Spinlock used to protect the _laritos.properties list
+     * Protects the _laritos.properties list and the property values
      */
-    spinlock_t prop_lock;
+    rwlock_t prop_lock;
 
     /**
      * CPU shortcuts, will be initialized by cpu_init()
      */
     DEF_CPU_LOCAL(cpu_t *, cpu);
 
+#ifdef CONFIG_SYNC_LOCKDEP
+    /**
+     * Bitmask of the lock classes held by each cpu (see lock_class_t)
+     */
+    DEF_CPU_LOCAL(uint32_t, lockdep_held);
+#endif
+
     bool components_loaded;
 
     laritos_process_t proc;
     laritos_sched_t sched;
+    laritos_rcu_t rcu;
     laritos_stats_t stats;
     laritos_fs_t fs;
 
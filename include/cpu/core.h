@@ -26,6 +26,18 @@ static inline uint8_t cpu_get_id(void) {
     return arch_cpu_get_id();
 }
 
+/**
+ * Per-cpu pointer to the thread running on the cpu (the current pcb in process mode).
+ * Doesn't need to disable irqs, see arch_cpu_get_thread_ptr()
+ */
+static inline void *cpu_get_thread_ptr(void) {
+    return arch_cpu_get_thread_ptr();
+}
+
+static inline void cpu_set_thread_ptr(void *ptr) {
+    arch_cpu_set_thread_ptr(ptr);
+}
+
 static inline cpu_t *cpu(void) {
     cpu_t *c = CPU_LOCAL_GET(_laritos.cpu);
     assert(c != NULL, "cpu() cannot be NULL");
@@ -87,3 +99,9 @@ static inline int cpu_reset_cycle_count(void) {
 static inline uint64_t cpu_get_cycle_count(void) {
     return arch_cpu_get_cycle_count();
 }
+
+#ifdef CONFIG_SMP
+static inline int cpu_start_secondary(uint8_t id) {
+    return arch_cpu_start_secondary(id);
+}
+#endif
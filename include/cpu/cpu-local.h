@@ -18,26 +18,42 @@
         &_name[cpuid]; \
     }))
 
+/**
+ * Pointer to the instance of <_name> that belongs to cpu <_cpuid>, not necessarily the
+ * current one (e.g. to update the per-cpu state of a remote cpu under a lock)
+ */
+#define CPU_LOCAL_GET_PTR_FOR_CPU(_name, _cpuid) \
+    (({ \
+        uint8_t __cpuid = (_cpuid); \
+        assert(__cpuid < ARRAYSIZE(_name), "Invalid cpu id #%u", __cpuid); \
+        &_name[__cpuid]; \
+    }))
+
+/**
+ * The irqs are only disabled (so that the caller is not migrated in between) if they
+ * weren't already
+ */
 #define CPU_LOCAL_GET(_name) \
     (({ \
-        irqctx_t _ctx; \
-        irq_disable_local_and_save_ctx(&_ctx); \
-        \
-        uint8_t cpuid = arch_cpu_get_id(); \
-        assert(cpuid < ARRAYSIZE(_name), "Invalid cpu id #%u", cpuid); \
-        typeof(_name[0]) _value = _name[cpuid]; \
-        \
-        irq_local_restore_ctx(&_ctx); \
+        typeof(_name[0]) _value; \
+        if (!irq_is_enabled()) { \
+            _value = *CPU_LOCAL_GET_PTR_LOCKED(_name); \
+        } else { \
+            irqctx_t _ctx; \
+            irq_disable_local_and_save_ctx(&_ctx); \
+            _value = *CPU_LOCAL_GET_PTR_LOCKED(_name); \
+            irq_local_restore_ctx(&_ctx); \
+        } \
         _value; \
     }))
 
 #define CPU_LOCAL_SET(_name, _value) do { \
-        irqctx_t _ctx; \
-        irq_disable_local_and_save_ctx(&_ctx); \
-        \
-        uint8_t cpuid = arch_cpu_get_id(); \
-        assert(cpuid < ARRAYSIZE(_name), "Invalid cpu id #%u", cpuid); \
-        (_name)[cpuid] = _value; \
-        \
-        irq_local_restore_ctx(&_ctx); \
+        if (!irq_is_enabled()) { \
+            *CPU_LOCAL_GET_PTR_LOCKED(_name) = _value; \
+        } else { \
+            irqctx_t _ctx; \
+            irq_disable_local_and_save_ctx(&_ctx); \
+            *CPU_LOCAL_GET_PTR_LOCKED(_name) = _value; \
+            irq_local_restore_ctx(&_ctx); \
+        } \
     } while (0)
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <generated/autoconf.h>
+
+#ifdef CONFIG_SMP
+/**
+ * Software generated interrupt used to ask a cpu to run the scheduler
+ */
+#define SMP_IPI_RESCHED 0
+/**
+ * Software generated interrupt used to ask a cpu to re-arm the vrtimers it owns
+ */
+#define SMP_IPI_VRTIMER 1
+
+/**
+ * Powers on every secondary cpu described in the board information. Each of them
+ * initializes its private hardware state, starts its local tick and runs its own idle
+ * process. The load balancer then spreads the READY processes across the online cpus.
+ *
+ * Must be called by the boot cpu once the board components are loaded and before
+ * the OS tickers are started
+ *
+ * @return 0 if every secondary cpu was powered on, <0 otherwise
+ */
+int smp_boot_secondary_cpus(void);
+
+/**
+ * Interrupts cpu <cpuid> so that it runs the scheduler right away (e.g. to pick up a
+ * process that just became ready)
+ */
+void smp_send_resched(uint8_t cpuid);
+
+/**
+ * Interrupts cpu <cpuid> so that it re-arms the expiration of the vrtimers it owns
+ * (see vrtimer_comp_t.cpu)
+ */
+void smp_send_vrtimer_update(uint8_t cpuid);
+
+/**
+ * Entry point of the secondary cpus, once their stacks are set up (see start.S)
+ */
+void smp_secondary_entry(void);
+#endif
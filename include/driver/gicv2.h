@@ -17,6 +17,11 @@
  */
 #define GICV2_SPURIOUS_INT_ID 1023
 
+/**
+ * Interrupt IDs 0-15 are Software Generated Interrupts
+ */
+#define GICV2_MAX_SGI_ID 15
+
 
 typedef enum {
     ARCH_REV_UNKNOWN,
@@ -27,7 +32,27 @@ typedef enum {
 } arch_rev_t;
 
 /**
- * Controls the generation of SGIs
+ * Determines how the Distributor processes the requested SGI
+ */
+typedef enum {
+    /**
+     * Forward the interrupt to the CPU interfaces specified in the CPUTargetList field
+     */
+    GIC_SGI_FILTER_TARGET_LIST = 0,
+    /**
+     * Forward the interrupt to all CPU interfaces except that of the processor that
+     * requested the interrupt
+     */
+    GIC_SGI_FILTER_ALL_BUT_SELF,
+    /**
+     * Forward the interrupt only to the CPU interface of the processor that requested
+     * the interrupt
+     */
+    GIC_SGI_FILTER_SELF,
+} gic_sgi_filter_t;
+
+/**
+ * Controls the generation of SGIs. Write-only
  */
 typedef volatile struct {
     union {
@@ -12,6 +12,13 @@ static inline uint8_t bitset_ffz(bitset_t bs) {
     return arch_bitset_ffz(bs);
 }
 
+/**
+ * @return Position (left-most numbering) of the first bit set, BITSET_IDX_NOT_FOUND if none
+ */
+static inline uint8_t bitset_ffs(bitset_t bs) {
+    return arch_bitset_ffz(~bs);
+}
+
 static inline uint32_t bitset_array_ffz(bitset_t bs[], size_t n) {
     int i;
     for (i = 0; i < n; i++) {
@@ -19,6 +19,7 @@
 #define LIST_H_ (1)
 
 #include <utils/utils.h>
+#include <sync/barrier.h>
 
 // import from include/linux/types.h
 typedef struct list_head {
@@ -33,6 +34,11 @@ struct hlist_node {
     struct hlist_node *next, **pprev;
 };
 
+typedef struct rcu_head {
+    struct rcu_head *next;
+    void (*func)(struct rcu_head *head);
+} rcu_head_t;
+
 // import from include/linux/poison.h
 
 /*
@@ -614,6 +620,69 @@ static inline void list_splice_tail_init(struct list_head *list,
 #define list_safe_reset_next(pos, n, member)                \
     n = list_next_entry(pos, member)
 
+/*
+ * RCU variants (see include/sync/rcu.h). Writers must still serialize among themselves
+ * (e.g. with a spinlock), readers walk the list inside an rcu_read_lock() section without
+ * taking any lock.
+ */
+
+/**
+ * list_add_rcu - add a new entry to an rcu-protected list
+ * @new: new entry to be added
+ * @head: list head to add it after
+ *
+ * The entry is fully initialized before it becomes visible to the readers.
+ */
+static inline void list_add_rcu(struct list_head *new, struct list_head *head) {
+    struct list_head *next = head->next;
+    new->next = next;
+    new->prev = head;
+    // Publish the entry only once its contents are visible
+    dmb();
+    *(struct list_head *volatile *) &head->next = new;
+    next->prev = new;
+}
+
+/**
+ * list_add_tail_rcu - add a new entry to the end of an rcu-protected list
+ * @new: new entry to be added
+ * @head: list head to add it before
+ */
+static inline void list_add_tail_rcu(struct list_head *new, struct list_head *head) {
+    struct list_head *prev = head->prev;
+    new->next = head;
+    new->prev = prev;
+    dmb();
+    *(struct list_head *volatile *) &prev->next = new;
+    head->prev = new;
+}
+
+/**
+ * list_del_rcu - deletes entry from an rcu-protected list
+ * @entry: the element to delete from the list.
+ *
+ * The entry keeps pointing to its successor, readers currently on it can still move
+ * forward. It must not be freed nor reused until a grace period has elapsed
+ * (see call_rcu() and synchronize_rcu()).
+ */
+static inline void list_del_rcu(struct list_head *entry) {
+    __list_del_entry(entry);
+    entry->prev = LIST_POISON2;
+}
+
+/**
+ * list_for_each_entry_rcu - iterate over an rcu-protected list of given type
+ * @pos:	the type * to use as a loop cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the list_head within the struct.
+ *
+ * Must be called inside an rcu_read_lock() section (or with irqs disabled).
+ */
+#define list_for_each_entry_rcu(pos, head, member)            \
+    for (pos = list_entry(*(struct list_head *volatile *) &(head)->next, typeof(*pos), member); \
+         &pos->member != (head);                    \
+         pos = list_entry(*(struct list_head *volatile *) &pos->member.next, typeof(*pos), member))
+
 /*
  * Double linked lists with a single pointer list head.
  * Mostly useful for hash tables where the two pointer list head is
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <utils/utils.h>
+
+/**
+ * Intrusive red-black tree.
+ *
+ * Nodes are embedded in the user structure (same as list_head_t) and the ordering is
+ * given by a less-than function at insertion time. The left-most node is cached in the
+ * tree so that getting the minimum is O(1), insertion and removal are O(log n).
+ */
+typedef struct rbnode {
+    struct rbnode *parent;
+    struct rbnode *left;
+    struct rbnode *right;
+    bool red;
+} rbnode_t;
+
+typedef struct {
+    rbnode_t *root;
+    rbnode_t *leftmost;
+} rbtree_t;
+
+/**
+ * @return true if <a> must be placed before <b>
+ */
+typedef bool (*rbtree_less_t)(const rbnode_t *a, const rbnode_t *b);
+
+#define RBTREE_STATIC_INIT { .root = NULL, .leftmost = NULL }
+
+#define rbtree_entry(_ptr, _type, _member) container_of(_ptr, _type, _member)
+
+#define rbtree_first_entry_or_null(_tree, _type, _member) ({ \
+        rbnode_t *__n = (_tree)->leftmost; \
+        __n != NULL ? rbtree_entry(__n, _type, _member) : NULL; \
+    })
+
+static inline void rbtree_init(rbtree_t *t) {
+    t->root = NULL;
+    t->leftmost = NULL;
+}
+
+static inline bool rbtree_is_empty(const rbtree_t *t) {
+    return t->root == NULL;
+}
+
+static inline rbnode_t *rbtree_first(const rbtree_t *t) {
+    return t->leftmost;
+}
+
+/**
+ * Marks the node as not linked to any tree (a node pointing to itself cannot be part of a tree)
+ */
+static inline void rbnode_init(rbnode_t *n) {
+    n->parent = n;
+    n->left = NULL;
+    n->right = NULL;
+    n->red = false;
+}
+
+static inline bool rbnode_is_linked(const rbnode_t *n) {
+    return n->parent != n;
+}
+
+/**
+ * Inserts <n> into the tree. Nodes comparing equal to an existing one are placed after it,
+ * so the in-order traversal of equal nodes follows insertion order
+ */
+void rbtree_insert(rbtree_t *t, rbnode_t *n, rbtree_less_t less);
+
+/**
+ * Removes <n> from the tree and marks it as not linked
+ */
+void rbtree_remove(rbtree_t *t, rbnode_t *n);
+
+/**
+ * @return In-order successor of <n>, NULL if <n> is the last node
+ */
+rbnode_t *rbtree_next(const rbnode_t *n);
@@ -25,7 +25,7 @@ static inline int file_get_abs_dirname(char *path, char *buf, size_t len) {
         strncpy(buf, path, len);
     } else {
         char cwd[256];
-        vfs_dentry_get_fullpath(process_get_current()->cwd, cwd, sizeof(cwd));
+        vfs_dentry_get_fullpath(process_get_leader(process_get_current())->cwd, cwd, sizeof(cwd));
         snprintf(buf, len, "%s/%s", cwd, path);
     }
 
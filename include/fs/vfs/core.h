@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <fs/vfs/types.h>
+#include <mm/slab.h>
 
 int vfs_init_global_context(void);
 
@@ -47,7 +48,10 @@ int vfs_file_remove(fs_dentry_t *parent, char *fname);
 fs_file_t *vfs_file_open(char *path, fs_access_mode_t mode);
 fs_file_t *vfs_file_dentry_open(fs_dentry_t *d, fs_access_mode_t mode);
 int vfs_file_close(fs_file_t *f);
-int vfs_file_close_all_for_cur_process(void);
+/**
+ * Closes the files still open in the fd table <fds_slab>, right before it is destroyed
+ */
+int vfs_file_close_all(slab_t *fds_slab);
 int vfs_file_read(fs_file_t *f, void *buf, size_t blen, uint32_t offset);
 int vfs_file_read_cur_offset(fs_file_t *f, void *buf, size_t blen);
 int vfs_file_write(fs_file_t *f, void *buf, size_t blen, uint32_t offset);
@@ -1,16 +1,27 @@
 #pragma once
 
 #include <log.h>
+#include <stdbool.h>
 #include <cpu/core.h>
 #include <core.h>
 #include <utils/debug.h>
 #include <symbol.h>
+#include <sync/atomic.h>
 #include <mm/exc-handlers.h>
+#ifdef CONFIG_MEM_HEAP_PROFILER
+#include <mm/heap-prof.h>
+#endif
+#include <generated/autoconf.h>
 
 
 #define CANARY 0xAACCBBDDL
 
 typedef struct {
+    /**
+     * Bytes between the start of the heap chunk and this header (only non-zero for
+     * chunks allocated with memalign())
+     */
+    uint32_t pad;
     regpc_t pc;
     uint32_t canary;
     size_t size;
@@ -20,6 +31,173 @@ typedef struct {
     uint32_t canary;
 } bufprot_tail_t;
 
+/**
+ * Dumps information about a corrupted chunk (allocation and deallocation sites)
+ */
+void heap_prot_report_overflow(bufprot_head_t *h, bufprot_tail_t *t, regpc_t pc);
+
+/**
+ * Called after releasing a corrupted chunk. Kills the current process, or stops
+ * the kernel if the corruption happened outside of a process context
+ */
+__attribute__((always_inline)) static inline void heap_prot_handle_overflow(void) {
+    if (_laritos.process_mode) {
+        // Kill process and schedule
+        exc_handle_process_exception(process_get_current());
+        // Execution will never reach this point
+    } else {
+        // Stop the kernel
+        fatal("ABORT: Heap buffer overflow");
+    }
+}
+
+/**
+ * Initializes the head and tail canaries of a <size> bytes chunk starting at <h>
+ *
+ * @return Pointer to the user data
+ */
+__attribute__((always_inline)) static inline void *heap_prot_guard(bufprot_head_t *h, size_t size, regpc_t pc) {
+    h->pad = 0;
+    h->pc = pc;
+    h->canary = CANARY;
+    h->size = size;
+    bufprot_tail_t *t = (bufprot_tail_t *) ((char *) h + sizeof(bufprot_head_t) + size);
+    t->canary = CANARY;
+#ifdef CONFIG_MEM_HEAP_PROFILER
+    heap_prof_record_alloc(pc, size);
+#endif
+    return (char *) h + sizeof(bufprot_head_t);
+}
+
+/**
+ * @return true if any of the canaries around the user data <ptr> was corrupted
+ */
+__attribute__((always_inline)) static inline bool heap_prot_is_corrupted(void *ptr, bufprot_head_t **h, bufprot_tail_t **t) {
+    *h = (bufprot_head_t *) ((char *) ptr - sizeof(bufprot_head_t));
+    *t = (bufprot_tail_t *) ((char *) ptr + (*h)->size);
+    return (*h)->canary != CANARY || (*t)->canary != CANARY;
+}
+
+/**
+ * Called right before releasing a (non-corrupted) protected chunk
+ */
+__attribute__((always_inline)) static inline void heap_prot_unguard(bufprot_head_t *h) {
+#ifdef CONFIG_MEM_HEAP_PROFILER
+    heap_prof_record_free(h->pc, h->size);
+#endif
+}
+
+/**
+ * Computes the size of a heap chunk able to hold <size> bytes of user data plus the canaries
+ *
+ * @return true if the size doesn't fit in a size_t
+ */
+static inline bool heap_prot_chunk_size(size_t size, size_t *total) {
+    return __builtin_add_overflow(size, sizeof(bufprot_head_t) + sizeof(bufprot_tail_t), total);
+}
+
+
+#ifdef CONFIG_MEM_HEAP_BUFFER_PROTECTION_SAMPLED
+
+/**
+ * Sampled mode: only 1 out of every <sample rate> allocations carries canaries. Those are
+ * served from a dedicated pool of fixed-size slots, so that free() can tell them apart
+ * from regular (unguarded) chunks just by their address.
+ */
+
+#define HEAP_PROT_POOL_SIZE (CONFIG_MEM_HEAP_PROT_SAMPLED_SLOTS * CONFIG_MEM_HEAP_PROT_SAMPLED_SLOT_SIZE)
+
+extern char _heap_prot_pool[HEAP_PROT_POOL_SIZE];
+/**
+ * Allocations left until the next sampled one. Shared by all the cpus, hence atomic
+ */
+extern atomic32_t _heap_prot_countdown;
+
+void *heap_prot_sampled_malloc(size_t size, regpc_t pc);
+void heap_prot_sampled_free(void *ptr, regpc_t pc);
+void heap_prot_set_sample_rate(uint32_t rate);
+uint32_t heap_prot_get_sample_rate(void);
+
+__attribute__((always_inline)) static inline bool heap_prot_is_sampled(void *ptr) {
+    return (char *) ptr >= _heap_prot_pool && (char *) ptr < _heap_prot_pool + HEAP_PROT_POOL_SIZE;
+}
+
+/**
+ * @return true if the current allocation must be sampled
+ */
+__attribute__((always_inline)) static inline bool heap_prot_should_sample(void) {
+    return atomic32_dec(&_heap_prot_countdown) <= 0;
+}
+
+__attribute__((always_inline)) static inline void *malloc(size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+
+    if (heap_prot_should_sample()) {
+        void *ptr = heap_prot_sampled_malloc(size, cpu_get_pc());
+        if (ptr != NULL) {
+            return ptr;
+        }
+    }
+    return heap_malloc(size);
+}
+
+__attribute__((always_inline)) static inline void free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    if (heap_prot_is_sampled(ptr)) {
+        heap_prot_sampled_free(ptr, cpu_get_pc());
+        return;
+    }
+    heap_free(ptr);
+}
+
+__attribute__((always_inline)) static inline void *calloc(size_t nmemb, size_t size) {
+    size_t n;
+    if (heap_calloc_size(nmemb, size, &n) || n == 0) {
+        return NULL;
+    }
+
+    if (heap_prot_should_sample()) {
+        void *ptr = heap_prot_sampled_malloc(n, cpu_get_pc());
+        if (ptr != NULL) {
+            return memset(ptr, 0, n);
+        }
+    }
+    return heap_zalloc(n);
+}
+
+__attribute__((always_inline)) static inline void *realloc(void *ptr, size_t size) {
+    if (ptr == NULL || !heap_prot_is_sampled(ptr)) {
+        return heap_realloc(ptr, size);
+    }
+
+    // Sampled chunks live in fixed-size slots, they are always moved
+    void *nptr = NULL;
+    if (size > 0) {
+        nptr = malloc(size);
+        if (nptr == NULL) {
+            return NULL;
+        }
+        bufprot_head_t *h = (bufprot_head_t *) ((char *) ptr - sizeof(bufprot_head_t));
+        memcpy(nptr, ptr, h->size < size ? h->size : size);
+    }
+    heap_prot_sampled_free(ptr, cpu_get_pc());
+    return nptr;
+}
+
+/**
+ * Aligned chunks are never sampled
+ */
+__attribute__((always_inline)) static inline void *memalign(size_t alignment, size_t size) {
+    return heap_memalign(alignment, size);
+}
+
+#else
+
 /**
  * Custom malloc() which adds buffer protection metadata to detect buffer overflows
  *
@@ -31,17 +209,59 @@ __attribute__((always_inline)) static inline void *malloc(size_t size) {
         return NULL;
     }
 
-    bufprot_head_t *h = _malloc(sizeof(bufprot_head_t) + size + sizeof(bufprot_tail_t));
+    size_t csize;
+    if (heap_prot_chunk_size(size, &csize)) {
+        return NULL;
+    }
+    bufprot_head_t *h = heap_malloc(csize);
     if (h == NULL) {
         return NULL;
     }
+    return heap_prot_guard(h, size, cpu_get_pc());
+}
 
-    h->pc = cpu_get_pc();
-    h->canary = CANARY;
-    h->size = size;
-    bufprot_tail_t *t = (bufprot_tail_t *) ((char *) h + sizeof(bufprot_head_t) + size);
-    t->canary = CANARY;
-    return (char *) h + sizeof(bufprot_head_t);
+__attribute__((always_inline)) static inline void *calloc(size_t nmemb, size_t size) {
+    size_t n;
+    size_t csize;
+    if (heap_calloc_size(nmemb, size, &n) || n == 0 || heap_prot_chunk_size(n, &csize)) {
+        return NULL;
+    }
+
+    bufprot_head_t *h = heap_zalloc(csize);
+    if (h == NULL) {
+        return NULL;
+    }
+    return heap_prot_guard(h, n, cpu_get_pc());
+}
+
+/**
+ * The user data is placed at the first <alignment> boundary that leaves enough room for
+ * the header, the header keeps track of how far it is from the start of the heap chunk
+ */
+__attribute__((always_inline)) static inline void *memalign(size_t alignment, size_t size) {
+    if (size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        return NULL;
+    }
+
+    size_t off = sizeof(bufprot_head_t);
+    if (alignment > off) {
+        off = alignment;
+    } else {
+        off = (off + alignment - 1) & ~(alignment - 1);
+    }
+    size_t csize;
+    if (__builtin_add_overflow(off, size, &csize) ||
+            __builtin_add_overflow(csize, sizeof(bufprot_tail_t), &csize)) {
+        return NULL;
+    }
+    char *chunk = heap_memalign(alignment, csize);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    bufprot_head_t *h = (bufprot_head_t *) (chunk + off - sizeof(bufprot_head_t));
+    void *ptr = heap_prot_guard(h, size, cpu_get_pc());
+    h->pad = (char *) h - chunk;
+    return ptr;
 }
 
 /**
@@ -54,33 +274,55 @@ __attribute__((always_inline)) static inline void free(void *ptr) {
         return;
     }
 
-    bufprot_head_t *h = (bufprot_head_t *) ((char *) ptr - sizeof(bufprot_head_t));
-    bufprot_tail_t *t = (bufprot_tail_t *) ((char *) ptr + h->size);
-    if (h->canary != CANARY || t->canary != CANARY) {
-        regpc_t pc = cpu_get_pc();
-        debug_message_delimiter();
-        error("Buffer overflow on block with size %zu bytes:", h->size);
-        error("  Expected canaries head=0x%lX tail=0x%lX, got head=0x%lX tail=0x%lX", CANARY, CANARY, h->canary, t->canary);
-        char symbol[32] = { 0 };
-        symbol_get_name_at(h->pc, symbol, sizeof(symbol));
-        error("  Allocation at %s (pc=0x%p)", symbol, h->pc);
-        error("  Run gdb-multiarch -batch -n -ex 'file bin/laritos.elf' -ex 'disassemble /m 0x%p'", h->pc);
-        symbol_get_name_at(pc, symbol, sizeof(symbol));
-        error("  Deallocation at %s (pc=0x%p)", symbol, pc);
-        error("  Run gdb-multiarch -batch -n -ex 'file bin/laritos.elf' -ex 'disassemble /m 0x%p'", pc);
-        debug_message_delimiter();
-
-        if (_laritos.process_mode) {
-            // Free chunk anyway
-            _free(h);
-            // Kill process and schedule
-            exc_handle_process_exception(process_get_current());
-            // Execution will never reach this point
-        } else {
-            // Stop the kernel
-            fatal("ABORT: Heap buffer overflow");
+    bufprot_head_t *h;
+    bufprot_tail_t *t;
+    if (heap_prot_is_corrupted(ptr, &h, &t)) {
+        heap_prot_report_overflow(h, t, cpu_get_pc());
+        // Free chunk anyway (unless it's an aligned one, its padding can't be trusted)
+        if (h->pad == 0) {
+            heap_free(h);
         }
+        heap_prot_handle_overflow();
+    }
+    heap_prot_unguard(h);
+    heap_free((char *) h - h->pad);
+}
 
+/**
+ * Custom realloc() which checks the canaries of the old chunk before resizing it
+ */
+__attribute__((always_inline)) static inline void *realloc(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return malloc(size);
+    }
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+
+    bufprot_head_t *h;
+    bufprot_tail_t *t;
+    if (heap_prot_is_corrupted(ptr, &h, &t)) {
+        heap_prot_report_overflow(h, t, cpu_get_pc());
+        heap_prot_handle_overflow();
     }
-    _free(h);
+
+    size_t csize;
+    if (heap_prot_chunk_size(size, &csize)) {
+        return NULL;
+    }
+    if (h->pad == 0 && heap_resize(h, csize)) {
+        heap_prot_unguard(h);
+        return heap_prot_guard(h, size, cpu_get_pc());
+    }
+
+    void *nptr = malloc(size);
+    if (nptr == NULL) {
+        return NULL;
+    }
+    memcpy(nptr, ptr, h->size < size ? h->size : size);
+    free(ptr);
+    return nptr;
 }
+
+#endif
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cpu/core.h>
+#include <generated/autoconf.h>
+
+/**
+ * Heap allocation profiler, aggregates the allocations recorded by the heap buffer
+ * protection code per call site (pc of the malloc() caller)
+ */
+void heap_prof_record_alloc(regpc_t pc, size_t size);
+void heap_prof_record_free(regpc_t pc, size_t size);
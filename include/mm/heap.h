@@ -1,35 +1,215 @@
 #pragma once
 
 #include <log.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include <process/types.h>
 #include <generated/autoconf.h>
+#ifdef CONFIG_MM_PAGE_ALLOC
+#include <mm/page.h>
+#endif
 
 int heap_initialize(void *start, uint32_t size);
 uint32_t heap_get_available(void);
 void *_malloc(size_t size);
 void _free(void *ptr);
+/**
+ * Allocates up to <n> chunks of <size> bytes while holding the heap lock only once
+ *
+ * @return Number of chunks allocated (stored in ptrs[0..ret-1])
+ */
+uint32_t _malloc_batch(size_t size, void **ptrs, uint32_t n);
+/**
+ * Frees <n> chunks while holding the heap lock only once. NULL pointers are ignored
+ */
+void _free_batch(void **ptrs, uint32_t n);
+/**
+ * Allocates <size> bytes aligned to <alignment> (must be a power of two)
+ */
+void *_memalign(size_t alignment, size_t size);
+/**
+ * Grows or shrinks the chunk pointed by <ptr> in place so that it can hold <size> bytes.
+ * Growing is only possible when the block right after the chunk is free
+ *
+ * @return true on success, false if the chunk was left untouched
+ */
+bool _resize(void *ptr, size_t size);
+/**
+ * @return Usable size of the chunk pointed by <ptr> (may be bigger than the requested size)
+ */
+size_t heap_get_chunk_size(void *ptr);
 
-#ifdef CONFIG_MEM_HEAP_BUFFER_PROTECTION
-#include <mm/_heap-prot.h>
+#ifdef CONFIG_MM_HEAP_PERCPU_CACHE
+void *heap_cache_malloc(size_t size);
+void heap_cache_free(void *ptr);
+#endif
+
+/**
+ * Entry points used by the malloc()/free() wrappers. Big requests are served by the
+ * page allocator (if enabled) to keep them from fragmenting the heap, the rest go
+ * through the per-cpu cache (if enabled) before reaching the heap manager
+ */
+static inline void *heap_malloc(size_t size) {
+#ifdef CONFIG_MM_PAGE_ALLOC
+    if (size >= CONFIG_MM_PAGE_ALLOC_THRESHOLD) {
+        void *ptr = page_alloc(page_order_for_size(size));
+        if (ptr != NULL) {
+            return ptr;
+        }
+        // Fall back to the heap
+    }
+#endif
+#ifdef CONFIG_MM_HEAP_PERCPU_CACHE
+    return heap_cache_malloc(size);
 #else
-static inline void *malloc(size_t size) {
     return _malloc(size);
+#endif
 }
 
-static inline void free(void *ptr) {
+static inline void heap_free(void *ptr) {
+#ifdef CONFIG_MM_PAGE_ALLOC
+    if (page_is_managed(ptr)) {
+        page_free(ptr);
+        return;
+    }
+#endif
+#ifdef CONFIG_MM_HEAP_PERCPU_CACHE
+    heap_cache_free(ptr);
+#else
     _free(ptr);
-}
 #endif
+}
 
-__attribute__((always_inline)) static inline void *calloc(size_t nmemb, size_t size) {
-    // Pretty basic implementation
-    size_t n = size * nmemb;
-    void *ptr = malloc(n);
+/**
+ * Same as heap_malloc(), but the chunk is filled with zeros. Blocks from the page allocator
+ * may already be known to be zero, in which case they are not cleared again
+ */
+static inline void *heap_zalloc(size_t size) {
+    void *ptr;
+#ifdef CONFIG_MM_PAGE_ALLOC
+    if (size >= CONFIG_MM_PAGE_ALLOC_THRESHOLD) {
+        ptr = page_alloc_zeroed(page_order_for_size(size));
+        if (ptr != NULL) {
+            return ptr;
+        }
+    }
+#endif
+#ifdef CONFIG_MM_HEAP_PERCPU_CACHE
+    ptr = heap_cache_malloc(size);
+#else
+    ptr = _malloc(size);
+#endif
     if (ptr != NULL) {
-        memset(ptr, 0, n);
+        memset(ptr, 0, size);
     }
     return ptr;
 }
+
+static inline void *heap_memalign(size_t alignment, size_t size) {
+#ifdef CONFIG_MM_PAGE_ALLOC
+    if (size >= CONFIG_MM_PAGE_ALLOC_THRESHOLD && alignment <= PAGE_SIZE) {
+        // Blocks are always page-aligned
+        void *ptr = page_alloc(page_order_for_size(size));
+        if (ptr != NULL) {
+            return ptr;
+        }
+    }
+#endif
+    // The per-cpu cache doesn't know about alignments, go straight to the heap manager
+    return _memalign(alignment, size);
+}
+
+/**
+ * @return Usable size of a chunk returned by any of the heap_*() allocation functions
+ */
+static inline size_t heap_get_usable_size(void *ptr) {
+#ifdef CONFIG_MM_PAGE_ALLOC
+    if (page_is_managed(ptr)) {
+        return page_get_size(ptr);
+    }
+#endif
+    return heap_get_chunk_size(ptr);
+}
+
+/**
+ * Tries to resize a chunk returned by any of the heap_*() allocation functions in place
+ *
+ * @return true on success, false if the chunk was left untouched
+ */
+static inline bool heap_resize(void *ptr, size_t size) {
+#ifdef CONFIG_MM_PAGE_ALLOC
+    if (page_is_managed(ptr)) {
+        // Blocks are never split or merged while in use
+        return page_get_size(ptr) >= size;
+    }
+#endif
+    return _resize(ptr, size);
+}
+
+static inline void *heap_realloc(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return heap_malloc(size);
+    }
+    if (size == 0) {
+        heap_free(ptr);
+        return NULL;
+    }
+    if (heap_resize(ptr, size)) {
+        return ptr;
+    }
+
+    void *nptr = heap_malloc(size);
+    if (nptr == NULL) {
+        return NULL;
+    }
+    size_t oldsize = heap_get_usable_size(ptr);
+    memcpy(nptr, ptr, oldsize < size ? oldsize : size);
+    heap_free(ptr);
+    return nptr;
+}
+
+/**
+ * Computes <nmemb> * <size>
+ *
+ * @return true if the multiplication overflowed
+ */
+static inline bool heap_calloc_size(size_t nmemb, size_t size, size_t *total) {
+    return __builtin_mul_overflow(nmemb, size, total);
+}
+
+#ifdef CONFIG_MEM_HEAP_BUFFER_PROTECTION
+#include <mm/_heap-prot.h>
+#else
+static inline void *malloc(size_t size) {
+    return heap_malloc(size);
+}
+
+static inline void free(void *ptr) {
+    heap_free(ptr);
+}
+
+static inline void *calloc(size_t nmemb, size_t size) {
+    size_t n;
+    if (heap_calloc_size(nmemb, size, &n)) {
+        return NULL;
+    }
+    return heap_zalloc(n);
+}
+
+static inline void *realloc(void *ptr, size_t size) {
+    return heap_realloc(ptr, size);
+}
+
+static inline void *memalign(size_t alignment, size_t size) {
+    return heap_memalign(alignment, size);
+}
+#endif
+
+/**
+ * C11 flavor of memalign()
+ */
+__attribute__((always_inline)) static inline void *aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
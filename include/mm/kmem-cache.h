@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <dstruct/list.h>
+#include <sync/spinlock.h>
+#include <generated/autoconf.h>
+
+struct fs_dentry;
+
+/**
+ * Named cache of fixed-size objects built on top of the slab allocator.
+ *
+ * Objects are carved out of slabs of CONFIG_MM_KMEM_CACHE_OBJS_PER_SLAB elements,
+ * a new slab is added whenever all the existing ones are full, and empty slabs
+ * are given back to the heap (except for the last one).
+ *
+ * If a ctor is provided, it is called on every object returned by kmem_cache_alloc(),
+ * otherwise the object is zeroed (same semantics as calloc()). The dtor (if any)
+ * is called by kmem_cache_free() right before releasing the object.
+ */
+typedef struct kmem_cache {
+    const char *name;
+    size_t objsize;
+    void (*ctor)(void *obj);
+    void (*dtor)(void *obj);
+
+    spinlock_t lock;
+    list_head_t slabs;
+    uint32_t active;
+    uint32_t total;
+    uint32_t highwater;
+
+    /**
+     * Caches register themselves into the global list on first use, so that they can
+     * be statically defined and used before any initialization code runs
+     */
+    bool registered;
+    list_head_t list;
+    struct fs_dentry *sysfs_dir;
+} kmem_cache_t;
+
+#define KMEM_CACHE_INIT(_var, _name, _objsize, _ctor, _dtor) { \
+        .name = (_name), \
+        .objsize = (_objsize), \
+        .ctor = (_ctor), \
+        .dtor = (_dtor), \
+        .slabs = LIST_HEAD_INIT((_var).slabs), \
+        .list = LIST_HEAD_INIT((_var).list), \
+    }
+
+/**
+ * Defines a static cache <_var> of objects of type <_type>, exposed under /mem/slab/<_name>
+ */
+#define DEF_KMEM_CACHE(_var, _name, _type, _ctor, _dtor) \
+    static kmem_cache_t _var = KMEM_CACHE_INIT(_var, _name, sizeof(_type), _ctor, _dtor)
+
+kmem_cache_t *kmem_cache_create(const char *name, size_t objsize, void (*ctor)(void *obj), void (*dtor)(void *obj));
+int kmem_cache_destroy(kmem_cache_t *cache);
+void *kmem_cache_alloc(kmem_cache_t *cache);
+void kmem_cache_free(kmem_cache_t *cache, void *obj);
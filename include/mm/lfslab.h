@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Lock-free slab. Free elements are kept in an index-based Treiber stack, so
+ * alloc/free never take a lock nor disable interrupts
+ */
+typedef void lfslab_t;
+
+lfslab_t *lfslab_create(uint32_t numelems, size_t elemsize);
+void *lfslab_alloc(lfslab_t *slab);
+void lfslab_free(lfslab_t *slab, void *ptr);
+void lfslab_destroy(lfslab_t *slab);
+uint32_t lfslab_get_avail_elems(lfslab_t *slab);
+uint32_t lfslab_get_total_elems(lfslab_t *slab);
+int32_t lfslab_get_slab_position(lfslab_t *slab, void *ptr);
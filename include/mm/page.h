@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <generated/autoconf.h>
+
+#define PAGE_SIZE CONFIG_MM_PAGE_SIZE
+#define PAGE_MAX_ORDER CONFIG_MM_PAGE_MAX_ORDER
+
+extern char __pages_start[];
+extern char __pages_end[];
+
+int page_alloc_initialize(void *start, uint32_t size);
+/**
+ * Allocates 2^<order> contiguous pages. Blocks are page-aligned, but only aligned to their
+ * size relative to the start of the managed area (__pages_start is not necessarily aligned
+ * to the biggest block size)
+ *
+ * @return Pointer to the first page, NULL if there is no block big enough
+ */
+void *page_alloc(uint8_t order);
+/**
+ * Same as page_alloc(), but the block is filled with zeros. Blocks that were never
+ * used before are not cleared again
+ */
+void *page_alloc_zeroed(uint8_t order);
+void page_free(void *ptr);
+/**
+ * @return Size of the allocated block pointed by <ptr>, 0 if <ptr> is not an allocated block
+ */
+size_t page_get_size(void *ptr);
+uint32_t page_get_available(void);
+
+/**
+ * @return true if <ptr> belongs to the memory area managed by the page allocator
+ */
+static inline bool page_is_managed(void *ptr) {
+    return (char *) ptr >= __pages_start && (char *) ptr < __pages_end;
+}
+
+/**
+ * @return Smallest order able to hold <size> bytes
+ */
+static inline uint8_t page_order_for_size(size_t size) {
+    uint8_t order = 0;
+    while (((size_t) PAGE_SIZE << order) < size) {
+        order++;
+    }
+    return order;
+}
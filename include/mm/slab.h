@@ -7,6 +7,18 @@
 typedef void slab_t;
 
 slab_t *slab_create(uint32_t numelems, size_t elemsize);
+/**
+ * Creates a slab that starts with <chunkelems> elements and grows by chunks of
+ * <chunkelems> elements on demand, up to <maxelems> (which must be a multiple of
+ * <chunkelems>). Chunks are given back to the heap once they are no longer used.
+ * Element positions are stable.
+ */
+slab_t *slab_create_growable(uint32_t chunkelems, uint32_t maxelems, size_t elemsize);
+/**
+ * Same as slab_create(), but the slab is not exposed in sysfs. Meant for
+ * allocators built on top of slabs, which report their own statistics
+ */
+slab_t *slab_create_nosysfs(uint32_t numelems, size_t elemsize);
 void *slab_alloc(slab_t *slab);
 void slab_free(slab_t *slab, void *ptr);
 void slab_destroy(slab_t *slab);
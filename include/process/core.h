@@ -28,16 +28,66 @@ int process_register(pcb_t *pcb);
  * Note: Must be called with _laritos.proc.pcbs_data_lock held
  */
 int process_release_zombie_resources_locked(pcb_t *pcb);
+/**
+ * Releases the stack of a ZOMBIE process that was still live on a cpu when it got killed,
+ * once that cpu has switched away from it (see sched_finish_switch()). Drops the reference
+ * that kept the pcb alive until then and wakes up its parent
+ *
+ * Note: Must be called with no pcbs_data_lock or any lock that comes after it
+ */
+void process_release_switched_out_zombie(pcb_t *pcb);
 void process_unregister_zombie_children(pcb_t *pcb);
+/**
+ * Moves <pcb> to ZOMBIE, whatever its status and cpu are (see sched_move_to_zombie_locked()),
+ * and removes it from the _laritos.proc.pcbs list
+ *
+ * Note: Must be called with no pcbs_lock, _laritos.proc.pcbs_data_lock or any lock that
+ * comes after them
+ */
 void process_kill(pcb_t *pcb);
 /**
- * Note: Must be called with _laritos.proc.pcbs_data_lock held
+ * Note: Must be called with _laritos.proc.pcbs_data_lock held, and no condition spinlock,
+ * pcb or ready queue lock. The process is not removed from the _laritos.proc.pcbs list,
+ * that needs the write side of pcbs_lock (see process_kill())
  */
 void process_kill_locked(pcb_t *pcb);
 void process_kill_and_schedule(pcb_t *pcb);
 int process_set_priority(pcb_t *pcb, uint8_t priority);
+/**
+ * Changes the priority <pcb> is scheduled with, without changing its base priority
+ * (used by the rmutex priority inheritance)
+ *
+ * Note: Must be called with _laritos.proc.pi_lock held
+ */
+void process_apply_priority_locked(pcb_t *pcb, uint8_t priority);
+/**
+ * Restricts the cpus <pcb> is allowed to run on. If the process is on a cpu outside
+ * <affinity>, it is moved to an allowed one (a running process once it gets switched out)
+ *
+ * @param affinity: Mask of allowed cpus (see BIT_FOR_CPU())
+ * @return 0 on success, <0 if <affinity> doesn't include any valid cpu
+ */
+int process_set_affinity(pcb_t *pcb, cpubits_t affinity);
 spctx_t *process_get_current_pcb_stack_context(void);
 pcb_t *process_spawn_kernel_process(char *name, kproc_main_t main, void *data, uint32_t stacksize, uint8_t priority);
+/**
+ * Same as process_spawn_kernel_process(), but the process is restricted to the cpus in
+ * <affinity> from the start, i.e. it never gets queued on any other cpu (see
+ * process_set_affinity())
+ */
+pcb_t *process_spawn_kernel_process_on(char *name, kproc_main_t main, void *data, uint32_t stacksize,
+        uint8_t priority, cpubits_t affinity);
+/**
+ * Spawns a kernel thread, i.e. a kernel process that shares the fd table, cwd and image
+ * of the current process (or of its leader, if the current process is a thread itself).
+ * Only a stack and a pcb are allocated, no fd table or sysfs entries. As any other
+ * child process, the thread must be waited for with process_wait_for()
+ */
+pcb_t *process_spawn_kernel_thread(char *name, kproc_main_t main, void *data, uint32_t stacksize, uint8_t priority);
+/**
+ * Spawns the idle process of cpu <cpuid>, pinned to that cpu
+ */
+pcb_t *idle_launch_on_cpu(uint8_t cpuid);
 void process_exit(int exit_status);
 int process_wait_for(pcb_t *pcb, int *status);
 int process_wait_pid(uint16_t pid, int *status);
@@ -47,13 +97,25 @@ int process_wait_pid(uint16_t pid, int *status);
 uint32_t process_get_avail_stack_locked(pcb_t *pcb);
 
 static inline pcb_t *process_get_current(void) {
-    pcb_t *pcb = CPU_LOCAL_GET(_laritos.sched.running);
+    pcb_t *pcb = cpu_get_thread_ptr();
     assert(pcb != NULL, "Current pcb cannot be NULL, make sure you are running in process mode");
     return pcb;
 }
 
+/**
+ * Returns the process whose fd table and cwd <pcb> uses, i.e. <pcb> itself unless it is a thread
+ */
+static inline pcb_t *process_get_leader(pcb_t *pcb) {
+    return pcb->leader != NULL ? pcb->leader : pcb;
+}
+
+/**
+ * Note: Must be called with irqs disabled
+ */
 static inline void process_set_current(pcb_t *pcb) {
-    CPU_LOCAL_SET(_laritos.sched.running, pcb);
+    // Kept in the per-cpu array as well, so that other cpus can check what this one is running
+    *CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.running) = pcb;
+    cpu_set_thread_ptr(pcb);
 }
 
 static inline void process_set_current_pcb_stack_context(spctx_t *spctx) {
@@ -70,7 +132,7 @@ static inline void process_set_name(pcb_t *pcb, char *name) {
 }
 
 /**
- * NOTE: Must be called with pcbs_lock held
+ * NOTE: Must be called with pcbs_lock held (the read side is enough)
  */
 #define for_each_process_locked(_p) \
     list_for_each_entry(_p, &_laritos.proc.pcbs, sched.pcb_node)
@@ -87,14 +149,3 @@ static inline void process_set_name(pcb_t *pcb, char *name) {
 #define for_each_child_process_safe_locked(_parent, _child, _temp) \
     list_for_each_entry_safe(_child, _temp, &_parent->children, siblings)
 
-/**
- * NOTE: Must be called with pcbs_data_lock held
- */
-#define for_each_ready_process_locked(_p) \
-    list_for_each_entry(_p, CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.ready_pcbs), sched.sched_node)
-
-/**
- * NOTE: Must be called with pcbs_data_lock held
- */
-#define for_each_ready_process_safe_locked(_p, _n) \
-    list_for_each_entry_safe(_p, _n, CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.ready_pcbs), sched.sched_node)
@@ -6,13 +6,16 @@
 #include <string.h>
 
 #include <dstruct/list.h>
+#include <dstruct/rbtree.h>
 #include <core.h>
+#include <cpu/core.h>
 #include <refcount.h>
 #include <mm/slab.h>
 #include <process/status.h>
 #include <time/tick.h>
 #include <sync/atomic.h>
 #include <sync/condition.h>
+#include <sync/spinlock.h>
 #include <syscall/syscall-no.h>
 #include <fs/vfs/types.h>
 #include <generated/autoconf.h>
@@ -40,7 +43,16 @@ typedef struct {
 
 typedef struct {
     process_status_t status;
+    /**
+     * Priority the process is scheduled with. It may be temporarily higher (i.e. lower
+     * number) than <base_priority> while the process owns an rmutex a higher priority
+     * process is waiting for (priority inheritance)
+     */
     uint8_t priority;
+    /**
+     * Priority set with process_set_priority()
+     */
+    uint8_t base_priority;
 
     /**
      * Monotonic start time in nano seconds
@@ -60,6 +72,67 @@ typedef struct {
      * event has any).
      */
     list_head_t sched_node;
+
+    /**
+     * Lock protecting the blocked list <sched_node> is linked to, if the process is BLOCKED
+     * on one (e.g. the spinlock of a condition)
+     */
+    spinlock_t *blocked_spin;
+
+    /**
+     * Priority inheritance state, protected by _laritos.proc.pi_lock:
+     *      - pi_blocked_on: rmutex the process is waiting for (if any)
+     *      - pi_node: Node used to link the process to the waiters of <pi_blocked_on>
+     *      - pi_mutexes: Contended rmutexes owned by the process
+     */
+    struct rmutex *pi_blocked_on;
+    list_head_t pi_node;
+    list_head_t pi_mutexes;
+
+    /**
+     * Address the process is waiting on in a futex (NULL if none). Protected by the lock
+     * of the futex hash bucket (see include/sync/futex.h)
+     */
+    volatile int32_t *futex_addr;
+
+    /**
+     * Number of ticks left in the current time slice of a RUNNING process
+     */
+    tick_t quantum_left;
+
+    /**
+     * Cpu whose ready queue holds the process (if READY), or where it last ran
+     */
+    uint8_t cpu;
+
+    /**
+     * Set while the process context lives on a cpu, i.e. from the moment it starts RUNNING
+     * until the switch to another process completes. A process cannot be moved to another
+     * cpu before its context has been saved.
+     * For a ZOMBIE, it is cleared with _laritos.proc.pcbs_data_lock held once its stack is
+     * released (see process_release_switched_out_zombie())
+     */
+    bool on_cpu;
+
+    /**
+     * Cpus the process is allowed to run on (see BIT_FOR_CPU()), CPU_ALL_MASK by default
+     */
+    cpubits_t affinity;
+
+#ifdef CONFIG_SCHED_CFS
+    /**
+     * Node used to link a process to a fair READY queue (used instead of sched_node)
+     */
+    rbnode_t fair_node;
+    /**
+     * Running time weighted by priority, in 1/1024th of a tick of a default priority process
+     */
+    uint64_t vruntime;
+    /**
+     * Value of stats.ticks_spent[PROC_STATUS_RUNNING] already accounted in vruntime
+     */
+    tick_t vruntime_ticks;
+#endif
 } pcb_sched_t;
 
 typedef struct {
@@ -73,6 +146,12 @@ typedef struct {
 } pcb_stats_t;
 
 typedef struct pcb {
+    /**
+     * Protects the scheduling state of the process that can be changed from any cpu
+     * (BLOCKED transitions, priority, affinity). See the lock ordering in include/core.h
+     */
+    spinlock_t lock;
+
     uint16_t pid;
     char name[CONFIG_PROCESS_MAX_NAME_LEN];
     bool kernel;
@@ -86,6 +165,12 @@ typedef struct pcb {
 
     int exit_status;
 
+    /**
+     * Process whose fd table, cwd and image are shared by this kernel thread (NULL for a
+     * regular process). See process_spawn_kernel_thread()
+     */
+    struct pcb *leader;
+
     struct pcb *parent;
     condition_t parent_waiting_cond;
     list_head_t children;
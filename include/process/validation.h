@@ -4,14 +4,17 @@
 #include <sched/context.h>
 
 /**
- * NOTE: Must be called with pcbs_data_lock held
+ * NOTE: The process must not be able to run or exit while being checked (e.g. hold
+ * pcbs_data_lock or the lock of the ready queue it is in)
  */
 bool process_is_valid_kernel_exec_addr_locked(void *addr);
 /**
- * NOTE: Must be called with pcbs_data_lock held
+ * NOTE: The process must not be able to run or exit while being checked (e.g. hold
+ * pcbs_data_lock or the lock of the ready queue it is in)
  */
 bool process_is_valid_exec_addr_locked(pcb_t *pcb, void *addr);
 /**
- * NOTE: Must be called with pcbs_data_lock held
+ * NOTE: The process must not be able to run or exit while being checked (e.g. hold
+ * pcbs_data_lock or the lock of the ready queue it is in)
  */
 bool process_is_valid_context_locked(pcb_t *pcb, spctx_t *ctx);
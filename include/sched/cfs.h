@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <process/types.h>
+#include <sched/types.h>
+
+/**
+ * Completely fair scheduling support for the per-cpu ready queues (see core/sched/cfs.c)
+ *
+ * Note: All these functions must be called with the lock of <rq> held
+ */
+
+void sched_cfs_enqueue_locked(sched_runqueue_t *rq, pcb_t *pcb);
+void sched_cfs_dequeue_locked(sched_runqueue_t *rq, pcb_t *pcb);
+bool sched_cfs_should_preempt_locked(sched_runqueue_t *rq, pcb_t *curpcb, pcb_t *pcb);
+
+/**
+ * @return Weight of a process with the given priority, 1024 for the default user priority.
+ *         A process gets a share of the cpu proportional to its weight
+ */
+uint32_t sched_cfs_get_weight(uint8_t priority);
+
+/**
+ * @return READY process with the smallest virtual runtime, NULL if the queue is empty
+ */
+static inline pcb_t *sched_cfs_first_locked(sched_runqueue_t *rq) {
+    return rbtree_first_entry_or_null(&rq->vtree, pcb_t, sched.fair_node);
+}
@@ -2,25 +2,53 @@
 
 #include <log.h>
 #include <core.h>
+#include <cpu/core.h>
 #include <cpu/cpu-local.h>
+#include <cpu/smp.h>
 #include <process/core.h>
 #include <process/status.h>
 #include <sync/condition.h>
 #include <sync/spinlock.h>
 #include <time/system-tick.h>
 #include <irq/core.h>
+#include <dstruct/bitset.h>
+#include <utils/utils.h>
+#ifdef CONFIG_SCHED_CFS
+#include <sched/cfs.h>
+#endif
 
 void schedule(void);
 void sched_execute_first_system_proc(pcb_t *pcb);
 
+struct cpu;
+/**
+ * Lets the scheduler of <c> prepare the cpu ready queue before it starts scheduling
+ */
+int sched_attach_cpu(struct cpu *c);
+
+/**
+ * Lets other cpus pick the process this cpu switched away from, once its context is saved.
+ * Runs right after a context switch, or on the first schedule()/irq of a process that
+ * started executing from scratch
+ *
+ * NOTE: Must be called with irqs disabled
+ */
+void sched_finish_switch(void);
+
 static inline void schedule_if_needed(void) {
     irqctx_t ctx;
     irq_disable_local_and_save_ctx(&ctx);
 
-    // Check whether we need to schedule
-    if (_laritos.sched.need_sched && _laritos.process_mode) {
+    if (_laritos.process_mode) {
+        sched_finish_switch();
+    }
+
+    // Check whether we need to schedule. If preemption is disabled, the flag is kept set
+    // and preempt_enable() takes care of it
+    bool *need_sched = CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.need_sched);
+    if (*need_sched && _laritos.process_mode && *CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.preempt_count) == 0) {
         insane_async("Re-schedule needed");
-        _laritos.sched.need_sched = false;
+        *need_sched = false;
         schedule();
     }
 
@@ -28,7 +56,35 @@ static inline void schedule_if_needed(void) {
 }
 
 /**
- * Must be called with _laritos.proc.pcbs_data_lock held
+ * Keeps the current process running on this cpu until the matching preempt_enable().
+ * Irqs are still served, but any re-schedule they request is deferred until then.
+ * Calls can be nested.
+ *
+ * NOTE: The process must not block nor call schedule() while preemption is disabled
+ */
+static inline void preempt_disable(void) {
+    irqctx_t ctx;
+    irq_disable_local_and_save_ctx(&ctx);
+    (*CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.preempt_count))++;
+    irq_local_restore_ctx(&ctx);
+}
+
+static inline void preempt_enable(void) {
+    irqctx_t ctx;
+    irq_disable_local_and_save_ctx(&ctx);
+    uint32_t *count = CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.preempt_count);
+    (*count)--;
+    bool resched = *count == 0 && *CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.need_sched);
+    irq_local_restore_ctx(&ctx);
+    // Irq handlers and spinlock holders (irqs disabled) leave it for later
+    if (resched && irq_is_enabled_in_ctx(&ctx)) {
+        schedule_if_needed();
+    }
+}
+
+/**
+ * Must be called with the lock of <pcb> and the lock of its ready queue held (see
+ * sched_pcb_rq_lock())
  */
 static inline void sched_update_stats_locked(pcb_t *pcb) {
     tick_t delta = tick_get_os_ticks() - pcb->stats.last_status_change;
@@ -36,64 +92,443 @@ static inline void sched_update_stats_locked(pcb_t *pcb) {
     pcb->stats.last_status_change = tick_get_os_ticks();
 }
 
-static inline void sched_update_stats(pcb_t *pcb) {
-    irqctx_t ctx;
-    spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
-    sched_update_stats_locked(pcb);
-    spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
+/**
+ * @return Time slice, in ticks, for a process with the given priority
+ */
+static inline tick_t sched_get_quantum(uint8_t priority) {
+    if (priority < CONFIG_SCHED_PRIORITY_MAX_USER) {
+        return CONFIG_SCHED_QUANTUM_KERNEL;
+    }
+    if (priority < CONFIG_SCHED_PRIORITY_USER_DEFAULT) {
+        return CONFIG_SCHED_QUANTUM_USER_HIGH;
+    }
+    return CONFIG_SCHED_QUANTUM_USER;
+}
+
+static inline void sched_rq_init(sched_runqueue_t *rq) {
+    int i;
+    for (i = 0; i < ARRAYSIZE(rq->queues); i++) {
+        INIT_LIST_HEAD(&rq->queues[i]);
+    }
+    for (i = 0; i < ARRAYSIZE(rq->prio_map); i++) {
+        rq->prio_map[i] = 0;
+    }
+    rq->summary = 0;
+    rq->nready = 0;
+    spinlock_init_class(&rq->lock, LOCK_CLASS_RQ);
+#ifdef CONFIG_SCHED_CFS
+    rq->fair = false;
+    rbtree_init(&rq->vtree);
+    rq->min_vruntime = 0;
+#endif
 }
 
 /**
- * Adds a READY process in the ready queue sorted in ascending order by priority number
- * (i.e. highest priority process are first in the list).
- * If two or more processes share the same priority, the new pcb will be added next to the
- * last process with that priority.
+ * Note: Must be called with irqs disabled. The contents of the queue can only be accessed
+ * with its lock held
  *
- * Note: Must be called with _laritos.proc.pcbs_data_lock held
+ * @return Ready queue of the current cpu
+ */
+static inline sched_runqueue_t *sched_get_rq_locked(void) {
+    return CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.rq);
+}
+
+/**
+ * Note: The contents of the queue can only be accessed with its lock held
+ *
+ * @return Ready queue of cpu <cpuid>
+ */
+static inline sched_runqueue_t *sched_get_rq_of_cpu_locked(uint8_t cpuid) {
+    return CPU_LOCAL_GET_PTR_FOR_CPU(_laritos.sched.rq, cpuid);
+}
+
+/**
+ * Locks the ready queue of cpu <cpuid>
  *
- * @param pcb: Process to add
- * @return void
+ * @return Locked ready queue
  */
-static inline void _sched_add_ready_proc_sorted_locked(pcb_t *pcb) {
+static inline sched_runqueue_t *sched_rq_lock(uint8_t cpuid, irqctx_t *ctx) {
+    sched_runqueue_t *rq = sched_get_rq_of_cpu_locked(cpuid);
+    spinlock_acquire(&rq->lock, ctx);
+    return rq;
+}
+
+static inline void sched_rq_unlock(sched_runqueue_t *rq, irqctx_t *ctx) {
+    spinlock_release(&rq->lock, ctx);
+}
+
+/**
+ * Locks the ready queues of cpus <a> and <b> (which may be the same), lowest cpu id first
+ */
+static inline void sched_rq_double_lock(uint8_t a, uint8_t b, irqctx_t *actx, irqctx_t *bctx) {
+    if (a == b) {
+        sched_rq_lock(a, actx);
+    } else if (a < b) {
+        sched_rq_lock(a, actx);
+        spinlock_acquire_nested(&sched_get_rq_of_cpu_locked(b)->lock, bctx);
+    } else {
+        sched_rq_lock(b, bctx);
+        spinlock_acquire_nested(&sched_get_rq_of_cpu_locked(a)->lock, actx);
+    }
+}
+
+static inline void sched_rq_double_unlock(uint8_t a, uint8_t b, irqctx_t *actx, irqctx_t *bctx) {
+    if (a == b) {
+        sched_rq_unlock(sched_get_rq_of_cpu_locked(a), actx);
+    } else if (a < b) {
+        sched_rq_unlock(sched_get_rq_of_cpu_locked(b), bctx);
+        sched_rq_unlock(sched_get_rq_of_cpu_locked(a), actx);
+    } else {
+        sched_rq_unlock(sched_get_rq_of_cpu_locked(a), actx);
+        sched_rq_unlock(sched_get_rq_of_cpu_locked(b), bctx);
+    }
+}
+
+/**
+ * Locks <pcb> and the ready queue of the cpu it belongs to, which freezes its whole
+ * scheduling state
+ *
+ * @return Locked ready queue of <pcb>
+ */
+static inline sched_runqueue_t *sched_pcb_rq_lock(pcb_t *pcb, irqctx_t *pcbctx, irqctx_t *rqctx) {
+    spinlock_acquire(&pcb->lock, pcbctx);
+    while (1) {
+        uint8_t cpuid = pcb->sched.cpu;
+        sched_runqueue_t *rq = sched_rq_lock(cpuid, rqctx);
+        // A READY process may have been migrated while we were waiting for the queue
+        if (pcb->sched.cpu == cpuid) {
+            return rq;
+        }
+        sched_rq_unlock(rq, rqctx);
+    }
+}
+
+static inline void sched_pcb_rq_unlock(pcb_t *pcb, sched_runqueue_t *rq, irqctx_t *pcbctx, irqctx_t *rqctx) {
+    sched_rq_unlock(rq, rqctx);
+    spinlock_release(&pcb->lock, pcbctx);
+}
+
+/**
+ * Adds <pcb> at the end of the FIFO queue of its priority
+ *
+ * Note: Must be called with the lock of <rq> held
+ */
+static inline void sched_rq_enqueue_locked(sched_runqueue_t *rq, pcb_t *pcb) {
+#ifdef CONFIG_SCHED_CFS
+    if (rq->fair) {
+        sched_cfs_enqueue_locked(rq, pcb);
+        return;
+    }
+#endif
+    uint8_t prio = pcb->sched.priority;
+    list_add_tail(&pcb->sched.sched_node, &rq->queues[prio]);
+    bitset_lm_set(&rq->prio_map[prio / BITSET_NBITS], prio % BITSET_NBITS);
+    bitset_lm_set(&rq->summary, prio / BITSET_NBITS);
+    rq->nready++;
+}
+
+/**
+ * Removes <pcb> from the queue of its priority. Nothing is done if the process wasn't queued
+ *
+ * Note: Must be called with the lock of <rq> held
+ */
+static inline void sched_rq_dequeue_locked(sched_runqueue_t *rq, pcb_t *pcb) {
+#ifdef CONFIG_SCHED_CFS
+    if (rq->fair) {
+        sched_cfs_dequeue_locked(rq, pcb);
+        return;
+    }
+#endif
+    if (list_empty(&pcb->sched.sched_node)) {
+        return;
+    }
     list_del_init(&pcb->sched.sched_node);
-    pcb_t *proc;
-    for_each_ready_process_locked(proc) {
-        if (pcb->sched.priority < proc->sched.priority) {
-            list_add(&pcb->sched.sched_node, proc->sched.sched_node.prev);
+    rq->nready--;
+
+    uint8_t prio = pcb->sched.priority;
+    if (list_empty(&rq->queues[prio])) {
+        bitset_t *map = &rq->prio_map[prio / BITSET_NBITS];
+        bitset_lm_clear(map, prio % BITSET_NBITS);
+        if (*map == 0) {
+            bitset_lm_clear(&rq->summary, prio / BITSET_NBITS);
+        }
+    }
+}
+
+/**
+ * Note: Must be called with the lock of <rq> held
+ *
+ * @return Highest priority READY process (the oldest one if several share the same
+ *         priority), NULL if the queue is empty
+ */
+static inline pcb_t *sched_rq_first_locked(sched_runqueue_t *rq) {
+#ifdef CONFIG_SCHED_CFS
+    if (rq->fair) {
+        return sched_cfs_first_locked(rq);
+    }
+#endif
+    uint8_t i = bitset_ffs(rq->summary);
+    if (i == BITSET_IDX_NOT_FOUND) {
+        return NULL;
+    }
+    uint32_t prio = i * BITSET_NBITS + bitset_ffs(rq->prio_map[i]);
+    return list_first_entry(&rq->queues[prio], pcb_t, sched.sched_node);
+}
+
+/**
+ * @return true if the affinity of <pcb> allows it to run on cpu <cpuid>
+ */
+static inline bool sched_can_run_on(pcb_t *pcb, uint8_t cpuid) {
+    return (pcb->sched.affinity & BIT_FOR_CPU(cpuid)) != 0;
+}
+
+/**
+ * @return true if <pcb> can be moved to the ready queue of cpu <cpuid>, i.e. its affinity
+ *         allows it and its context isn't still live on the cpu it last ran on
+ */
+static inline bool sched_can_migrate_to(pcb_t *pcb, uint8_t cpuid) {
+    return !pcb->sched.on_cpu && sched_can_run_on(pcb, cpuid);
+}
+
+/**
+ * Note: Must be called with the lock of <rq> held
+ *
+ * @return First READY process in scheduling order that can be migrated to cpu <cpuid>
+ *         (see sched_can_migrate_to()), NULL if there is none
+ */
+static inline pcb_t *sched_rq_first_migratable_locked(sched_runqueue_t *rq, uint8_t cpuid) {
+    pcb_t *pcb;
+#ifdef CONFIG_SCHED_CFS
+    if (rq->fair) {
+        rbnode_t *n;
+        for (n = rbtree_first(&rq->vtree); n != NULL; n = rbtree_next(n)) {
+            pcb = rbtree_entry(n, pcb_t, sched.fair_node);
+            if (sched_can_migrate_to(pcb, cpuid)) {
+                return pcb;
+            }
+        }
+        return NULL;
+    }
+#endif
+    int prio;
+    for (prio = 0; prio < SCHED_NUM_PRIORITIES; prio++) {
+        list_for_each_entry(pcb, &rq->queues[prio], sched.sched_node) {
+            if (sched_can_migrate_to(pcb, cpuid)) {
+                return pcb;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Note: Must be called with the lock of <rq> held
+ *
+ * @return true if the ready process <pcb> should take the cpu from the running <curpcb>,
+ *         i.e. <pcb> has the same or higher priority (or, for a fair queue, <curpcb> got
+ *         ahead of <pcb> in virtual runtime)
+ */
+static inline bool sched_rq_should_preempt_locked(sched_runqueue_t *rq, pcb_t *curpcb, pcb_t *pcb) {
+#ifdef CONFIG_SCHED_CFS
+    if (rq->fair) {
+        return sched_cfs_should_preempt_locked(rq, curpcb, pcb);
+    }
+#endif
+    return curpcb->sched.priority >= pcb->sched.priority;
+}
+
+/**
+ * Note: Must be called with the lock of <rq> held
+ *
+ * @return true if <pcb>, which just became ready, should interrupt the time slice of the
+ *         running <curpcb>, i.e. <pcb> has a strictly higher priority
+ */
+static inline bool sched_rq_wakeup_preempts_locked(sched_runqueue_t *rq, pcb_t *curpcb, pcb_t *pcb) {
+#ifdef CONFIG_SCHED_CFS
+    if (rq->fair) {
+        return sched_cfs_should_preempt_locked(rq, curpcb, pcb);
+    }
+#endif
+    return pcb->sched.priority < curpcb->sched.priority;
+}
+
+/**
+ * Unlinks the process from the ready queue or the blocked list it is currently in
+ *
+ * Note: Must be called with the lock of the ready queue of <pcb> held, plus the lock
+ * protecting the blocked list if the process is BLOCKED on one
+ */
+static inline void _sched_unlink_locked(pcb_t *pcb) {
+    if (pcb->sched.status == PROC_STATUS_READY) {
+        sched_rq_dequeue_locked(sched_get_rq_of_cpu_locked(pcb->sched.cpu), pcb);
+    } else {
+        list_del_init(&pcb->sched.sched_node);
+    }
+}
+
+/**
+ * Asks cpu <cpuid> to run the scheduler. A remote cpu is interrupted right away
+ *
+ * Note: Can be called with any lock held, the flag is only cleared by <cpuid> itself
+ */
+static inline void sched_request_resched_locked(uint8_t cpuid) {
+    *CPU_LOCAL_GET_PTR_FOR_CPU(_laritos.sched.need_sched, cpuid) = true;
+#ifdef CONFIG_SMP
+    if (cpuid != cpu_get_id() && (_laritos.sched.online & BIT_FOR_CPU(cpuid))) {
+        smp_send_resched(cpuid);
+    }
+#endif
+}
+
+#ifdef CONFIG_SMP
+/**
+ * Wakes up an idle cpu (other than <busy>) allowed to run <pcb>, so that it steals the
+ * process from the queue of <busy>
+ *
+ * Note: The process running on each cpu is checked without taking their queue locks, at
+ * worst a busy cpu gets a spurious re-schedule request
+ */
+static inline void sched_kick_idle_cpu_locked(pcb_t *pcb, uint8_t busy) {
+    uint8_t i;
+    for (i = 0; i < CONFIG_CPU_MAX_CPUS; i++) {
+        if (i == busy || !(_laritos.sched.online & BIT_FOR_CPU(i)) || !sched_can_run_on(pcb, i)) {
+            continue;
+        }
+        pcb_t *running = *CPU_LOCAL_GET_PTR_FOR_CPU(_laritos.sched.running, i);
+        if (running == *CPU_LOCAL_GET_PTR_FOR_CPU(_laritos.sched.idle, i)) {
+            sched_request_resched_locked(i);
             return;
         }
     }
-    list_add_tail(&pcb->sched.sched_node, CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.ready_pcbs));
 }
+#endif
 
 /**
- * Note: Must be called with _laritos.proc.pcbs_data_lock held
+ * Moves <pcb> to the ready queue of cpu <cpuid>
+ *
+ * Note: Must be called with the lock of the ready queue of <cpuid> held. Unless <pcb> is
+ * the RUNNING process of <cpuid>, the lock of <pcb> must be held as well
  */
-static inline void sched_move_to_ready_locked(pcb_t *pcb) {
+static inline void sched_move_to_ready_on_cpu_locked(pcb_t *pcb, uint8_t cpuid) {
     if (pcb->sched.status == PROC_STATUS_ZOMBIE) {
         error_async("Cannot move a ZOMBIE process to READY");
         return;
     }
-    insane_async("PID %u: %s -> READY", pcb->pid, pcb_get_status_str(pcb->sched.status));
+    insane_async("PID %u: %s -> READY (cpu #%u)", pcb->pid, pcb_get_status_str(pcb->sched.status), cpuid);
 
     sched_update_stats_locked(pcb);
 
-    _sched_add_ready_proc_sorted_locked(pcb);
+    sched_runqueue_t *rq = sched_get_rq_of_cpu_locked(cpuid);
+    _sched_unlink_locked(pcb);
+    pcb->sched.blocked_spin = NULL;
+    pcb->sched.cpu = cpuid;
+    sched_rq_enqueue_locked(rq, pcb);
     pcb->sched.status = PROC_STATUS_READY;
 
     // Re-schedule in case there is a new higher priority process
-    if (list_first_entry(CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.ready_pcbs), pcb_t, sched.sched_node) == pcb) {
-        _laritos.sched.need_sched = true;
+    pcb_t *cur = *CPU_LOCAL_GET_PTR_FOR_CPU(_laritos.sched.running, cpuid);
+    if (sched_rq_first_locked(rq) == pcb && (cur == NULL || cur->sched.status != PROC_STATUS_RUNNING ||
+                sched_rq_wakeup_preempts_locked(rq, cur, pcb))) {
+        sched_request_resched_locked(cpuid);
+        return;
+    }
+
+    if (sched_rq_first_locked(rq) == pcb) {
+        // Let the running process finish its time slice
+        atomic32_inc(&_laritos.stats.avoided_switches);
+    }
+#ifdef CONFIG_SMP
+    // <pcb> has to wait, let an idle cpu take it instead
+    if (!pcb->sched.on_cpu) {
+        sched_kick_idle_cpu_locked(pcb, cpuid);
     }
+#endif
 }
 
+/**
+ * Note: Must be called with the lock of <pcb> held
+ *
+ * @return Cpu whose ready queue should get <pcb>: the current one if the affinity of
+ *         <pcb> allows it, otherwise the one it last ran on or the first allowed cpu
+ */
+static inline uint8_t sched_select_cpu_locked(pcb_t *pcb) {
+    uint8_t cpuid = cpu_get_id();
+    if (sched_can_run_on(pcb, cpuid)) {
+        return cpuid;
+    }
+    if (sched_can_run_on(pcb, pcb->sched.cpu)) {
+        return pcb->sched.cpu;
+    }
+    return (uint8_t) __builtin_ctz(pcb->sched.affinity);
+}
+
+/**
+ * Wakes up a BLOCKED (or not yet started) process by moving it to the ready queue of the
+ * cpu picked by sched_select_cpu_locked(). A process whose context is still live on a cpu
+ * (i.e. it blocked but didn't switch out yet) stays on that cpu.
+ *
+ * Note: If the process is BLOCKED on a list, it must have been unlinked from it by the
+ * caller. Must not be called with <pcb> or any ready queue locked
+ *
+ * @return true if the process was woken up, false if it wasn't BLOCKED nor NOT_INIT
+ */
+static inline bool sched_wake_up(pcb_t *pcb) {
+    irqctx_t pcbctx;
+    spinlock_acquire(&pcb->lock, &pcbctx);
+    if (pcb->sched.status != PROC_STATUS_BLOCKED && pcb->sched.status != PROC_STATUS_NOT_INIT) {
+        spinlock_release(&pcb->lock, &pcbctx);
+        return false;
+    }
+
+    uint8_t cpuid = pcb->sched.on_cpu ? pcb->sched.cpu : sched_select_cpu_locked(pcb);
+    irqctx_t rqctx;
+    sched_runqueue_t *rq = sched_rq_lock(cpuid, &rqctx);
+    sched_move_to_ready_on_cpu_locked(pcb, cpuid);
+    sched_pcb_rq_unlock(pcb, rq, &pcbctx, &rqctx);
+    return true;
+}
+
+/**
+ * Moves the READY <pcb> to the ready queue of cpu <cpuid>. For fair queues, the process
+ * keeps its virtual runtime lag relative to the queue it leaves
+ *
+ * Note: Must be called with the locks of both ready queues held (see sched_rq_double_lock())
+ * and <pcb> not on_cpu
+ */
+static inline void sched_migrate_locked(pcb_t *pcb, uint8_t cpuid) {
+    sched_runqueue_t *from = sched_get_rq_of_cpu_locked(pcb->sched.cpu);
+    sched_runqueue_t *to = sched_get_rq_of_cpu_locked(cpuid);
+    insane_async("PID %u: cpu #%u -> cpu #%u", pcb->pid, pcb->sched.cpu, cpuid);
+
+    sched_rq_dequeue_locked(from, pcb);
+#ifdef CONFIG_SCHED_CFS
+    if (from->fair && to->fair) {
+        pcb->sched.vruntime = pcb->sched.vruntime - from->min_vruntime + to->min_vruntime;
+    }
+#endif
+    pcb->sched.cpu = cpuid;
+    sched_rq_enqueue_locked(to, pcb);
+}
+
+/**
+ * Moves <pcb> to a cpu allowed by its affinity if the current one isn't: right away if
+ * it is READY, or by re-scheduling its cpu if it is RUNNING (a BLOCKED process will pick
+ * an allowed cpu when it wakes up)
+ *
+ * Note: Must not be called with any ready queue locked
+ */
+void sched_apply_affinity(pcb_t *pcb);
+
 /**
  * @param blocked_list: List associated with the event the process is waiting for (may be
  *        NULL is the event doesn't keep any list)
+ * @param blocked_spin: Lock protecting <blocked_list>, needed to unlink the process if it
+ *        gets killed while BLOCKED
  *
- * Note: Must be called with _laritos.proc.pcbs_data_lock held
+ * Note: Must be called with the lock of <pcb> and the lock of its ready queue held, plus
+ * <blocked_spin> if not NULL
  */
-static inline void sched_move_to_blocked_locked(pcb_t *pcb, list_head_t *blocked_list) {
+static inline void sched_move_to_blocked_locked(pcb_t *pcb, list_head_t *blocked_list, spinlock_t *blocked_spin) {
     if (pcb->sched.status == PROC_STATUS_ZOMBIE || pcb->sched.status == PROC_STATUS_NOT_INIT) {
         error_async("Cannot move a ZOMBIE or NOT_INIT process to BLOCKED");
         return;
@@ -102,15 +537,32 @@ static inline void sched_move_to_blocked_locked(pcb_t *pcb, list_head_t *blocked
 
     sched_update_stats_locked(pcb);
 
-    list_del_init(&pcb->sched.sched_node);
+    _sched_unlink_locked(pcb);
     if (blocked_list != NULL) {
         list_add_tail(&pcb->sched.sched_node, blocked_list);
+        pcb->sched.blocked_spin = blocked_spin;
     }
     pcb->sched.status = PROC_STATUS_BLOCKED;
 }
 
 /**
- * Note: Must be called with _laritos.proc.pcbs_data_lock held
+ * Blocks the current process without linking it to any list, it is up to the caller to
+ * make sure someone will wake it up with sched_wake_up(). The process keeps running until
+ * the next call to schedule()
+ *
+ * Note: Must not be called with the lock of the current process or any ready queue held
+ */
+static inline void sched_block_current(void) {
+    pcb_t *pcb = process_get_current();
+    irqctx_t pcbctx;
+    irqctx_t rqctx;
+    sched_runqueue_t *rq = sched_pcb_rq_lock(pcb, &pcbctx, &rqctx);
+    sched_move_to_blocked_locked(pcb, NULL, NULL);
+    sched_pcb_rq_unlock(pcb, rq, &pcbctx, &rqctx);
+}
+
+/**
+ * Note: Must be called with the lock of the ready queue of the current cpu held
  */
 static inline void sched_move_to_running_locked(pcb_t *pcb) {
     if (pcb->sched.status != PROC_STATUS_READY) {
@@ -121,40 +573,20 @@ static inline void sched_move_to_running_locked(pcb_t *pcb) {
 
     sched_update_stats_locked(pcb);
 
-    list_del_init(&pcb->sched.sched_node);
+    _sched_unlink_locked(pcb);
     pcb->sched.status = PROC_STATUS_RUNNING;
+    pcb->sched.cpu = cpu_get_id();
+    pcb->sched.on_cpu = true;
+    pcb->sched.quantum_left = sched_get_quantum(pcb->sched.priority);
     process_set_current(pcb);
 }
 
 /**
- * Note: Must be called with _laritos.proc.pcbs_data_lock held
+ * Unlinks the process from the scheduler, re-parents its children to its parent and
+ * notifies the parent. Any process can be killed, regardless of its status and cpu (a
+ * process RUNNING on another cpu stops as soon as that cpu re-schedules)
+ *
+ * Note: Must be called with _laritos.proc.pcbs_data_lock held, and no condition spinlock,
+ * pcb or ready queue lock
  */
-static inline void sched_move_to_zombie_locked(pcb_t *pcb) {
-    insane_async("PID %u: %s -> ZOMBIE ", pcb->pid, pcb_get_status_str(pcb->sched.status));
-
-    sched_update_stats_locked(pcb);
-
-    pcb_t *child;
-    pcb_t *temp;
-    pcb_t *gparent = pcb->parent;
-
-    // Grandparent will become the new parent
-    for_each_child_process_safe_locked(pcb, child, temp) {
-        insane_async("pid=%u new parent pid=%u", child->pid, gparent->pid);
-        child->parent = gparent;
-        list_move_tail(&child->siblings, &gparent->children);
-    }
-
-    list_del_init(&pcb->sched.sched_node);
-    pcb->sched.status = PROC_STATUS_ZOMBIE;
-
-    process_release_zombie_resources_locked(pcb);
-
-    // Notify blocked parent (if any) about its dead
-    condition_notify_locked(&pcb->parent_waiting_cond);
-
-    if (gparent == _laritos.proc.init) {
-        // New zombie process child of init, wake up init so that it releases its resources
-        sched_move_to_ready_locked(_laritos.proc.init);
-    }
-}
+void sched_move_to_zombie_locked(pcb_t *pcb);
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <dstruct/list.h>
+#include <dstruct/bitset.h>
+#include <dstruct/rbtree.h>
+#include <sync/spinlock.h>
+#include <sync/atomic.h>
+#include <generated/autoconf.h>
+
+#define SCHED_NUM_PRIORITIES (CONFIG_SCHED_PRIORITY_LOWEST + 1)
+#define SCHED_PRIOMAP_LEN ((SCHED_NUM_PRIORITIES + BITSET_NBITS - 1) / BITSET_NBITS)
+
+/**
+ * Per-cpu queue of READY processes.
+ *
+ * There is one FIFO list per priority level, plus a two-level bitmap telling which levels
+ * are not empty: bit n (left-most numbering) of prio_map[i] is set if queues[i * 32 + n]
+ * has any process, and bit i of summary is set if prio_map[i] != 0. Finding the highest
+ * priority ready process takes two clz instructions, regardless of the number of processes.
+ *
+ * When the cpu is driven by the cfs scheduler, the priority queues are left empty and the
+ * READY processes are kept in <vtree> instead, sorted by weighted virtual runtime.
+ *
+ * Protected by <lock> (see the lock ordering in include/core.h)
+ */
+typedef struct {
+    spinlock_t lock;
+    bitset_t summary;
+    bitset_t prio_map[SCHED_PRIOMAP_LEN];
+    list_head_t queues[SCHED_NUM_PRIORITIES];
+    uint32_t nready;
+#ifdef CONFIG_SCHED_CFS
+    bool fair;
+    rbtree_t vtree;
+    /**
+     * Monotonic lower bound of the virtual runtime of the processes in the queue, used
+     * to place new and waking processes
+     */
+    uint64_t min_vruntime;
+#endif
+} sched_runqueue_t;
+
+struct work;
+typedef void (*work_func_t)(struct work *work);
+
+/**
+ * Deferred work item, see include/sched/workqueue.h
+ */
+typedef struct work {
+    work_func_t func;
+    void *data;
+    /**
+     * Next item in the queue of the cpu the work is pending on
+     */
+    struct work *next;
+    /**
+     * Non-zero while the work is queued and not yet picked up by a worker
+     */
+    atomic32_t pending;
+} work_t;
+
+/**
+ * Per-cpu FIFO of deferred work.
+ *
+ * Only accessed by its own cpu with irqs disabled (the same way as the per-cpu
+ * need_sched flag), hence it doesn't need any lock: irq handlers queue work on the
+ * cpu they run on and the workers of that cpu are pinned to it
+ */
+typedef struct {
+    work_t *head;
+    work_t *tail;
+    struct pcb *workers[CONFIG_SCHED_WORKQUEUE_WORKERS];
+    /**
+     * Set while the corresponding worker is blocked waiting for work (and only then it
+     * can be woken up, a worker may also block inside a work function)
+     */
+    bool waiting[CONFIG_SCHED_WORKQUEUE_WORKERS];
+} sched_workqueue_t;
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sched/types.h>
+#include <sync/atomic.h>
+
+/**
+ * Deferred work (bottom halves).
+ *
+ * Irq handlers (or any other context) queue a work_t on the cpu they run on, and the worker
+ * processes of that cpu run it later in process mode, with irqs enabled and preemptible.
+ * This keeps the time spent with irqs disabled short, the same way need_sched defers a
+ * schedule() until the irq is done.
+ *
+ * A work function must not wait for other work queued on the same cpu, since all of its
+ * workers could end up blocked
+ */
+
+static inline void work_init(work_t *work, work_func_t func, void *data) {
+    work->func = func;
+    work->data = data;
+    work->next = NULL;
+    atomic32_init(&work->pending, 0);
+}
+
+static inline bool work_is_pending(work_t *work) {
+    return atomic32_get(&work->pending) != 0;
+}
+
+/**
+ * Queues <work> on the current cpu and wakes up one of its waiting workers
+ *
+ * Note: Can be called from irq context. Must not be called with any pcb or ready queue lock held
+ *
+ * @return true if queued, false if <work> was already pending (it will only run once)
+ */
+bool workqueue_queue(work_t *work);
+
+/**
+ * Spawns the worker processes of cpu <cpuid>, pinned to that cpu
+ */
+int workqueue_launch_on_cpu(uint8_t cpuid);
@@ -5,3 +5,7 @@
 static inline void dmb(void) {
     arch_barrier_dmb();
 }
+
+static inline void dsb(void) {
+    arch_barrier_dsb();
+}
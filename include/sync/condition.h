@@ -12,7 +12,8 @@ typedef struct {
 
 int condition_init(condition_t *cond);
 /**
- * Note: Must be called with <spin> lock held
+ * Note: Must be called with <spin> lock held. <spin> must come before the pcb and ready
+ * queue locks in the lock ordering (see include/core.h)
  */
 void condition_wait_locked(condition_t *cond, spinlock_t *spin, irqctx_t *ctx);
 /**
@@ -25,6 +26,13 @@ struct pcb *condition_notify_locked(condition_t *cond);
  * condition_wait_locked()
  */
 bool condition_notify_all_locked(condition_t *cond);
+/**
+ * Wakes up <pcb>, which must be blocked on <cond>
+ *
+ * Note: Must be called with <spin> lock held, where <spin> is the lock used in
+ * condition_wait_locked()
+ */
+void condition_notify_pcb_locked(condition_t *cond, struct pcb *pcb);
 
 
 #define CONDITION_STATIC_INIT(_cond) { .blocked = LIST_HEAD_INIT(_cond.blocked), }
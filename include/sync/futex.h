@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Fast userspace mutexes.
+ *
+ * Userspace builds its locks on top of an int32_t with atomic instructions, and only
+ * enters the kernel when there is contention:
+ *      - FUTEX_WAIT: Blocks the caller as long as *addr == val
+ *      - FUTEX_WAKE: Wakes up to val processes waiting on addr
+ *
+ * Waiters are kept in a hash table of condition_t wait queues indexed by address.
+ * A waiter may return without a matching wake (e.g. if *addr changed before it could
+ * block), callers must always check the value again.
+ */
+typedef enum {
+    FUTEX_WAIT = 0,
+    FUTEX_WAKE,
+} futex_op_t;
+
+int futex_init_global_context(void);
+/**
+ * @return 0 once woken up, -1 if *<addr> != <val> or <addr> is not valid
+ */
+int futex_wait(volatile int32_t *addr, int32_t val);
+/**
+ * @return Number of processes woken up, -1 if <addr> is not valid
+ */
+int futex_wake(volatile int32_t *addr, int32_t nwake);
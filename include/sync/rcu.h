@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <core.h>
+#include <cpu/cpu-local.h>
+#include <dstruct/list.h>
+#include <sched/core.h>
+#include <sync/atomic.h>
+#include <generated/autoconf.h>
+
+/**
+ * Read-copy-update.
+ *
+ * Readers of an rcu-protected structure (e.g. a list walked with list_for_each_entry_rcu())
+ * don't take any lock, they just mark their read-side critical section with rcu_read_lock()
+ * and rcu_read_unlock(). Irq handlers run with irqs disabled and need no marking at all.
+ *
+ * Writers serialize among themselves, unlink the old data (e.g. list_del_rcu()) and only
+ * free it after a grace period, i.e. once every cpu went through a quiescent state and
+ * hence no reader can still hold a reference to it:
+ *      - synchronize_rcu() waits for a grace period, process context only
+ *      - call_rcu() runs a callback after a grace period, from any context
+ *
+ * Read-side critical sections disable preemption, so a cpu calling schedule() is in a
+ * quiescent state. They must not block.
+ */
+
+static inline void rcu_read_lock(void) {
+    preempt_disable();
+}
+
+static inline void rcu_read_unlock(void) {
+    preempt_enable();
+}
+
+/**
+ * Records a quiescent state for the current cpu (called by schedule())
+ *
+ * Note: Must be called with irqs disabled
+ */
+static inline void rcu_note_quiescent_state_locked(void) {
+#ifdef CONFIG_SMP
+    if (*CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.preempt_count) == 0) {
+        atomic32_inc(CPU_LOCAL_GET_PTR_LOCKED(_laritos.rcu.qs));
+    }
+#endif
+}
+
+int rcu_init_global_context(void);
+void synchronize_rcu(void);
+void call_rcu(rcu_head_t *head, void (*func)(rcu_head_t *head));
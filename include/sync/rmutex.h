@@ -5,13 +5,53 @@
 #include <sync/condition.h>
 #include <process/types.h>
 
-typedef struct {
+/**
+ * Recursive mutex with priority inheritance: while a process is blocked on the mutex, its
+ * owner (and, transitively, the owner of any other rmutex the owner is blocked on) runs
+ * with the priority of the highest priority waiter
+ */
+typedef struct rmutex {
     uint16_t lock_count;
     spinlock_t lock;
     condition_t cond;
     pcb_t *owner;
+
+    /**
+     * Processes blocked on the mutex, linked by pcb_t.sched.pi_node
+     *
+     * Protected by _laritos.proc.pi_lock
+     */
+    list_head_t pi_waiters;
+    /**
+     * Node used to link the mutex to the pcb_t.sched.pi_mutexes list of its owner
+     * while it has waiters
+     *
+     * Protected by _laritos.proc.pi_lock
+     */
+    list_head_t pi_node;
 } rmutex_t;
 
 int rmutex_init(rmutex_t *mutex);
 int rmutex_acquire(rmutex_t *mutex);
 int rmutex_release(rmutex_t *mutex);
+
+/**
+ * Returns the priority <pcb> must be scheduled with, i.e. the highest between its
+ * base priority and the priority of the processes blocked on the rmutexes it owns
+ *
+ * Note: Must be called with _laritos.proc.pi_lock held
+ */
+uint8_t rmutex_pi_get_priority_locked(pcb_t *pcb);
+
+/**
+ * Re-computes the priority of <pcb> and propagates the change along the chain of
+ * rmutex owners <pcb> is (transitively) blocked on
+ *
+ * Note: Must be called with _laritos.proc.pi_lock held
+ */
+void rmutex_pi_update_priority_locked(pcb_t *pcb);
+
+/**
+ * Drops any priority inheritance relationship of a dying process
+ */
+void rmutex_pi_process_exit(pcb_t *pcb);
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <irq/core.h>
+#include <sync/atomic.h>
+#include <sync/spinlock.h>
+#include <generated/autoconf.h>
+
+/**
+ * Readers-writer spinning lock, for data that is read much more often than it is modified.
+ * Any number of readers on different cpus can hold the lock at the same time, a writer
+ * holds it alone. As with spinlocks, local irqs are disabled while the lock is held.
+ *
+ * Waiting writers take precedence over new readers so that they don't starve. Hence a
+ * cpu must never acquire the read side of a lock it is already reading.
+ */
+typedef struct {
+    /**
+     * Number of readers holding the lock, or RWLOCK_WRITER if held by a writer
+     */
+    atomic32_t state;
+    atomic32_t writers_waiting;
+#ifdef CONFIG_SYNC_LOCKDEP
+    lock_class_t lclass;
+#endif
+} rwlock_t;
+
+#define RWLOCK_WRITER (-1)
+
+int rwlock_init(rwlock_t *lock);
+/**
+ * Same as rwlock_init() for a lock taking part in the lock ordering (see lock_class_t).
+ * Both sides of the lock are checked against <lclass>
+ */
+int rwlock_init_class(rwlock_t *lock, lock_class_t lclass);
+int rwlock_read_acquire(rwlock_t *lock, irqctx_t *ctx);
+int rwlock_read_release(rwlock_t *lock, irqctx_t *ctx);
+int rwlock_write_acquire(rwlock_t *lock, irqctx_t *ctx);
+int rwlock_write_release(rwlock_t *lock, irqctx_t *ctx);
+
+static inline bool rwlock_is_read_locked(rwlock_t *lock) {
+    return atomic32_get(&lock->state) > 0;
+}
+
+static inline bool rwlock_is_write_locked(rwlock_t *lock) {
+    return atomic32_get(&lock->state) == RWLOCK_WRITER;
+}
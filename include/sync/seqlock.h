@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <irq/core.h>
+#include <sync/atomic.h>
+#include <sync/spinlock.h>
+
+/**
+ * Sequence lock, for small pieces of data that are read very often and seldom written.
+ * Writers serialize on a spinlock and bump the sequence number before and after the update,
+ * readers never block writers: they take a snapshot of the data and retry if a write
+ * happened in the meantime, e.g.
+ *
+ *     uint32_t seq;
+ *     do {
+ *         seq = seqlock_read_begin(&lock);
+ *         copy = data;
+ *     } while (seqlock_read_retry(&lock, seq));
+ *
+ * Readers may observe inconsistent data until the retry check, so they must only copy it,
+ * never follow pointers out of it.
+ */
+typedef struct {
+    spinlock_t lock;
+    /**
+     * Odd while a write is in progress
+     */
+    atomic32_t seq;
+} seqlock_t;
+
+int seqlock_init(seqlock_t *lock);
+uint32_t seqlock_read_begin(seqlock_t *lock);
+/**
+ * Returns true if the data read since seqlock_read_begin() returned <start> may be
+ * inconsistent and must be read again
+ */
+bool seqlock_read_retry(seqlock_t *lock, uint32_t start);
+int seqlock_write_acquire(seqlock_t *lock, irqctx_t *ctx);
+int seqlock_write_release(seqlock_t *lock, irqctx_t *ctx);
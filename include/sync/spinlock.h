@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <irq/core.h>
 #include <arch/spinlock.h>
+#include <sync/atomic.h>
 #include <generated/autoconf.h>
 
 /**
@@ -16,19 +17,99 @@
 
 #define SPINLOCK_KERNEL_OWNER ((void *) -1)
 
+/**
+ * Classes of the locks that must be acquired in a fixed order (see the lock ordering in
+ * include/core.h). A lock can only be acquired while the cpu holds locks of lower classes.
+ * With CONFIG_SYNC_LOCKDEP, any violation of the order triggers an assertion.
+ *
+ * Locks initialized with spinlock_init() belong to LOCK_CLASS_NONE and are not checked
+ */
+typedef enum {
+    LOCK_CLASS_NONE = 0,
+    LOCK_CLASS_PCBS,
+    LOCK_CLASS_PCBS_DATA,
+    LOCK_CLASS_PI,
+    LOCK_CLASS_PCB,
+    LOCK_CLASS_RQ,
+    /**
+     * Second ready queue lock, when two queues are locked at once (lowest cpu id first)
+     */
+    LOCK_CLASS_RQ_NESTED,
+    LOCK_CLASS_LEN,
+} lock_class_t;
+
 struct pcb;
 
+#if defined(CONFIG_SMP) && defined(CONFIG_SYNC_SPINLOCK_TICKET)
+/**
+ * Ticket lock: a cpu takes the next ticket and waits until it is being served, so the lock
+ * is granted in fifo order
+ */
+typedef struct {
+    atomic32_t next;
+    atomic32_t serving;
+} spinlock_raw_t;
+#define SPINLOCK_IMPL_NAME "ticket"
+#elif defined(CONFIG_SMP) && defined(CONFIG_SYNC_SPINLOCK_MCS)
+/**
+ * MCS queued lock node. Each waiting cpu spins on its own node instead of on the lock
+ */
+typedef struct spinlock_mcs_node {
+    struct spinlock_mcs_node *volatile next;
+    volatile bool locked;
+    bool busy;
+} spinlock_mcs_node_t;
+
+/**
+ * MCS queued lock: <tail> is the last cpu node in the queue of waiters (NULL if unlocked),
+ * <node> is the node of the current owner
+ */
+typedef struct {
+    spinlock_mcs_node_t *volatile tail;
+    spinlock_mcs_node_t *node;
+} spinlock_raw_t;
+#define SPINLOCK_IMPL_NAME "mcs"
+#else
+typedef arch_spinlock_t spinlock_raw_t;
+#define SPINLOCK_IMPL_NAME "simple"
+#endif
+
 typedef struct {
 #ifdef CONFIG_SMP
-    arch_spinlock_t lock;
+    spinlock_raw_t lock;
 #endif
     struct pcb *owner;
+#ifdef CONFIG_SYNC_LOCKDEP
+    lock_class_t lclass;
+    /**
+     * Class the lock was acquired with (differs from <lclass> if nested)
+     */
+    lock_class_t held_class;
+#endif
 } spinlock_t;
 
 
 int spinlock_init(spinlock_t *lock);
+int spinlock_init_class(spinlock_t *lock, lock_class_t lclass);
 int spinlock_acquire(spinlock_t *lock, irqctx_t *ctx);
+/**
+ * Same as spinlock_acquire(), for a lock of the same class as one already held by the cpu.
+ * The caller is responsible for taking both in a consistent order (e.g. by cpu id)
+ */
+int spinlock_acquire_nested(spinlock_t *lock, irqctx_t *ctx);
 bool spinlock_trylock(spinlock_t *lock, irqctx_t *ctx);
 int spinlock_release(spinlock_t *lock, irqctx_t *ctx);
 bool spinlock_is_locked(spinlock_t *lock);
 bool spinlock_owned_by_me(spinlock_t *lock);
+
+#ifdef CONFIG_SYNC_LOCKDEP
+/**
+ * Checks that <lock> can be acquired as <lclass>, i.e. the cpu doesn't hold any lock of
+ * the same or a higher class, and records the class as held. <check> is false for trylocks.
+ * Returns the class actually recorded, to be passed to lockdep_release_class()
+ *
+ * Note: Must be called with irqs disabled
+ */
+lock_class_t lockdep_acquire_class(void *lock, lock_class_t lclass, bool check);
+void lockdep_release_class(lock_class_t lclass);
+#endif
@@ -25,6 +25,7 @@ typedef enum {
     SYSCALL_SPAWN_PROCESS,
     SYSCALL_WAITPID,
     SYSCALL_MKDIR,
+    SYSCALL_FUTEX,
 
     SYSCALL_LEN,
 } syscall_t;
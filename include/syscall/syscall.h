@@ -36,3 +36,4 @@ int syscall_get_property(char *id, void *buf);
 int syscall_spawn_process(char *executable);
 int syscall_waitpid(int pid, int *status);
 int syscall_mkdir(char *path, fs_access_mode_t mode);
+int syscall_futex(int32_t *addr, int op, int32_t val);
@@ -12,6 +12,13 @@ static inline abstick_t tick_get_os_ticks(void) {
     return (abstick_t) atomic64_get(&_laritos.timeinfo.osticks);
 }
 
+/**
+ * Accounts <ticks> OS ticks that elapsed without the ticker running (e.g. tickless idle)
+ */
+static inline abstick_t tick_add_os_ticks(abstick_t ticks) {
+    return (abstick_t) atomic64_add(&_laritos.timeinfo.osticks, (int64_t) ticks);
+}
+
 static inline abstick_t tick_inc_os_ticks(void) {
     // Even though the ticks var is an int64_t (atomic64_t) we still treat it
     // as an uint64_t
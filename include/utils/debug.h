@@ -53,29 +53,38 @@ static inline void debug_dump_processes(void) {
     // Prevent the OS from doing any change on the active processes
     // WARNING: We can only do this here since this is only used for debugging purposes
     irqctx_t ctx;
-    spinlock_acquire(&_laritos.proc.pcbs_lock, &ctx);
+    rwlock_read_acquire(&_laritos.proc.pcbs_lock, &ctx);
 
     for_each_process_locked(proc) {
         irqctx_t ctx;
         spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
 
-        if (proc->sched.status == PROC_STATUS_RUNNING) {
+        // Take a snapshot of the scheduling data, logging may need to wake up processes
+        irqctx_t pcbctx;
+        irqctx_t rqctx;
+        sched_runqueue_t *rq = sched_pcb_rq_lock(proc, &pcbctx, &rqctx);
+        process_status_t status = proc->sched.status;
+        uint8_t prio = proc->sched.priority;
+        spctx_t *spctx = proc->mm.sp_ctx;
+        sched_pcb_rq_unlock(proc, rq, &pcbctx, &rqctx);
+
+        if (status == PROC_STATUS_RUNNING) {
             log_always("%-7.7s %2u  %2u    %s   %7s    %3u   %-12.12s   0x%p           -",
                     proc->name, proc->pid, proc->parent != NULL ? proc->parent->pid : 0, proc->kernel ? "K" : "U",
-                    pcb_get_status_str(proc->sched.status), proc->sched.priority,
+                    pcb_get_status_str(status), prio,
                     arch_debug_get_psr_str(arch_cpu_get_cpsr(), buf, sizeof(buf)), arch_cpu_get_pc());
         } else {
             log_always("%-7.7s %2u  %2u    %s   %7s    %3u   %-12.12s   0x%p  0x%p",
                     proc->name, proc->pid, proc->parent != NULL ? proc->parent->pid : 0, proc->kernel ? "K" : "U",
-                    pcb_get_status_str(proc->sched.status), proc->sched.priority,
-                    arch_debug_get_psr_str_from_ctx(proc->mm.sp_ctx, buf, sizeof(buf)),
-                    arch_context_get_retaddr(proc->mm.sp_ctx), proc->mm.sp_ctx);
+                    pcb_get_status_str(status), prio,
+                    arch_debug_get_psr_str_from_ctx(spctx, buf, sizeof(buf)),
+                    arch_context_get_retaddr(spctx), spctx);
         }
 
         spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
     }
 
-    spinlock_release(&_laritos.proc.pcbs_lock, &ctx);
+    rwlock_read_release(&_laritos.proc.pcbs_lock, &ctx);
 }
 
 static inline void _dump_pstree_for(pcb_t *pcb, uint8_t level) {
@@ -115,7 +124,7 @@ static inline void debug_dump_processes_stats(void) {
     // Prevent the OS from doing any change on the active processes
     // WARNING: We can only do this here since this is only used for debugging purposes
     irqctx_t ctx;
-    spinlock_acquire(&_laritos.proc.pcbs_lock, &ctx);
+    rwlock_read_acquire(&_laritos.proc.pcbs_lock, &ctx);
 
     log_always("Processes stats:");
     for_each_process_locked(proc) {
@@ -146,16 +155,22 @@ static inline void debug_dump_processes_stats(void) {
 
         // Scheduling stats
         // Update with the latest stats
+        irqctx_t pcbctx;
+        irqctx_t rqctx;
+        sched_runqueue_t *rq = sched_pcb_rq_lock(proc, &pcbctx, &rqctx);
         sched_update_stats_locked(proc);
-        log_always("      sched | ready=%lu running=%lu blocked=%lu zombie=%lu", proc->stats.ticks_spent[PROC_STATUS_READY], proc->stats.ticks_spent[PROC_STATUS_RUNNING],
-                    proc->stats.ticks_spent[PROC_STATUS_BLOCKED], proc->stats.ticks_spent[PROC_STATUS_ZOMBIE]);
+        tick_t ticks[PROC_STATUS_LEN];
+        memcpy(ticks, proc->stats.ticks_spent, sizeof(ticks));
+        sched_pcb_rq_unlock(proc, rq, &pcbctx, &rqctx);
+        log_always("      sched | ready=%lu running=%lu blocked=%lu zombie=%lu", ticks[PROC_STATUS_READY], ticks[PROC_STATUS_RUNNING],
+                    ticks[PROC_STATUS_BLOCKED], ticks[PROC_STATUS_ZOMBIE]);
 
         spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
 
         log_always("  -----");
     }
 
-    spinlock_release(&_laritos.proc.pcbs_lock, &ctx);
+    rwlock_read_release(&_laritos.proc.pcbs_lock, &ctx);
 }
 
 /**
@@ -31,18 +31,24 @@
 #include <time/system-tick.h>
 #include <component/component.h>
 #include <dstruct/list.h>
+#include <sync/rcu.h>
 #include <test/utils/process.h>
 #include <test/utils/time.h>
+#include <irq/core.h>
 
 
 static bool is_callback_registered(ticker_comp_t *t, ticker_cb_t cb, void *data) {
+    bool found = false;
+    rcu_read_lock();
     ticker_cb_info_t *ti;
-    list_for_each_entry(ti, &t->cbs, list) {
+    list_for_each_entry_rcu(ti, &t->cbs, list) {
         if (ti->cb == cb && ti->data == data) {
-            return true;
+            found = true;
+            break;
         }
     }
-    return false;
+    rcu_read_unlock();
+    return found;
 }
 
 T(ticker_global_ctx_tick_is_incremented_periodically_secs) {
@@ -94,6 +100,47 @@ T(ticker_can_be_paused_and_resumed) {
     tassert(ticks <= tick_get_os_ticks());
 TEND
 
+#ifdef CONFIG_TICKER_NOHZ_IDLE
+T(ticker_nohz_accounts_the_skipped_ticks) {
+    ticker_comp_t *t = get_ticker();
+    tassert(t != NULL);
+
+    irqctx_t ctx;
+    irq_disable_local_and_save_ctx(&ctx);
+    int ret_enter = ticker_nohz_enter_all();
+    bool stopped = t->nohz_stopped && !t->running;
+    abstick_t ticks = tick_get_os_ticks();
+    // Somewhere between 1 and 2 seconds
+    TEST_BUSY_WAIT(2);
+    int ret_exit = ticker_nohz_exit_all();
+    abstick_t delta = tick_get_os_ticks() - ticks;
+    irq_local_restore_ctx(&ctx);
+
+    tassert(ret_enter >= 0);
+    tassert(ret_exit >= 0);
+    tassert(stopped);
+    tassert(!t->nohz_stopped && t->running);
+    tassert(delta >= t->ticks_per_sec);
+    tassert(delta <= 2 * t->ticks_per_sec + 1);
+TEND
+
+T(ticker_nohz_does_not_restart_a_paused_ticker) {
+    ticker_comp_t *t = get_ticker();
+    tassert(t != NULL);
+
+    t->ops.pause(t);
+    irqctx_t ctx;
+    irq_disable_local_and_save_ctx(&ctx);
+    ticker_nohz_enter_all();
+    ticker_nohz_exit_all();
+    bool running = t->running;
+    irq_local_restore_ctx(&ctx);
+    t->ops.resume(t);
+
+    tassert(!running);
+TEND
+#endif
+
 static int cb0(ticker_comp_t *t, void *data) {
     return 0;
 }
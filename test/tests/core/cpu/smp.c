@@ -0,0 +1,207 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <test/test.h>
+#include <core.h>
+#include <cpu/core.h>
+#include <process/core.h>
+#include <sched/core.h>
+#include <component/component.h>
+#include <sync/spinlock.h>
+#include <sync/atomic.h>
+#include <time/core.h>
+#include <utils/utils.h>
+#include <math.h>
+#include <limits.h>
+#include <generated/autoconf.h>
+
+static uint32_t get_online(void) {
+    irqctx_t ctx;
+    spinlock_acquire(&_laritos.proc.pcbs_data_lock, &ctx);
+    uint32_t online = _laritos.sched.online;
+    spinlock_release(&_laritos.proc.pcbs_data_lock, &ctx);
+    return online;
+}
+
+T(smp_every_cpu_in_the_board_comes_online) {
+    uint32_t expected = 0;
+    component_t *c;
+    for_each_component_type(c, COMP_TYPE_CPU) {
+        expected |= BIT_FOR_CPU(((cpu_t *) c)->id);
+    }
+    tassert(get_online() == expected);
+TEND
+
+static bool volatile stop;
+static bool volatile ran_on[CONFIG_CPU_MAX_CPUS];
+
+static int busy(void *data) {
+    while (!stop) {
+        ran_on[cpu_get_id()] = true;
+    }
+    return 0;
+}
+
+T(smp_busy_processes_spread_across_cpus) {
+    if (get_online() == BIT_FOR_CPU(cpu_get_id())) {
+        return TEST_SKIP;
+    }
+
+    int32_t migrations = atomic32_get(&_laritos.stats.migrations);
+    stop = false;
+    int i;
+    for (i = 0; i < ARRAYSIZE(ran_on); i++) {
+        ran_on[i] = false;
+    }
+
+    pcb_t *pcbs[4];
+    for (i = 0; i < ARRAYSIZE(pcbs); i++) {
+        pcbs[i] = process_spawn_kernel_process("busy", busy, NULL,
+                            8196, CONFIG_SCHED_PRIORITY_MAX_USER - 1);
+        tassert(pcbs[i] != NULL);
+    }
+
+    sleep(2);
+    stop = true;
+    for (i = 0; i < ARRAYSIZE(pcbs); i++) {
+        process_wait_for(pcbs[i], NULL);
+    }
+
+    tassert(atomic32_get(&_laritos.stats.migrations) > migrations);
+    // Busy processes must have run on more than one cpu
+    int ncpus = 0;
+    for (i = 0; i < ARRAYSIZE(ran_on); i++) {
+        ncpus += ran_on[i] ? 1 : 0;
+    }
+    tassert(ncpus > 1);
+TEND
+
+static int busy_on_affinity(void *data) {
+    while (!stop) {
+        if (!sched_can_run_on(process_get_current(), cpu_get_id())) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+T(smp_processes_only_run_on_the_cpus_of_their_affinity) {
+    uint8_t other = cpu_get_id() == 0 ? 1 : 0;
+    if (!(get_online() & BIT_FOR_CPU(other))) {
+        return TEST_SKIP;
+    }
+
+    stop = false;
+    pcb_t *pcbs[4];
+    int i;
+    for (i = 0; i < ARRAYSIZE(pcbs); i++) {
+        pcbs[i] = process_spawn_kernel_process("affinity", busy_on_affinity, NULL,
+                            8196, CONFIG_SCHED_PRIORITY_MAX_USER - 1);
+        tassert(pcbs[i] != NULL);
+        tassert(process_set_affinity(pcbs[i], BIT_FOR_CPU(other)) == 0);
+    }
+    tassert(process_set_affinity(pcbs[0], 0) < 0);
+
+    sleep(2);
+    stop = true;
+    for (i = 0; i < ARRAYSIZE(pcbs); i++) {
+        int status;
+        process_wait_for(pcbs[i], &status);
+        tassert(status == 0);
+    }
+TEND
+
+#define SPINLOCK_BENCH_ITERS 20000
+
+static spinlock_t bench_lock;
+static uint32_t volatile bench_counter;
+static bool volatile bench_go;
+static uint64_t bench_cycles[CONFIG_CPU_MAX_CPUS];
+
+static int spinlock_contender(void *data) {
+    uint32_t slot = (uint32_t) data;
+    while (!bench_go);
+
+    uint64_t start = cpu_get_cycle_count();
+    int i;
+    for (i = 0; i < SPINLOCK_BENCH_ITERS; i++) {
+        irqctx_t ctx;
+        spinlock_acquire(&bench_lock, &ctx);
+        bench_counter++;
+        spinlock_release(&bench_lock, &ctx);
+    }
+    bench_cycles[slot] = cpu_get_cycle_count() - start;
+    return 0;
+}
+
+/**
+ * Contention benchmark of the configured spinlock implementation (see CONFIG_SYNC_SPINLOCK_*),
+ * with one contender pinned to each of 1 up to 4 online cpus. Build with each implementation
+ * to compare them
+ */
+T(smp_spinlock_contention_benchmark) {
+    uint32_t online = get_online();
+    uint8_t cpus[CONFIG_CPU_MAX_CPUS];
+    int ncpus = 0;
+    int i;
+    for (i = 0; i < CONFIG_CPU_MAX_CPUS && ncpus < 4; i++) {
+        if (online & BIT_FOR_CPU(i)) {
+            cpus[ncpus++] = i;
+        }
+    }
+
+    int n;
+    for (n = 1; n <= ncpus; n++) {
+        spinlock_init(&bench_lock);
+        bench_counter = 0;
+        bench_go = false;
+
+        pcb_t *pcbs[CONFIG_CPU_MAX_CPUS];
+        // Lower priority than the test process, so that they start at once when it waits
+        for (i = 0; i < n; i++) {
+            pcbs[i] = process_spawn_kernel_process("lockbench", spinlock_contender, (void *) i,
+                                8196, process_get_current()->sched.priority + 1);
+            tassert(pcbs[i] != NULL);
+            tassert(process_set_affinity(pcbs[i], BIT_FOR_CPU(cpus[i])) == 0);
+        }
+        bench_go = true;
+        for (i = 0; i < n; i++) {
+            process_wait_for(pcbs[i], NULL);
+        }
+        tassert(bench_counter == n * SPINLOCK_BENCH_ITERS);
+
+        uint64_t total = 0;
+        uint64_t slowest = 0;
+        uint64_t fastest = U64_MAX;
+        for (i = 0; i < n; i++) {
+            total += bench_cycles[i];
+            slowest = max(slowest, bench_cycles[i]);
+            fastest = min(fastest, bench_cycles[i]);
+        }
+        info("spinlock (" SPINLOCK_IMPL_NAME ") %d cpu/s: %lu cycles per acquisition, slowest/fastest cpu %lu/%lu cycles",
+                n, (uint32_t) (total / (n * SPINLOCK_BENCH_ITERS)), (uint32_t) slowest, (uint32_t) fastest);
+    }
+TEND
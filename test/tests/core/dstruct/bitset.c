@@ -72,6 +72,18 @@ T(bitset_ffz_returns_the_right_pos_on_first_zero) {
     }
 TEND
 
+T(bitset_ffs_returns_the_right_pos_on_first_one) {
+    tassert(bitset_ffs(0) == BITSET_IDX_NOT_FOUND);
+    int i;
+    for (i = 0; i < BITSET_NBITS; i++) {
+        bitset_t bs = 0;
+        bitset_lm_set(&bs, i);
+        tassert(bitset_ffs(bs) == i);
+        bitset_lm_set(&bs, BITSET_NBITS - 1);
+        tassert(bitset_ffs(bs) == i);
+    }
+TEND
+
 T(bitset_lm_bit_returns_the_right_bit_value) {
     bitset_t bs = 0;
     int i;
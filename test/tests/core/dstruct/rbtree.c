@@ -0,0 +1,164 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <test/test.h>
+#include <dstruct/rbtree.h>
+#include <utils/utils.h>
+
+typedef struct {
+    int key;
+    int seq;
+    rbnode_t node;
+} rbitem_t;
+
+static rbitem_t items[64];
+
+static bool item_less(const rbnode_t *a, const rbnode_t *b) {
+    return rbtree_entry(a, rbitem_t, node)->key < rbtree_entry(b, rbitem_t, node)->key;
+}
+
+/**
+ * @return Black height of the subtree rooted at <n>, -1 if any red-black property is broken
+ */
+static int black_height(const rbnode_t *n, const rbnode_t *parent) {
+    if (n == NULL) {
+        return 1;
+    }
+    if (n->parent != parent) {
+        return -1;
+    }
+    if (n->red && ((n->left != NULL && n->left->red) || (n->right != NULL && n->right->red))) {
+        return -1;
+    }
+    int lh = black_height(n->left, n);
+    int rh = black_height(n->right, n);
+    if (lh < 0 || lh != rh) {
+        return -1;
+    }
+    return lh + (n->red ? 0 : 1);
+}
+
+static bool is_valid_tree(rbtree_t *t, int expected_len) {
+    if (t->root != NULL && t->root->red) {
+        return false;
+    }
+    if (black_height(t->root, NULL) < 0) {
+        return false;
+    }
+    int len = 0;
+    rbitem_t *prev = NULL;
+    rbnode_t *n;
+    for (n = rbtree_first(t); n != NULL; n = rbtree_next(n)) {
+        rbitem_t *it = rbtree_entry(n, rbitem_t, node);
+        if (prev != NULL && (prev->key > it->key || (prev->key == it->key && prev->seq > it->seq))) {
+            return false;
+        }
+        prev = it;
+        len++;
+    }
+    return len == expected_len;
+}
+
+static void init_items(void) {
+    int i;
+    for (i = 0; i < ARRAYSIZE(items); i++) {
+        items[i].key = 0;
+        items[i].seq = i;
+        rbnode_init(&items[i].node);
+    }
+}
+
+T(rbtree_new_tree_is_empty) {
+    rbtree_t t = RBTREE_STATIC_INIT;
+    tassert(rbtree_is_empty(&t));
+    tassert(rbtree_first(&t) == NULL);
+    tassert(rbtree_first_entry_or_null(&t, rbitem_t, node) == NULL);
+TEND
+
+T(rbtree_in_order_traversal_is_sorted) {
+    rbtree_t t;
+    rbtree_init(&t);
+    init_items();
+
+    int i;
+    for (i = 0; i < ARRAYSIZE(items); i++) {
+        // Pseudo-random keys, with repetitions
+        items[i].key = (i * 37) % 23;
+        rbtree_insert(&t, &items[i].node, item_less);
+        tassert(rbnode_is_linked(&items[i].node));
+        tassert(is_valid_tree(&t, i + 1));
+    }
+
+    rbitem_t *first = rbtree_first_entry_or_null(&t, rbitem_t, node);
+    tassert(first != NULL && first->key == 0);
+TEND
+
+T(rbtree_equal_keys_keep_insertion_order) {
+    rbtree_t t;
+    rbtree_init(&t);
+    init_items();
+
+    int i;
+    for (i = 0; i < 8; i++) {
+        rbtree_insert(&t, &items[i].node, item_less);
+    }
+    for (i = 0; i < 8; i++) {
+        tassert(rbtree_first(&t) == &items[i].node);
+        rbtree_remove(&t, &items[i].node);
+    }
+    tassert(rbtree_is_empty(&t));
+TEND
+
+T(rbtree_remove_keeps_the_tree_balanced) {
+    rbtree_t t;
+    rbtree_init(&t);
+    init_items();
+
+    int i;
+    for (i = 0; i < ARRAYSIZE(items); i++) {
+        items[i].key = (i * 13) % 64;
+        rbtree_insert(&t, &items[i].node, item_less);
+    }
+
+    // Remove nodes from the middle, the beginning and the end of the tree
+    int len = ARRAYSIZE(items);
+    for (i = 0; i < ARRAYSIZE(items); i += 3) {
+        rbtree_remove(&t, &items[i].node);
+        tassert(!rbnode_is_linked(&items[i].node));
+        tassert(is_valid_tree(&t, --len));
+    }
+
+    // The cached left-most node must always be the minimum
+    while (!rbtree_is_empty(&t)) {
+        rbitem_t *first = rbtree_first_entry_or_null(&t, rbitem_t, node);
+        for (i = 0; i < ARRAYSIZE(items); i++) {
+            tassert(!rbnode_is_linked(&items[i].node) || items[i].key >= first->key);
+        }
+        rbtree_remove(&t, &first->node);
+        tassert(is_valid_tree(&t, --len));
+    }
+    tassert(len == 0);
+TEND
@@ -181,6 +181,23 @@ T(memset_doesnt_overflow) {
     tassert(strncmp(buf, "ddd", sizeof(buf)) == 0);
 TEND
 
+T(memset_fills_unaligned_ranges) {
+    uint32_t words[8];
+    char *buf = (char *) words;
+    int start;
+    int len;
+    for (start = 0; start < 4; start++) {
+        for (len = 0; len < sizeof(words) - 8; len++) {
+            memset(buf, 'x', sizeof(words));
+            tassert(memset(buf + start, 0xff, len) == buf + start);
+            int i;
+            for (i = 0; i < sizeof(words); i++) {
+                tassert(buf[i] == (i >= start && i < start + len ? (char) 0xff : 'x'));
+            }
+        }
+    }
+TEND
+
 // memcpy
 T(memcpy_doesnt_overflow) {
     char from[] = { 'a', 'b', 'c'};
@@ -25,6 +25,8 @@
 #include <stdint.h>
 #include <test/test.h>
 #include <mm/slab.h>
+#include <utils/latency.h>
+#include <utils/utils.h>
 
 T(bitsetslab_returns_null_when_cannot_satisfy_mem_requirement) {
     slab_t *slab = slab_create(1, sizeof(uint32_t));
@@ -150,7 +152,7 @@ T(bitsetslab_large_num_of_allocs) {
     for (i = 0; i < slab->total_elems; i++) {
         v[i] = slab_alloc(slab);
         tassert(v[i] != NULL);
-        tassert((char *) v[i] == slab->data + i * sizeof(uint32_t));
+        tassert((char *) v[i] == slab->chunks[0]->data + i * sizeof(uint32_t));
         tassert(slab_get_avail_elems(slab) == slab->total_elems - i - 1);
         tassert(slab_is_taken(slab, i));
     }
@@ -234,3 +236,143 @@ T(bitsetslab_get_position_returns_null_on_invalid_position) {
     tassert(slab_get_slab_position(slab, slab_get_ptr_from_position(slab, 9) + 1) == -1);
     slab_destroy(slab);
 TEND
+
+T(bitsetslab_finds_free_elements_beyond_the_first_summary_element) {
+    uint32_t n = BITSET_NBITS * BITSET_NBITS + 5;
+    slab_t *slab = slab_create(n, sizeof(char));
+    tassert(slab != NULL);
+
+    int i;
+    for (i = 0; i < n; i++) {
+        char *v = slab_alloc(slab);
+        tassert(v != NULL);
+        tassert(slab_get_slab_position(slab, v) == i);
+    }
+    tassert(slab_alloc(slab) == NULL);
+
+    // Free one element in the middle and one in the last (partially used) bitset element
+    slab_free(slab, slab_get_ptr_from_position(slab, BITSET_NBITS * 7 + 3));
+    slab_free(slab, slab_get_ptr_from_position(slab, n - 1));
+
+    tassert(slab_get_slab_position(slab, slab_alloc(slab)) == BITSET_NBITS * 7 + 3);
+    tassert(slab_get_slab_position(slab, slab_alloc(slab)) == n - 1);
+    tassert(slab_alloc(slab) == NULL);
+
+    slab_destroy(slab);
+TEND
+
+T(bitsetslab_growable_slab_grows_by_chunks_up_to_max_elems) {
+    bs_slab_t *slab = (bs_slab_t *) slab_create_growable(4, 12, sizeof(uint32_t));
+    tassert(slab != NULL);
+    tassert(slab->nchunks == 3);
+    tassert(slab_get_total_elems(slab) == 12);
+    tassert(slab->chunks[0] != NULL);
+    tassert(slab->chunks[1] == NULL);
+
+    int i;
+    for (i = 0; i < 12; i++) {
+        uint32_t *v = slab_alloc(slab);
+        tassert(v != NULL);
+        tassert(slab_get_slab_position(slab, v) == i);
+        tassert(slab_get_ptr_from_position(slab, i) == v);
+    }
+    tassert(slab->chunks[1] != NULL);
+    tassert(slab->chunks[2] != NULL);
+    tassert(slab_get_avail_elems(slab) == 0);
+    tassert(slab_alloc(slab) == NULL);
+
+    slab_destroy(slab);
+TEND
+
+T(bitsetslab_growable_slab_keeps_positions_stable_and_releases_empty_chunks) {
+    bs_slab_t *slab = (bs_slab_t *) slab_create_growable(4, 12, sizeof(uint32_t));
+    tassert(slab != NULL);
+
+    void *v[12];
+    int i;
+    for (i = 0; i < ARRAYSIZE(v); i++) {
+        v[i] = slab_alloc(slab);
+        tassert(v[i] != NULL);
+    }
+
+    // Empty the middle chunk, it is kept since there are no other free elements
+    for (i = 4; i < 8; i++) {
+        slab_free(slab, v[i]);
+    }
+    tassert(slab->chunks[1] != NULL);
+
+    // Empty the last chunk, now there is a whole chunk worth of free elements in
+    // the middle one, so the last one is given back to the heap
+    for (i = 8; i < 12; i++) {
+        slab_free(slab, v[i]);
+    }
+    tassert(slab->chunks[2] == NULL);
+    tassert(slab_get_ptr_from_position(slab, 8) == NULL);
+    tassert(!slab_is_taken(slab, 8));
+
+    // Elements in the first chunk keep their positions
+    for (i = 0; i < 4; i++) {
+        tassert(slab_get_slab_position(slab, v[i]) == i);
+        tassert(slab_is_taken(slab, i));
+    }
+
+    // The lowest free position is handed out first
+    tassert(slab_get_slab_position(slab, slab_alloc(slab)) == 4);
+    tassert(slab_get_avail_elems(slab) == 7);
+
+    slab_destroy(slab);
+TEND
+
+T(bitsetslab_growable_slab_cannot_be_smaller_than_a_chunk) {
+    slab_t *slab = slab_create_growable(8, 4, sizeof(uint32_t));
+    tassert(slab == NULL);
+    slab = slab_create_growable(0, 4, sizeof(uint32_t));
+    tassert(slab == NULL);
+TEND
+
+T(bitsetslab_growable_slab_max_elems_must_be_a_multiple_of_the_chunk) {
+    slab_t *slab = slab_create_growable(4, 10, sizeof(uint32_t));
+    tassert(slab == NULL);
+TEND
+
+/**
+ * Allocates elements until <used> elements are taken
+ */
+static int fill_slab(slab_t *slab, uint32_t used) {
+    while (slab_get_total_elems(slab) - slab_get_avail_elems(slab) < used) {
+        if (slab_alloc(slab) == NULL) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+#define BENCH_ALLOC_FREE(_slab, _tag) do { \
+        int _i; \
+        for (_i = 0; _i < 50; _i++) { \
+            void *_p = NULL; \
+            LATENCY("slab_alloc() " _tag, { \
+                _p = slab_alloc(_slab); \
+            }); \
+            LATENCY("slab_free() " _tag, { \
+                slab_free(_slab, _p); \
+            }); \
+        } \
+    } while (0)
+
+T(bitsetslab_benchmark_alloc_free_at_different_occupancies) {
+    uint32_t n = 1024;
+    slab_t *slab = slab_create(n, sizeof(uint32_t));
+    tassert(slab != NULL);
+
+    tassert(fill_slab(slab, n * 10 / 100) >= 0);
+    BENCH_ALLOC_FREE(slab, "10%");
+
+    tassert(fill_slab(slab, n * 50 / 100) >= 0);
+    BENCH_ALLOC_FREE(slab, "50%");
+
+    tassert(fill_slab(slab, n * 95 / 100) >= 0);
+    BENCH_ALLOC_FREE(slab, "95%");
+
+    slab_destroy(slab);
+TEND
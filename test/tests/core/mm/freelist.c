@@ -200,3 +200,80 @@ T(freelist_calloc_and_free_merges_adjacent_free_blocks) {
     tassert(get_num_blocks() == blocks);
     tassert(heap_get_available() == avail);
 TEND
+
+T(freelist_calloc_returns_null_on_overflow) {
+    uint32_t avail = heap_get_available();
+    tassert(calloc(0x10000, 0x10001) == NULL);
+    tassert(calloc(SIZE_MAX, 2) == NULL);
+    tassert(heap_get_available() == avail);
+TEND
+
+T(freelist_resize_grows_in_place_when_next_block_is_free) {
+    char *p = _malloc(10);
+    char *q = _malloc(10);
+    char *r = _malloc(10);
+    tassert(p != NULL && q != NULL && r != NULL);
+
+    // Next block in use
+    tassert(!_resize(p, 20));
+    tassert(heap_get_chunk_size(p) == 10);
+
+    _free(q);
+    tassert(_resize(p, 20));
+    tassert(heap_get_chunk_size(p) >= 20);
+    // Cannot go past r
+    tassert(!_resize(p, 10 + sizeof(fl_node_t) + 11));
+
+    // Shrinking gives the tail back
+    uint32_t avail = heap_get_available();
+    tassert(_resize(p, 4));
+    tassert(heap_get_chunk_size(p) == 4);
+    tassert(heap_get_available() > avail);
+
+    _free(p);
+    _free(r);
+TEND
+
+T(freelist_memalign_returns_aligned_chunks) {
+    uint32_t avail = heap_get_available();
+    uint32_t blocks = get_num_blocks();
+
+    size_t align;
+    for (align = 1; align <= 4096; align <<= 1) {
+        char *p = _memalign(align, 100);
+        tassert(p != NULL);
+        tassert(((uintptr_t) p & (align - 1)) == 0);
+        tassert(heap_get_chunk_size(p) >= 100);
+        memset(p, 0xab, 100);
+        _free(p);
+    }
+    tassert(_memalign(3, 100) == NULL);
+    tassert(_memalign(0, 100) == NULL);
+
+    tassert(get_num_blocks() == blocks);
+    tassert(heap_get_available() == avail);
+TEND
+
+T(freelist_realloc_keeps_the_contents) {
+    char *p = realloc(NULL, 16);
+    tassert(p != NULL);
+    int i;
+    for (i = 0; i < 16; i++) {
+        p[i] = i;
+    }
+    // Force a move
+    char *blocker = malloc(16);
+    tassert(blocker != NULL);
+    p = realloc(p, 1000);
+    tassert(p != NULL);
+    for (i = 0; i < 16; i++) {
+        tassert(p[i] == i);
+    }
+    p = realloc(p, 8);
+    tassert(p != NULL);
+    for (i = 0; i < 8; i++) {
+        tassert(p[i] == i);
+    }
+    tassert(realloc(p, 0) == NULL);
+    free(blocker);
+TEND
@@ -0,0 +1,108 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdint.h>
+#include <test/test.h>
+#include <cpu/cpu-local.h>
+#include <irq/core.h>
+
+static inline hc_cpu_cache_t *get_cpu_cache(void) {
+    irqctx_t ctx;
+    irq_disable_local_and_save_ctx(&ctx);
+    hc_cpu_cache_t *cc = CPU_LOCAL_GET_PTR_LOCKED(cpucache);
+    irq_local_restore_ctx(&ctx);
+    return cc;
+}
+
+T(heapcache_size_classes_are_computed_correctly) {
+    tassert(class_for_alloc(1) == 0);
+    tassert(class_for_alloc(HC_MIN_SIZE) == 0);
+    tassert(class_for_alloc(HC_MIN_SIZE + 1) == 1);
+    tassert(class_for_alloc(HC_MAX_SIZE) == HC_NUM_CLASSES - 1);
+    tassert(class_for_free(HC_MIN_SIZE) == 0);
+    tassert(class_for_free(HC_MIN_SIZE * 2 - 1) == 0);
+    tassert(class_for_free(HC_MIN_SIZE * 2) == 1);
+    tassert(class_for_free(HC_MAX_SIZE * 2 - 1) == HC_NUM_CLASSES - 1);
+TEND
+
+T(heapcache_freed_chunk_is_reused_by_the_next_alloc_of_the_same_class) {
+    void *p = heap_cache_malloc(40);
+    tassert(p != NULL);
+    heap_cache_free(p);
+
+    uint32_t hits = get_cpu_cache()->hits;
+    void *p2 = heap_cache_malloc(50);
+    tassert(p2 == p);
+    tassert(get_cpu_cache()->hits == hits + 1);
+    heap_cache_free(p2);
+TEND
+
+T(heapcache_empty_magazine_is_refilled_in_batches) {
+    hc_magazine_t *mag = &get_cpu_cache()->mags[HC_NUM_CLASSES - 1];
+    void *p[HC_MAG_SIZE];
+    int i;
+    // Empty the magazine
+    uint32_t n = mag->count;
+    for (i = 0; i < n; i++) {
+        p[i] = heap_cache_malloc(HC_MAX_SIZE);
+        tassert(p[i] != NULL);
+    }
+    tassert(mag->count == 0);
+
+    uint32_t misses = get_cpu_cache()->misses;
+    void *ptr = heap_cache_malloc(HC_MAX_SIZE);
+    tassert(ptr != NULL);
+    tassert(get_cpu_cache()->misses == misses + 1);
+    tassert(mag->count == HC_BATCH - 1);
+
+    heap_cache_free(ptr);
+    for (i = 0; i < n; i++) {
+        heap_cache_free(p[i]);
+    }
+TEND
+
+T(heapcache_full_magazine_is_drained_to_the_heap) {
+    hc_magazine_t *mag = &get_cpu_cache()->mags[0];
+    void *p[HC_MAG_SIZE + 1];
+    int i;
+    for (i = 0; i < ARRAYSIZE(p); i++) {
+        p[i] = heap_cache_malloc(HC_MIN_SIZE);
+        tassert(p[i] != NULL);
+    }
+    for (i = 0; i < ARRAYSIZE(p); i++) {
+        heap_cache_free(p[i]);
+        tassert(mag->count <= HC_MAG_SIZE);
+    }
+    tassert(mag->count > 0);
+TEND
+
+T(heapcache_big_chunks_bypass_the_cache) {
+    uint32_t hits = get_cpu_cache()->hits;
+    uint32_t misses = get_cpu_cache()->misses;
+    void *p = heap_cache_malloc(HC_MAX_SIZE * 4);
+    tassert(p != NULL);
+    heap_cache_free(p);
+    tassert(get_cpu_cache()->hits == hits);
+    tassert(get_cpu_cache()->misses == misses);
+TEND
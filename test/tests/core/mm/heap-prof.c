@@ -0,0 +1,103 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <test/test.h>
+#include <mm/heap.h>
+#include <mm/heap-prof.h>
+
+#define FAKE_PC ((regpc_t) 0xdead0000)
+
+T(heapprof_aggregates_allocations_per_call_site) {
+    heap_prof_record_alloc(FAKE_PC, 100);
+    heap_prof_record_alloc(FAKE_PC, 50);
+
+    irqctx_t ctx;
+    spinlock_acquire(&hprof.lock, &ctx);
+    hprof_entry_t *e = get_entry_locked(FAKE_PC, false);
+    spinlock_release(&hprof.lock, &ctx);
+    tassert(e != NULL);
+    tassert(e->live_bytes == 150);
+    tassert(e->live_allocs == 2);
+    tassert(e->total_allocs == 2);
+    tassert(e->peak_bytes == 150);
+
+    heap_prof_record_free(FAKE_PC, 100);
+    tassert(e->live_bytes == 50);
+    tassert(e->live_allocs == 1);
+    tassert(e->total_allocs == 2);
+    tassert(e->peak_bytes == 150);
+
+    heap_prof_record_free(FAKE_PC, 50);
+    tassert(e->live_bytes == 0);
+    tassert(e->live_allocs == 0);
+TEND
+
+T(heapprof_call_sites_with_colliding_hashes_get_different_entries) {
+    // Same hash, different pc
+    regpc_t pc1 = (regpc_t) 0x1000;
+    regpc_t pc2 = (regpc_t) (0x1000 + HPROF_NENTRIES * 4);
+    tassert(hash_pc(pc1) == hash_pc(pc2));
+
+    heap_prof_record_alloc(pc1, 8);
+    heap_prof_record_alloc(pc2, 16);
+
+    irqctx_t ctx;
+    spinlock_acquire(&hprof.lock, &ctx);
+    hprof_entry_t *e1 = get_entry_locked(pc1, false);
+    hprof_entry_t *e2 = get_entry_locked(pc2, false);
+    spinlock_release(&hprof.lock, &ctx);
+    tassert(e1 != NULL && e2 != NULL && e1 != e2);
+    tassert(e1->live_bytes == 8);
+    tassert(e2->live_bytes == 16);
+
+    heap_prof_record_free(pc1, 8);
+    heap_prof_record_free(pc2, 16);
+TEND
+
+#ifndef CONFIG_MEM_HEAP_BUFFER_PROTECTION_SAMPLED
+T(heapprof_malloc_and_free_are_recorded) {
+    uint32_t live = 0;
+    int i;
+    for (i = 0; i < HPROF_NENTRIES; i++) {
+        live += hprof.entries[i].live_bytes;
+    }
+
+    char *p = malloc(123);
+    tassert(p != NULL);
+    uint32_t live2 = 0;
+    for (i = 0; i < HPROF_NENTRIES; i++) {
+        live2 += hprof.entries[i].live_bytes;
+    }
+    tassert(live2 == live + 123);
+
+    free(p);
+    live2 = 0;
+    for (i = 0; i < HPROF_NENTRIES; i++) {
+        live2 += hprof.entries[i].live_bytes;
+    }
+    tassert(live2 == live);
+TEND
+#endif
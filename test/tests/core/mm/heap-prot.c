@@ -0,0 +1,161 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <test/test.h>
+#include <mm/heap.h>
+
+#ifdef CONFIG_MEM_HEAP_BUFFER_PROTECTION_SAMPLED
+
+T(heapprot_samples_one_out_of_n_allocations) {
+    uint32_t rate = heap_prot_get_sample_rate();
+    // Make sure the countdown restarts, whatever the current rate is
+    heap_prot_set_sample_rate(1);
+    heap_prot_set_sample_rate(4);
+
+    void *p[8];
+    int sampled = 0;
+    int i;
+    for (i = 0; i < ARRAYSIZE(p); i++) {
+        p[i] = malloc(16);
+        tassert(p[i] != NULL);
+        if (heap_prot_is_sampled(p[i])) {
+            sampled++;
+        }
+    }
+    tassert(sampled == 2);
+    tassert(heap_prot_is_sampled(p[3]));
+    tassert(heap_prot_is_sampled(p[7]));
+
+    for (i = 0; i < ARRAYSIZE(p); i++) {
+        free(p[i]);
+    }
+    heap_prot_set_sample_rate(rate);
+TEND
+
+T(heapprot_setting_the_same_rate_keeps_the_countdown) {
+    uint32_t rate = heap_prot_get_sample_rate();
+    heap_prot_set_sample_rate(1);
+    heap_prot_set_sample_rate(4);
+
+    void *p[4];
+    int i;
+    for (i = 0; i < ARRAYSIZE(p); i++) {
+        // Same rate, e.g. applied again by the health check
+        heap_prot_set_sample_rate(4);
+        p[i] = malloc(16);
+        tassert(p[i] != NULL);
+    }
+    tassert(heap_prot_is_sampled(p[3]));
+
+    for (i = 0; i < ARRAYSIZE(p); i++) {
+        free(p[i]);
+    }
+    heap_prot_set_sample_rate(rate);
+TEND
+
+T(heapprot_sampled_chunks_are_guarded_by_canaries) {
+    uint32_t rate = heap_prot_get_sample_rate();
+    heap_prot_set_sample_rate(1);
+
+    char *p = malloc(10);
+    tassert(p != NULL);
+    tassert(heap_prot_is_sampled(p));
+    bufprot_head_t *h;
+    bufprot_tail_t *t;
+    tassert(!heap_prot_is_corrupted(p, &h, &t));
+    tassert(h->size == 10);
+    // Sampled chunks are placed at the end of their slot
+    tassert(((char *) t - _heap_prot_pool) % SLOT_SIZE >= SLOT_SIZE - sizeof(bufprot_tail_t) - 8);
+    free(p);
+
+    heap_prot_set_sample_rate(rate);
+TEND
+
+T(heapprot_big_allocations_are_never_sampled) {
+    uint32_t rate = heap_prot_get_sample_rate();
+    heap_prot_set_sample_rate(1);
+
+    char *p = malloc(SLOT_MAX_ALLOC + 1);
+    tassert(p != NULL);
+    tassert(!heap_prot_is_sampled(p));
+    // The next (small enough) allocation is sampled instead
+    char *p2 = malloc(SLOT_MAX_ALLOC);
+    tassert(p2 != NULL);
+    tassert(heap_prot_is_sampled(p2));
+    free(p);
+    free(p2);
+
+    heap_prot_set_sample_rate(rate);
+TEND
+
+T(heapprot_detects_writes_to_freed_sampled_chunks) {
+    uint32_t rate = heap_prot_get_sample_rate();
+    heap_prot_set_sample_rate(1);
+
+    char *p = malloc(16);
+    tassert(p != NULL);
+    tassert(heap_prot_is_sampled(p));
+    uint32_t slot = (p - _heap_prot_pool) / SLOT_SIZE;
+    free(p);
+
+    // Use after free
+    p[0] = 'x';
+
+    // Take all the slots until the dirty one is reused
+    uint32_t uaf = hp.uaf;
+    void *ptrs[NSLOTS];
+    int n = 0;
+    bool reused = false;
+    while (n < ARRAYSIZE(ptrs) && !reused) {
+        ptrs[n] = malloc(16);
+        tassert(ptrs[n] != NULL);
+        reused = heap_prot_is_sampled(ptrs[n]) && ((char *) ptrs[n] - _heap_prot_pool) / SLOT_SIZE == slot;
+        n++;
+    }
+    tassert(reused);
+    tassert(hp.uaf == uaf + 1);
+
+    while (n > 0) {
+        free(ptrs[--n]);
+    }
+    heap_prot_set_sample_rate(rate);
+TEND
+
+#else
+
+T(heapprot_rejects_sizes_that_overflow_with_the_canaries) {
+    tassert(malloc(SIZE_MAX - 4) == NULL);
+    tassert(calloc(1, 0xFFFFFFF8) == NULL);
+    tassert(memalign(8, SIZE_MAX - 4) == NULL);
+
+    char *p = malloc(16);
+    tassert(p != NULL);
+    tassert(realloc(p, SIZE_MAX - 4) == NULL);
+    free(p);
+TEND
+
+#endif
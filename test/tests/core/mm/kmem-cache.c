@@ -0,0 +1,154 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <test/test.h>
+#include <mm/kmem-cache.h>
+#include <utils/utils.h>
+
+typedef struct {
+    uint32_t magic;
+    uint32_t data[3];
+} kc_test_obj_t;
+
+T(kmem_cache_cannot_create_cache_without_name_or_size) {
+    tassert(kmem_cache_create(NULL, sizeof(kc_test_obj_t), NULL, NULL) == NULL);
+    tassert(kmem_cache_create("", sizeof(kc_test_obj_t), NULL, NULL) == NULL);
+    tassert(kmem_cache_create("kctest", 0, NULL, NULL) == NULL);
+TEND
+
+T(kmem_cache_returns_zeroed_objects_when_there_is_no_ctor) {
+    kmem_cache_t *c = kmem_cache_create("kctest", sizeof(kc_test_obj_t), NULL, NULL);
+    tassert(c != NULL);
+
+    kc_test_obj_t *o = kmem_cache_alloc(c);
+    tassert(o != NULL);
+    o->magic = 0xcafe;
+    kmem_cache_free(c, o);
+
+    o = kmem_cache_alloc(c);
+    tassert(o != NULL);
+    tassert(o->magic == 0);
+    kmem_cache_free(c, o);
+
+    tassert(kmem_cache_destroy(c) == 0);
+TEND
+
+T(kmem_cache_grows_when_full_and_shrinks_when_empty) {
+    kmem_cache_t *c = kmem_cache_create("kctest", sizeof(kc_test_obj_t), NULL, NULL);
+    tassert(c != NULL);
+    tassert(c->total == 0);
+
+    void *objs[KC_OBJS_PER_SLAB * 3];
+    int i;
+    for (i = 0; i < ARRAYSIZE(objs); i++) {
+        objs[i] = kmem_cache_alloc(c);
+        tassert(objs[i] != NULL);
+    }
+    tassert(c->active == ARRAYSIZE(objs));
+    tassert(c->total == ARRAYSIZE(objs));
+    tassert(c->highwater == ARRAYSIZE(objs));
+
+    for (i = 0; i < ARRAYSIZE(objs); i++) {
+        kmem_cache_free(c, objs[i]);
+    }
+    tassert(c->active == 0);
+    // One slab is always kept around
+    tassert(c->total == KC_OBJS_PER_SLAB);
+    tassert(c->highwater == ARRAYSIZE(objs));
+
+    tassert(kmem_cache_destroy(c) == 0);
+TEND
+
+static uint32_t ctor_calls;
+static uint32_t dtor_calls;
+
+static void test_ctor(void *obj) {
+    ((kc_test_obj_t *) obj)->magic = 0x1234;
+    ctor_calls++;
+}
+
+static void test_dtor(void *obj) {
+    ((kc_test_obj_t *) obj)->magic = 0;
+    dtor_calls++;
+}
+
+T(kmem_cache_calls_ctor_and_dtor_on_every_object) {
+    ctor_calls = 0;
+    dtor_calls = 0;
+    kmem_cache_t *c = kmem_cache_create("kctest", sizeof(kc_test_obj_t), test_ctor, test_dtor);
+    tassert(c != NULL);
+
+    kc_test_obj_t *o1 = kmem_cache_alloc(c);
+    kc_test_obj_t *o2 = kmem_cache_alloc(c);
+    tassert(o1 != NULL && o2 != NULL);
+    tassert(o1->magic == 0x1234 && o2->magic == 0x1234);
+    tassert(ctor_calls == 2);
+    tassert(dtor_calls == 0);
+
+    kmem_cache_free(c, o1);
+    kmem_cache_free(c, o2);
+    tassert(dtor_calls == 2);
+
+    tassert(kmem_cache_destroy(c) == 0);
+TEND
+
+T(kmem_cache_cannot_be_destroyed_with_objects_in_use) {
+    kmem_cache_t *c = kmem_cache_create("kctest", sizeof(kc_test_obj_t), NULL, NULL);
+    tassert(c != NULL);
+    void *o = kmem_cache_alloc(c);
+    tassert(o != NULL);
+    tassert(kmem_cache_destroy(c) < 0);
+    kmem_cache_free(c, o);
+    tassert(kmem_cache_destroy(c) == 0);
+TEND
+
+T(kmem_cache_ignores_objects_from_a_different_cache) {
+    kmem_cache_t *c1 = kmem_cache_create("kctest1", sizeof(kc_test_obj_t), NULL, NULL);
+    kmem_cache_t *c2 = kmem_cache_create("kctest2", sizeof(kc_test_obj_t), NULL, NULL);
+    tassert(c1 != NULL && c2 != NULL);
+
+    void *o = kmem_cache_alloc(c1);
+    tassert(o != NULL);
+    kmem_cache_free(c2, o);
+    tassert(c1->active == 1);
+    tassert(c2->active == 0);
+    kmem_cache_free(c1, o);
+    tassert(c1->active == 0);
+
+    tassert(kmem_cache_destroy(c1) == 0);
+    tassert(kmem_cache_destroy(c2) == 0);
+TEND
+
+T(kmem_cache_static_caches_register_themselves_on_first_use) {
+    DEF_KMEM_CACHE(cache, "kcstatic", kc_test_obj_t, NULL, NULL);
+    tassert(!cache.registered);
+    void *o = kmem_cache_alloc(&cache);
+    tassert(o != NULL);
+    tassert(cache.registered);
+    tassert(cache.sysfs_dir != NULL);
+    kmem_cache_free(&cache, o);
+    tassert(cache.active == 0);
+TEND
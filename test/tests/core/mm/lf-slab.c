@@ -0,0 +1,198 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <test/test.h>
+#include <mm/lfslab.h>
+#include <process/core.h>
+#include <utils/utils.h>
+
+T(lfslab_returns_null_when_cannot_satisfy_mem_requirement) {
+    lfslab_t *slab = lfslab_create(1, sizeof(uint32_t));
+    tassert(slab != NULL);
+
+    uint32_t *v1 = lfslab_alloc(slab);
+    tassert(v1 != NULL);
+    uint32_t *v2 = lfslab_alloc(slab);
+    tassert(v2 == NULL);
+
+    lfslab_free(slab, v1);
+
+    v2 = lfslab_alloc(slab);
+    tassert(v2 != NULL);
+    lfslab_free(slab, v2);
+
+    lfslab_destroy(slab);
+TEND
+
+T(lfslab_cannot_create_empty_or_too_big_slab) {
+    tassert(lfslab_create(0, sizeof(uint32_t)) == NULL);
+    tassert(lfslab_create(1, 0) == NULL);
+    tassert(lfslab_create(LFS_MAX_ELEMS + 1, sizeof(uint32_t)) == NULL);
+TEND
+
+T(lfslab_freeing_or_destroying_null_slab_doesnt_crash_os) {
+    lfslab_t *slab = lfslab_create(1, sizeof(uint32_t));
+    tassert(slab != NULL);
+    lfslab_free(slab, NULL);
+    lfslab_destroy(slab);
+    lfslab_free(NULL, NULL);
+    lfslab_destroy(NULL);
+TEND
+
+T(lfslab_ignores_pointers_not_belonging_to_the_slab) {
+    lfslab_t *slab = lfslab_create(4, sizeof(uint32_t));
+    tassert(slab != NULL);
+    uint32_t *v = lfslab_alloc(slab);
+    tassert(v != NULL);
+    tassert(lfslab_get_avail_elems(slab) == 3);
+
+    uint32_t local;
+    lfslab_free(slab, &local);
+    lfslab_free(slab, (char *) v + 1);
+    tassert(lfslab_get_avail_elems(slab) == 3);
+
+    lfslab_free(slab, v);
+    tassert(lfslab_get_avail_elems(slab) == 4);
+    lfslab_destroy(slab);
+TEND
+
+T(lfslab_returns_correct_available_items) {
+    lfslab_t *slab = lfslab_create(10, sizeof(uint32_t));
+    tassert(slab != NULL);
+    tassert(lfslab_get_total_elems(slab) == 10);
+    tassert(lfslab_get_avail_elems(slab) == 10);
+
+    void *ptrs[10];
+    int i;
+    for (i = 0; i < ARRAYSIZE(ptrs); i++) {
+        ptrs[i] = lfslab_alloc(slab);
+        tassert(ptrs[i] != NULL);
+        tassert(lfslab_get_avail_elems(slab) == 10 - i - 1);
+    }
+    tassert(lfslab_alloc(slab) == NULL);
+
+    for (i = 0; i < ARRAYSIZE(ptrs); i++) {
+        lfslab_free(slab, ptrs[i]);
+        tassert(lfslab_get_avail_elems(slab) == i + 1);
+    }
+    lfslab_destroy(slab);
+TEND
+
+T(lfslab_hands_out_every_element_exactly_once) {
+    lfslab_t *slab = lfslab_create(64, sizeof(uint32_t));
+    tassert(slab != NULL);
+
+    bool seen[64] = { 0 };
+    int i;
+    for (i = 0; i < ARRAYSIZE(seen); i++) {
+        void *p = lfslab_alloc(slab);
+        tassert(p != NULL);
+        int32_t pos = lfslab_get_slab_position(slab, p);
+        tassert(pos >= 0 && pos < ARRAYSIZE(seen));
+        tassert(!seen[pos]);
+        seen[pos] = true;
+    }
+    tassert(lfslab_alloc(slab) == NULL);
+
+    for (i = 0; i < ARRAYSIZE(seen); i++) {
+        lfslab_free(slab, ((lf_slab_t *) slab)->data + i * sizeof(uint32_t));
+    }
+    tassert(lfslab_get_avail_elems(slab) == ARRAYSIZE(seen));
+    lfslab_destroy(slab);
+TEND
+
+
+#define STRESS_NPROCS 4
+#define STRESS_ELEMS 8
+#define STRESS_ITERATIONS 20000
+#define STRESS_BATCH 3
+
+typedef struct {
+    lfslab_t *slab;
+    atomic32_t errors;
+} stress_data_t;
+
+static int stress_alloc_free(void *data) {
+    stress_data_t *sd = (stress_data_t *) data;
+    uint32_t owner = (uint32_t) process_get_current()->pid;
+    uint32_t *ptrs[STRESS_BATCH];
+    int i;
+    int j;
+    for (i = 0; i < STRESS_ITERATIONS; i++) {
+        for (j = 0; j < STRESS_BATCH; j++) {
+            ptrs[j] = lfslab_alloc(sd->slab);
+            if (ptrs[j] != NULL) {
+                // Tag the element, any other process writing it means it was handed out twice
+                *ptrs[j] = owner;
+            }
+        }
+        for (j = 0; j < STRESS_BATCH; j++) {
+            if (ptrs[j] != NULL) {
+                if (*ptrs[j] != owner) {
+                    atomic32_inc(&sd->errors);
+                }
+                lfslab_free(sd->slab, ptrs[j]);
+            }
+        }
+    }
+    return 0;
+}
+
+T(lfslab_concurrent_alloc_free_never_hands_out_an_element_twice) {
+    stress_data_t sd;
+    // Fewer elements than STRESS_NPROCS * STRESS_BATCH so that the empty stack case is also exercised
+    sd.slab = lfslab_create(STRESS_ELEMS, sizeof(uint32_t));
+    tassert(sd.slab != NULL);
+    atomic32_init(&sd.errors, 0);
+
+    pcb_t *procs[STRESS_NPROCS];
+    int i;
+    for (i = 0; i < ARRAYSIZE(procs); i++) {
+        procs[i] = process_spawn_kernel_process("lfslab", stress_alloc_free, &sd,
+                        8196, process_get_current()->sched.priority);
+        tassert(procs[i] != NULL);
+    }
+    for (i = 0; i < ARRAYSIZE(procs); i++) {
+        process_wait_for(procs[i], NULL);
+    }
+
+    tassert(atomic32_get(&sd.errors) == 0);
+    tassert(lfslab_get_avail_elems(sd.slab) == STRESS_ELEMS);
+
+    // The free stack must still contain every element exactly once
+    bool seen[STRESS_ELEMS] = { 0 };
+    for (i = 0; i < STRESS_ELEMS; i++) {
+        void *p = lfslab_alloc(sd.slab);
+        tassert(p != NULL);
+        int32_t pos = lfslab_get_slab_position(sd.slab, p);
+        tassert(pos >= 0 && !seen[pos]);
+        seen[pos] = true;
+    }
+    tassert(lfslab_alloc(sd.slab) == NULL);
+
+    lfslab_destroy(sd.slab);
+TEND
@@ -0,0 +1,153 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <test/test.h>
+#include <mm/page.h>
+#include <mm/heap.h>
+
+T(page_alloc_returns_blocks_aligned_to_their_size) {
+    uint32_t avail = page_get_available();
+    uint8_t order;
+    for (order = 0; order <= 4; order++) {
+        char *p = page_alloc(order);
+        tassert(p != NULL);
+        tassert(((p - pa.start) & ((PAGE_SIZE << order) - 1)) == 0);
+        tassert(page_get_available() == avail - (PAGE_SIZE << order));
+        // Make sure the whole block is usable
+        memset(p, 0xab, PAGE_SIZE << order);
+        page_free(p);
+        tassert(page_get_available() == avail);
+    }
+TEND
+
+T(page_alloc_cannot_allocate_beyond_max_order) {
+    tassert(page_alloc(PAGE_MAX_ORDER + 1) == NULL);
+TEND
+
+T(page_alloc_coalesces_buddies_on_free) {
+    uint32_t nfree[PAGE_MAX_ORDER + 1];
+    memcpy(nfree, pa.nfree, sizeof(nfree));
+    uint32_t avail = page_get_available();
+
+    char *p1 = page_alloc(0);
+    char *p2 = page_alloc(0);
+    char *p3 = page_alloc(1);
+    tassert(p1 != NULL && p2 != NULL && p3 != NULL);
+    tassert(p1 != p2);
+
+    page_free(p2);
+    page_free(p3);
+    page_free(p1);
+
+    // Everything must be merged back into the same blocks we had before
+    tassert(page_get_available() == avail);
+    tassert(memcmp(nfree, pa.nfree, sizeof(nfree)) == 0);
+TEND
+
+T(page_alloc_ignores_invalid_and_double_frees) {
+    uint32_t avail = page_get_available();
+    char *p = page_alloc(1);
+    tassert(p != NULL);
+
+    page_free(p + 1);
+    page_free(p + PAGE_SIZE);
+    tassert(page_get_available() == avail - 2 * PAGE_SIZE);
+
+    page_free(p);
+    tassert(page_get_available() == avail);
+    page_free(p);
+    tassert(page_get_available() == avail);
+    page_free(NULL);
+TEND
+
+T(page_alloc_serves_big_mallocs) {
+    uint32_t avail = page_get_available();
+    char *p = malloc(CONFIG_MM_PAGE_ALLOC_THRESHOLD);
+    tassert(p != NULL);
+    tassert(page_get_available() < avail);
+    free(p);
+    tassert(page_get_available() == avail);
+
+    p = malloc(CONFIG_MM_PAGE_ALLOC_THRESHOLD / 2);
+    tassert(p != NULL);
+    tassert(page_get_available() == avail);
+    free(p);
+TEND
+
+T(page_alloc_zeroed_returns_zero_filled_blocks) {
+    char *p = page_alloc(1);
+    tassert(p != NULL);
+    memset(p, 0xab, 2 * PAGE_SIZE);
+    page_free(p);
+
+    // Whatever block we get, it must be zeroed, dirty or not
+    int n;
+    for (n = 0; n < 2; n++) {
+        uint32_t *z = page_alloc_zeroed(1);
+        tassert(z != NULL);
+        int i;
+        for (i = 0; i < 2 * PAGE_SIZE / sizeof(uint32_t); i++) {
+            tassert(z[i] == 0);
+        }
+        memset(z, 0xcd, 2 * PAGE_SIZE);
+        page_free(z);
+    }
+TEND
+
+T(page_alloc_freed_blocks_are_no_longer_zeroed) {
+    char *p = page_alloc(0);
+    tassert(p != NULL);
+    uint32_t idx = (p - pa.start) / PAGE_SIZE;
+    page_free(p);
+    tassert(!(pageinfo[idx] & PI_ZEROED));
+TEND
+
+T(page_alloc_reports_the_block_size) {
+    char *p = page_alloc(2);
+    tassert(p != NULL);
+    tassert(page_get_size(p) == 4 * PAGE_SIZE);
+    page_free(p);
+    tassert(page_get_size(p) == 0);
+TEND
+
+T(page_alloc_serves_big_reallocs_and_callocs) {
+    char *p = malloc(CONFIG_MM_PAGE_ALLOC_THRESHOLD);
+    tassert(p != NULL);
+    p[0] = 'x';
+    char *p2 = realloc(p, CONFIG_MM_PAGE_ALLOC_THRESHOLD + 1);
+    tassert(p2 != NULL);
+    tassert(p2[0] == 'x');
+    free(p2);
+
+    uint32_t *z = calloc(CONFIG_MM_PAGE_ALLOC_THRESHOLD / sizeof(uint32_t), sizeof(uint32_t));
+    tassert(z != NULL);
+    int i;
+    for (i = 0; i < CONFIG_MM_PAGE_ALLOC_THRESHOLD / sizeof(uint32_t); i++) {
+        tassert(z[i] == 0);
+    }
+    free(z);
+TEND
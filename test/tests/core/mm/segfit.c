@@ -0,0 +1,242 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdint.h>
+#include <test/test.h>
+#include <dstruct/list.h>
+
+static int get_num_blocks(void) {
+    uint32_t blocks = 0;
+    int i;
+    for (i = 0; i < ARRAYSIZE(classes); i++) {
+        list_head_t *pos;
+        list_for_each(pos, &classes[i]) {
+            blocks++;
+        }
+    }
+    return blocks;
+}
+
+T(segfit_size_class_is_floor_log2_of_size) {
+    tassert(size_class(1) == 0);
+    tassert(size_class(2) == 1);
+    tassert(size_class(3) == 1);
+    tassert(size_class(8) == 3);
+    tassert(size_class(15) == 3);
+    tassert(size_class(16) == 4);
+    tassert(size_class(4096) == 12);
+    tassert(size_class(0x80000000) == 31);
+    tassert(size_class(0xFFFFFFFF) == 31);
+TEND
+
+T(segfit_heap_reports_the_right_available_space) {
+    uint32_t avail = heap_get_available();
+
+    char *p = malloc(0);
+    tassert(p == NULL);
+    tassert(heap_get_available() == avail);
+    free(p);
+    tassert(heap_get_available() == avail);
+
+    p = malloc(10);
+    tassert(p != NULL);
+    // Payload is rounded up to SF_ALIGN bytes (and the block may not be split if the remainder
+    // is too small to hold another block)
+    tassert(heap_get_available() <= avail - 16);
+    free(p);
+    tassert(heap_get_available() == avail);
+TEND
+
+T(segfit_malloc_returns_null_when_cannot_satisfy_mem_req) {
+    uint32_t avail = heap_get_available();
+
+    char *p = malloc(avail + 1);
+    tassert(p == NULL);
+    tassert(heap_get_available() == avail);
+    free(p);
+    tassert(heap_get_available() == avail);
+TEND
+
+T(segfit_malloc_returns_aligned_chunks) {
+    char *p[8];
+    int i;
+    for (i = 0; i < ARRAYSIZE(p); i++) {
+        p[i] = _malloc(i * 3 + 1);
+        tassert(p[i] != NULL);
+        tassert(((uint32_t) p[i] & (SF_ALIGN - 1)) == 0);
+    }
+    for (i = 0; i < ARRAYSIZE(p); i++) {
+        _free(p[i]);
+    }
+TEND
+
+T(segfit_free_merges_adjacent_free_blocks) {
+    uint32_t avail = heap_get_available();
+    uint32_t blocks = get_num_blocks();
+
+    char *p[3];
+
+    p[0] = _malloc(64);
+    tassert(p[0] != NULL);
+    p[1] = _malloc(64);
+    tassert(p[1] != NULL);
+    p[2] = _malloc(64);
+    tassert(p[2] != NULL);
+
+    _free(p[0]);
+    _free(p[2]);
+    _free(p[1]);
+    tassert(get_num_blocks() == blocks);
+    tassert(heap_get_available() == avail);
+TEND
+
+T(segfit_freed_block_goes_back_to_its_size_class) {
+    // Keep a used block on both sides so that the freed one cannot be merged
+    char *left = _malloc(16);
+    tassert(left != NULL);
+    char *p = _malloc(100);
+    tassert(p != NULL);
+    char *right = _malloc(16);
+    tassert(right != NULL);
+
+    _free(p);
+    sf_block_t *b = ptr_to_block(p);
+    tassert(block_is_free(b));
+    tassert(bitset_array_lm_bit(classmap, ARRAYSIZE(classmap), size_class(block_size(b))));
+    tassert(ptr_to_block(right)->size & SF_FLAG_PREV_FREE);
+    tassert(ptr_to_block(right)->prev_size == block_size(b));
+
+    // Same size request must reuse the freed block
+    char *p2 = _malloc(100);
+    tassert(p2 == p);
+
+    _free(left);
+    _free(p2);
+    _free(right);
+TEND
+
+T(segfit_double_free_is_ignored) {
+    uint32_t avail = heap_get_available();
+    char *left = _malloc(16);
+    char *p = _malloc(32);
+    char *right = _malloc(16);
+    tassert(left != NULL && p != NULL && right != NULL);
+
+    _free(p);
+    uint32_t avail2 = heap_get_available();
+    _free(p);
+    tassert(heap_get_available() == avail2);
+
+    _free(left);
+    _free(right);
+    tassert(heap_get_available() == avail);
+TEND
+
+T(segfit_many_allocs_of_different_sizes_restore_the_heap) {
+    uint32_t avail = heap_get_available();
+    uint32_t blocks = get_num_blocks();
+
+    char *p[64];
+    int i;
+    for (i = 0; i < ARRAYSIZE(p); i++) {
+        p[i] = calloc(1, (i * 37) % 500 + 1);
+        tassert(p[i] != NULL);
+    }
+    // Free odd blocks first to create holes, then the rest
+    for (i = 1; i < ARRAYSIZE(p); i += 2) {
+        free(p[i]);
+    }
+    for (i = 0; i < ARRAYSIZE(p); i += 2) {
+        free(p[i]);
+    }
+
+    tassert(get_num_blocks() == blocks);
+    tassert(heap_get_available() == avail);
+TEND
+
+T(segfit_resize_grows_in_place_when_next_block_is_free) {
+    uint32_t avail = heap_get_available();
+    char *p = _malloc(64);
+    char *q = _malloc(64);
+    char *r = _malloc(64);
+    tassert(p != NULL && q != NULL && r != NULL);
+
+    // Next block in use
+    tassert(!_resize(p, 100));
+    tassert(heap_get_chunk_size(p) == 64);
+
+    _free(q);
+    tassert(_resize(p, 100));
+    tassert(heap_get_chunk_size(p) == 104);
+    // The remainder of q must still be a valid free block
+    sf_block_t *rem = block_next(ptr_to_block(p));
+    tassert(block_is_free(rem));
+    tassert(ptr_to_block(r)->size & SF_FLAG_PREV_FREE);
+    tassert(!_resize(p, 64 + SF_HDR_SIZE + 64 + 8));
+
+    // Shrinking merges the tail with the free block after it
+    uint32_t blocks = get_num_blocks();
+    tassert(_resize(p, 16));
+    tassert(heap_get_chunk_size(p) == 16);
+    tassert(get_num_blocks() == blocks);
+
+    _free(p);
+    _free(r);
+    tassert(heap_get_available() == avail);
+TEND
+
+T(segfit_memalign_returns_aligned_chunks) {
+    uint32_t avail = heap_get_available();
+    uint32_t blocks = get_num_blocks();
+
+    size_t align;
+    for (align = 1; align <= 4096; align <<= 1) {
+        char *p = _memalign(align, 100);
+        tassert(p != NULL);
+        tassert(((uintptr_t) p & (align - 1)) == 0);
+        tassert(heap_get_chunk_size(p) >= 100);
+        memset(p, 0xab, 100);
+        _free(p);
+    }
+    tassert(_memalign(24, 100) == NULL);
+
+    tassert(get_num_blocks() == blocks);
+    tassert(heap_get_available() == avail);
+TEND
+
+T(segfit_realloc_and_aligned_alloc_work_through_the_wrappers) {
+    char *p = aligned_alloc(64, 128);
+    tassert(p != NULL);
+    tassert(((uintptr_t) p & 63) == 0);
+    memset(p, 0x5a, 128);
+    p = realloc(p, 4096);
+    tassert(p != NULL);
+    int i;
+    for (i = 0; i < 128; i++) {
+        tassert((uint8_t) p[i] == 0x5a);
+    }
+    free(p);
+
+    tassert(calloc(0x10000, 0x10001) == NULL);
+TEND
@@ -38,9 +38,9 @@
 
 static bool is_process_active(pcb_t *pcb) {
     irqctx_t ctx;
-    spinlock_acquire(&_laritos.proc.pcbs_lock, &ctx);
+    rwlock_read_acquire(&_laritos.proc.pcbs_lock, &ctx);
     bool active = is_process_in(&pcb->sched.pcb_node, &_laritos.proc.pcbs);
-    spinlock_release(&_laritos.proc.pcbs_lock, &ctx);
+    rwlock_read_release(&_laritos.proc.pcbs_lock, &ctx);
     return active;
 }
 
@@ -231,7 +231,7 @@ T(process_orphan_proc_grandparent_becomes_new_parent) {
     pcb_t *pcb = NULL;
 
     irqctx_t ctx;
-    spinlock_acquire(&_laritos.proc.pcbs_lock, &ctx);
+    rwlock_read_acquire(&_laritos.proc.pcbs_lock, &ctx);
 
     for_each_process_locked(pcb) {
         if (pcb->pid == child_pid) {
@@ -239,7 +239,7 @@ T(process_orphan_proc_grandparent_becomes_new_parent) {
         }
     }
 
-    spinlock_release(&_laritos.proc.pcbs_lock, &ctx);
+    rwlock_read_release(&_laritos.proc.pcbs_lock, &ctx);
 
     tassert(pcb != NULL);
     tassert(is_process_active(pcb));
@@ -474,3 +474,49 @@ T(process_orphan_children_are_adopted_by_grandparent) {
         sleep(1);
     }
 TEND
+
+static int kthread_check_shared(void *data) {
+    pcb_t *leader = (pcb_t *) data;
+    pcb_t *cur = process_get_current();
+    return cur->leader == leader && cur->fs.fds_slab == leader->fs.fds_slab &&
+            process_get_leader(cur)->cwd == leader->cwd ? 12345 : 0;
+}
+
+T(process_kernel_thread_shares_fds_and_cwd_with_its_leader) {
+    pcb_t *cur = process_get_current();
+    pcb_t *leader = process_get_leader(cur);
+    pcb_t *t = process_spawn_kernel_thread("kthread", kthread_check_shared, leader,
+                        8196, cur->sched.priority - 1);
+    tassert(t != NULL);
+    tassert(t->leader == leader);
+
+    int status;
+    process_wait_for(t, &status);
+    tassert(status == 12345);
+    // The fd table of the leader must survive the thread
+    tassert(leader->fs.fds_slab != NULL);
+TEND
+
+static int kthread_spawn_thread(void *data) {
+    pcb_t *leader = (pcb_t *) data;
+    pcb_t *t = process_spawn_kernel_thread("kthread1", kthread_check_shared, leader,
+                        8196, process_get_current()->sched.priority);
+    if (t == NULL) {
+        return 0;
+    }
+    int status;
+    process_wait_for(t, &status);
+    return status;
+}
+
+T(process_kernel_thread_spawned_by_a_thread_shares_the_same_leader) {
+    pcb_t *cur = process_get_current();
+    pcb_t *leader = process_get_leader(cur);
+    pcb_t *t = process_spawn_kernel_thread("kthread0", kthread_spawn_thread, leader,
+                        8196, cur->sched.priority - 1);
+    tassert(t != NULL);
+
+    int status;
+    process_wait_for(t, &status);
+    tassert(status == 12345);
+TEND
@@ -0,0 +1,175 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <test/test.h>
+#include <process/core.h>
+#include <sched/core.h>
+#include <sched/cfs.h>
+#include <utils/utils.h>
+#include <generated/autoconf.h>
+
+static pcb_t fakepcbs[8];
+
+static void init_fake_pcbs(uint8_t priority) {
+    int i;
+    for (i = 0; i < ARRAYSIZE(fakepcbs); i++) {
+        memset(&fakepcbs[i], 0, sizeof(pcb_t));
+        INIT_LIST_HEAD(&fakepcbs[i].sched.sched_node);
+        rbnode_init(&fakepcbs[i].sched.fair_node);
+        fakepcbs[i].sched.priority = priority;
+    }
+}
+
+static void init_fair_rq(sched_runqueue_t *rq) {
+    sched_rq_init(rq);
+    rq->fair = true;
+}
+
+/**
+ * Simulates <nticks> scheduling decisions, each process picked runs for one tick
+ */
+static void run_ticks(sched_runqueue_t *rq, int nticks) {
+    int i;
+    for (i = 0; i < nticks; i++) {
+        pcb_t *pcb = sched_rq_first_locked(rq);
+        sched_rq_dequeue_locked(rq, pcb);
+        pcb->stats.ticks_spent[PROC_STATUS_RUNNING]++;
+        sched_rq_enqueue_locked(rq, pcb);
+    }
+}
+
+T(cfs_weight_decreases_with_priority) {
+    tassert(sched_cfs_get_weight(CONFIG_SCHED_PRIORITY_USER_DEFAULT) == 1024);
+    tassert(sched_cfs_get_weight(CONFIG_SCHED_PRIORITY_USER_DEFAULT - CONFIG_SCHED_CFS_PRIORITY_HALVING) == 2048);
+    tassert(sched_cfs_get_weight(CONFIG_SCHED_PRIORITY_USER_DEFAULT + CONFIG_SCHED_CFS_PRIORITY_HALVING) == 512);
+
+    int prio;
+    for (prio = 1; prio <= CONFIG_SCHED_PRIORITY_LOWEST; prio++) {
+        tassert(sched_cfs_get_weight(prio) > 0);
+        tassert(sched_cfs_get_weight(prio) <= sched_cfs_get_weight(prio - 1));
+    }
+TEND
+
+T(cfs_first_is_the_process_with_the_smallest_vruntime) {
+    sched_runqueue_t rq;
+    init_fair_rq(&rq);
+    init_fake_pcbs(CONFIG_SCHED_PRIORITY_USER_DEFAULT);
+
+    tassert(sched_rq_first_locked(&rq) == NULL);
+
+    int i;
+    for (i = 0; i < ARRAYSIZE(fakepcbs); i++) {
+        fakepcbs[i].sched.vruntime = (ARRAYSIZE(fakepcbs) - i) * 1024;
+        sched_rq_enqueue_locked(&rq, &fakepcbs[i]);
+        tassert(sched_rq_first_locked(&rq) == &fakepcbs[i]);
+    }
+    tassert(rq.nready == ARRAYSIZE(fakepcbs));
+
+    for (i = ARRAYSIZE(fakepcbs) - 1; i >= 0; i--) {
+        tassert(sched_rq_first_locked(&rq) == &fakepcbs[i]);
+        sched_rq_dequeue_locked(&rq, &fakepcbs[i]);
+        // Dequeuing twice must be harmless
+        sched_rq_dequeue_locked(&rq, &fakepcbs[i]);
+    }
+    tassert(rq.nready == 0);
+    tassert(sched_rq_first_locked(&rq) == NULL);
+TEND
+
+T(cfs_idle_process_only_runs_when_nobody_else_is_ready) {
+    sched_runqueue_t rq;
+    init_fair_rq(&rq);
+    init_fake_pcbs(CONFIG_SCHED_PRIORITY_USER_DEFAULT);
+
+    pcb_t *idle = &fakepcbs[0];
+    idle->sched.priority = CONFIG_SCHED_PRIORITY_LOWEST;
+    sched_rq_enqueue_locked(&rq, idle);
+    fakepcbs[1].sched.vruntime = 1000000;
+    sched_rq_enqueue_locked(&rq, &fakepcbs[1]);
+
+    tassert(sched_rq_first_locked(&rq) == &fakepcbs[1]);
+    tassert(sched_rq_should_preempt_locked(&rq, idle, &fakepcbs[1]));
+    tassert(!sched_rq_should_preempt_locked(&rq, &fakepcbs[1], idle));
+
+    sched_rq_dequeue_locked(&rq, &fakepcbs[1]);
+    tassert(sched_rq_first_locked(&rq) == idle);
+TEND
+
+T(cfs_equal_priority_processes_get_the_same_cpu_time) {
+    sched_runqueue_t rq;
+    init_fair_rq(&rq);
+    init_fake_pcbs(CONFIG_SCHED_PRIORITY_USER_DEFAULT);
+
+    int i;
+    for (i = 0; i < ARRAYSIZE(fakepcbs); i++) {
+        sched_rq_enqueue_locked(&rq, &fakepcbs[i]);
+    }
+
+    run_ticks(&rq, ARRAYSIZE(fakepcbs) * 100);
+
+    for (i = 0; i < ARRAYSIZE(fakepcbs); i++) {
+        tassert(fakepcbs[i].stats.ticks_spent[PROC_STATUS_RUNNING] == 100);
+    }
+TEND
+
+T(cfs_cpu_time_is_proportional_to_the_weight) {
+    sched_runqueue_t rq;
+    init_fair_rq(&rq);
+    init_fake_pcbs(CONFIG_SCHED_PRIORITY_USER_DEFAULT);
+
+    pcb_t *heavy = &fakepcbs[0];
+    pcb_t *light = &fakepcbs[1];
+    heavy->sched.priority = CONFIG_SCHED_PRIORITY_USER_DEFAULT - CONFIG_SCHED_CFS_PRIORITY_HALVING;
+    sched_rq_enqueue_locked(&rq, heavy);
+    sched_rq_enqueue_locked(&rq, light);
+
+    run_ticks(&rq, 300);
+
+    // Twice the weight, twice the cpu time
+    tick_t hticks = heavy->stats.ticks_spent[PROC_STATUS_RUNNING];
+    tick_t lticks = light->stats.ticks_spent[PROC_STATUS_RUNNING];
+    tassert(hticks + lticks == 300);
+    tassert(hticks >= 199 && hticks <= 201);
+TEND
+
+T(cfs_waking_process_does_not_monopolize_the_cpu) {
+    sched_runqueue_t rq;
+    init_fair_rq(&rq);
+    init_fake_pcbs(CONFIG_SCHED_PRIORITY_USER_DEFAULT);
+
+    sched_rq_enqueue_locked(&rq, &fakepcbs[0]);
+    sched_rq_enqueue_locked(&rq, &fakepcbs[1]);
+    run_ticks(&rq, 1000);
+
+    // A process that has never run (vruntime=0) is placed next to the others
+    sched_rq_enqueue_locked(&rq, &fakepcbs[2]);
+    tassert(fakepcbs[2].sched.vruntime + CONFIG_SCHED_CFS_GRANULARITY * 1024 >= rq.min_vruntime);
+
+    run_ticks(&rq, 30);
+    tassert(fakepcbs[0].stats.ticks_spent[PROC_STATUS_RUNNING] > 500);
+    tassert(fakepcbs[1].stats.ticks_spent[PROC_STATUS_RUNNING] > 500);
+    tassert(fakepcbs[2].stats.ticks_spent[PROC_STATUS_RUNNING] <= 10 + CONFIG_SCHED_CFS_GRANULARITY);
+TEND
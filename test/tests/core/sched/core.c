@@ -0,0 +1,247 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <test/test.h>
+#include <process/core.h>
+#include <sched/core.h>
+#include <cpu/core.h>
+#include <utils/latency.h>
+#include <utils/utils.h>
+#include <generated/autoconf.h>
+
+static pcb_t fakepcbs[32];
+
+static void init_fake_pcbs(void) {
+    int i;
+    for (i = 0; i < ARRAYSIZE(fakepcbs); i++) {
+        memset(&fakepcbs[i], 0, sizeof(pcb_t));
+        INIT_LIST_HEAD(&fakepcbs[i].sched.sched_node);
+        // Spread them over the whole priority range
+        fakepcbs[i].sched.priority = (i * 37) % SCHED_NUM_PRIORITIES;
+    }
+}
+
+T(sched_rq_first_returns_the_highest_priority_process) {
+    sched_runqueue_t rq;
+    sched_rq_init(&rq);
+    init_fake_pcbs();
+    tassert(sched_rq_first_locked(&rq) == NULL);
+
+    int i;
+    pcb_t *best = NULL;
+    for (i = 0; i < ARRAYSIZE(fakepcbs); i++) {
+        sched_rq_enqueue_locked(&rq, &fakepcbs[i]);
+        if (best == NULL || fakepcbs[i].sched.priority < best->sched.priority) {
+            best = &fakepcbs[i];
+        }
+        tassert(sched_rq_first_locked(&rq) == best);
+    }
+    tassert(rq.nready == ARRAYSIZE(fakepcbs));
+
+    // Dequeuing in priority order must return the processes sorted by priority
+    uint8_t prev = 0;
+    for (i = 0; i < ARRAYSIZE(fakepcbs); i++) {
+        pcb_t *p = sched_rq_first_locked(&rq);
+        tassert(p != NULL);
+        tassert(p->sched.priority >= prev);
+        prev = p->sched.priority;
+        sched_rq_dequeue_locked(&rq, p);
+    }
+    tassert(sched_rq_first_locked(&rq) == NULL);
+    tassert(rq.nready == 0);
+    tassert(rq.summary == 0);
+TEND
+
+T(sched_rq_processes_with_the_same_priority_are_fifo) {
+    sched_runqueue_t rq;
+    sched_rq_init(&rq);
+    init_fake_pcbs();
+
+    int i;
+    for (i = 0; i < 4; i++) {
+        fakepcbs[i].sched.priority = 10;
+        sched_rq_enqueue_locked(&rq, &fakepcbs[i]);
+    }
+    for (i = 0; i < 4; i++) {
+        tassert(sched_rq_first_locked(&rq) == &fakepcbs[i]);
+        sched_rq_dequeue_locked(&rq, &fakepcbs[i]);
+    }
+TEND
+
+T(sched_rq_dequeue_keeps_the_bitmap_consistent) {
+    sched_runqueue_t rq;
+    sched_rq_init(&rq);
+    init_fake_pcbs();
+
+    fakepcbs[0].sched.priority = 40;
+    fakepcbs[1].sched.priority = 40;
+    fakepcbs[2].sched.priority = 200;
+    sched_rq_enqueue_locked(&rq, &fakepcbs[0]);
+    sched_rq_enqueue_locked(&rq, &fakepcbs[1]);
+    sched_rq_enqueue_locked(&rq, &fakepcbs[2]);
+
+    sched_rq_dequeue_locked(&rq, &fakepcbs[0]);
+    tassert(bitset_array_lm_bit(rq.prio_map, ARRAYSIZE(rq.prio_map), 40));
+    sched_rq_dequeue_locked(&rq, &fakepcbs[1]);
+    tassert(!bitset_array_lm_bit(rq.prio_map, ARRAYSIZE(rq.prio_map), 40));
+    tassert(!bitset_lm_bit(rq.summary, 40 / BITSET_NBITS));
+    // Dequeuing twice is harmless
+    sched_rq_dequeue_locked(&rq, &fakepcbs[1]);
+    tassert(rq.nready == 1);
+    tassert(sched_rq_first_locked(&rq) == &fakepcbs[2]);
+    sched_rq_dequeue_locked(&rq, &fakepcbs[2]);
+    tassert(sched_rq_first_locked(&rq) == NULL);
+TEND
+
+T(sched_rq_enqueue_and_pick_latency_with_many_ready_processes) {
+    sched_runqueue_t rq;
+    sched_rq_init(&rq);
+    init_fake_pcbs();
+
+    int i;
+    for (i = 1; i < ARRAYSIZE(fakepcbs); i++) {
+        sched_rq_enqueue_locked(&rq, &fakepcbs[i]);
+    }
+    // Worst case for a sorted list: lowest priority, goes after everyone else
+    fakepcbs[0].sched.priority = CONFIG_SCHED_PRIORITY_LOWEST;
+    for (i = 0; i < 1000; i++) {
+        LATENCY("enqueue+pick+dequeue (31 ready)", {
+            sched_rq_enqueue_locked(&rq, &fakepcbs[0]);
+            tassert(sched_rq_first_locked(&rq) != NULL);
+            sched_rq_dequeue_locked(&rq, &fakepcbs[0]);
+        });
+    }
+TEND
+
+T(sched_quantum_depends_on_the_priority_band) {
+    tassert(sched_get_quantum(CONFIG_SCHED_PRIORITY_MAX_KERNEL) == CONFIG_SCHED_QUANTUM_KERNEL);
+    tassert(sched_get_quantum(CONFIG_SCHED_PRIORITY_MAX_USER - 1) == CONFIG_SCHED_QUANTUM_KERNEL);
+    tassert(sched_get_quantum(CONFIG_SCHED_PRIORITY_MAX_USER) == CONFIG_SCHED_QUANTUM_USER_HIGH);
+    tassert(sched_get_quantum(CONFIG_SCHED_PRIORITY_USER_DEFAULT) == CONFIG_SCHED_QUANTUM_USER);
+    tassert(sched_get_quantum(CONFIG_SCHED_PRIORITY_LOWEST) == CONFIG_SCHED_QUANTUM_USER);
+TEND
+
+T(sched_rq_first_migratable_respects_the_affinity_mask) {
+    sched_runqueue_t rq;
+    sched_rq_init(&rq);
+    init_fake_pcbs();
+    tassert(sched_rq_first_migratable_locked(&rq, 1) == NULL);
+
+    int i;
+    pcb_t *best = NULL;
+    for (i = 0; i < ARRAYSIZE(fakepcbs); i++) {
+        // Pin every other process to cpu #0
+        fakepcbs[i].sched.affinity = i % 2 == 0 ? BIT_FOR_CPU(0) : CPU_ALL_MASK;
+        sched_rq_enqueue_locked(&rq, &fakepcbs[i]);
+        if (sched_can_run_on(&fakepcbs[i], 1) &&
+                (best == NULL || fakepcbs[i].sched.priority < best->sched.priority)) {
+            best = &fakepcbs[i];
+        }
+        tassert(sched_rq_first_migratable_locked(&rq, 1) == best);
+        tassert(sched_rq_first_migratable_locked(&rq, 0) == sched_rq_first_locked(&rq));
+    }
+
+    // Only processes pinned to cpu #0 left
+    for (i = 1; i < ARRAYSIZE(fakepcbs); i += 2) {
+        sched_rq_dequeue_locked(&rq, &fakepcbs[i]);
+    }
+    tassert(sched_rq_first_migratable_locked(&rq, 1) == NULL);
+    tassert(sched_rq_first_migratable_locked(&rq, 0) != NULL);
+TEND
+
+T(sched_rq_first_migratable_skips_processes_whose_context_is_still_on_a_cpu) {
+    sched_runqueue_t rq;
+    sched_rq_init(&rq);
+    init_fake_pcbs();
+
+    fakepcbs[0].sched.priority = 1;
+    fakepcbs[1].sched.priority = 2;
+    fakepcbs[0].sched.affinity = CPU_ALL_MASK;
+    fakepcbs[1].sched.affinity = CPU_ALL_MASK;
+    sched_rq_enqueue_locked(&rq, &fakepcbs[0]);
+    sched_rq_enqueue_locked(&rq, &fakepcbs[1]);
+    tassert(sched_rq_first_migratable_locked(&rq, 1) == &fakepcbs[0]);
+
+    // Preempted, but not switched out yet
+    fakepcbs[0].sched.on_cpu = true;
+    tassert(sched_rq_first_migratable_locked(&rq, 1) == &fakepcbs[1]);
+    // It can still be picked by its own cpu
+    tassert(sched_rq_first_locked(&rq) == &fakepcbs[0]);
+
+    fakepcbs[0].sched.on_cpu = false;
+    sched_rq_dequeue_locked(&rq, &fakepcbs[0]);
+    sched_rq_dequeue_locked(&rq, &fakepcbs[1]);
+    tassert(sched_rq_first_locked(&rq) == NULL);
+TEND
+
+static int yielder(void *data) {
+    int i;
+    for (i = 0; i < 1000; i++) {
+        LATENCY("schedule() ping-pong", {
+            schedule();
+        });
+    }
+    return 0;
+}
+
+static int filler(void *data) {
+    return 0;
+}
+
+T(sched_equal_priority_wakeup_does_not_preempt_the_running_process) {
+    uint32_t avoided = atomic32_get(&_laritos.stats.avoided_switches);
+    pcb_t *p = process_spawn_kernel_process("eqprio", filler, NULL,
+                        8196, process_get_current()->sched.priority);
+    tassert(p != NULL);
+    // The new process had to wait for the current time slice to finish
+    tassert(atomic32_get(&_laritos.stats.avoided_switches) > avoided);
+    process_wait_for(p, NULL);
+TEND
+
+T(sched_context_switch_latency) {
+    // Lower priority processes stay READY while the benchmark runs
+    pcb_t *fillers[16];
+    int i;
+    for (i = 0; i < ARRAYSIZE(fillers); i++) {
+        fillers[i] = process_spawn_kernel_process("filler", filler, NULL,
+                            8196, process_get_current()->sched.priority + 1);
+        tassert(fillers[i] != NULL);
+    }
+
+    pcb_t *p1 = process_spawn_kernel_process("yield1", yielder, NULL,
+                        8196, process_get_current()->sched.priority - 1);
+    tassert(p1 != NULL);
+    pcb_t *p2 = process_spawn_kernel_process("yield2", yielder, NULL,
+                        8196, process_get_current()->sched.priority - 1);
+    tassert(p2 != NULL);
+
+    process_wait_for(p1, NULL);
+    process_wait_for(p2, NULL);
+    for (i = 0; i < ARRAYSIZE(fillers); i++) {
+        process_wait_for(fillers[i], NULL);
+    }
+TEND
@@ -0,0 +1,105 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <log.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <test/test.h>
+#include <irq/core.h>
+#include <process/core.h>
+#include <sched/core.h>
+#include <sched/workqueue.h>
+#include <time/core.h>
+#include <generated/autoconf.h>
+
+typedef struct {
+    work_t work;
+    uint32_t runs;
+    pcb_t *runner;
+    bool irqs_enabled;
+} test_work_t;
+
+static void count_work(work_t *work) {
+    test_work_t *tw = (test_work_t *) work->data;
+    tw->runs++;
+    tw->runner = process_get_current();
+    tw->irqs_enabled = irq_is_enabled();
+}
+
+T(workqueue_queued_work_is_run_by_a_worker_in_process_mode) {
+    test_work_t tw = { 0 };
+    work_init(&tw.work, count_work, &tw);
+
+    tassert(workqueue_queue(&tw.work));
+    sleep(1);
+
+    tassert(tw.runs == 1);
+    tassert(tw.runner != NULL);
+    tassert(tw.runner != process_get_current());
+    tassert(tw.irqs_enabled);
+    tassert(!work_is_pending(&tw.work));
+TEND
+
+T(workqueue_pending_work_is_only_queued_once) {
+    test_work_t tw = { 0 };
+    work_init(&tw.work, count_work, &tw);
+
+    // Keep irqs disabled so that no worker can run in between
+    irqctx_t ctx;
+    irq_disable_local_and_save_ctx(&ctx);
+    tassert(workqueue_queue(&tw.work));
+    tassert(work_is_pending(&tw.work));
+    tassert(!workqueue_queue(&tw.work));
+    irq_local_restore_ctx(&ctx);
+    sleep(1);
+
+    tassert(tw.runs == 1);
+    tassert(!work_is_pending(&tw.work));
+
+    // Once it ran, the work can be queued again
+    tassert(workqueue_queue(&tw.work));
+    sleep(1);
+    tassert(tw.runs == 2);
+TEND
+
+T(workqueue_work_runs_in_the_order_it_was_queued) {
+    test_work_t tw[4] = { 0 };
+    int i;
+    irqctx_t ctx;
+    irq_disable_local_and_save_ctx(&ctx);
+    for (i = 0; i < ARRAYSIZE(tw); i++) {
+        work_init(&tw[i].work, count_work, &tw[i]);
+        tassert(workqueue_queue(&tw[i].work));
+    }
+    sched_workqueue_t *wq = CPU_LOCAL_GET_PTR_LOCKED(_laritos.sched.wq);
+    work_t *w = wq->head;
+    for (i = 0; i < ARRAYSIZE(tw) && w != NULL; i++, w = w->next) {
+        tassert(w == &tw[i].work);
+    }
+    irq_local_restore_ctx(&ctx);
+    sleep(1);
+
+    for (i = 0; i < ARRAYSIZE(tw); i++) {
+        tassert(tw[i].runs == 1);
+    }
+TEND
@@ -0,0 +1,108 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <test/test.h>
+#include <sync/futex.h>
+#include <process/core.h>
+#include <process/status.h>
+#include <sched/core.h>
+#include <time/core.h>
+
+static int futex_waiter(void *data) {
+    volatile int32_t *word = data;
+    // Spurious returns are allowed, check the value again like a real lock would
+    while (*word == 0) {
+        if (futex_wait(word, 0) < 0 && *word == 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static bool wait_blocked(pcb_t *pcb) {
+    int i;
+    for (i = 0; i < 100 && pcb->sched.status != PROC_STATUS_BLOCKED; i++) {
+        msleep(10);
+    }
+    return pcb->sched.status == PROC_STATUS_BLOCKED;
+}
+
+T(futex_wait_returns_right_away_if_the_value_changed) {
+    int32_t word = 1;
+    tassert(futex_wait(&word, 0) < 0);
+TEND
+
+T(futex_rejects_invalid_addresses) {
+    tassert(futex_wait(NULL, 0) < 0);
+    tassert(futex_wake(NULL, 1) < 0);
+    int32_t words[2];
+    tassert(futex_wake((int32_t *) ((char *) words + 1), 1) < 0);
+TEND
+
+T(futex_wake_without_waiters_wakes_nobody) {
+    int32_t word = 0;
+    tassert(futex_wake(&word, 1) == 0);
+TEND
+
+T(futex_wait_blocks_until_woken_up) {
+    static int32_t word;
+    word = 0;
+    pcb_t *p = process_spawn_kernel_process("fwait", futex_waiter, &word,
+                        8196, process_get_current()->sched.priority - 1);
+    tassert(p != NULL);
+    schedule();
+    tassert(wait_blocked(p));
+
+    word = 1;
+    tassert(futex_wake(&word, 1) == 1);
+
+    int status;
+    process_wait_for(p, &status);
+    tassert(status == 0);
+TEND
+
+T(futex_wake_only_wakes_up_to_the_requested_number_of_waiters_of_the_address) {
+    static int32_t word;
+    static int32_t other;
+    word = 0;
+    other = 0;
+    pcb_t *p0 = process_spawn_kernel_process("fwait0", futex_waiter, &word,
+                        8196, process_get_current()->sched.priority - 1);
+    tassert(p0 != NULL);
+    pcb_t *p1 = process_spawn_kernel_process("fwait1", futex_waiter, &word,
+                        8196, process_get_current()->sched.priority - 1);
+    tassert(p1 != NULL);
+    schedule();
+    tassert(wait_blocked(p0));
+    tassert(wait_blocked(p1));
+
+    tassert(futex_wake(&other, 2) == 0);
+    word = 1;
+    tassert(futex_wake(&word, 1) == 1);
+    tassert(futex_wake(&word, 2) == 1);
+
+    process_wait_for(p0, NULL);
+    process_wait_for(p1, NULL);
+TEND
@@ -0,0 +1,144 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <test/test.h>
+#include <core.h>
+#include <dstruct/list.h>
+#include <irq/core.h>
+#include <sched/core.h>
+#include <sync/rcu.h>
+#include <time/core.h>
+#include <utils/utils.h>
+
+typedef struct {
+    int value;
+    list_head_t list;
+    rcu_head_t rcu;
+} rcu_test_node_t;
+
+static volatile int freed;
+
+static void rcu_test_free(rcu_head_t *head) {
+    rcu_test_node_t *n = container_of(head, rcu_test_node_t, rcu);
+    freed += n->value;
+}
+
+static bool wait_freed(int expected) {
+    int i;
+    for (i = 0; i < 100 && freed != expected; i++) {
+        msleep(10);
+    }
+    return freed == expected;
+}
+
+T(rcu_read_lock_disables_preemption_but_not_irqs) {
+    uint32_t count = CPU_LOCAL_GET(_laritos.sched.preempt_count);
+    rcu_read_lock();
+    tassert(irq_is_enabled());
+    tassert(CPU_LOCAL_GET(_laritos.sched.preempt_count) == count + 1);
+    rcu_read_lock();
+    tassert(CPU_LOCAL_GET(_laritos.sched.preempt_count) == count + 2);
+    rcu_read_unlock();
+    rcu_read_unlock();
+    tassert(CPU_LOCAL_GET(_laritos.sched.preempt_count) == count);
+TEND
+
+T(rcu_list_walk_sees_the_entries_added) {
+    LIST_HEAD(head);
+    rcu_test_node_t nodes[3];
+    int i;
+    for (i = 0; i < ARRAYSIZE(nodes); i++) {
+        nodes[i].value = i + 1;
+        list_add_tail_rcu(&nodes[i].list, &head);
+    }
+
+    int sum = 0;
+    rcu_read_lock();
+    rcu_test_node_t *n;
+    list_for_each_entry_rcu(n, &head, list) {
+        sum = sum * 10 + n->value;
+    }
+    rcu_read_unlock();
+    tassert(sum == 123);
+TEND
+
+T(rcu_list_walk_can_move_forward_from_a_deleted_entry) {
+    LIST_HEAD(head);
+    rcu_test_node_t nodes[3];
+    int i;
+    for (i = 0; i < ARRAYSIZE(nodes); i++) {
+        nodes[i].value = i + 1;
+        list_add_tail_rcu(&nodes[i].list, &head);
+    }
+
+    int sum = 0;
+    rcu_read_lock();
+    rcu_test_node_t *n;
+    list_for_each_entry_rcu(n, &head, list) {
+        if (n->value == 2) {
+            // The reader is still on this entry
+            list_del_rcu(&n->list);
+        }
+        sum = sum * 10 + n->value;
+    }
+    rcu_read_unlock();
+    tassert(sum == 123);
+
+    sum = 0;
+    list_for_each_entry_rcu(n, &head, list) {
+        sum = sum * 10 + n->value;
+    }
+    tassert(sum == 13);
+TEND
+
+T(rcu_call_rcu_runs_the_callbacks_after_a_grace_period) {
+    freed = 0;
+    rcu_test_node_t nodes[2] = { { .value = 1 }, { .value = 2 } };
+    call_rcu(&nodes[0].rcu, rcu_test_free);
+    call_rcu(&nodes[1].rcu, rcu_test_free);
+    tassert(wait_freed(3));
+TEND
+
+T(rcu_callbacks_are_not_run_inside_a_read_side_critical_section) {
+    freed = 0;
+    rcu_test_node_t node = { .value = 1 };
+
+    rcu_read_lock();
+    call_rcu(&node.rcu, rcu_test_free);
+    // Without preemption, the worker cannot run on this cpu and no grace period can complete
+    bool early = false;
+    int i;
+    for (i = 0; i < 1000000 && !early; i++) {
+        early = freed != 0;
+    }
+    rcu_read_unlock();
+    tassert(!early);
+    tassert(wait_freed(1));
+TEND
+
+T(rcu_synchronize_rcu_returns_when_there_are_no_readers) {
+    synchronize_rcu();
+    synchronize_rcu();
+TEND
@@ -211,3 +211,76 @@ T(rmutex_blocked_proc_with_the_highest_priority_acquires_mutex_after_it_is_relea
 
     rmutex_release(&m);
 TEND
+
+T(rmutex_owner_inherits_the_priority_of_the_highest_priority_waiter) {
+    rmutex_t m;
+    rmutex_init(&m);
+    pcb_t *cur = process_get_current();
+    uint8_t prio = cur->sched.base_priority;
+    rmutex_acquire(&m);
+
+    pcb_t *p0 = process_spawn_kernel_process("pi0", proc_acquire, &m, 8196, prio - 1);
+    tassert(p0 != NULL);
+    schedule();
+    tassert(cur->sched.priority == prio - 1);
+    tassert(cur->sched.base_priority == prio);
+
+    pcb_t *p1 = process_spawn_kernel_process("pi1", proc_acquire, &m, 8196, prio - 3);
+    tassert(p1 != NULL);
+    schedule();
+    tassert(cur->sched.priority == prio - 3);
+    tassert(cur->sched.base_priority == prio);
+
+    rmutex_release(&m);
+    tassert(cur->sched.priority == prio);
+
+    process_wait_for(p0, NULL);
+    process_wait_for(p1, NULL);
+    tassert(m.lock_count == 0);
+    tassert(cur->sched.priority == prio);
+TEND
+
+typedef struct {
+    rmutex_t inner;
+    rmutex_t outer;
+} pi_chain_t;
+
+static int proc_acquire_chain(void *data) {
+    pi_chain_t *chain = (pi_chain_t *) data;
+    rmutex_acquire(&chain->outer);
+    rmutex_acquire(&chain->inner);
+    rmutex_release(&chain->inner);
+    rmutex_release(&chain->outer);
+    return 0;
+}
+
+T(rmutex_priority_inheritance_is_propagated_along_the_chain_of_owners) {
+    pi_chain_t chain;
+    rmutex_init(&chain.inner);
+    rmutex_init(&chain.outer);
+    pcb_t *cur = process_get_current();
+    uint8_t prio = cur->sched.base_priority;
+    rmutex_acquire(&chain.inner);
+
+    // p0 takes <outer> and blocks on <inner>, owned by the test process
+    pcb_t *p0 = process_spawn_kernel_process("pich0", proc_acquire_chain, &chain, 8196, prio - 1);
+    tassert(p0 != NULL);
+    schedule();
+    tassert(chain.outer.owner == p0);
+    tassert(cur->sched.priority == prio - 1);
+
+    // p1 blocks on <outer>, both p0 and the test process inherit its priority
+    pcb_t *p1 = process_spawn_kernel_process("pich1", proc_acquire, &chain.outer, 8196, prio - 3);
+    tassert(p1 != NULL);
+    schedule();
+    tassert(p0->sched.priority == prio - 3);
+    tassert(cur->sched.priority == prio - 3);
+
+    rmutex_release(&chain.inner);
+    tassert(cur->sched.priority == prio);
+
+    process_wait_for(p0, NULL);
+    process_wait_for(p1, NULL);
+    tassert(chain.inner.lock_count == 0);
+    tassert(chain.outer.lock_count == 0);
+TEND
@@ -0,0 +1,175 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <test/test.h>
+#include <core.h>
+#include <cpu/core.h>
+#include <sync/rwlock.h>
+#include <irq/core.h>
+#include <process/core.h>
+#include <sched/core.h>
+#include <utils/utils.h>
+#include <generated/autoconf.h>
+
+T(rwlock_read_acquire_disables_irqs_and_release_restores_them) {
+    rwlock_t l;
+    rwlock_init(&l);
+    tassert(!rwlock_is_read_locked(&l));
+    tassert(irq_is_enabled());
+
+    irqctx_t ctx;
+    rwlock_read_acquire(&l, &ctx);
+    tassert(rwlock_is_read_locked(&l));
+    tassert(!rwlock_is_write_locked(&l));
+    tassert(!irq_is_enabled());
+    rwlock_read_release(&l, &ctx);
+    tassert(!rwlock_is_read_locked(&l));
+    tassert(irq_is_enabled());
+TEND
+
+T(rwlock_write_acquire_disables_irqs_and_release_restores_them) {
+    rwlock_t l;
+    rwlock_init(&l);
+    tassert(!rwlock_is_write_locked(&l));
+
+    irqctx_t ctx;
+    rwlock_write_acquire(&l, &ctx);
+    tassert(rwlock_is_write_locked(&l));
+    tassert(!rwlock_is_read_locked(&l));
+    tassert(!irq_is_enabled());
+    rwlock_write_release(&l, &ctx);
+    tassert(!rwlock_is_write_locked(&l));
+    tassert(irq_is_enabled());
+TEND
+
+T(rwlock_can_be_reacquired_after_being_released) {
+    rwlock_t l;
+    rwlock_init(&l);
+
+    irqctx_t ctx;
+    int i;
+    for (i = 0; i < 3; i++) {
+        rwlock_write_acquire(&l, &ctx);
+        rwlock_write_release(&l, &ctx);
+        rwlock_read_acquire(&l, &ctx);
+        rwlock_read_release(&l, &ctx);
+    }
+    tassert(atomic32_get(&l.state) == 0);
+    tassert(atomic32_get(&l.writers_waiting) == 0);
+TEND
+
+#ifdef CONFIG_SMP
+#define RWLOCK_TEST_SPINS 100000000
+
+static rwlock_t shared;
+static bool volatile started;
+static bool volatile go;
+static bool volatile done;
+
+static int other_reader(void *data) {
+    started = true;
+    while (!go);
+    irqctx_t ctx;
+    rwlock_read_acquire(&shared, &ctx);
+    done = true;
+    rwlock_read_release(&shared, &ctx);
+    return 0;
+}
+
+static int other_writer(void *data) {
+    started = true;
+    while (!go);
+    irqctx_t ctx;
+    rwlock_write_acquire(&shared, &ctx);
+    done = true;
+    rwlock_write_release(&shared, &ctx);
+    return 0;
+}
+
+/**
+ * Launches <main> on another cpu and waits until it is running there
+ */
+static pcb_t *run_on_other_cpu(int (*main)(void *)) {
+    uint8_t other = cpu_get_id() == 0 ? 1 : 0;
+    started = false;
+    go = false;
+    done = false;
+    rwlock_init(&shared);
+    // Lower priority, so that it never gets to run on this cpu before being moved
+    pcb_t *pcb = process_spawn_kernel_process("rwlock", main, NULL,
+                        8196, process_get_current()->sched.priority + 1);
+    if (pcb == NULL) {
+        return NULL;
+    }
+    process_set_affinity(pcb, BIT_FOR_CPU(other));
+    while (!started) {
+        schedule();
+    }
+    return pcb;
+}
+
+static bool wait_done(void) {
+    int i;
+    for (i = 0; i < RWLOCK_TEST_SPINS && !done; i++);
+    return done;
+}
+
+T(rwlock_readers_on_different_cpus_do_not_block_each_other) {
+    uint8_t other = cpu_get_id() == 0 ? 1 : 0;
+    if (!(_laritos.sched.online & BIT_FOR_CPU(other))) {
+        return TEST_SKIP;
+    }
+    pcb_t *pcb = run_on_other_cpu(other_reader);
+    tassert(pcb != NULL);
+
+    irqctx_t ctx;
+    rwlock_read_acquire(&shared, &ctx);
+    go = true;
+    bool read_concurrently = wait_done();
+    rwlock_read_release(&shared, &ctx);
+
+    process_wait_for(pcb, NULL);
+    tassert(read_concurrently);
+TEND
+
+T(rwlock_writer_waits_until_the_last_reader_leaves) {
+    uint8_t other = cpu_get_id() == 0 ? 1 : 0;
+    if (!(_laritos.sched.online & BIT_FOR_CPU(other))) {
+        return TEST_SKIP;
+    }
+    pcb_t *pcb = run_on_other_cpu(other_writer);
+    tassert(pcb != NULL);
+
+    irqctx_t ctx;
+    rwlock_read_acquire(&shared, &ctx);
+    go = true;
+    bool wrote_while_reading = wait_done();
+    rwlock_read_release(&shared, &ctx);
+
+    process_wait_for(pcb, NULL);
+    tassert(!wrote_while_reading);
+    tassert(done);
+TEND
+#endif
@@ -0,0 +1,65 @@
+/**
+ * MIT License
+ * Copyright (c) 2020-present Leandro Zungri
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <test/test.h>
+#include <sync/seqlock.h>
+#include <irq/core.h>
+
+T(seqlock_read_does_not_retry_if_nothing_was_written) {
+    seqlock_t l;
+    seqlock_init(&l);
+
+    uint32_t seq = seqlock_read_begin(&l);
+    tassert(!seqlock_read_retry(&l, seq));
+TEND
+
+T(seqlock_read_retries_if_a_write_happened_in_between) {
+    seqlock_t l;
+    seqlock_init(&l);
+
+    uint32_t seq = seqlock_read_begin(&l);
+    irqctx_t ctx;
+    seqlock_write_acquire(&l, &ctx);
+    seqlock_write_release(&l, &ctx);
+    tassert(seqlock_read_retry(&l, seq));
+
+    // A new read after the write is consistent again
+    seq = seqlock_read_begin(&l);
+    tassert(!seqlock_read_retry(&l, seq));
+TEND
+
+T(seqlock_sequence_is_odd_only_while_writing) {
+    seqlock_t l;
+    seqlock_init(&l);
+    tassert((atomic32_get(&l.seq) & 1) == 0);
+
+    irqctx_t ctx;
+    seqlock_write_acquire(&l, &ctx);
+    tassert(atomic32_get(&l.seq) & 1);
+    tassert(!irq_is_enabled());
+    seqlock_write_release(&l, &ctx);
+    tassert((atomic32_get(&l.seq) & 1) == 0);
+    tassert(irq_is_enabled());
+TEND
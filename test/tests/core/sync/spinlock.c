@@ -124,3 +124,42 @@ T(spinlock_locked_by_me_returns_true_to_the_lock_process_owner) {
     process_wait_for(p1, &own_by_spinowner);
     tassert(own_by_spinowner);
 TEND
+
+#ifdef CONFIG_SYNC_LOCKDEP
+T(spinlock_lockdep_tracks_the_lock_classes_held_by_the_cpu) {
+    spinlock_t outer;
+    spinlock_t inner;
+    spinlock_t nested;
+    spinlock_init_class(&outer, LOCK_CLASS_PCB);
+    spinlock_init_class(&inner, LOCK_CLASS_RQ);
+    spinlock_init_class(&nested, LOCK_CLASS_RQ);
+    uint32_t pcbbit = 1 << LOCK_CLASS_PCB;
+    uint32_t rqbits = (1 << LOCK_CLASS_RQ) | (1 << LOCK_CLASS_RQ_NESTED);
+
+    irqctx_t outerctx;
+    spinlock_acquire(&outer, &outerctx);
+    // Irqs are disabled, the process cannot move to another cpu
+    uint32_t *held = CPU_LOCAL_GET_PTR_LOCKED(_laritos.lockdep_held);
+    tassert((*held & (pcbbit | rqbits)) == pcbbit);
+
+    irqctx_t innerctx;
+    irqctx_t nestedctx;
+    spinlock_acquire(&inner, &innerctx);
+    spinlock_acquire_nested(&nested, &nestedctx);
+    tassert((*held & (pcbbit | rqbits)) == (pcbbit | rqbits));
+    spinlock_release(&nested, &nestedctx);
+    spinlock_release(&inner, &innerctx);
+    tassert((*held & (pcbbit | rqbits)) == pcbbit);
+
+    // A trylock of an already held class is recorded as nested
+    irqctx_t tryctx;
+    spinlock_acquire(&inner, &innerctx);
+    tassert(spinlock_trylock(&nested, &tryctx));
+    tassert((*held & rqbits) == rqbits);
+    spinlock_release(&nested, &tryctx);
+    spinlock_release(&inner, &innerctx);
+    tassert((*held & (pcbbit | rqbits)) == pcbbit);
+
+    spinlock_release(&outer, &outerctx);
+TEND
+#endif